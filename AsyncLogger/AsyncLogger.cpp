@@ -0,0 +1,263 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include "MxBase/Log/Log.h"
+#include "AsyncLogger.h"
+
+namespace {
+    const unsigned int FLUSH_WAIT_TIME = 100;
+
+    const char *BaseName(const char *path)
+    {
+        const char *slash = strrchr(path, '/');
+        return slash == nullptr ? path : slash + 1;
+    }
+
+    int64_t SteadySeconds()
+    {
+        return (int64_t)std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+AsyncLogger *AsyncLogger::GetInstance()
+{
+    static AsyncLogger logger;
+    return &logger;
+}
+
+void AsyncLogger::Start(uint32_t queueSize)
+{
+    if (running) {
+        return;
+    }
+    queue.reset(new MpmcRingQueue<HotLogRecord>(queueSize));
+    running = true;
+    flusher = std::thread(&AsyncLogger::Flush, this);
+}
+
+void AsyncLogger::Stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    queue->Stop();
+    flusher.join();
+    // lines pushed while the flusher was leaving
+    for (const auto &record : queue->GetRemainItems()) {
+        Write(record);
+    }
+    if (dropped != reportedDrops) {
+        LogWarn << "hot path logger dropped " << dropped << " lines, its queue was full";
+    }
+}
+
+void AsyncLogger::Submit(HotLogRecord &record)
+{
+    if (!running.load(std::memory_order_acquire)) {
+        Write(record);
+        return;
+    }
+    if (!queue->TryPush(record)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint64_t AsyncLogger::GetDroppedCount() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+void AsyncLogger::Flush()
+{
+    HotLogRecord record;
+    while (queue->Pop(record, FLUSH_WAIT_TIME) != APP_ERR_QUEUE_STOPED) {
+        if (record.file != nullptr) {
+            Write(record);
+            record.file = nullptr;
+        }
+        uint64_t drops = dropped.load(std::memory_order_relaxed);
+        if (drops != reportedDrops && queue->IsEmpty()) {
+            LogWarn << "hot path logger dropped " << (drops - reportedDrops) << " lines, its queue was full";
+            reportedDrops = drops;
+        }
+    }
+}
+
+void AsyncLogger::Write(const HotLogRecord &record)
+{
+    std::string text(record.text, record.length);
+    const char *file = BaseName(record.file);
+    switch (record.level) {
+        case HOT_LOG_LEVEL_DEBUG:
+            LogDebug << file << ":" << record.line << "] " << text;
+            break;
+        case HOT_LOG_LEVEL_WARN:
+            LogWarn << file << ":" << record.line << "] " << text;
+            break;
+        case HOT_LOG_LEVEL_ERROR:
+            LogError << file << ":" << record.line << "] " << text;
+            break;
+        default:
+            LogInfo << file << ":" << record.line << "] " << text;
+            break;
+    }
+}
+
+bool HotLogSite::Every(uint32_t n)
+{
+    return calls.fetch_add(1, std::memory_order_relaxed) % (n == 0 ? 1 : n) == 0;
+}
+
+bool HotLogSite::Rate(uint32_t perSecond)
+{
+    int64_t second = SteadySeconds();
+    int64_t window = windowSecond.load(std::memory_order_relaxed);
+    // the first caller of a new second resets the budget
+    if (window != second && windowSecond.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+        windowCount.store(0, std::memory_order_relaxed);
+    }
+    if (windowCount.fetch_add(1, std::memory_order_relaxed) < perSecond) {
+        return true;
+    }
+    suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+uint64_t HotLogSite::TakeSuppressed()
+{
+    return suppressed.exchange(0, std::memory_order_relaxed);
+}
+
+HotLogLine::HotLogLine(int level, const char *file, int line, HotLogSite *site) : site(site)
+{
+    record.file = file;
+    record.line = line;
+    record.level = level;
+}
+
+HotLogLine::~HotLogLine()
+{
+    uint64_t suppressed = site == nullptr ? 0 : site->TakeSuppressed();
+    if (suppressed != 0) {
+        AppendFormat(" (%llu similar lines suppressed)", (unsigned long long)suppressed);
+    }
+    AsyncLogger::GetInstance()->Submit(record);
+}
+
+void HotLogLine::Append(const char *text, size_t length)
+{
+    size_t room = HOT_LOG_TEXT_SIZE - record.length;
+    if (length > room) {
+        length = room;
+    }
+    memcpy(record.text + record.length, text, length);
+    record.length += (uint32_t)length;
+}
+
+void HotLogLine::AppendFormat(const char *format, ...)
+{
+    size_t room = HOT_LOG_TEXT_SIZE - record.length;
+    if (room == 0) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(record.text + record.length, room, format, args);
+    va_end(args);
+    if (written > 0) {
+        // vsnprintf keeps one byte for its terminator, the record is length-delimited
+        record.length += (uint32_t)((size_t)written < room ? (size_t)written : room - 1);
+    }
+}
+
+HotLogLine &HotLogLine::operator<<(const char *value)
+{
+    if (value == nullptr) {
+        value = "(null)";
+    }
+    Append(value, strlen(value));
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(const std::string &value)
+{
+    Append(value.data(), value.size());
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(char value)
+{
+    Append(&value, 1);
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(bool value)
+{
+    return *this << (value ? "true" : "false");
+}
+
+HotLogLine &HotLogLine::operator<<(int value)
+{
+    AppendFormat("%d", value);
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(unsigned int value)
+{
+    AppendFormat("%u", value);
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(long value)
+{
+    AppendFormat("%ld", value);
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(unsigned long value)
+{
+    AppendFormat("%lu", value);
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(long long value)
+{
+    AppendFormat("%lld", value);
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(unsigned long long value)
+{
+    AppendFormat("%llu", value);
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(double value)
+{
+    AppendFormat("%g", value);
+    return *this;
+}
+
+HotLogLine &HotLogLine::operator<<(const void *value)
+{
+    AppendFormat("%p", value);
+    return *this;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_ASYNCLOGGER_H
+#define STREAM_PULL_SAMPLE_ASYNCLOGGER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <stdint.h>
+#include "../BlockingQueue/RingQueue.h"
+
+#define HOT_LOG_LEVEL_DEBUG 0
+#define HOT_LOG_LEVEL_INFO 1
+#define HOT_LOG_LEVEL_WARN 2
+#define HOT_LOG_LEVEL_ERROR 3
+#define HOT_LOG_LEVEL_OFF 4
+
+// Call sites below this level compile to nothing, their arguments are never evaluated.
+// Release builds raise it to HOT_LOG_LEVEL_WARN, see CMakeLists.txt.
+#ifndef HOT_LOG_LEVEL
+#define HOT_LOG_LEVEL HOT_LOG_LEVEL_INFO
+#endif
+
+static const uint32_t HOT_LOG_TEXT_SIZE = 232;
+static const uint32_t DEFAULT_HOT_LOG_QUEUE_SIZE = 4096;
+
+struct HotLogRecord {
+    const char *file = nullptr;
+    int line = 0;
+    int level = HOT_LOG_LEVEL_INFO;
+    uint32_t length = 0;
+    char text[HOT_LOG_TEXT_SIZE];
+};
+
+// Per-frame log lines for the decode and inference threads. A line is formatted into a fixed
+// buffer on the caller's stack and pushed into a lock-free ring; one background thread hands it to
+// glog. A full ring drops the line and counts it instead of blocking the caller.
+// Before Start (benchmarks, tools) and after Stop lines go to glog synchronously.
+class AsyncLogger {
+public:
+    static AsyncLogger *GetInstance();
+
+    void Start(uint32_t queueSize = DEFAULT_HOT_LOG_QUEUE_SIZE);
+    // writes out what is queued, then returns to synchronous logging
+    void Stop();
+    void Submit(HotLogRecord &record);
+    uint64_t GetDroppedCount() const;
+private:
+    AsyncLogger() = default;
+    void Flush();
+    static void Write(const HotLogRecord &record);
+private:
+    std::unique_ptr<MpmcRingQueue<HotLogRecord>> queue;
+    std::thread flusher;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> dropped{0};
+    uint64_t reportedDrops = 0;
+};
+
+// One call site's sampling state; every HotLogEvery/HotLogRate call site owns one.
+class HotLogSite {
+public:
+    // true for the 1st, (n+1)th, (2n+1)th ... call
+    bool Every(uint32_t n);
+    // true for at most perSecond calls per second, the rest are counted as suppressed
+    bool Rate(uint32_t perSecond);
+    // lines suppressed since the last call, reported with the next line that gets through
+    uint64_t TakeSuppressed();
+private:
+    std::atomic<uint64_t> calls{0};
+    std::atomic<int64_t> windowSecond{-1};
+    std::atomic<uint32_t> windowCount{0};
+    std::atomic<uint64_t> suppressed{0};
+};
+
+// Stream-style formatter into HotLogRecord, no allocation; text beyond the buffer is cut.
+class HotLogLine {
+public:
+    HotLogLine(int level, const char *file, int line, HotLogSite *site = nullptr);
+    ~HotLogLine();
+    HotLogLine(const HotLogLine &) = delete;
+    HotLogLine &operator=(const HotLogLine &) = delete;
+
+    HotLogLine &operator<<(const char *value);
+    HotLogLine &operator<<(const std::string &value);
+    HotLogLine &operator<<(char value);
+    HotLogLine &operator<<(bool value);
+    HotLogLine &operator<<(int value);
+    HotLogLine &operator<<(unsigned int value);
+    HotLogLine &operator<<(long value);
+    HotLogLine &operator<<(unsigned long value);
+    HotLogLine &operator<<(long long value);
+    HotLogLine &operator<<(unsigned long long value);
+    HotLogLine &operator<<(double value);
+    HotLogLine &operator<<(const void *value);
+private:
+    void Append(const char *text, size_t length);
+    void AppendFormat(const char *format, ...) __attribute__((format(printf, 2, 3)));
+private:
+    HotLogRecord record;
+    HotLogSite *site;
+};
+
+// the lambda gives every expansion its own static HotLogSite
+#define HOT_LOG_SITE() ([]() -> HotLogSite & { static HotLogSite site; return site; }())
+
+#define HOT_LOG_ENABLED(level) ((level) >= HOT_LOG_LEVEL)
+
+#define HotLog(level) \
+    if (!HOT_LOG_ENABLED(level)) {} else HotLogLine((level), __FILE__, __LINE__)
+#define HotLogDebug HotLog(HOT_LOG_LEVEL_DEBUG)
+#define HotLogInfo HotLog(HOT_LOG_LEVEL_INFO)
+#define HotLogWarn HotLog(HOT_LOG_LEVEL_WARN)
+#define HotLogError HotLog(HOT_LOG_LEVEL_ERROR)
+
+// every n-th line of this call site
+#define HotLogEvery(level, n) \
+    if (!HOT_LOG_ENABLED(level)) {} else \
+    for (HotLogSite *hotLogSite_ = &HOT_LOG_SITE(); hotLogSite_ != nullptr && hotLogSite_->Every(n); \
+         hotLogSite_ = nullptr) HotLogLine((level), __FILE__, __LINE__, hotLogSite_)
+// at most perSecond lines per second from this call site
+#define HotLogRate(level, perSecond) \
+    if (!HOT_LOG_ENABLED(level)) {} else \
+    for (HotLogSite *hotLogSite_ = &HOT_LOG_SITE(); hotLogSite_ != nullptr && hotLogSite_->Rate(perSecond); \
+         hotLogSite_ = nullptr) HotLogLine((level), __FILE__, __LINE__, hotLogSite_)
+
+#endif // STREAM_PULL_SAMPLE_ASYNCLOGGER_H
@@ -0,0 +1,43 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_BENCHMARKARGS_H
+#define STREAM_PULL_SAMPLE_BENCHMARKARGS_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// true when arg is the "--name=N" benchmark option, N is then stored in value; benchmarks that pass
+// the remaining arguments on to ParseAppConfig use it to tell their own options apart
+inline bool MatchArg(const char *arg, const char *name, uint32_t &value)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0) {
+        return false;
+    }
+    value = (uint32_t)atoi(arg + len);
+    return true;
+}
+
+// value of a "--name=N" benchmark option when arg is that option, otherwise value unchanged
+inline uint32_t ParseArg(const char *arg, const char *name, uint32_t value)
+{
+    MatchArg(arg, name, value);
+    return value;
+}
+
+#endif // STREAM_PULL_SAMPLE_BENCHMARKARGS_H
@@ -0,0 +1,188 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// BufferPool on host memory: first checks its accounting (reuse per size class, free-list cap,
+// handles outliving the pool, MemoryTracker's view of it), then the cost of an acquire/release pair
+// against a plain allocation of the same size, for the detector input and a keypoint crop from
+// several threads at once.
+// usage: buffer_pool_benchmark [--iterations=N] [--threads=N]
+// Exits non-zero when an accounting check fails.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "../InferenceBackend/BufferPool.h"
+#include "../Metrics/MemoryTracker.h"
+#include "BenchmarkArgs.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    // NV12 VPC outputs of a 416x416 detector input and a 256x256 keypoint crop
+    const size_t DETECT_INPUT_SIZE = 416 * 416 * 3 / 2;
+    const size_t CROP_INPUT_SIZE = 256 * 256 * 3 / 2;
+    const uint32_t SMALL_FREE_CAP = 2;
+
+    // host memory that remembers how much of it is still out
+    class CountingAllocator : public HostAllocator {
+    public:
+        APP_ERROR Malloc(size_t size, void *&data) override
+        {
+            outstanding += size;
+            return HostAllocator::Malloc(size, data);
+        }
+        void Free(void *data, size_t size) override
+        {
+            outstanding -= size;
+            HostAllocator::Free(data, size);
+        }
+        std::atomic<size_t> outstanding{0};
+    };
+
+    bool Check(bool ok, const char *what)
+    {
+        printf("  %-60s %s\n", what, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    bool CheckAccounting()
+    {
+        bool ok = true;
+        ok &= Check(BufferPool::SizeClass(1) == BufferPool::SizeClass(4096), "small sizes share the smallest class");
+        ok &= Check(BufferPool::SizeClass(DETECT_INPUT_SIZE) >= DETECT_INPUT_SIZE &&
+                    BufferPool::SizeClass(DETECT_INPUT_SIZE) <= DETECT_INPUT_SIZE * 5 / 4,
+                    "a class wastes at most a quarter");
+        ok &= Check(BufferPool::SizeClass(DETECT_INPUT_SIZE) != BufferPool::SizeClass(CROP_INPUT_SIZE),
+                    "detector and crop inputs get their own classes");
+
+        auto allocator = std::make_shared<CountingAllocator>();
+        auto pool = std::make_shared<BufferPool>(allocator,
+                                                 MxBase::MemoryData::MEMORY_HOST_NEW, 0, SMALL_FREE_CAP);
+        PooledBuffer first;
+        pool->Acquire(DETECT_INPUT_SIZE, first);
+        void *firstData = first->ptrData;
+        ok &= Check(first->size == DETECT_INPUT_SIZE, "a buffer reports the requested size");
+        first.reset();
+        PooledBuffer second;
+        pool->Acquire(DETECT_INPUT_SIZE - 1, second);
+        BufferPoolStats stats = pool->GetStats();
+        ok &= Check(second->ptrData == firstData && stats.allocations == 1 && stats.reuses == 1,
+                    "a released buffer is reused within its class");
+        second.reset();
+
+        std::vector<PooledBuffer> held(SMALL_FREE_CAP + 2);
+        for (auto &buffer : held) {
+            pool->Acquire(CROP_INPUT_SIZE, buffer);
+        }
+        ok &= Check(pool->GetStats().inUse == held.size(), "handles are counted in use");
+        held.clear();
+        stats = pool->GetStats();
+        ok &= Check(stats.inUse == 0 && stats.free == SMALL_FREE_CAP + 1,
+                    "free lists keep at most the cap per class");
+        ok &= Check(stats.bytes == BufferPool::SizeClass(DETECT_INPUT_SIZE) +
+                    SMALL_FREE_CAP * BufferPool::SizeClass(CROP_INPUT_SIZE), "bytes count the buffers kept");
+
+        InputTensorHandle tensor;
+        ok &= Check(pool->AcquireTensor({1, CROP_INPUT_SIZE}, MxBase::TENSOR_DTYPE_UINT8, CROP_INPUT_SIZE,
+                                        tensor) == APP_ERR_OK && tensor->GetBuffer() != nullptr,
+                    "a tensor borrows a pooled buffer");
+        memset(tensor->GetBuffer(), 0, CROP_INPUT_SIZE);
+        // the pool goes first, as when a backend is torn down with frames still in flight
+        pool.reset();
+        ok &= Check(allocator->outstanding == BufferPool::SizeClass(CROP_INPUT_SIZE),
+                    "a closed pool frees its free lists");
+        tensor.reset();
+        ok &= Check(allocator->outstanding == 0, "a handle outliving its pool frees its buffer");
+        MemoryUsage usage = MemoryTracker::GetInstance()->GetUsage(MxBase::MemoryData::MEMORY_HOST_NEW);
+        ok &= Check(usage.liveBuffers == 0 && usage.peakBytes == BufferPool::SizeClass(DETECT_INPUT_SIZE) +
+                    (SMALL_FREE_CAP + 2) * BufferPool::SizeClass(CROP_INPUT_SIZE),
+                    "MemoryTracker saw every buffer come and go");
+        return ok;
+    }
+
+    double MeasurePool(BufferPool &pool, uint32_t iterations, size_t size)
+    {
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < iterations; i++) {
+            PooledBuffer buffer;
+            pool.Acquire(size, buffer);
+            ((volatile uint8_t*)buffer->ptrData)[0] = (uint8_t)i;
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double MeasureNew(uint32_t iterations, size_t size)
+    {
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < iterations; i++) {
+            uint8_t *data = new uint8_t[size];
+            ((volatile uint8_t*)data)[0] = (uint8_t)i;
+            delete[] data;
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // per-pair cost in ns with threadNum threads sharing the pool
+    void Measure(uint32_t iterations, uint32_t threadNum, size_t size, double &poolNs, double &newNs)
+    {
+        BufferPool pool(std::make_shared<HostAllocator>(), MxBase::MemoryData::MEMORY_HOST_NEW, 0);
+        std::vector<double> poolSeconds(threadNum);
+        std::vector<double> newSeconds(threadNum);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadNum; t++) {
+            threads.emplace_back([&, t]() {
+                poolSeconds[t] = MeasurePool(pool, iterations, size);
+                newSeconds[t] = MeasureNew(iterations, size);
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        poolNs = 0;
+        newNs = 0;
+        for (uint32_t t = 0; t < threadNum; t++) {
+            poolNs += poolSeconds[t] * 1e9 / iterations / threadNum;
+            newNs += newSeconds[t] * 1e9 / iterations / threadNum;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t iterations = 100000;
+    uint32_t threadNum = 4;
+    for (int i = 1; i < argc; i++) {
+        iterations = ParseArg(argv[i], "--iterations=", iterations);
+        threadNum = ParseArg(argv[i], "--threads=", threadNum);
+    }
+    if (iterations == 0 || threadNum == 0) {
+        printf("usage: %s [--iterations=N] [--threads=N]\n", argv[0]);
+        return 1;
+    }
+    printf("accounting:\n");
+    bool ok = CheckAccounting();
+    const size_t sizes[] = {DETECT_INPUT_SIZE, CROP_INPUT_SIZE};
+    for (size_t size : sizes) {
+        double poolNs = 0;
+        double newNs = 0;
+        Measure(iterations, threadNum, size, poolNs, newNs);
+        printf("%7lu bytes, %u threads: pool %.1f ns, new[]/delete[] %.1f ns per acquire/release\n",
+               (unsigned long)size, threadNum, poolNs, newNs);
+    }
+    return ok ? 0 : 1;
+}
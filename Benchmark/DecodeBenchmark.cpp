@@ -0,0 +1,204 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decode throughput of one H.264/H.265 file on either decoder, demux and NV12 output included,
+// so a host without VDEC can be sized for the software decoder.
+// usage: decode_benchmark FILE [--decoder=dvpp|cpu] [--threads=N] [--frames=N]
+// --threads is the libavcodec thread count (0 one per core), --frames stops after N packets (0 the whole file).
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include "MxBase/Log/Log.h"
+#include "MxBase/DeviceManager/DeviceManager.h"
+#include "../Config/AppConfig.h"
+#include "../VideoDecoder/VideoDecoder.h"
+#include "BenchmarkArgs.h"
+
+extern "C"{
+#include "libavformat/avformat.h"
+}
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const uint32_t DEVICE_ID = 0;
+    // VDEC returns frames asynchronously, stop waiting for the rest after this long without one
+    const uint32_t DRAIN_TIMEOUT_MS = 1000;
+    const uint32_t DRAIN_POLL_MS = 5;
+
+    int FindVideoStream(AVFormatContext *formatContext)
+    {
+        for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
+            if (formatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    // the same Annex-B conversion VideoProcess applies to MP4/MKV input
+    AVBSFContext *OpenBitstreamFilter(const AVStream *stream)
+    {
+        const AVCodecParameters *codecpar = stream->codecpar;
+        if (codecpar->extradata == nullptr || codecpar->extradata_size == 0 || codecpar->extradata[0] != 1) {
+            return nullptr;
+        }
+        const AVBitStreamFilter *filter = av_bsf_get_by_name(codecpar->codec_id == AV_CODEC_ID_HEVC ?
+                                                             "hevc_mp4toannexb" : "h264_mp4toannexb");
+        AVBSFContext *bsfContext = nullptr;
+        if (filter == nullptr || av_bsf_alloc(filter, &bsfContext) < 0) {
+            return nullptr;
+        }
+        avcodec_parameters_copy(bsfContext->par_in, codecpar);
+        bsfContext->time_base_in = stream->time_base;
+        if (av_bsf_init(bsfContext) < 0) {
+            av_bsf_free(&bsfContext);
+        }
+        return bsfContext;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || strncmp(argv[1], "--", 2) == 0) {
+        printf("usage: %s FILE [--decoder=dvpp|cpu] [--threads=N] [--frames=N]\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[1];
+    DecoderType decoderType = DECODER_DVPP;
+    uint32_t threads = 0;
+    uint32_t maxFrames = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strncmp(argv[i], "--decoder=", strlen("--decoder=")) == 0 &&
+            ParseDecoderType(argv[i] + strlen("--decoder="), decoderType) != APP_ERR_OK) {
+            return 1;
+        }
+        threads = ParseArg(argv[i], "--threads=", threads);
+        maxFrames = ParseArg(argv[i], "--frames=", maxFrames);
+    }
+
+    AVFormatContext *formatContext = nullptr;
+    if (avformat_open_input(&formatContext, path, nullptr, nullptr) != 0 ||
+        avformat_find_stream_info(formatContext, nullptr) < 0) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+    int videoIndex = FindVideoStream(formatContext);
+    if (videoIndex < 0 || !IsSupportedCodec(formatContext->streams[videoIndex]->codecpar->codec_id)) {
+        printf("%s has no H.264/H.265 video stream\n", path);
+        avformat_close_input(&formatContext);
+        return 1;
+    }
+    AVStream *stream = formatContext->streams[videoIndex];
+    AVBSFContext *bsfContext = OpenBitstreamFilter(stream);
+
+    if (decoderType == DECODER_DVPP) {
+        MxBase::DeviceContext device;
+        device.devId = DEVICE_ID;
+        if (MxBase::DeviceManager::GetInstance()->InitDevices() != APP_ERR_OK ||
+            MxBase::DeviceManager::GetInstance()->SetDevice(device) != APP_ERR_OK) {
+            printf("no Ascend device, try --decoder=cpu\n");
+            return 1;
+        }
+    }
+    std::shared_ptr<VideoDecoder> decoder = CreateVideoDecoder(decoderType);
+    DecoderInitParam param;
+    param.codecpar = bsfContext != nullptr ? bsfContext->par_out : stream->codecpar;
+    param.deviceId = DEVICE_ID;
+    param.threadNum = threads;
+    // the software decoder's frames stay on the host, as they do for the CPU inference backend
+    param.outputMemoryType = decoderType == DECODER_DVPP ?
+        MxBase::MemoryData::MEMORY_DVPP : MxBase::MemoryData::MEMORY_HOST_NEW;
+    std::atomic<uint64_t> decoded(0);
+    APP_ERROR ret = decoder->Init(param, [&decoded](const std::shared_ptr<MxBase::MemoryData> &,
+                                                    const FrameGeometry &, uint32_t) {
+        decoded.fetch_add(1, std::memory_order_relaxed);
+    });
+    if (ret != APP_ERR_OK) {
+        printf("decoder init failed, ret=%d\n", ret);
+        return 1;
+    }
+
+    uint32_t submitted = 0;
+    uint32_t failed = 0;
+    auto submit = [&](AVPacket &pkt) {
+        if (decoder->Decode(pkt.data, (size_t)pkt.size, (uint32_t)stream->codecpar->width,
+                            (uint32_t)stream->codecpar->height, submitted) == APP_ERR_OK) {
+            submitted++;
+        } else {
+            failed++;
+        }
+    };
+    AVPacket pkt;
+    AVPacket filtered;
+    av_init_packet(&filtered);
+    filtered.data = nullptr;
+    filtered.size = 0;
+    auto start = Clock::now();
+    while (maxFrames == 0 || submitted < maxFrames) {
+        av_init_packet(&pkt);
+        if (av_read_frame(formatContext, &pkt) < 0) {
+            break;
+        }
+        if (pkt.stream_index != videoIndex) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+        if (bsfContext == nullptr) {
+            submit(pkt);
+            av_packet_unref(&pkt);
+            continue;
+        }
+        if (av_bsf_send_packet(bsfContext, &pkt) < 0) {
+            av_packet_unref(&pkt);
+            failed++;
+            continue;
+        }
+        while (av_bsf_receive_packet(bsfContext, &filtered) == 0) {
+            submit(filtered);
+            av_packet_unref(&filtered);
+        }
+    }
+    decoder->Flush();
+    uint64_t seen = decoded.load();
+    auto lastProgress = Clock::now();
+    while (seen < submitted && Clock::now() - lastProgress < std::chrono::milliseconds(DRAIN_TIMEOUT_MS)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_POLL_MS));
+        if (decoded.load() != seen) {
+            seen = decoded.load();
+            lastProgress = Clock::now();
+        }
+    }
+    // up to the last frame, not the idle drain timeout
+    double seconds = std::chrono::duration<double>(lastProgress - start).count();
+
+    printf("%s %s %dx%d decoder=%s threads=%u: %llu frames from %u packets (%u failed) in %.3f s, %.1f fps\n",
+           path, avcodec_get_name(stream->codecpar->codec_id), stream->codecpar->width, stream->codecpar->height,
+           DecoderTypeName(decoderType), threads, (unsigned long long)decoded.load(), submitted, failed, seconds,
+           decoded.load() / seconds);
+    decoder->DeInit();
+    if (bsfContext != nullptr) {
+        av_bsf_free(&bsfContext);
+    }
+    avformat_close_input(&formatContext);
+    if (decoderType == DECODER_DVPP) {
+        MxBase::DeviceManager::GetInstance()->DestroyDevices();
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host cost of GestureEngine::Process per frame, on synthetic hands that cycle through every gesture
+// with a few pixels of keypoint jitter, and the gesture events it reports for them.
+// usage: gesture_benchmark [--frames=N] [--hands=N] [--hold=N] [--jitter=PX]
+// --hold is how many frames each pose is kept, --jitter the uniform noise added to every keypoint.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../GestureEngine/GestureEngine.h"
+#include "BenchmarkArgs.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const float BOX_SIZE = 200.0f;
+    const float HAND_SPACING = 300.0f;
+    const int64_t FRAME_INTERVAL_US = 40000;
+    const uint32_t FINGER_JOINTS = 4;
+
+    struct Pose {
+        GestureType gesture;
+        bool thumbUp;       // false: thumb folded over the palm
+        bool fingers[4];    // index, middle, ring, pinky extended
+    };
+
+    const Pose POSES[] = {
+        {GESTURE_OPEN_HAND, true, {true, true, true, true}},
+        {GESTURE_FIST, false, {false, false, false, false}},
+        {GESTURE_THUMBS_UP, true, {false, false, false, false}},
+        {GESTURE_POINTING, false, {true, false, false, false}},
+        {GESTURE_VICTORY, false, {true, true, false, false}},
+    };
+    const uint32_t POSE_NUM = sizeof(POSES) / sizeof(POSES[0]);
+
+    // an upright right hand in a BOX_SIZE box, frame pixels: wrist at the bottom, fingers up
+    void MakeKeypoints(const Pose &pose, float *points)
+    {
+        const float wrist[2] = {100, 190};
+        // thumb: carpal, knuckle, joint, tip; out and up, or folded over the palm
+        const float thumbOut[8] = {80, 170, 55, 150, 30, 118, 10, 90};
+        const float thumbIn[8] = {80, 170, 75, 150, 85, 135, 95, 130};
+        points[0] = wrist[0];
+        points[1] = wrist[1];
+        memcpy(points + 2, pose.thumbUp ? thumbOut : thumbIn, sizeof(thumbOut));
+        for (uint32_t f = 0; f < 4; f++) {
+            float bx = 70 + 20 * f;
+            float by = 100;
+            // extended: straight up; folded: the middle joint points up, the rest curls back down
+            const float up[6] = {bx, by - 25, bx, by - 45, bx, by - 60};
+            const float curled[6] = {bx, by - 20, bx, by - 5, bx, by + 10};
+            float *finger = points + ((f + 1) * FINGER_JOINTS + 1) * 2;
+            finger[0] = bx;
+            finger[1] = by;
+            memcpy(finger + 2, pose.fingers[f] ? up : curled, sizeof(up));
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t frames = 10000;
+    uint32_t handNum = 2;
+    uint32_t hold = 30;
+    uint32_t jitter = 2;
+    for (int i = 1; i < argc; i++) {
+        frames = ParseArg(argv[i], "--frames=", frames);
+        handNum = ParseArg(argv[i], "--hands=", handNum);
+        hold = ParseArg(argv[i], "--hold=", hold);
+        jitter = ParseArg(argv[i], "--jitter=", jitter);
+    }
+    if (frames == 0 || hold == 0) {
+        printf("usage: %s [--frames=N] [--hands=N] [--hold=N] [--jitter=PX]\n", argv[0]);
+        return 1;
+    }
+    GestureParam param;
+    GestureEngine engine(param, "");
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> noise(-(float)jitter, (float)jitter);
+    std::vector<HandResult> hands(handNum);
+    float points[GestureEngine::KEYPOINT_NUM * 2];
+    uint32_t expected = 0;
+    uint32_t correct = 0;
+    uint32_t wrong = 0;
+    double seconds = 0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        const Pose &pose = POSES[(frame / hold) % POSE_NUM];
+        if (frame % hold == 0) {
+            expected += handNum;
+        }
+        MakeKeypoints(pose, points);
+        for (uint32_t h = 0; h < handNum; h++) {
+            HandResult &hand = hands[h];
+            hand.box.x0 = h * HAND_SPACING;
+            hand.box.y0 = 0;
+            hand.box.x1 = hand.box.x0 + BOX_SIZE;
+            hand.box.y1 = BOX_SIZE;
+            hand.keypoints.resize(GestureEngine::KEYPOINT_NUM * 2);
+            for (uint32_t k = 0; k < GestureEngine::KEYPOINT_NUM * 2; k++) {
+                hand.keypoints[k] = (points[k] + noise(random)) / BOX_SIZE;
+            }
+        }
+        // 只计时手势引擎本身，合成关键点不计入
+        auto start = Clock::now();
+        engine.Process((int64_t)frame * FRAME_INTERVAL_US + 1, hands);
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        for (const auto &hand : hands) {
+            if (hand.gestureStart) {
+                hand.gesture == pose.gesture ? correct++ : wrong++;
+            }
+        }
+    }
+    printf("%u frames x %u hands, jitter %u px, pose held %u frames: %.3f us per frame, %.3f us per hand\n",
+           frames, handNum, jitter, hold, seconds * 1e6 / frames, handNum == 0 ? 0 : seconds * 1e6 / frames / handNum);
+    printf("gesture events: %u correct, %u wrong, %u pose changes\n", correct, wrong, expected);
+    return 0;
+}
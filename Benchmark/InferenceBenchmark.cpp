@@ -0,0 +1,199 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Per-frame cost of the GetResults steps (resize, detect, postprocess, crop, keypoints) on a
+// synthetic NV12 frame (1080p unless --width/--height say otherwise), for capacity planning on either backend.
+// usage: inference_benchmark [--frames=N] [--threads=N] [--hands=N] [--width=N] [--height=N]
+//                            [--backend=ascend|cpu] [--yolo-model=..] [--resnet-model=..] [--max-hands=N]
+//                            [--detect-input=N] [--keypoint-input=N]
+// --hands is the number of crops per frame sent to the keypoint model (batched up to --max-hands).
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "MxBase/Log/Log.h"
+#include "MxBase/DeviceManager/DeviceManager.h"
+#include "../Config/AppConfig.h"
+#include "../Yolov3Detection/Yolov3Detection.h"
+#include "../ResnetDetector/ResnetDetector.h"
+#include "BenchmarkArgs.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const uint32_t DEFAULT_FRAME_WIDTH = 1920;
+    const uint32_t DEFAULT_FRAME_HEIGHT = 1080;
+    // fixed centered hand box so the keypoint stage always runs, detections on noise are not needed;
+    // its side is this share of the frame height (400 px at 1080p)
+    const float CROP_SHARE = 0.37f;
+
+    enum Step { STEP_RESIZE = 0, STEP_DETECT, STEP_POSTPROCESS, STEP_CROP, STEP_KEYPOINTS, STEP_NUM };
+    const char *STEP_NAMES[STEP_NUM] = {"resize", "detect", "postprocess", "crop", "keypoints"};
+
+    struct StepCost {
+        std::atomic<uint64_t> totalNs[STEP_NUM];
+        std::atomic<uint64_t> frames;
+
+        StepCost() : frames(0)
+        {
+            for (int i = 0; i < STEP_NUM; i++) {
+                totalNs[i] = 0;
+            }
+        }
+    };
+
+    uint64_t Since(Clock::time_point &last)
+    {
+        auto now = Clock::now();
+        uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+        last = now;
+        return ns;
+    }
+
+    void RunFrames(uint32_t frames, uint32_t hands, uint32_t deviceId, std::shared_ptr<MxBase::MemoryData> frame,
+                   FrameGeometry geometry, std::shared_ptr<Yolov3Detection> yolov3,
+                   std::shared_ptr<ResnetDetector> resnet, StepCost *cost)
+    {
+        uint32_t side = (uint32_t)(geometry.height * CROP_SHARE);
+        uint32_t cropX0 = (geometry.width - side) / 2;
+        uint32_t cropY0 = (geometry.height - side) / 2;
+        MxBase::DeviceContext device;
+        device.devId = deviceId;
+        MxBase::DeviceManager::GetInstance()->SetDevice(device);
+        for (uint32_t i = 0; i < frames; i++) {
+            auto last = Clock::now();
+            InputTensorHandle resizeFrame;
+            if (yolov3->ResizeFrame(frame, geometry, resizeFrame) != APP_ERR_OK) {
+                return;
+            }
+            cost->totalNs[STEP_RESIZE] += Since(last);
+            std::vector<MxBase::TensorBase> inputs = {*resizeFrame};
+            OutputTensorHandle outputs;
+            if (yolov3->Inference(inputs, outputs) != APP_ERR_OK) {
+                return;
+            }
+            cost->totalNs[STEP_DETECT] += Since(last);
+            std::vector<std::vector<MxBase::ObjectInfo>> objInfos;
+            if (yolov3->PostProcess(*outputs, geometry.height, geometry.width, objInfos) != APP_ERR_OK) {
+                return;
+            }
+            cost->totalNs[STEP_POSTPROCESS] += Since(last);
+            std::vector<InputTensorHandle> cropHandles(hands);
+            std::vector<MxBase::TensorBase> crops;
+            for (uint32_t h = 0; h < hands; h++) {
+                if (resnet->CropAndResizeFrame(frame, geometry, cropX0, cropY0, cropX0 + side - 1, cropY0 + side - 1,
+                                               cropHandles[h]) != APP_ERR_OK) {
+                    return;
+                }
+                crops.push_back(*cropHandles[h]);
+            }
+            cost->totalNs[STEP_CROP] += Since(last);
+            std::vector<std::vector<float>> keypoints;
+            if (resnet->BatchInference(crops, keypoints) != APP_ERR_OK) {
+                return;
+            }
+            cost->totalNs[STEP_KEYPOINTS] += Since(last);
+            cost->frames++;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t frames = 200;
+    uint32_t threads = 1;
+    uint32_t hands = 1;
+    uint32_t width = DEFAULT_FRAME_WIDTH;
+    uint32_t height = DEFAULT_FRAME_HEIGHT;
+    // benchmark options first, the rest is the regular command line
+    std::vector<char*> appArgs = {argv[0]};
+    for (int i = 1; i < argc; i++) {
+        if (!MatchArg(argv[i], "--frames=", frames) && !MatchArg(argv[i], "--threads=", threads) &&
+            !MatchArg(argv[i], "--hands=", hands) && !MatchArg(argv[i], "--width=", width) &&
+            !MatchArg(argv[i], "--height=", height)) {
+            appArgs.push_back(argv[i]);
+        }
+    }
+    AppConfig config;
+    APP_ERROR ret = ParseAppConfig((int)appArgs.size(), appArgs.data(), config);
+    if (ret != APP_ERR_OK) {
+        PrintUsage(argv[0]);
+        return ret;
+    }
+    const uint32_t deviceId = 0;
+    if (config.backendType == BACKEND_ASCEND) {
+        ret = MxBase::DeviceManager::GetInstance()->InitDevices();
+        if (ret != APP_ERR_OK) {
+            LogError << "InitDevices failed";
+            return ret;
+        }
+    }
+    auto yolov3 = std::make_shared<Yolov3Detection>();
+    auto resnet = std::make_shared<ResnetDetector>();
+    InitParam initParam;
+    InitYolov3Param(config, initParam, deviceId);
+    ResnetInitParam resInitParam;
+    InitResnetParam(config, resInitParam, deviceId);
+    ret = yolov3->FrameInit(initParam);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    ret = resnet->Init(resInitParam);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    // laid out like VDEC output on the Ascend backend
+    FrameGeometry geometry = config.backendType == BACKEND_ASCEND ?
+        MakeFrameGeometry(width, height, DVPP_WIDTH_ALIGN, DVPP_HEIGHT_ALIGN) : MakeFrameGeometry(width, height);
+    std::shared_ptr<MxBase::MemoryData> frame;
+    ret = CreateWarmupFrame(config.backendType, deviceId, geometry, frame, FRAME_PATTERN_NOISE);
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to prepare the benchmark frame";
+        return ret;
+    }
+
+    // first-call allocations stay out of the measurement
+    if (yolov3->Warmup(geometry) != APP_ERR_OK || resnet->Warmup(geometry) != APP_ERR_OK) {
+        LogError << "Warm-up failed";
+        return APP_ERR_COMM_FAILURE;
+    }
+
+    StepCost cost;
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threads; t++) {
+        workers.emplace_back(RunFrames, frames, hands, deviceId, frame, geometry, yolov3, resnet, &cost);
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("backend=%s frame=%ux%u threads=%u hands=%u frames=%lu wall=%.2fs throughput=%.1f fps\n",
+           BackendTypeName(config.backendType), width, height, threads, hands, (unsigned long)cost.frames.load(),
+           seconds, cost.frames.load() / seconds);
+    for (int i = 0; i < STEP_NUM; i++) {
+        double meanMs = cost.frames.load() == 0 ? 0 : cost.totalNs[i].load() / 1e6 / cost.frames.load();
+        printf("  %-12s %8.2f ms/frame\n", STEP_NAMES[i], meanMs);
+    }
+    frame.reset();
+    resnet->DeInit();
+    yolov3->FrameDeInit();
+    if (config.backendType == BACKEND_ASCEND) {
+        MxBase::DeviceManager::GetInstance()->DestroyDevices();
+    }
+    return 0;
+}
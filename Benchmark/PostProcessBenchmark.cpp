@@ -0,0 +1,161 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// YOLOv3 decode + NMS cost per frame: SDK Yolov3PostProcess vs the in-tree HandDecoder, on synthetic
+// 13/26/52 outputs of the hand model with a few planted hands and background everywhere else.
+// usage: postprocess_benchmark [--frames=N] [--hands=N]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "MxBase/Log/Log.h"
+#include "../Config/AppConfig.h"
+#include "../Yolov3Detection/Yolov3Detection.h"
+#include "BenchmarkArgs.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const uint32_t MODEL_INPUT_SIZE = 416;
+    const uint32_t GRIDS[YOLO_LAYER_NUM] = {13, 26, 52};
+    const uint32_t FRAME_WIDTH = 1920;
+    const uint32_t FRAME_HEIGHT = 1080;
+    const float BACKGROUND_MIN = -12.0f;
+    const float BACKGROUND_MAX = -4.0f;
+    const float HAND_LOGIT = 4.0f;
+
+    struct SyntheticOutputs {
+        std::vector<OutputTensorDesc> descs;
+        std::vector<std::vector<float>> data;
+    };
+
+    void MakeOutputs(uint32_t hands, SyntheticOutputs &outputs)
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> background(BACKGROUND_MIN, BACKGROUND_MAX);
+        for (uint32_t i = 0; i < YOLO_LAYER_NUM; i++) {
+            OutputTensorDesc desc;
+            desc.shape = {1, HandDecoder::LAYER_CHANNELS, GRIDS[i], GRIDS[i]};
+            outputs.descs.push_back(desc);
+            std::vector<float> layer(HandDecoder::LAYER_CHANNELS * GRIDS[i] * GRIDS[i]);
+            for (auto &v : layer) {
+                v = background(rng);
+            }
+            outputs.data.push_back(layer);
+        }
+        // one confident cell per hand, spread over the layers so NMS has nothing to merge
+        for (uint32_t h = 0; h < hands; h++) {
+            uint32_t layer = h % YOLO_LAYER_NUM;
+            uint32_t plane = GRIDS[layer] * GRIDS[layer];
+            uint32_t cell = (h * 7919u) % plane;
+            float *base = outputs.data[layer].data() + (h % 3) * HandDecoder::CHANNELS_PER_ANCHOR * plane;
+            base[cell] = 0;
+            base[plane + cell] = 0;
+            base[2 * plane + cell] = 0;
+            base[3 * plane + cell] = 0;
+            base[4 * plane + cell] = HAND_LOGIT;
+            base[5 * plane + cell] = HAND_LOGIT;
+        }
+    }
+
+    double RunNative(const InitParam &initParam, SyntheticOutputs &outputs, uint32_t frames, uint32_t &boxNum)
+    {
+        std::vector<std::vector<float>> layerAnchors;
+        if (Yolov3Detection::GetLayerAnchors(initParam, outputs.descs, layerAnchors) != APP_ERR_OK) {
+            return -1;
+        }
+        HandDecoder decoder(strtof(initParam.objectnessThresh.c_str(), nullptr),
+                            strtof(initParam.scoreThresh.c_str(), nullptr),
+                            strtof(initParam.iouThresh.c_str(), nullptr), MODEL_INPUT_SIZE, MODEL_INPUT_SIZE);
+        HandDecoder::Layer layers[YOLO_LAYER_NUM];
+        for (uint32_t i = 0; i < YOLO_LAYER_NUM; i++) {
+            layers[i].data = outputs.data[i].data();
+            layers[i].gridH = GRIDS[i];
+            layers[i].gridW = GRIDS[i];
+            layers[i].anchors = layerAnchors[i].data();
+        }
+        HandDecoder::Box boxes[HandDecoder::MAX_BOXES];
+        auto start = Clock::now();
+        for (uint32_t f = 0; f < frames; f++) {
+            boxNum = decoder.Decode(layers, YOLO_LAYER_NUM, boxes);
+        }
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+    }
+
+    double RunSdk(const InitParam &initParam, SyntheticOutputs &outputs, uint32_t frames, uint32_t &boxNum)
+    {
+        std::map<std::string, std::shared_ptr<void>> config;
+        Yolov3Detection::SetYolov3PostProcessConfig(initParam, config);
+        MxBase::Yolov3PostProcess post;
+        if (post.Init(config) != APP_ERR_OK) {
+            LogError << "Yolov3PostProcess init failed";
+            return -1;
+        }
+        std::vector<MxBase::TensorBase> tensors;
+        for (uint32_t i = 0; i < YOLO_LAYER_NUM; i++) {
+            MxBase::MemoryData memory(outputs.data[i].data(), outputs.data[i].size() * sizeof(float),
+                                      MxBase::MemoryData::MEMORY_HOST, initParam.deviceId);
+            tensors.push_back(MxBase::TensorBase(memory, false, outputs.descs[i].shape, MxBase::TENSOR_DTYPE_FLOAT32));
+        }
+        MxBase::ResizedImageInfo imgInfo;
+        imgInfo.widthOriginal = FRAME_WIDTH;
+        imgInfo.heightOriginal = FRAME_HEIGHT;
+        imgInfo.widthResize = MODEL_INPUT_SIZE;
+        imgInfo.heightResize = MODEL_INPUT_SIZE;
+        imgInfo.resizeType = MxBase::RESIZER_STRETCHING;
+        std::vector<MxBase::ResizedImageInfo> imageInfoVec = {imgInfo};
+        std::vector<std::vector<MxBase::ObjectInfo>> objInfos;
+        auto start = Clock::now();
+        for (uint32_t f = 0; f < frames; f++) {
+            objInfos.clear();
+            post.Process(tensors, objInfos, imageInfoVec);
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+        boxNum = objInfos.empty() ? 0 : (uint32_t)objInfos[0].size();
+        post.DeInit();
+        return us;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t frames = 1000;
+    uint32_t hands = 2;
+    for (int i = 1; i < argc; i++) {
+        frames = ParseArg(argv[i], "--frames=", frames);
+        hands = ParseArg(argv[i], "--hands=", hands);
+    }
+    if (frames == 0) {
+        frames = 1;
+    }
+    AppConfig appConfig;
+    InitParam initParam;
+    InitYolov3Param(appConfig, initParam, 0);
+    SyntheticOutputs outputs;
+    MakeOutputs(hands, outputs);
+
+    uint32_t nativeBoxes = 0;
+    uint32_t sdkBoxes = 0;
+    double nativeUs = RunNative(initParam, outputs, frames, nativeBoxes);
+    double sdkUs = RunSdk(initParam, outputs, frames, sdkBoxes);
+    printf("planted hands=%u frames=%u\n", hands, frames);
+    printf("  %-20s %10.1f us/frame boxes=%u\n", "Yolov3PostProcess", sdkUs, sdkBoxes);
+    printf("  %-20s %10.1f us/frame boxes=%u\n", "HandDecoder", nativeUs, nativeBoxes);
+    if (nativeUs > 0 && sdkUs > 0) {
+        printf("  speedup %.1fx\n", sdkUs / nativeUs);
+    }
+    return 0;
+}
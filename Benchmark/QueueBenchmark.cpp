@@ -0,0 +1,191 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Handoff cost of the decoded-frame queue: BlockingQueue vs SpscRingQueue vs MpmcRingQueue.
+// usage: queue_benchmark [streams] [seconds]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../BlockingQueue/BlockingQueue.h"
+#include "../BlockingQueue/RingQueue.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const uint32_t QUEUE_LENGTH = 64;
+    const uint32_t BURST_ITEMS = 1000000;
+    const uint32_t STREAM_FPS = 30;
+    const uint32_t POP_WAIT_TIME = 10;
+
+    // stands in for the MemoryData a decoded frame carries through the queue
+    struct FrameStamp {
+        Clock::time_point pushTime;
+    };
+
+    std::shared_ptr<void> MakeFrame()
+    {
+        auto stamp = std::make_shared<FrameStamp>();
+        stamp->pushTime = Clock::now();
+        return stamp;
+    }
+
+    double ElapsedNs(const Clock::time_point &from, const Clock::time_point &to)
+    {
+        return std::chrono::duration<double, std::nano>(to - from).count();
+    }
+
+    void PrintLatency(const char *name, const char *scenario, std::vector<double> &latency)
+    {
+        if (latency.empty()) {
+            printf("%-16s %-10s no samples\n", name, scenario);
+            return;
+        }
+        std::sort(latency.begin(), latency.end());
+        double sum = 0;
+        for (double v : latency) {
+            sum += v;
+        }
+        printf("%-16s %-10s samples=%-8zu mean=%9.0fns p50=%9.0fns p99=%9.0fns max=%9.0fns\n", name, scenario,
+               latency.size(), sum / latency.size(), latency[latency.size() / 2],
+               latency[latency.size() * 99 / 100], latency.back());
+    }
+
+    // one producer pushes as fast as the queue accepts, one consumer drains
+    template<typename Q> void RunBurst(const char *name)
+    {
+        Q queue(QUEUE_LENGTH);
+        auto start = Clock::now();
+        std::thread consumer([&queue]() {
+            std::shared_ptr<void> item;
+            for (uint32_t i = 0; i < BURST_ITEMS; i++) {
+                while (queue.Pop(item, POP_WAIT_TIME) != APP_ERR_OK) {
+                }
+            }
+        });
+        std::vector<std::shared_ptr<void>> frames;
+        for (uint32_t i = 0; i < QUEUE_LENGTH * 2; i++) {
+            frames.push_back(MakeFrame());
+        }
+        for (uint32_t i = 0; i < BURST_ITEMS; i++) {
+            queue.Push(frames[i % frames.size()], true);
+        }
+        consumer.join();
+        double totalNs = ElapsedNs(start, Clock::now());
+        printf("%-16s %-10s items=%-10u %.1f ns/handoff %.2f Mitems/s\n", name, "burst", BURST_ITEMS,
+               totalNs / BURST_ITEMS, BURST_ITEMS * 1000.0 / totalNs);
+    }
+
+    // every stream produces 30 frames per second into its own queue with its own consumer,
+    // which is how decode and inference are paired per camera
+    template<typename Q> void RunPacedPerStream(const char *name, uint32_t streams, uint32_t seconds)
+    {
+        std::vector<std::unique_ptr<Q>> queues;
+        std::vector<std::vector<double>> latency(streams);
+        for (uint32_t s = 0; s < streams; s++) {
+            queues.emplace_back(new Q(QUEUE_LENGTH));
+        }
+        std::vector<std::thread> threads;
+        const uint32_t frames = seconds * STREAM_FPS;
+        for (uint32_t s = 0; s < streams; s++) {
+            Q *queue = queues[s].get();
+            std::vector<double> *samples = &latency[s];
+            threads.emplace_back([queue, samples, frames]() {
+                std::shared_ptr<void> item;
+                for (uint32_t i = 0; i < frames; i++) {
+                    while (queue->Pop(item, POP_WAIT_TIME) != APP_ERR_OK) {
+                    }
+                    samples->push_back(ElapsedNs(std::static_pointer_cast<FrameStamp>(item)->pushTime, Clock::now()));
+                }
+            });
+            threads.emplace_back([queue, frames]() {
+                auto next = Clock::now();
+                for (uint32_t i = 0; i < frames; i++) {
+                    next += std::chrono::microseconds(1000000 / STREAM_FPS);
+                    std::this_thread::sleep_until(next);
+                    queue->Push(MakeFrame(), true);
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        std::vector<double> all;
+        for (auto &samples : latency) {
+            all.insert(all.end(), samples.begin(), samples.end());
+        }
+        PrintLatency(name, "paced", all);
+    }
+
+    // all streams fan in to one shared queue drained by a single inference thread
+    template<typename Q> void RunPacedFanIn(const char *name, uint32_t streams, uint32_t seconds)
+    {
+        Q queue(QUEUE_LENGTH);
+        std::vector<double> latency;
+        const uint32_t frames = seconds * STREAM_FPS;
+        std::thread consumer([&queue, &latency, frames, streams]() {
+            std::shared_ptr<void> item;
+            for (uint32_t i = 0; i < frames * streams; i++) {
+                while (queue.Pop(item, POP_WAIT_TIME) != APP_ERR_OK) {
+                }
+                latency.push_back(ElapsedNs(std::static_pointer_cast<FrameStamp>(item)->pushTime, Clock::now()));
+            }
+        });
+        std::vector<std::thread> producers;
+        for (uint32_t s = 0; s < streams; s++) {
+            producers.emplace_back([&queue, frames]() {
+                auto next = Clock::now();
+                for (uint32_t i = 0; i < frames; i++) {
+                    next += std::chrono::microseconds(1000000 / STREAM_FPS);
+                    std::this_thread::sleep_until(next);
+                    queue.Push(MakeFrame(), true);
+                }
+            });
+        }
+        for (auto &t : producers) {
+            t.join();
+        }
+        consumer.join();
+        PrintLatency(name, "fan-in", latency);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t streams = 8;
+    uint32_t seconds = 5;
+    if (argc > 1) {
+        streams = (uint32_t)atoi(argv[1]);
+    }
+    if (argc > 2) {
+        seconds = (uint32_t)atoi(argv[2]);
+    }
+    typedef BlockingQueue<std::shared_ptr<void>> Blocking;
+    typedef SpscRingQueue<std::shared_ptr<void>> Spsc;
+    typedef MpmcRingQueue<std::shared_ptr<void>> Mpmc;
+
+    printf("queue length %u, %u streams at %u fps for %u s\n", QUEUE_LENGTH, streams, STREAM_FPS, seconds);
+    RunBurst<Blocking>("BlockingQueue");
+    RunBurst<Spsc>("SpscRingQueue");
+    RunBurst<Mpmc>("MpmcRingQueue");
+    RunPacedPerStream<Blocking>("BlockingQueue", streams, seconds);
+    RunPacedPerStream<Spsc>("SpscRingQueue", streams, seconds);
+    RunPacedFanIn<Blocking>("BlockingQueue", streams, seconds);
+    RunPacedFanIn<Mpmc>("MpmcRingQueue", streams, seconds);
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Result protocol v2: encode/decode cost, then loopback throughput, loss and latency through
+// ResultReceiver. The sender stamps sendUs and the receiver takes the delta on the same clock.
+// usage: result_protocol_benchmark [--packets=N] [--hands=N] [--rate=PPS] [--port=P]
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../ResultProtocol/ResultProtocol.h"
+#include "../ResultProtocol/ResultReceiver.h"
+#include "BenchmarkArgs.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const uint32_t CODEC_ITERATIONS = 200000;
+    const int RECEIVE_TIMEOUT_MS = 500;
+
+    ResultPacket MakePacket(uint32_t hands)
+    {
+        ResultPacket packet;
+        packet.streamId = 1;
+        for (uint32_t h = 0; h < hands; h++) {
+            ResultHand hand;
+            hand.x0 = 100 + h * 200;
+            hand.y0 = 300;
+            hand.x1 = hand.x0 + 180;
+            hand.y1 = 520;
+            hand.confidence = 0.9f;
+            for (uint32_t k = 0; k < RESULT_KEYPOINT_NUM; k++) {
+                hand.keypoints.push_back(hand.x0 + k * 8);
+                hand.keypoints.push_back(hand.y0 + k * 10);
+            }
+            packet.hands.push_back(hand);
+        }
+        return packet;
+    }
+
+    void BenchCodec(const ResultPacket &packet)
+    {
+        std::vector<uint8_t> buf(RESULT_MAX_DATAGRAM_SIZE);
+        size_t len = 0;
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < CODEC_ITERATIONS; i++) {
+            len = EncodeResultPacket(packet, buf.data(), buf.size());
+        }
+        double encodeNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / CODEC_ITERATIONS;
+        ResultPacket decoded;
+        start = Clock::now();
+        for (uint32_t i = 0; i < CODEC_ITERATIONS; i++) {
+            DecodeResultPacket(buf.data(), len, decoded);
+        }
+        double decodeNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / CODEC_ITERATIONS;
+        printf("datagram %zu bytes for %zu hands, encode %.0f ns, decode %.0f ns\n", len, packet.hands.size(),
+               encodeNs, decodeNs);
+    }
+
+    double Percentile(std::vector<int64_t> &values, double q)
+    {
+        if (values.empty()) {
+            return 0;
+        }
+        size_t index = std::min(values.size() - 1, (size_t)(q * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return (double)values[index];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t packets = 100000;
+    uint32_t hands = 2;
+    uint32_t rate = 0;
+    uint32_t port = 17072;
+    for (int i = 1; i < argc; i++) {
+        packets = ParseArg(argv[i], "--packets=", packets);
+        hands = ParseArg(argv[i], "--hands=", hands);
+        rate = ParseArg(argv[i], "--rate=", rate);
+        port = ParseArg(argv[i], "--port=", port);
+    }
+    ResultPacket packet = MakePacket(std::min(hands, RESULT_MAX_HANDS));
+    BenchCodec(packet);
+
+    ResultReceiver receiver;
+    if (!receiver.Open((uint16_t)port, "127.0.0.1")) {
+        printf("cannot bind 127.0.0.1:%u: %s\n", port, strerror(errno));
+        return 1;
+    }
+    std::vector<int64_t> latencyUs;
+    latencyUs.reserve(packets);
+    std::thread receiveThread([&receiver, &latencyUs, packets]() {
+        ResultPacket received;
+        while (latencyUs.size() < packets) {
+            ReceiveResult ret = receiver.Receive(received, RECEIVE_TIMEOUT_MS);
+            if (ret == RECEIVE_TIMEOUT || ret == RECEIVE_ERROR) {
+                break;
+            }
+            if (ret == RECEIVE_OK) {
+                latencyUs.push_back(ResultWallClockUs() - received.sendUs);
+            }
+        }
+    });
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::vector<uint8_t> buf(RESULT_MAX_DATAGRAM_SIZE);
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < packets; i++) {
+        if (rate != 0) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)i * 1000000 / rate));
+        }
+        packet.sequence = i;
+        packet.frameId = i;
+        packet.sendUs = ResultWallClockUs();
+        packet.captureUs = packet.sendUs;
+        size_t len = EncodeResultPacket(packet, buf.data(), buf.size());
+        sendto(sock, buf.data(), len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    }
+    double sendSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    receiveThread.join();
+    close(sock);
+
+    if (receiver.GetStats().empty()) {
+        printf("nothing received\n");
+        return 1;
+    }
+    // lost counts gaps between received sequences, missing also covers a lost tail
+    const ResultStreamStats &stats = receiver.GetStats().begin()->second;
+    printf("sent %u in %.3f s (%.0f/s), received %llu, missing %llu, lost %llu, reordered %llu\n", packets,
+           sendSeconds, packets / sendSeconds, (unsigned long long)stats.received,
+           (unsigned long long)(packets - stats.received), (unsigned long long)stats.lost,
+           (unsigned long long)stats.reordered);
+    printf("send to receive latency us: p50 %.0f p99 %.0f max %.0f\n", Percentile(latencyUs, 0.5),
+           Percentile(latencyUs, 0.99), Percentile(latencyUs, 1.0));
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of N synthetic streams spread over the model replicas of a WorkerGroup, and how evenly
+// they are spread. Every stream thread runs resize, detect, postprocess, crop and keypoints on its
+// own replica like a stream pipeline does. Run it with --devices=0 and --devices=0,1,... to see how
+// throughput scales with chips; --backend=cpu --devices=0,0,0,0 does the same with CPU replicas.
+// usage: worker_group_benchmark [--stream-num=N] [--frames=N] [--width=N] [--height=N]
+//                               [--devices=ID,..] [--backend=ascend|cpu] [--yolo-model=..] [--resnet-model=..]
+// --frames is per stream.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+#include "MxBase/Log/Log.h"
+#include "MxBase/DeviceManager/DeviceManager.h"
+#include "../Config/AppConfig.h"
+#include "../WorkerGroup/WorkerGroup.h"
+#include "BenchmarkArgs.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const uint32_t DEFAULT_FRAME_WIDTH = 1920;
+    const uint32_t DEFAULT_FRAME_HEIGHT = 1080;
+    // fixed centered hand box so the keypoint stage always runs, as in inference_benchmark
+    const float CROP_SHARE = 0.37f;
+
+    // one stream: its frame lives on its replica's device, like a decoder on that chip would put it
+    void RunStream(uint32_t streamId, uint32_t frames, BackendType backendType, FrameGeometry geometry,
+                   std::shared_ptr<WorkerGroup> workers, std::atomic<uint32_t> *failed)
+    {
+        std::shared_ptr<WorkerReplica> replica = workers->Acquire(streamId);
+        if (backendType == BACKEND_ASCEND) {
+            MxBase::DeviceContext device;
+            device.devId = (int32_t)replica->deviceId;
+            if (MxBase::DeviceManager::GetInstance()->SetDevice(device) != APP_ERR_OK) {
+                (*failed)++;
+                return;
+            }
+        }
+        std::shared_ptr<MxBase::MemoryData> frame;
+        if (CreateWarmupFrame(backendType, replica->deviceId, geometry, frame, FRAME_PATTERN_NOISE) != APP_ERR_OK) {
+            (*failed)++;
+            return;
+        }
+        uint32_t side = (uint32_t)(geometry.height * CROP_SHARE);
+        uint32_t cropX0 = (geometry.width - side) / 2;
+        uint32_t cropY0 = (geometry.height - side) / 2;
+        for (uint32_t i = 0; i < frames; i++) {
+            InputTensorHandle resizeFrame;
+            std::vector<std::vector<MxBase::ObjectInfo>> objInfos;
+            InputTensorHandle crop;
+            std::vector<std::vector<float>> keypoints;
+            OutputTensorHandle outputs;
+            if (replica->yolov3->ResizeFrame(frame, geometry, resizeFrame) != APP_ERR_OK ||
+                replica->yolov3->Inference({*resizeFrame}, outputs) != APP_ERR_OK ||
+                replica->yolov3->PostProcess(*outputs, geometry.height, geometry.width, objInfos) != APP_ERR_OK ||
+                replica->resnet->CropAndResizeFrame(frame, geometry, cropX0, cropY0, cropX0 + side - 1,
+                                                    cropY0 + side - 1, crop) != APP_ERR_OK ||
+                replica->resnet->BatchInference({*crop}, keypoints) != APP_ERR_OK) {
+                (*failed)++;
+                return;
+            }
+            replica->frames->Add();
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t streamNum = 4;
+    uint32_t frames = 100;
+    uint32_t width = DEFAULT_FRAME_WIDTH;
+    uint32_t height = DEFAULT_FRAME_HEIGHT;
+    // benchmark options first, the rest is the regular command line
+    std::vector<char*> appArgs = {argv[0]};
+    for (int i = 1; i < argc; i++) {
+        if (!MatchArg(argv[i], "--stream-num=", streamNum) && !MatchArg(argv[i], "--frames=", frames) &&
+            !MatchArg(argv[i], "--width=", width) && !MatchArg(argv[i], "--height=", height)) {
+            appArgs.push_back(argv[i]);
+        }
+    }
+    AppConfig config;
+    APP_ERROR ret = ParseAppConfig((int)appArgs.size(), appArgs.data(), config);
+    if (ret != APP_ERR_OK || streamNum == 0) {
+        PrintUsage(argv[0]);
+        return ret != APP_ERR_OK ? ret : APP_ERR_COMM_INVALID_PARAM;
+    }
+    if (config.backendType == BACKEND_ASCEND) {
+        ret = MxBase::DeviceManager::GetInstance()->InitDevices();
+        if (ret != APP_ERR_OK) {
+            LogError << "InitDevices failed";
+            return ret;
+        }
+    }
+    // laid out like VDEC output on the Ascend backend
+    FrameGeometry geometry = config.backendType == BACKEND_ASCEND ?
+        MakeFrameGeometry(width, height, DVPP_WIDTH_ALIGN, DVPP_HEIGHT_ALIGN) : MakeFrameGeometry(width, height);
+    auto workers = std::make_shared<WorkerGroup>();
+    WorkerGroupParam param;
+    InitWorkerGroupParam(config, geometry, param);
+    auto loadStart = Clock::now();
+    ret = workers->Init(param);
+    if (ret == APP_ERR_OK) {
+        ret = workers->Load();
+    }
+    if (ret != APP_ERR_OK) {
+        LogError << "Loading the worker group failed";
+        return ret;
+    }
+    double loadSeconds = std::chrono::duration<double>(Clock::now() - loadStart).count();
+
+    std::atomic<uint32_t> failed(0);
+    auto start = Clock::now();
+    std::vector<std::thread> streams;
+    for (uint32_t s = 0; s < streamNum; s++) {
+        streams.emplace_back(RunStream, s, frames, config.backendType, geometry, workers, &failed);
+    }
+    for (auto &stream : streams) {
+        stream.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    uint64_t total = 0;
+    std::map<uint32_t, uint32_t> replicaStreams;
+    std::map<uint32_t, uint64_t> replicaFrames;
+    std::map<uint32_t, uint32_t> replicaDevices;
+    for (uint32_t s = 0; s < streamNum; s++) {
+        std::shared_ptr<WorkerReplica> replica = workers->Acquire(s);
+        replicaStreams[replica->index]++;
+        replicaFrames[replica->index] = replica->frames->Get();
+        replicaDevices[replica->index] = replica->deviceId;
+    }
+    for (const auto &frameNum : replicaFrames) {
+        total += frameNum.second;
+    }
+    printf("backend=%s replicas=%lu streams=%u frames/stream=%u load=%.2fs wall=%.2fs throughput=%.1f fps "
+           "failed streams=%u\n", BackendTypeName(config.backendType), (unsigned long)workers->GetReplicaNum(),
+           streamNum, frames, loadSeconds, seconds, total / seconds, failed.load());
+    for (const auto &frameNum : replicaFrames) {
+        printf("  replica %-3u device %-3u streams %-3u %8.1f fps\n", frameNum.first, replicaDevices[frameNum.first],
+               replicaStreams[frameNum.first], frameNum.second / seconds);
+    }
+    workers->DeInit();
+    if (config.backendType == BACKEND_ASCEND) {
+        MxBase::DeviceManager::GetInstance()->DestroyDevices();
+    }
+    return 0;
+}
@@ -158,6 +158,7 @@ public:
 
     APP_ERROR GetBackItem(T &item)
     {
+        std::unique_lock<std::mutex> lock(mutex_);
         if (is_stoped_) {
             return APP_ERR_QUEUE_STOPED;
         }
@@ -183,11 +184,13 @@ public:
 
     int GetSize()
     {
+        std::unique_lock<std::mutex> lock(mutex_);
         return queue_.size();
     }
 
     APP_ERROR IsEmpty()
     {
+        std::unique_lock<std::mutex> lock(mutex_);
         return queue_.empty();
     }
 
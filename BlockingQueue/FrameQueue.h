@@ -0,0 +1,164 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <atomic>
+#include <list>
+#include <stdint.h>
+
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "RingQueue.h"
+
+enum QueuePolicy {
+    QUEUE_POLICY_BLOCK = 0,   // producer waits for room, nothing is dropped (offline use only)
+    QUEUE_POLICY_DROP_NEWEST, // a full queue rejects the incoming frame
+    QUEUE_POLICY_DROP_OLDEST, // a full queue evicts its oldest frame to make room
+    QUEUE_POLICY_LATEST_ONLY, // mailbox: only the freshest frame is kept
+};
+
+static const uint32_t DEFAULT_FRAME_QUEUE_DEPTH = 4;
+
+// Bounded frame queue with an explicit overflow policy. Every frame that is not delivered to the
+// consumer is counted, so latency and buffer usage stay bounded when the consumer falls behind.
+// Built on MpmcRingQueue because DROP_OLDEST lets the producer evict from the consumer end.
+template<typename T> class FrameQueue {
+public:
+    FrameQueue(QueuePolicy policy = QUEUE_POLICY_DROP_OLDEST, uint32_t depth = DEFAULT_FRAME_QUEUE_DEPTH)
+        : policy_(policy), depth_(policy == QUEUE_POLICY_LATEST_ONLY ? 1 : (depth == 0 ? 1 : depth)),
+          queue_(depth_), pushed_(0), dropped_(0) {}
+
+    ~FrameQueue() {}
+
+    // returns APP_ERR_OK when the item was queued, even if an older item was evicted for it
+    APP_ERROR Push(const T &item)
+    {
+        T copy = item;
+        switch (policy_) {
+            case QUEUE_POLICY_BLOCK:
+                return Accept(queue_.Push(std::move(copy), true));
+            case QUEUE_POLICY_DROP_NEWEST:
+                if (queue_.GetSize() >= (int)depth_) {
+                    pushed_.fetch_add(1, std::memory_order_relaxed);
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return APP_ERR_QUEUE_FULL;
+                }
+                return Accept(queue_.Push(std::move(copy), false));
+            default:
+                return PushEvictOldest(copy);
+        }
+    }
+
+    APP_ERROR Pop(T &item)
+    {
+        return queue_.Pop(item);
+    }
+
+    APP_ERROR Pop(T &item, unsigned int timeOutMs)
+    {
+        return queue_.Pop(item, timeOutMs);
+    }
+
+    void Stop()
+    {
+        queue_.Stop();
+    }
+
+    void Restart()
+    {
+        queue_.Restart();
+    }
+
+    std::list<T> GetRemainItems()
+    {
+        return queue_.GetRemainItems();
+    }
+
+    int GetSize()
+    {
+        return queue_.GetSize();
+    }
+
+    bool IsEmpty()
+    {
+        return queue_.IsEmpty();
+    }
+
+    void Clear()
+    {
+        queue_.Clear();
+    }
+
+    QueuePolicy GetPolicy() const
+    {
+        return policy_;
+    }
+
+    uint32_t GetDepth() const
+    {
+        return depth_;
+    }
+
+    // frames offered by the producer, delivered or not
+    uint64_t GetPushedCount() const
+    {
+        return pushed_.load(std::memory_order_relaxed);
+    }
+
+    // frames rejected or evicted by the overflow policy
+    uint64_t GetDroppedCount() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    APP_ERROR Accept(APP_ERROR ret)
+    {
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        if (ret == APP_ERR_QUEUE_FULL) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return ret;
+    }
+
+    APP_ERROR PushEvictOldest(T &item)
+    {
+        if (queue_.IsStopped()) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        T evicted;
+        while (queue_.GetSize() >= (int)depth_ && queue_.TryPop(evicted)) {
+            evicted = T();
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        while (!queue_.TryPush(item)) {
+            if (queue_.TryPop(evicted)) {
+                evicted = T();
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        return APP_ERR_OK;
+    }
+
+private:
+    const QueuePolicy policy_;
+    const uint32_t depth_;
+    MpmcRingQueue<T> queue_;
+    std::atomic<uint64_t> pushed_;
+    std::atomic<uint64_t> dropped_;
+};
+#endif // FRAME_QUEUE_H
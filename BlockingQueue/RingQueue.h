@@ -0,0 +1,505 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "MxBase/ErrorCode/ErrorCodes.h"
+
+static const size_t RING_CACHE_LINE_SIZE = 64;
+static const uint32_t DEFAULT_RING_QUEUE_SIZE = 256;
+
+namespace RingQueueDetail {
+    // spin with a cpu hint first, then give the core away, then park on a condition variable
+    const uint32_t SPIN_COUNT = 256;
+    const uint32_t YIELD_COUNT = 16;
+
+    inline void CpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    // spinning only pays off when the other side can run at the same time
+    inline uint32_t SpinCount()
+    {
+        static const uint32_t spinCount = std::thread::hardware_concurrency() > 1 ? SPIN_COUNT : 0;
+        return spinCount;
+    }
+
+    inline size_t RoundUpPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    // atomic index alone on its cache line, so producer and consumer never false share
+    struct PaddedIndex {
+        std::atomic<size_t> value;
+        char pad[RING_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+        PaddedIndex() : value(0) {}
+    };
+
+    // plain index owned by one side, padded for the same reason as PaddedIndex
+    struct PaddedCache {
+        size_t value;
+        char pad[RING_CACHE_LINE_SIZE - sizeof(size_t)];
+
+        PaddedCache() : value(0) {}
+    };
+}
+
+// Adaptive waiter used by the ring queues: the fast path never touches the mutex,
+// Notify() only takes the lock when the other side has actually parked.
+class SpinParkWaiter {
+public:
+    SpinParkWaiter() : parked_(0) {}
+
+    // pred is re-evaluated until it returns true; returns false only on timeout
+    template<typename Pred> bool Wait(Pred pred, unsigned int timeOutMs, bool hasTimeOut)
+    {
+        for (uint32_t i = 0; i < RingQueueDetail::SpinCount(); i++) {
+            if (pred()) {
+                return true;
+            }
+            RingQueueDetail::CpuRelax();
+        }
+        for (uint32_t i = 0; i < RingQueueDetail::YIELD_COUNT; i++) {
+            if (pred()) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOutMs);
+        std::unique_lock<std::mutex> lock(mutex_);
+        parked_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ready = pred();
+        while (!ready) {
+            if (!hasTimeOut) {
+                cond_.wait(lock);
+            } else if (cond_.wait_until(lock, deadline) == std::cv_status::timeout) {
+                ready = pred();
+                break;
+            }
+            ready = pred();
+        }
+        parked_.fetch_sub(1);
+        return ready;
+    }
+
+    void Notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.notify_all();
+    }
+
+    void NotifyAll()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::atomic<int> parked_;
+};
+
+// Bounded single-producer/single-consumer ring with the Push/Pop/Stop semantics of BlockingQueue.
+// Exactly one thread may push and exactly one thread may pop; capacity is rounded up to a power of two.
+template<typename T> class SpscRingQueue {
+public:
+    SpscRingQueue(uint32_t maxSize = DEFAULT_RING_QUEUE_SIZE)
+        : capacity_(RingQueueDetail::RoundUpPowerOfTwo(maxSize)), mask_(capacity_ - 1),
+          max_size_(maxSize), buffer_(new T[capacity_]), is_stoped_(false) {}
+
+    ~SpscRingQueue() {}
+
+    APP_ERROR Pop(T &item)
+    {
+        return PopImpl(item, 0, false);
+    }
+
+    APP_ERROR Pop(T &item, unsigned int timeOutMs)
+    {
+        return PopImpl(item, timeOutMs, true);
+    }
+
+    APP_ERROR Push(const T &item, bool isWait = false)
+    {
+        T copy = item;
+        return Push(std::move(copy), isWait);
+    }
+
+    APP_ERROR Push(T &&item, bool isWait = false)
+    {
+        if (is_stoped_.load(std::memory_order_acquire)) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+        if (TryPush(item)) {
+            return APP_ERR_OK;
+        }
+        if (!isWait) {
+            return APP_ERR_QUEUE_FULL;
+        }
+        bool pushed = false;
+        full_waiter_.Wait([&]() {
+            if (is_stoped_.load(std::memory_order_acquire)) {
+                return true;
+            }
+            pushed = TryPush(item);
+            return pushed;
+        }, 0, false);
+        return pushed ? APP_ERR_OK : APP_ERR_QUEUE_STOPED;
+    }
+
+    // non-blocking producer side, the item is moved only on success
+    bool TryPush(T &item)
+    {
+        const size_t tail = tail_.value.load(std::memory_order_relaxed);
+        if (tail - head_cache_.value >= max_size_) {
+            head_cache_.value = head_.value.load(std::memory_order_acquire);
+            if (tail - head_cache_.value >= max_size_) {
+                return false;
+            }
+        }
+        buffer_[tail & mask_] = std::move(item);
+        tail_.value.store(tail + 1, std::memory_order_release);
+        empty_waiter_.Notify();
+        return true;
+    }
+
+    // non-blocking consumer side
+    bool TryPop(T &item)
+    {
+        const size_t head = head_.value.load(std::memory_order_relaxed);
+        if (head == tail_cache_.value) {
+            tail_cache_.value = tail_.value.load(std::memory_order_acquire);
+            if (head == tail_cache_.value) {
+                return false;
+            }
+        }
+        item = std::move(buffer_[head & mask_]);
+        buffer_[head & mask_] = T();
+        head_.value.store(head + 1, std::memory_order_release);
+        full_waiter_.Notify();
+        return true;
+    }
+
+    void Stop()
+    {
+        is_stoped_.store(true, std::memory_order_release);
+        full_waiter_.NotifyAll();
+        empty_waiter_.NotifyAll();
+    }
+
+    void Restart()
+    {
+        is_stoped_.store(false, std::memory_order_release);
+    }
+
+    bool IsStopped() const
+    {
+        return is_stoped_.load(std::memory_order_acquire);
+    }
+
+    // if the queue is stoped, need call this function (from the consumer side) to release the unprocessed items
+    std::list<T> GetRemainItems()
+    {
+        std::list<T> items;
+        if (!is_stoped_.load(std::memory_order_acquire)) {
+            return items;
+        }
+        T item;
+        while (TryPop(item)) {
+            items.push_back(std::move(item));
+        }
+        return items;
+    }
+
+    bool IsFull()
+    {
+        return GetSize() >= max_size_;
+    }
+
+    int GetSize()
+    {
+        const size_t head = head_.value.load(std::memory_order_acquire);
+        const size_t tail = tail_.value.load(std::memory_order_acquire);
+        return static_cast<int>(tail - head);
+    }
+
+    bool IsEmpty()
+    {
+        return GetSize() == 0;
+    }
+
+    // consumer side only
+    void Clear()
+    {
+        T item;
+        while (TryPop(item)) {
+        }
+    }
+
+private:
+    APP_ERROR PopImpl(T &item, unsigned int timeOutMs, bool hasTimeOut)
+    {
+        bool popped = false;
+        bool ready = empty_waiter_.Wait([&]() {
+            if (is_stoped_.load(std::memory_order_acquire)) {
+                return true;
+            }
+            popped = TryPop(item);
+            return popped;
+        }, timeOutMs, hasTimeOut);
+        if (popped) {
+            return APP_ERR_OK;
+        }
+        return ready ? APP_ERR_QUEUE_STOPED : APP_ERR_QUEUE_EMPTY;
+    }
+
+private:
+    RingQueueDetail::PaddedIndex lead_pad_;
+    RingQueueDetail::PaddedIndex head_;       // written by the consumer
+    RingQueueDetail::PaddedCache tail_cache_; // consumer's last view of tail_
+    RingQueueDetail::PaddedIndex tail_;       // written by the producer
+    RingQueueDetail::PaddedCache head_cache_; // producer's last view of head_
+    const size_t capacity_;
+    const size_t mask_;
+    const size_t max_size_;
+    std::unique_ptr<T[]> buffer_;
+    std::atomic<bool> is_stoped_;
+    SpinParkWaiter empty_waiter_;
+    SpinParkWaiter full_waiter_;
+};
+
+// Bounded multi-producer/multi-consumer ring (Vyukov sequence cells) for fan-in between several
+// producers and one or more consumers. Same Push/Pop/Stop semantics as SpscRingQueue.
+template<typename T> class MpmcRingQueue {
+public:
+    MpmcRingQueue(uint32_t maxSize = DEFAULT_RING_QUEUE_SIZE)
+        : capacity_(RingQueueDetail::RoundUpPowerOfTwo(maxSize)), mask_(capacity_ - 1),
+          cells_(new Cell[capacity_]), is_stoped_(false)
+    {
+        for (size_t i = 0; i < capacity_; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpmcRingQueue() {}
+
+    APP_ERROR Pop(T &item)
+    {
+        return PopImpl(item, 0, false);
+    }
+
+    APP_ERROR Pop(T &item, unsigned int timeOutMs)
+    {
+        return PopImpl(item, timeOutMs, true);
+    }
+
+    APP_ERROR Push(const T &item, bool isWait = false)
+    {
+        T copy = item;
+        return Push(std::move(copy), isWait);
+    }
+
+    APP_ERROR Push(T &&item, bool isWait = false)
+    {
+        if (is_stoped_.load(std::memory_order_acquire)) {
+            return APP_ERR_QUEUE_STOPED;
+        }
+        if (TryPush(item)) {
+            return APP_ERR_OK;
+        }
+        if (!isWait) {
+            return APP_ERR_QUEUE_FULL;
+        }
+        bool pushed = false;
+        full_waiter_.Wait([&]() {
+            if (is_stoped_.load(std::memory_order_acquire)) {
+                return true;
+            }
+            pushed = TryPush(item);
+            return pushed;
+        }, 0, false);
+        return pushed ? APP_ERR_OK : APP_ERR_QUEUE_STOPED;
+    }
+
+    // non-blocking, the item is moved only on success
+    bool TryPush(T &item)
+    {
+        size_t pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        empty_waiter_.Notify();
+        return true;
+    }
+
+    bool TryPop(T &item)
+    {
+        size_t pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->data);
+        cell->data = T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        full_waiter_.Notify();
+        return true;
+    }
+
+    void Stop()
+    {
+        is_stoped_.store(true, std::memory_order_release);
+        full_waiter_.NotifyAll();
+        empty_waiter_.NotifyAll();
+    }
+
+    void Restart()
+    {
+        is_stoped_.store(false, std::memory_order_release);
+    }
+
+    bool IsStopped() const
+    {
+        return is_stoped_.load(std::memory_order_acquire);
+    }
+
+    // if the queue is stoped, need call this function to release the unprocessed items
+    std::list<T> GetRemainItems()
+    {
+        std::list<T> items;
+        if (!is_stoped_.load(std::memory_order_acquire)) {
+            return items;
+        }
+        T item;
+        while (TryPop(item)) {
+            items.push_back(std::move(item));
+        }
+        return items;
+    }
+
+    bool IsFull()
+    {
+        return GetSize() >= (int)capacity_;
+    }
+
+    // approximate while producers or consumers are running
+    int GetSize()
+    {
+        const size_t head = dequeue_pos_.value.load(std::memory_order_acquire);
+        const size_t tail = enqueue_pos_.value.load(std::memory_order_acquire);
+        return tail > head ? static_cast<int>(tail - head) : 0;
+    }
+
+    bool IsEmpty()
+    {
+        return GetSize() == 0;
+    }
+
+    void Clear()
+    {
+        T item;
+        while (TryPop(item)) {
+        }
+    }
+
+private:
+    APP_ERROR PopImpl(T &item, unsigned int timeOutMs, bool hasTimeOut)
+    {
+        bool popped = false;
+        bool ready = empty_waiter_.Wait([&]() {
+            if (is_stoped_.load(std::memory_order_acquire)) {
+                return true;
+            }
+            popped = TryPop(item);
+            return popped;
+        }, timeOutMs, hasTimeOut);
+        if (popped) {
+            return APP_ERR_OK;
+        }
+        return ready ? APP_ERR_QUEUE_STOPED : APP_ERR_QUEUE_EMPTY;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    RingQueueDetail::PaddedIndex lead_pad_;
+    RingQueueDetail::PaddedIndex enqueue_pos_;
+    RingQueueDetail::PaddedIndex dequeue_pos_;
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    std::atomic<bool> is_stoped_;
+    SpinParkWaiter empty_waiter_;
+    SpinParkWaiter full_waiter_;
+};
+#endif // RING_QUEUE_H
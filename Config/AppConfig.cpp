@@ -0,0 +1,537 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include "MxBase/Log/Log.h"
+#include "AppConfig.h"
+
+namespace {
+    const uint32_t MAX_METRICS_PORT = 65535;
+    // every queued frame holds a decoded picture, so a deep queue only adds latency and memory
+    const uint32_t MAX_QUEUE_DEPTH = 64;
+    // YOLOv3 downsamples by 32 to its coarsest grid
+    const uint32_t DETECT_INPUT_ALIGN = 32;
+
+    APP_ERROR ParseUint(const std::string &key, const std::string &value, uint32_t &result)
+    {
+        // strtoul would accept a sign and leading blanks, and wrap "-1" to ULONG_MAX
+        if (value.empty() || !isdigit((unsigned char)value[0])) {
+            LogError << "Invalid value for --" << key << ": " << value;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        char *end = nullptr;
+        errno = 0;
+        unsigned long parsed = strtoul(value.c_str(), &end, 10);
+        if (end == nullptr || *end != '\0') {
+            LogError << "Invalid value for --" << key << ": " << value;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        if (errno == ERANGE || parsed > UINT32_MAX) {
+            LogError << "--" << key << " out of range: " << value;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        result = (uint32_t)parsed;
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR ParseFloat(const std::string &key, const std::string &value, float &result)
+    {
+        char *end = nullptr;
+        float parsed = strtof(value.c_str(), &end);
+        if (value.empty() || end == nullptr || *end != '\0') {
+            LogError << "Invalid value for --" << key << ": " << value;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        result = parsed;
+        return APP_ERR_OK;
+    }
+
+    // post-processor thresholds are passed on as text, checked here to be a number within [0, 1]
+    APP_ERROR ParseThreshold(const std::string &key, const std::string &value, std::string &result)
+    {
+        float parsed = 0;
+        APP_ERROR ret = ParseFloat(key, value, parsed);
+        if (ret == APP_ERR_OK && (parsed < 0 || parsed > 1)) {
+            LogError << "--" << key << " must be within [0, 1]";
+            ret = APP_ERR_COMM_INVALID_PARAM;
+        }
+        if (ret == APP_ERR_OK) {
+            result = value;
+        }
+        return ret;
+    }
+
+    // "w,h,w,h,...": an even number of positive values
+    APP_ERROR ParseAnchors(const std::string &key, const std::string &value, std::string &result)
+    {
+        size_t count = 0;
+        size_t begin = 0;
+        while (begin <= value.size()) {
+            size_t end = value.find(',', begin);
+            if (end == std::string::npos) {
+                end = value.size();
+            }
+            float anchor = 0;
+            APP_ERROR ret = ParseFloat(key, value.substr(begin, end - begin), anchor);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+            if (anchor <= 0) {
+                LogError << "--" << key << " needs positive anchor sizes";
+                return APP_ERR_COMM_INVALID_PARAM;
+            }
+            count++;
+            begin = end + 1;
+        }
+        if (count % 2 != 0) {
+            LogError << "--" << key << " needs width,height pairs, got " << count << " values";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        result = value;
+        return APP_ERR_OK;
+    }
+
+    // "0,1,2,3": one id per replica
+    APP_ERROR ParseDeviceList(const std::string &key, const std::string &value, std::vector<uint32_t> &result)
+    {
+        std::vector<uint32_t> ids;
+        size_t begin = 0;
+        while (begin <= value.size()) {
+            size_t end = value.find(',', begin);
+            end = end == std::string::npos ? value.size() : end;
+            uint32_t id = 0;
+            APP_ERROR ret = ParseUint(key, value.substr(begin, end - begin), id);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+            ids.push_back(id);
+            begin = end + 1;
+        }
+        if (ids.size() > MAX_WORKER_REPLICAS) {
+            LogError << "--" << key << " takes at most " << MAX_WORKER_REPLICAS << " entries";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        result.swap(ids);
+        return APP_ERR_OK;
+    }
+
+    APP_ERROR ParseSwitch(const std::string &key, const std::string &value, bool &result)
+    {
+        if (value != "on" && value != "off") {
+            LogError << "--" << key << " takes on or off, not " << value;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        result = value == "on";
+        return APP_ERR_OK;
+    }
+}
+
+APP_ERROR ParseQueuePolicy(const std::string &name, QueuePolicy &policy)
+{
+    if (name == "block") {
+        policy = QUEUE_POLICY_BLOCK;
+    } else if (name == "drop-newest") {
+        policy = QUEUE_POLICY_DROP_NEWEST;
+    } else if (name == "drop-oldest") {
+        policy = QUEUE_POLICY_DROP_OLDEST;
+    } else if (name == "latest") {
+        policy = QUEUE_POLICY_LATEST_ONLY;
+    } else {
+        LogError << "Unknown queue policy: " << name;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    return APP_ERR_OK;
+}
+
+const char *QueuePolicyName(QueuePolicy policy)
+{
+    switch (policy) {
+        case QUEUE_POLICY_BLOCK:
+            return "block";
+        case QUEUE_POLICY_DROP_NEWEST:
+            return "drop-newest";
+        case QUEUE_POLICY_DROP_OLDEST:
+            return "drop-oldest";
+        case QUEUE_POLICY_LATEST_ONLY:
+            return "latest";
+        default:
+            return "unknown";
+    }
+}
+
+APP_ERROR ParseBackendType(const std::string &name, BackendType &type)
+{
+    if (name == "ascend") {
+        type = BACKEND_ASCEND;
+    } else if (name == "cpu") {
+        type = BACKEND_CPU;
+    } else {
+        LogError << "Unknown inference backend: " << name;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    return APP_ERR_OK;
+}
+
+const char *BackendTypeName(BackendType type)
+{
+    return type == BACKEND_CPU ? "cpu" : "ascend";
+}
+
+APP_ERROR ParseDecoderType(const std::string &name, DecoderType &type)
+{
+    if (name == "dvpp") {
+        type = DECODER_DVPP;
+    } else if (name == "cpu") {
+        type = DECODER_SOFTWARE;
+    } else {
+        LogError << "Unknown decoder: " << name;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    return APP_ERR_OK;
+}
+
+const char *DecoderTypeName(DecoderType type)
+{
+    return type == DECODER_SOFTWARE ? "cpu" : "dvpp";
+}
+
+    /*
+CLASS_NUM=1
+BIASES_NUM=18
+BIASES=10,13,16,30,33,23,30,61,62,45,59,119,116,90,156,198,373,326
+SCORE_THRESH=0.31
+OBJECTNESS_THRESH=0.3
+IOU_THRESH=0.45
+YOLO_TYPE=3
+ANCHOR_DIM=3
+MODEL_TYPE=1
+RESIZE_FLAG=0    
+    */
+void InitYolov3Param(const AppConfig &config, InitParam &initParam, const uint32_t deviceID)
+{
+    initParam.deviceId = deviceID;
+    initParam.labelPath = "./model/coco.names";
+    initParam.checkTensor = true;
+    initParam.modelPath = "./model/hand.om";
+    initParam.classNum = 1;
+    initParam.biasesNum = 18;
+    initParam.biases = "10,13,16,30,33,23,30,61,62,45,59,119,116,90,156,198,373,326";
+    initParam.objectnessThresh = "0.3";
+    initParam.iouThresh = "0.45";
+    initParam.scoreThresh = "0.31";
+    initParam.yoloType = 3;
+    initParam.modelType = 1;
+    initParam.inputType = 0;
+    initParam.anchorDim = 3;
+    initParam.backendType = config.backendType;
+    initParam.nativeDecode = config.nativeDecode;
+    initParam.inputHeight = config.detectInputSize;
+    initParam.inputWidth = config.detectInputSize;
+    if (config.backendType == BACKEND_CPU) {
+        initParam.modelPath = "./model/hand.onnx";
+    }
+    if (!config.yoloModelPath.empty()) {
+        initParam.modelPath = config.yoloModelPath;
+    }
+}
+
+void InitFaceParam(const AppConfig &config, InitParam &initParam, const uint32_t deviceID)
+{
+    InitYolov3Param(config, initParam, deviceID);
+    initParam.modelPath = config.faceModelPath;
+    const FaceModelParam &face = config.faceParam;
+    if (!face.labelPath.empty()) {
+        initParam.labelPath = face.labelPath;
+    }
+    if (face.classNum != 0) {
+        initParam.classNum = face.classNum;
+    }
+    if (!face.anchors.empty()) {
+        initParam.biases = face.anchors;
+        initParam.biasesNum = (uint32_t)std::count(face.anchors.begin(), face.anchors.end(), ',') + 1;
+    }
+    if (!face.scoreThresh.empty()) {
+        initParam.scoreThresh = face.scoreThresh;
+    }
+    if (!face.objectnessThresh.empty()) {
+        initParam.objectnessThresh = face.objectnessThresh;
+    }
+    if (!face.iouThresh.empty()) {
+        initParam.iouThresh = face.iouThresh;
+    }
+}
+
+void InitResnetParam(const AppConfig &config, ResnetInitParam &initParam, const uint32_t deviceID)
+{
+    initParam.deviceId = deviceID;
+    initParam.modelPath = "./model/hand_keypoint.om";
+    initParam.classNum = 21;
+    initParam.backendType = config.backendType;
+    initParam.maxBatchSize = config.handParam.maxHands;
+    initParam.inputHeight = config.keypointInputSize;
+    initParam.inputWidth = config.keypointInputSize;
+    if (config.backendType == BACKEND_CPU) {
+        initParam.modelPath = "./model/hand_keypoint.onnx";
+    }
+    if (!config.resnetModelPath.empty()) {
+        initParam.modelPath = config.resnetModelPath;
+    }
+}
+
+void InitWorkerGroupParam(const AppConfig &config, const FrameGeometry &warmupGeometry, WorkerGroupParam &param)
+{
+    param.deviceIds = config.deviceIds;
+    InitYolov3Param(config, param.yoloParam, config.deviceIds[0]);
+    InitResnetParam(config, param.resnetParam, config.deviceIds[0]);
+    param.faceEnabled = !config.faceModelPath.empty();
+    if (param.faceEnabled) {
+        InitFaceParam(config, param.faceParam, config.deviceIds[0]);
+    }
+    param.warmupGeometry = warmupGeometry;
+}
+
+void PrintUsage(const char *program)
+{
+    std::cout << "usage: " << program << " [rtspUrl] [clientIp] [options]\n"
+              << "  --queue-policy=latest|drop-oldest|drop-newest|block\n"
+              << "                              decoded-frame overflow policy\n"
+              << "  --queue-depth=N             decoded-frame queue depth, at most 64\n"
+              << "  --backend=ascend|cpu        inference backend (cpu loads .onnx models)\n"
+              << "  --devices=ID[,ID...]        model replica per entry, streams spread over them (default 0)\n"
+              << "  --decoder=dvpp|cpu          H.264/H.265 decoder: Ascend VDEC or libavcodec,\n"
+              << "                              cpu with --backend=cpu runs without an Ascend device\n"
+              << "  --decode-threads=N          libavcodec threads per stream, 0 one per core\n"
+              << "  --yolo-model=PATH           hand detector model\n"
+              << "  --resnet-model=PATH         hand keypoint model\n"
+              << "  --face-model=PATH           face detector on the hand detector's input, v2 only\n"
+              << "  --face-labels=PATH          face class names, one per line\n"
+              << "  --face-classes=N            face model classes (default 1)\n"
+              << "  --face-anchors=W,H,...      face anchors, largest grid first\n"
+              << "  --face-score=F --face-objectness=F --face-iou=F\n"
+              << "                              face thresholds (default 0.31, 0.3, 0.45)\n"
+              << "  --postprocess=native|sdk    YOLO decode and NMS implementation\n"
+              << "  --detect-input=N            CPU detector input N x N, multiple of 32 (default 416)\n"
+              << "  --keypoint-input=N          CPU keypoint input N x N (default 256)\n"
+              << "  --max-hands=N               hands per frame that get keypoints\n"
+              << "  --hand-thresh=F             confidence needed by every hand but the best\n"
+              << "  --detect-interval=N         run the hand detector every N frames, track in between\n"
+              << "  --track-thresh=F            keypoint share inside the crop to keep tracking\n"
+              << "  --gestures=on|off           gesture recognition, sent in result protocol v2 (default on with v2)\n"
+              << "  --gesture-debounce=N        frames a new gesture must hold before it is reported\n"
+              << "  --smooth-keypoints=on|off   send the gesture filter's keypoints (default off)\n"
+              << "  --streams=FILE              stream list, one \"url clientIp [videoPort resultPort]\" per line\n"
+              << "  --replay=FILE               run a local MP4/H.264/H.265 file instead of the camera, then report\n"
+              << "  --replay-pace=fast|realtime\n"
+              << "                              replay as fast as possible or at the file's frame rate\n"
+              << "  --relay-rate=MBPS           video relay rate per stream in Mbit/s, 0 unpaced\n"
+              << "  --result-protocol=v1|v2     keypoint result datagram format\n"
+              << "  --render-every=N            write every N-th frame annotated as JPEG, 0 off\n"
+              << "  --render-threads=N          render workers shared by all streams\n"
+              << "  --render-qscale=N           JPEG quantizer, 2 best .. 31 smallest (default 5)\n"
+              << "  --render-dir=PATH           where rendered frames go (default ./result)\n"
+              << "  --video-out=DIR|URL         annotated H.264: MP4 segments in DIR, rtsp:// or MPEG-TS URL\n"
+              << "                              ({stream} in the URL becomes the stream id)\n"
+              << "  --video-out-bitrate=KBPS    video output bitrate per stream (default 2000)\n"
+              << "  --video-out-segment=SEC     length of one MP4 segment (default 300)\n"
+              << "  --metrics-port=N            Prometheus endpoint http://BIND:N/metrics\n"
+              << "  --metrics-bind=ADDR         metrics listen address (default 127.0.0.1)\n"
+              << "                              (/memory lists the live buffers per allocation site)\n"
+              << "  --soak=SEC                  run SEC seconds, fail if buffer memory grows after warm-up\n"
+              << "  --soak-growth=MB            steady-state growth a soak tolerates per memory type (default 8)\n";
+}
+
+APP_ERROR ParseAppConfig(int argc, char *argv[], AppConfig &config)
+{
+    int positional = 0;
+    bool gesturesSet = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            if (positional == 0) {
+                config.streamName = arg;
+            } else if (positional == 1) {
+                config.clientIp = arg;
+            } else {
+                LogError << "Unexpected argument: " << arg;
+                return APP_ERR_COMM_INVALID_PARAM;
+            }
+            positional++;
+            continue;
+        }
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        APP_ERROR ret = APP_ERR_OK;
+        if (key == "queue-policy") {
+            ret = ParseQueuePolicy(value, config.queuePolicy);
+        } else if (key == "queue-depth") {
+            ret = ParseUint(key, value, config.queueDepth);
+            if (ret == APP_ERR_OK && config.queueDepth > MAX_QUEUE_DEPTH) {
+                LogError << "--queue-depth must be at most " << MAX_QUEUE_DEPTH;
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "backend") {
+            ret = ParseBackendType(value, config.backendType);
+        } else if (key == "devices") {
+            ret = ParseDeviceList(key, value, config.deviceIds);
+        } else if (key == "decoder") {
+            ret = ParseDecoderType(value, config.decoderType);
+        } else if (key == "decode-threads") {
+            ret = ParseUint(key, value, config.decodeThreads);
+        } else if (key == "yolo-model") {
+            config.yoloModelPath = value;
+        } else if (key == "resnet-model") {
+            config.resnetModelPath = value;
+        } else if (key == "face-model") {
+            config.faceModelPath = value;
+        } else if (key == "face-labels") {
+            config.faceParam.labelPath = value;
+        } else if (key == "face-classes") {
+            ret = ParseUint(key, value, config.faceParam.classNum);
+        } else if (key == "face-anchors") {
+            ret = ParseAnchors(key, value, config.faceParam.anchors);
+        } else if (key == "face-score") {
+            ret = ParseThreshold(key, value, config.faceParam.scoreThresh);
+        } else if (key == "face-objectness") {
+            ret = ParseThreshold(key, value, config.faceParam.objectnessThresh);
+        } else if (key == "face-iou") {
+            ret = ParseThreshold(key, value, config.faceParam.iouThresh);
+        } else if (key == "postprocess") {
+            if (value == "native" || value == "sdk") {
+                config.nativeDecode = value == "native";
+            } else {
+                LogError << "Unknown post-process: " << value;
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "detect-input") {
+            ret = ParseUint(key, value, config.detectInputSize);
+            if (ret == APP_ERR_OK &&
+                (config.detectInputSize == 0 || config.detectInputSize % DETECT_INPUT_ALIGN != 0)) {
+                LogError << "--detect-input must be a positive multiple of " << DETECT_INPUT_ALIGN;
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "keypoint-input") {
+            ret = ParseUint(key, value, config.keypointInputSize);
+            if (ret == APP_ERR_OK && config.keypointInputSize == 0) {
+                LogError << "--keypoint-input must be at least 1";
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "max-hands") {
+            ret = ParseUint(key, value, config.handParam.maxHands);
+            if (ret == APP_ERR_OK && config.handParam.maxHands == 0) {
+                LogError << "--max-hands must be at least 1";
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "hand-thresh") {
+            ret = ParseFloat(key, value, config.handParam.minConfidence);
+        } else if (key == "detect-interval") {
+            ret = ParseUint(key, value, config.trackParam.detectInterval);
+            if (ret == APP_ERR_OK && config.trackParam.detectInterval == 0) {
+                LogError << "--detect-interval must be at least 1";
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "track-thresh") {
+            ret = ParseFloat(key, value, config.trackParam.minQuality);
+        } else if (key == "gestures") {
+            ret = ParseSwitch(key, value, config.gestureParam.enabled);
+            gesturesSet = true;
+        } else if (key == "gesture-debounce") {
+            ret = ParseUint(key, value, config.gestureParam.debounceFrames);
+            if (ret == APP_ERR_OK && config.gestureParam.debounceFrames == 0) {
+                LogError << "--gesture-debounce must be at least 1";
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "smooth-keypoints") {
+            ret = ParseSwitch(key, value, config.gestureParam.smoothKeypoints);
+        } else if (key == "streams") {
+            config.streamListPath = value;
+        } else if (key == "replay") {
+            config.replayPath = value;
+        } else if (key == "replay-pace") {
+            if (value == "fast" || value == "realtime") {
+                config.replayMode = value == "fast" ? REPLAY_FAST : REPLAY_REALTIME;
+            } else {
+                LogError << "Unknown replay pace: " << value;
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "relay-rate") {
+            ret = ParseUint(key, value, config.relayRateMbps);
+        } else if (key == "result-protocol") {
+            if (value == "v1" || value == "v2") {
+                config.resultProtocol = value == "v1" ? RESULT_PROTOCOL_V1 : RESULT_PROTOCOL_V2;
+            } else {
+                LogError << "Unknown result protocol: " << value;
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "render-every") {
+            ret = ParseUint(key, value, config.renderParam.renderEvery);
+        } else if (key == "render-threads") {
+            ret = ParseUint(key, value, config.renderParam.workerNum);
+            if (ret == APP_ERR_OK && config.renderParam.workerNum == 0) {
+                LogError << "--render-threads must be at least 1";
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+            config.renderParam.queueDepth = config.renderParam.workerNum * 2;
+        } else if (key == "render-qscale") {
+            ret = ParseUint(key, value, config.renderParam.qscale);
+        } else if (key == "render-dir") {
+            config.renderParam.outputDir = value;
+        } else if (key == "video-out") {
+            config.videoSink.output = value;
+        } else if (key == "video-out-bitrate") {
+            ret = ParseUint(key, value, config.videoSink.bitrateKbps);
+            if (ret == APP_ERR_OK && config.videoSink.bitrateKbps == 0) {
+                LogError << "--video-out-bitrate must be at least 1";
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "video-out-segment") {
+            ret = ParseUint(key, value, config.videoSink.segmentSeconds);
+            if (ret == APP_ERR_OK && config.videoSink.segmentSeconds == 0) {
+                LogError << "--video-out-segment must be at least 1";
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "metrics-port") {
+            ret = ParseUint(key, value, config.metricsPort);
+            if (ret == APP_ERR_OK && config.metricsPort > MAX_METRICS_PORT) {
+                LogError << "--metrics-port out of range: " << value;
+                ret = APP_ERR_COMM_INVALID_PARAM;
+            }
+        } else if (key == "metrics-bind") {
+            config.metricsBind = value;
+        } else if (key == "soak") {
+            ret = ParseUint(key, value, config.soakSeconds);
+        } else if (key == "soak-growth") {
+            ret = ParseUint(key, value, config.soakGrowthMb);
+        } else {
+            LogError << "Unknown option: " << arg;
+            ret = APP_ERR_COMM_INVALID_PARAM;
+        }
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+    }
+    // v1 datagrams carry no gestures, the engine only runs there when its smoothed keypoints are sent
+    if (!gesturesSet) {
+        config.gestureParam.enabled =
+            config.resultProtocol == RESULT_PROTOCOL_V2 || config.gestureParam.smoothKeypoints;
+    }
+    return APP_ERR_OK;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_APPCONFIG_H
+#define STREAM_PULL_SAMPLE_APPCONFIG_H
+
+#include <string>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "../BlockingQueue/FrameQueue.h"
+#include "../InferenceBackend/InferenceBackend.h"
+#include "../Yolov3Detection/Yolov3Detection.h"
+#include "../ResnetDetector/ResnetDetector.h"
+#include "../FramePipeline/FrameContext.h"
+#include "../Metrics/MetricsServer.h"
+#include "../Metrics/MemoryTracker.h"
+#include "../HandTracker/HandTracker.h"
+#include "../GestureEngine/GestureEngine.h"
+#include "../VideoRelay/VideoRelay.h"
+#include "../ResultProtocol/ResultProtocol.h"
+#include "../VideoProcess/VideoProcess.h"
+#include "../WorkerGroup/WorkerGroup.h"
+
+// face detector post-processing; empty strings and 0 keep the hand detector's settings
+struct FaceModelParam {
+    std::string labelPath;
+    uint32_t classNum = 0;
+    // "w,h,w,h,..." in input pixels, anchor-dim pairs per output, largest grid first
+    std::string anchors;
+    std::string scoreThresh;
+    std::string objectnessThresh;
+    std::string iouThresh;
+};
+
+// command line: stream_pull_test [rtspUrl] [clientIp] [--option=value ...]
+struct AppConfig {
+    std::string streamName = "rtsp://192.168.30.20/";
+    std::string clientIp = "192.168.30.36";
+    // overflow policy and depth of the decoded-frame queue
+    QueuePolicy queuePolicy = QUEUE_POLICY_DROP_OLDEST;
+    uint32_t queueDepth = DEFAULT_FRAME_QUEUE_DEPTH;
+    // where the detectors run; empty model paths pick the default for the backend
+    BackendType backendType = BACKEND_ASCEND;
+    // one model replica per entry, streams are spread over them; a repeated id loads several on one chip
+    std::vector<uint32_t> deviceIds = {VideoProcess::DEVICE_ID};
+    std::string yoloModelPath;
+    std::string resnetModelPath;
+    // optional face detector, a YOLOv3 with the hand detector's input size; empty detects no faces
+    std::string faceModelPath;
+    FaceModelParam faceParam;
+    // VDEC on the Ascend device, or libavcodec on the host; 0 decode threads picks one per core
+    DecoderType decoderType = DECODER_DVPP;
+    uint32_t decodeThreads = 0;
+    // square model input sizes for the CPU backend, 0 keeps 416/256; an .om model brings its own
+    uint32_t detectInputSize = 0;
+    uint32_t keypointInputSize = 0;
+    // YOLO post-processing: in-tree decoder (native) or the SDK Yolov3PostProcess (sdk)
+    bool nativeDecode = true;
+    // hands that get keypoints per frame, packed into one batched launch
+    HandSelectParam handParam;
+    // detector every N frames, keypoint tracking in between
+    TrackParam trackParam;
+    // keypoint filtering and gesture classification in the send stage
+    GestureParam gestureParam;
+    // stream list file, one "url clientIp [videoPort resultPort]" per line; empty runs the single positional stream
+    std::string streamListPath;
+    // offline benchmark: replay a local MP4/H.264/H.265 file as the only stream and report at the end
+    std::string replayPath;
+    ReplayMode replayMode = REPLAY_FAST;
+    // pacing of the UDP video relay to each client, 0 leaves it unpaced
+    uint32_t relayRateMbps = DEFAULT_RELAY_RATE_MBPS;
+    // keypoint datagram layout; v1 stays the default for existing clients
+    ResultProtocolVersion resultProtocol = RESULT_PROTOCOL_V1;
+    // annotated JPEGs for visual debugging, off unless --render-every is given
+    RenderParam renderParam;
+    // annotated H.264 video of every stream, off unless --video-out is given
+    VideoSinkParam videoSink;
+    // Prometheus text endpoint, 0 disables it; loopback only unless a bind address is given
+    uint32_t metricsPort = 0;
+    std::string metricsBind = DEFAULT_METRICS_BIND;
+    // soak run: stop after this many seconds and fail if live buffer memory kept growing, 0 off
+    uint32_t soakSeconds = 0;
+    uint32_t soakGrowthMb = DEFAULT_SOAK_GROWTH_BYTES / (1024 * 1024);
+};
+
+APP_ERROR ParseAppConfig(int argc, char *argv[], AppConfig &config);
+APP_ERROR ParseQueuePolicy(const std::string &name, QueuePolicy &policy);
+const char *QueuePolicyName(QueuePolicy policy);
+APP_ERROR ParseBackendType(const std::string &name, BackendType &type);
+const char *BackendTypeName(BackendType type);
+APP_ERROR ParseDecoderType(const std::string &name, DecoderType &type);
+const char *DecoderTypeName(DecoderType type);
+void InitYolov3Param(const AppConfig &config, InitParam &initParam, const uint32_t deviceID);
+// the hand detector's parameters with the face model and the --face-* overrides
+void InitFaceParam(const AppConfig &config, InitParam &initParam, const uint32_t deviceID);
+void InitResnetParam(const AppConfig &config, ResnetInitParam &initParam, const uint32_t deviceID);
+// replicas on config.deviceIds with the detector parameters above; the face model only when one is given
+void InitWorkerGroupParam(const AppConfig &config, const FrameGeometry &warmupGeometry, WorkerGroupParam &param);
+void PrintUsage(const char *program);
+
+#endif // STREAM_PULL_SAMPLE_APPCONFIG_H
@@ -0,0 +1,65 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_FRAMECONTEXT_H
+#define STREAM_PULL_SAMPLE_FRAMECONTEXT_H
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "MxBase/MemoryHelper/MemoryHelper.h"
+#include "MxBase/Tensor/TensorBase/TensorBase.h"
+#include "ObjectPostProcessors/Yolov3PostProcess.h"
+#include "../InferenceBackend/TensorPool.h"
+
+static const uint32_t DEFAULT_MAX_HANDS = 4;
+static const float DEFAULT_HAND_THRESH = 0.5;
+
+// which detections get keypoints: the most confident hand always, others from minConfidence on
+struct HandSelectParam {
+    uint32_t maxHands = DEFAULT_MAX_HANDS;
+    float minConfidence = DEFAULT_HAND_THRESH;
+};
+
+// one hand picked for keypoint inference
+struct HandResult {
+    MxBase::ObjectInfo box = {};     // detection box expanded for the crop, frame coordinates
+    InputTensorHandle cropFrame;     // keypoint model input, back to the pool after inference
+    std::vector<float> keypoints;    // (x, y) pairs normalized to box
+    uint8_t gesture = 0;             // GestureType, set in the send stage by GestureEngine
+    bool gestureStart = false;       // the gesture became stable on this frame
+};
+
+// Everything one decoded frame accumulates on its way through the pipeline stages.
+// A context is owned by exactly one stage at a time, so its fields need no locking.
+struct FrameContext {
+    uint32_t frameId = 0;
+    std::shared_ptr<MxBase::MemoryData> frame;            // decoded NV12 frame
+    FrameGeometry geometry;                               // size and padded layout of frame
+    InputTensorHandle resizeFrame;                        // detector input, back to the pool after inference
+    OutputTensorHandle detectOutputs;                     // released once post-processing is done
+    std::vector<std::vector<MxBase::ObjectInfo>> objInfos;
+    std::vector<HandResult> hands;                        // most confident first
+    std::vector<MxBase::ObjectInfo> faces;                // face boxes in frame pixels, most confident first
+    bool tracked = false;                                 // hands predicted by HandTracker, detector skipped
+    bool render = false;                                  // frame kept to the send stage for FrameRenderer/VideoSink
+    // a failed stage marks the frame, the stages after it pass it on without work
+    bool skip = false;
+    std::chrono::steady_clock::time_point startTime;      // decoder output, for the end-to-end latency
+    int64_t captureUs = 0;                                // camera wall clock, us since the Unix epoch
+};
+
+#endif // STREAM_PULL_SAMPLE_FRAMECONTEXT_H
@@ -0,0 +1,217 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include "MxBase/Log/Log.h"
+#include "MxBase/DeviceManager/DeviceManager.h"
+#include "FramePipeline.h"
+#include "../AsyncLogger/AsyncLogger.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const unsigned int STAGE_POP_WAIT_TIME = 10;
+    const double NS_PER_MS = 1e6;
+    const uint64_t NS_PER_US = 1000;
+}
+
+FramePipeline::FramePipeline(const std::string &metricLabels) : metricLabels(metricLabels)
+{
+    failedFrames = MetricsRegistry::GetInstance()->GetCounter("hand_failed_frames_total",
+        "Frames a pipeline stage failed on", metricLabels);
+}
+
+FramePipeline::~FramePipeline()
+{
+    Stop();
+}
+
+APP_ERROR FramePipeline::AddStage(const std::string &name, StageFunc func, uint32_t workerNum, uint32_t queueDepth)
+{
+    if (running) {
+        LogError << "Stage " << name << " added after the pipeline started";
+        return APP_ERR_COMM_FAILURE;
+    }
+    if (workerNum == 0 || queueDepth == 0 || !func) {
+        LogError << "Invalid stage " << name;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    stages.emplace_back(new Stage(name, func, workerNum, queueDepth));
+    std::string labels = JoinMetricLabels(metricLabels, MetricLabels({{"stage", name}}));
+    stages.back()->latency = MetricsRegistry::GetInstance()->GetHistogram("hand_stage_latency_seconds",
+        "Time spent in one processing stage per frame", labels);
+    return APP_ERR_OK;
+}
+
+APP_ERROR FramePipeline::Start(uint32_t deviceId, bool bindDevice)
+{
+    if (stages.empty()) {
+        LogError << "Pipeline has no stage";
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    if (running.exchange(true)) {
+        return APP_ERR_OK;
+    }
+    reportTime = Clock::now();
+    for (auto &stage : stages) {
+        Stage *stagePtr = stage.get();
+        metricCallbacks.push_back(MetricsRegistry::GetInstance()->RegisterCallback("hand_stage_queue_depth",
+            "Frames waiting in front of a pipeline stage", METRIC_GAUGE,
+            JoinMetricLabels(metricLabels, MetricLabels({{"stage", stage->name}})),
+            [stagePtr]() { return (double)stagePtr->input.GetSize(); }));
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        for (uint32_t w = 0; w < stages[i]->workerNum; w++) {
+            stages[i]->workers.emplace_back(&FramePipeline::StageWorker, this, i, deviceId, bindDevice);
+        }
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR FramePipeline::Push(const FrameContextPtr &context)
+{
+    if (stages.empty() || !running) {
+        return APP_ERR_QUEUE_STOPED;
+    }
+    pushedFrames++;
+    APP_ERROR ret = stages[0]->input.Push(context, true);
+    if (ret != APP_ERR_OK) {
+        pushedFrames--;
+    }
+    return ret;
+}
+
+bool FramePipeline::Drain(uint32_t timeoutMs)
+{
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (finishedFrames < pushedFrames) {
+        if (!running || Clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void FramePipeline::Stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    for (uint64_t id : metricCallbacks) {
+        MetricsRegistry::GetInstance()->Unregister(id);
+    }
+    metricCallbacks.clear();
+    for (auto &stage : stages) {
+        stage->input.Stop();
+    }
+    for (auto &stage : stages) {
+        for (auto &worker : stage->workers) {
+            worker.join();
+        }
+        stage->workers.clear();
+        stage->input.Clear();
+    }
+}
+
+void FramePipeline::StageWorker(size_t index, uint32_t deviceId, bool bindDevice)
+{
+    APP_ERROR ret = APP_ERR_OK;
+    if (bindDevice) {
+        MxBase::DeviceContext device;
+        device.devId = deviceId;
+        ret = MxBase::DeviceManager::GetInstance()->SetDevice(device);
+        if (ret != APP_ERR_OK) {
+            LogError << "SetDevice failed in stage " << stages[index]->name;
+            return;
+        }
+    }
+    Stage &stage = *stages[index];
+    Stage *next = index + 1 < stages.size() ? stages[index + 1].get() : nullptr;
+    while (true) {
+        FrameContextPtr context;
+        ret = stage.input.Pop(context, STAGE_POP_WAIT_TIME);
+        if (ret == APP_ERR_QUEUE_EMPTY) {
+            continue;
+        }
+        if (ret != APP_ERR_OK) {
+            break;
+        }
+        if (!context->skip) {
+            auto start = Clock::now();
+            ret = stage.func(*context);
+            auto elapsed = Clock::now() - start;
+            uint64_t busyNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            stage.busyNs += busyNs;
+            stage.frames++;
+            stage.latency->Observe(busyNs / NS_PER_US);
+            if (ret != APP_ERR_OK) {
+                HotLogRate(HOT_LOG_LEVEL_ERROR, 1) << "Stage " << stage.name << " failed on frame "
+                                                   << context->frameId << ", ret=" << ret;
+                context->skip = true;
+                failedFrames->Add();
+            }
+        }
+        if (next == nullptr) {
+            finishedFrames++;
+        } else if (next->input.Push(std::move(context), true) != APP_ERR_OK) {
+            break;
+        }
+    }
+}
+
+void FramePipeline::GetStageStats(std::vector<StageStats> &stats)
+{
+    auto now = Clock::now();
+    double windowNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(now - reportTime).count();
+    reportTime = now;
+    stats.clear();
+    for (auto &stage : stages) {
+        uint64_t busyNs = stage->busyNs.load();
+        uint64_t frames = stage->frames.load();
+        StageStats stat;
+        stat.name = stage->name;
+        stat.workerNum = stage->workerNum;
+        stat.frames = frames - stage->reportedFrames;
+        double busy = (double)(busyNs - stage->reportedBusyNs);
+        stat.busyRatio = windowNs > 0 ? busy / (windowNs * stage->workerNum) : 0;
+        stat.meanMs = stat.frames == 0 ? 0 : busy / NS_PER_MS / stat.frames;
+        stat.queueSize = stage->input.GetSize();
+        stage->reportedBusyNs = busyNs;
+        stage->reportedFrames = frames;
+        stats.push_back(stat);
+    }
+}
+
+void FramePipeline::ReportOccupancy()
+{
+    std::vector<StageStats> stats;
+    GetStageStats(stats);
+    if (stats.empty()) {
+        return;
+    }
+    size_t bottleneck = 0;
+    std::string line;
+    char item[128];
+    for (size_t i = 0; i < stats.size(); i++) {
+        if (stats[i].busyRatio > stats[bottleneck].busyRatio) {
+            bottleneck = i;
+        }
+        snprintf(item, sizeof(item), " %s %.0f%% %.2fms q%d", stats[i].name.c_str(), stats[i].busyRatio * 100,
+                 stats[i].meanMs, stats[i].queueSize);
+        line += item;
+    }
+    LogInfo << "pipeline occupancy:" << line << ", bottleneck: " << stats[bottleneck].name;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_FRAMEPIPELINE_H
+#define STREAM_PULL_SAMPLE_FRAMEPIPELINE_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "../BlockingQueue/RingQueue.h"
+#include "../Metrics/Metrics.h"
+#include "FrameContext.h"
+
+// frames waiting in front of a stage; small so in-flight frames (and their pooled tensors) stay bounded
+static const uint32_t DEFAULT_STAGE_QUEUE_DEPTH = 2;
+
+typedef std::shared_ptr<FrameContext> FrameContextPtr;
+typedef std::function<APP_ERROR(FrameContext &context)> StageFunc;
+
+struct StageStats {
+    std::string name;
+    uint32_t workerNum;
+    uint64_t frames;
+    double busyRatio;   // share of the report window the stage's workers spent working
+    double meanMs;      // per processed frame
+    int queueSize;      // frames waiting in front of the stage
+};
+
+// Runs the per-frame steps as a chain of stages. Every stage has its own worker thread(s) and a
+// bounded handoff queue in front of it, so consecutive frames overlap: while frame N runs keypoint
+// inference, frame N+1 is already being resized and detected. Throughput is set by the slowest
+// stage; a full queue blocks the stage before it, which pushes back onto the decoded-frame queue
+// and its drop policy.
+// Stages run in the order they are added. With one worker per stage frames leave in order.
+// Stage latency, queue depth and failed frames are exported to MetricsRegistry under metricLabels.
+class FramePipeline {
+public:
+    explicit FramePipeline(const std::string &metricLabels = "");
+    ~FramePipeline();
+    FramePipeline(const FramePipeline &) = delete;
+    FramePipeline &operator=(const FramePipeline &) = delete;
+
+    APP_ERROR AddStage(const std::string &name, StageFunc func, uint32_t workerNum = 1,
+                       uint32_t queueDepth = DEFAULT_STAGE_QUEUE_DEPTH);
+    // workers bind to deviceId before they run any stage, unless the stages never touch the device
+    APP_ERROR Start(uint32_t deviceId, bool bindDevice = true);
+    // blocks while the first stage is full; returns APP_ERR_QUEUE_STOPED once stopped
+    APP_ERROR Push(const FrameContextPtr &context);
+    // true once every pushed frame has left the last stage, false if that takes longer than timeoutMs
+    bool Drain(uint32_t timeoutMs);
+    void Stop();
+    // occupancy since the previous call
+    void GetStageStats(std::vector<StageStats> &stats);
+    void ReportOccupancy();
+private:
+    struct Stage {
+        std::string name;
+        StageFunc func;
+        uint32_t workerNum;
+        MpmcRingQueue<FrameContextPtr> input;
+        std::vector<std::thread> workers;
+        std::atomic<uint64_t> busyNs;
+        std::atomic<uint64_t> frames;
+        LatencyHistogram *latency = nullptr;
+        uint64_t reportedBusyNs = 0;
+        uint64_t reportedFrames = 0;
+
+        Stage(const std::string &name, StageFunc func, uint32_t workerNum, uint32_t queueDepth)
+            : name(name), func(func), workerNum(workerNum), input(queueDepth), busyNs(0), frames(0) {}
+    };
+    void StageWorker(size_t index, uint32_t deviceId, bool bindDevice);
+private:
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::atomic<bool> running{false};
+    // frames accepted by Push and frames that left the last stage (processed or failed)
+    std::atomic<uint64_t> pushedFrames{0};
+    std::atomic<uint64_t> finishedFrames{0};
+    const std::string metricLabels;
+    MetricCounter *failedFrames = nullptr;
+    std::vector<uint64_t> metricCallbacks;
+    std::chrono::steady_clock::time_point reportTime;
+};
+
+#endif // STREAM_PULL_SAMPLE_FRAMEPIPELINE_H
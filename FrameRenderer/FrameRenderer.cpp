@@ -0,0 +1,317 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "MxBase/Log/Log.h"
+#include "MxBase/DeviceManager/DeviceManager.h"
+#include "../AsyncLogger/AsyncLogger.h"
+#include "FrameRenderer.h"
+#include "Nv12Canvas.h"
+
+extern "C"{
+#include "libavcodec/avcodec.h"
+#include "libavutil/avutil.h"
+}
+
+namespace {
+    const uint32_t RENDER_POP_WAIT_TIME = 100;
+    const uint32_t MIN_QSCALE = 2;
+    const uint32_t MAX_QSCALE = 31;
+    // decoded NV12 is limited range (Y 16..235, UV 16..240), JPEG viewers assume full range
+    const int LIMITED_LUMA_MIN = 16;
+    const int LIMITED_LUMA_RANGE = 219;
+    const int LIMITED_CHROMA_RANGE = 224;
+    const int CHROMA_ZERO = 128;
+    const int FULL_RANGE = 255;
+
+    uint8_t ClampByte(int value)
+    {
+        return (uint8_t)std::min(std::max(value, 0), FULL_RANGE);
+    }
+}
+
+// per-thread state: the host copy of the frame, the chroma planes for the encoder and the
+// encoder itself, all kept between frames and only rebuilt when the picture size changes
+class FrameRenderer::Worker {
+public:
+    explicit Worker(const RenderParam &param) : param(param)
+    {
+        int half = LIMITED_LUMA_RANGE / 2;
+        for (int i = 0; i <= FULL_RANGE; i++) {
+            lumaLut[i] = ClampByte(((i - LIMITED_LUMA_MIN) * FULL_RANGE + half) / LIMITED_LUMA_RANGE);
+            int chroma = (i - CHROMA_ZERO) * FULL_RANGE;
+            chroma = (chroma + (chroma < 0 ? -LIMITED_CHROMA_RANGE : LIMITED_CHROMA_RANGE) / 2) / LIMITED_CHROMA_RANGE;
+            chromaLut[i] = ClampByte(chroma + CHROMA_ZERO);
+        }
+    }
+    ~Worker()
+    {
+        CloseEncoder();
+    }
+
+    APP_ERROR Render(const RenderJob &job)
+    {
+        const FrameGeometry &geometry = job.geometry;
+        size_t frameSize = GetNv12Size(geometry);
+        if (frameSize == 0 || job.frame->size < frameSize) {
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        // 拷贝到复用的Host缓冲区，直接在NV12平面上绘制
+        if (nv12.size() < frameSize) {
+            nv12.resize(frameSize);
+        }
+        MxBase::MemoryData host(nv12.data(), frameSize, MxBase::MemoryData::MEMORY_HOST_NEW, param.deviceId);
+        APP_ERROR ret = MxBase::MemoryHelper::MxbsMemcpy(host, *job.frame, frameSize);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        Nv12Canvas canvas(nv12.data(), geometry);
+        DrawHands(canvas, job.hands);
+        DrawFaces(canvas, job.faces);
+        ret = Encode(job);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        std::string path = param.outputDir + "/result_" + std::to_string(job.streamId) + "_" +
+            std::to_string(job.frameId) + ".jpg";
+        FILE *file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            HotLogRate(HOT_LOG_LEVEL_ERROR, 1) << "cannot write " << path;
+            av_packet_unref(packet);
+            return APP_ERR_COMM_OPEN_FAIL;
+        }
+        size_t jpegSize = (size_t)packet->size;
+        size_t written = fwrite(packet->data, 1, jpegSize, file);
+        fclose(file);
+        av_packet_unref(packet);
+        return written == jpegSize ? APP_ERR_OK : APP_ERR_COMM_WRITE_FAIL;
+    }
+private:
+    APP_ERROR OpenEncoder(uint32_t width, uint32_t height)
+    {
+        CloseEncoder();
+        const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+        if (codec == nullptr) {
+            LogError << "libavcodec has no MJPEG encoder";
+            return APP_ERR_COMM_INIT_FAIL;
+        }
+        encoder = avcodec_alloc_context3(codec);
+        picture = av_frame_alloc();
+        packet = av_packet_alloc();
+        if (encoder == nullptr || picture == nullptr || packet == nullptr) {
+            CloseEncoder();
+            return APP_ERR_COMM_ALLOC_MEM;
+        }
+        encoder->width = (int)width;
+        encoder->height = (int)height;
+        encoder->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        encoder->time_base = AVRational{1, 25};
+        // fixed quantizer instead of a bitrate, every image gets the same quality
+        encoder->flags |= AV_CODEC_FLAG_QSCALE;
+        encoder->global_quality = FF_QP2LAMBDA * (int)param.qscale;
+        // parallelism comes from the workers, one encoder thread each
+        encoder->thread_count = 1;
+        if (avcodec_open2(encoder, codec, nullptr) < 0) {
+            LogError << "Failed to open the MJPEG encoder for " << width << "x" << height;
+            CloseEncoder();
+            return APP_ERR_COMM_INIT_FAIL;
+        }
+        return APP_ERR_OK;
+    }
+
+    void CloseEncoder()
+    {
+        if (packet != nullptr) {
+            av_packet_free(&packet);
+        }
+        if (picture != nullptr) {
+            av_frame_free(&picture);
+        }
+        if (encoder != nullptr) {
+            avcodec_free_context(&encoder);
+        }
+    }
+
+    // leaves the JPEG in packet
+    APP_ERROR Encode(const RenderJob &job)
+    {
+        const FrameGeometry &geometry = job.geometry;
+        if (encoder == nullptr || encoder->width != (int)geometry.width || encoder->height != (int)geometry.height) {
+            APP_ERROR ret = OpenEncoder(geometry.width, geometry.height);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+        }
+        // the Y plane is expanded to full range in place, the interleaved UV plane is expanded while it is
+        // split for the planar encoder
+        for (uint32_t row = 0; row < geometry.height; row++) {
+            uint8_t *y = nv12.data() + (size_t)row * geometry.widthStride;
+            for (uint32_t col = 0; col < geometry.width; col++) {
+                y[col] = lumaLut[y[col]];
+            }
+        }
+        uint32_t chromaWidth = (geometry.width + 1) / 2;
+        uint32_t chromaHeight = (geometry.height + 1) / 2;
+        uPlane.resize((size_t)chromaWidth * chromaHeight);
+        vPlane.resize(uPlane.size());
+        const uint8_t *uv = nv12.data() + (size_t)geometry.widthStride * geometry.heightStride;
+        for (uint32_t row = 0; row < chromaHeight; row++) {
+            const uint8_t *src = uv + (size_t)row * geometry.widthStride;
+            uint8_t *u = uPlane.data() + (size_t)row * chromaWidth;
+            uint8_t *v = vPlane.data() + (size_t)row * chromaWidth;
+            for (uint32_t col = 0; col < chromaWidth; col++) {
+                u[col] = chromaLut[src[col * 2]];
+                v[col] = chromaLut[src[col * 2 + 1]];
+            }
+        }
+        picture->data[0] = nv12.data();
+        picture->data[1] = uPlane.data();
+        picture->data[2] = vPlane.data();
+        picture->linesize[0] = (int)geometry.widthStride;
+        picture->linesize[1] = (int)chromaWidth;
+        picture->linesize[2] = (int)chromaWidth;
+        picture->width = (int)geometry.width;
+        picture->height = (int)geometry.height;
+        picture->format = AV_PIX_FMT_YUVJ420P;
+        picture->quality = encoder->global_quality;
+        picture->pts = job.frameId;
+        if (avcodec_send_frame(encoder, picture) < 0 || avcodec_receive_packet(encoder, packet) < 0) {
+            return APP_ERR_COMM_FAILURE;
+        }
+        return APP_ERR_OK;
+    }
+private:
+    const RenderParam &param;
+    std::vector<uint8_t> nv12;
+    std::vector<uint8_t> uPlane;
+    std::vector<uint8_t> vPlane;
+    uint8_t lumaLut[FULL_RANGE + 1];
+    uint8_t chromaLut[FULL_RANGE + 1];
+    AVCodecContext *encoder = nullptr;
+    AVFrame *picture = nullptr;
+    AVPacket *packet = nullptr;
+};
+
+FrameRenderer::~FrameRenderer()
+{
+    Stop();
+}
+
+APP_ERROR FrameRenderer::Start(const RenderParam &param)
+{
+    if (running) {
+        return APP_ERR_OK;
+    }
+    if (param.renderEvery == 0 || param.workerNum == 0) {
+        LogError << "rendering needs a render interval and at least one worker";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    this->param = param;
+    this->param.qscale = std::min(std::max(param.qscale, MIN_QSCALE), MAX_QSCALE);
+    queue.reset(new FrameQueue<RenderJob>(QUEUE_POLICY_DROP_NEWEST, param.queueDepth));
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    rendered = registry->GetCounter("hand_rendered_frames_total", "Annotated frames written as JPEG", "");
+    failed = registry->GetCounter("hand_render_errors_total", "Frames the renderer could not write", "");
+    latency = registry->GetHistogram("hand_render_latency_seconds", "Copy, draw, encode and write of one frame", "");
+    FrameQueue<RenderJob> *jobs = queue.get();
+    metricCallbacks.push_back(registry->RegisterCallback("hand_render_dropped_total",
+        "Frames not rendered because every render worker was busy", METRIC_COUNTER, "",
+        [jobs]() { return (double)jobs->GetDroppedCount(); }));
+    running = true;
+    for (uint32_t i = 0; i < param.workerNum; i++) {
+        workers.emplace_back(&FrameRenderer::Run, this, i);
+    }
+    LogInfo << "rendering every " << param.renderEvery << " frame(s) to " << param.outputDir << " on "
+            << param.workerNum << " worker(s)";
+    return APP_ERR_OK;
+}
+
+void FrameRenderer::Stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    queue->Stop();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    for (uint64_t id : metricCallbacks) {
+        MetricsRegistry::GetInstance()->Unregister(id);
+    }
+    metricCallbacks.clear();
+    if (queue->GetDroppedCount() != 0) {
+        LogInfo << "renderer dropped " << queue->GetDroppedCount() << " of " << queue->GetPushedCount()
+                << " frames, its workers were busy";
+    }
+}
+
+bool FrameRenderer::ShouldRender(uint32_t frameId) const
+{
+    return running.load(std::memory_order_relaxed) && param.renderEvery != 0 && frameId % param.renderEvery == 0;
+}
+
+void FrameRenderer::Submit(const RenderJob &job)
+{
+    if (!running.load(std::memory_order_relaxed) || job.frame == nullptr) {
+        return;
+    }
+    queue->Push(job);
+}
+
+void FrameRenderer::Run(uint32_t index)
+{
+    MxBase::DeviceContext device;
+    device.devId = param.deviceId;
+    if (param.bindDevice && MxBase::DeviceManager::GetInstance()->SetDevice(device) != APP_ERR_OK) {
+        LogError << "SetDevice failed in render worker " << index;
+        return;
+    }
+    Worker worker(param);
+    RenderJob job;
+    while (queue->Pop(job, RENDER_POP_WAIT_TIME) != APP_ERR_QUEUE_STOPED) {
+        if (job.frame == nullptr) {
+            continue;
+        }
+        // 各路流的帧在各自的芯片上，拷贝前切换到帧所在的设备
+        if (param.bindDevice && job.frame->deviceId != device.devId) {
+            MxBase::DeviceContext frameDevice;
+            frameDevice.devId = job.frame->deviceId;
+            if (MxBase::DeviceManager::GetInstance()->SetDevice(frameDevice) != APP_ERR_OK) {
+                failed->Add();
+                HotLogRate(HOT_LOG_LEVEL_WARN, 1) << "render worker " << index << " cannot bind device "
+                                                  << frameDevice.devId;
+                job = RenderJob();
+                continue;
+            }
+            device = frameDevice;
+        }
+        auto start = std::chrono::steady_clock::now();
+        APP_ERROR ret = worker.Render(job);
+        // 尽早释放解码帧
+        job = RenderJob();
+        if (ret != APP_ERR_OK) {
+            failed->Add();
+            HotLogRate(HOT_LOG_LEVEL_WARN, 1) << "render worker " << index << " failed, ret=" << ret;
+            continue;
+        }
+        rendered->Add();
+        latency->ObserveSince(start);
+    }
+}
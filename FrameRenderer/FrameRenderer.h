@@ -0,0 +1,91 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_FRAMERENDERER_H
+#define STREAM_PULL_SAMPLE_FRAMERENDERER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "MxBase/MemoryHelper/MemoryHelper.h"
+#include "../BlockingQueue/FrameQueue.h"
+#include "../FramePipeline/FrameContext.h"
+#include "../Metrics/Metrics.h"
+
+static const uint32_t DEFAULT_RENDER_WORKERS = 2;
+static const uint32_t DEFAULT_RENDER_QSCALE = 5;
+
+struct RenderParam {
+    // annotate every N-th frame of each stream, 0 renders nothing
+    uint32_t renderEvery = 0;
+    uint32_t workerNum = DEFAULT_RENDER_WORKERS;
+    // frames waiting for a worker; a full queue drops the new frame, the pipeline never waits
+    uint32_t queueDepth = DEFAULT_RENDER_WORKERS * 2;
+    // MJPEG quantizer, 2 is the best quality and 31 the smallest file
+    uint32_t qscale = DEFAULT_RENDER_QSCALE;
+    // device the workers start on, they switch to the device of each frame they copy
+    uint32_t deviceId = 0;
+    // false when every frame is in host memory, the workers then bind no device
+    bool bindDevice = true;
+    std::string outputDir = "./result";
+};
+
+// one frame to annotate; holds the decoded frame until a worker has copied it to the host
+struct RenderJob {
+    uint32_t streamId = 0;
+    uint32_t frameId = 0;
+    int64_t captureUs = 0;      // camera wall clock, the video output's timestamps
+    std::shared_ptr<MxBase::MemoryData> frame;
+    FrameGeometry geometry;
+    std::vector<HandResult> hands;
+    std::vector<MxBase::ObjectInfo> faces;
+};
+
+// Visual debugging off the inference path. Workers copy the NV12 frame into a host buffer they
+// reuse, draw the hand and face boxes and the 21-point skeletons straight into the Y and UV planes and
+// encode the result with libavcodec's MJPEG encoder to <outputDir>/result_<stream>_<frame>.jpg.
+// There is no BGR conversion and nothing runs on the pipeline threads besides queuing the job.
+class FrameRenderer {
+public:
+    FrameRenderer() = default;
+    ~FrameRenderer();
+    FrameRenderer(const FrameRenderer &) = delete;
+    FrameRenderer &operator=(const FrameRenderer &) = delete;
+
+    APP_ERROR Start(const RenderParam &param);
+    // joins the workers; jobs still queued are discarded
+    void Stop();
+    bool ShouldRender(uint32_t frameId) const;
+    // never blocks; a job that finds the queue full is dropped and counted
+    void Submit(const RenderJob &job);
+private:
+    class Worker;
+    void Run(uint32_t index);
+private:
+    RenderParam param;
+    std::unique_ptr<FrameQueue<RenderJob>> queue;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{false};
+    MetricCounter *rendered = nullptr;
+    MetricCounter *failed = nullptr;
+    LatencyHistogram *latency = nullptr;
+    std::vector<uint64_t> metricCallbacks;
+};
+
+#endif // STREAM_PULL_SAMPLE_FRAMERENDERER_H
@@ -0,0 +1,132 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include "Nv12Canvas.h"
+
+namespace {
+    const int BOX_THICKNESS = 4;
+    // 手指关键点连线：每根手指从腕部0号点出发，依次连接4个关键点
+    const int FINGER_NUM = 5;
+    const int FINGER_POINTS = 4;
+    const int SKELETON_POINTS = FINGER_NUM * FINGER_POINTS + 1;
+    const Nv12Color BOX_COLOR = {145, 54, 34};          // green
+    const Nv12Color SKELETON_COLOR = {81, 90, 240};     // red
+    const Nv12Color FACE_COLOR = {41, 240, 110};        // blue
+
+    void DrawHand(Nv12Canvas &canvas, const HandResult &hand)
+    {
+        const MxBase::ObjectInfo &box = hand.box;
+        canvas.DrawRect((int)box.x0, (int)box.y0, (int)box.x1, (int)box.y1, BOX_THICKNESS, BOX_COLOR);
+        float ow = box.x1 - box.x0;
+        float oh = box.y1 - box.y0;
+        if (hand.keypoints.size() < (size_t)SKELETON_POINTS * 2) {
+            return;
+        }
+        // only the skeleton's points are projected, into fixed arrays: nothing is allocated per hand
+        int x[SKELETON_POINTS];
+        int y[SKELETON_POINTS];
+        for (int j = 0; j < SKELETON_POINTS; j++) {
+            x[j] = (int)(hand.keypoints[j * 2] * ow + box.x0);
+            y[j] = (int)(hand.keypoints[j * 2 + 1] * oh + box.y0);
+        }
+        for (int m = 0; m < FINGER_NUM; m++) {
+            int from = 0;
+            for (int n = 1; n <= FINGER_POINTS; n++) {
+                int to = m * FINGER_POINTS + n;
+                canvas.DrawLine(x[from], y[from], x[to], y[to], SKELETON_COLOR);
+                from = to;
+            }
+        }
+    }
+}
+
+Nv12Canvas::Nv12Canvas(uint8_t *data, const FrameGeometry &geometry)
+    : luma(data), chroma(data + (size_t)geometry.widthStride * geometry.heightStride), geometry(geometry)
+{
+}
+
+void Nv12Canvas::PaintBlock(int x, int y, const Nv12Color &color)
+{
+    if (x < 0 || y < 0 || x >= (int)geometry.width || y >= (int)geometry.height) {
+        return;
+    }
+    uint32_t bx = (uint32_t)x & ~1u;
+    uint32_t by = (uint32_t)y & ~1u;
+    uint32_t w = bx + 1 < geometry.width ? 2 : 1;
+    uint32_t h = by + 1 < geometry.height ? 2 : 1;
+    for (uint32_t row = by; row < by + h; row++) {
+        for (uint32_t col = bx; col < bx + w; col++) {
+            luma[(size_t)row * geometry.widthStride + col] = color.y;
+        }
+    }
+    uint8_t *uv = chroma + (size_t)(by / 2) * geometry.widthStride + bx;
+    uv[0] = color.u;
+    uv[1] = color.v;
+}
+
+void Nv12Canvas::DrawRect(int x0, int y0, int x1, int y1, int thickness, const Nv12Color &color)
+{
+    for (int t = 0; t < thickness; t += 2) {
+        for (int x = x0; x <= x1; x += 2) {
+            PaintBlock(x, y0 + t, color);
+            PaintBlock(x, y1 - t, color);
+        }
+        for (int y = y0; y <= y1; y += 2) {
+            PaintBlock(x0 + t, y, color);
+            PaintBlock(x1 - t, y, color);
+        }
+    }
+}
+
+// Bresenham, one block per step
+void Nv12Canvas::DrawLine(int x0, int y0, int x1, int y1, const Nv12Color &color)
+{
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    while (true) {
+        PaintBlock(x0, y0, color);
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void DrawHands(Nv12Canvas &canvas, const std::vector<HandResult> &hands)
+{
+    for (const auto &hand : hands) {
+        DrawHand(canvas, hand);
+    }
+}
+
+void DrawFaces(Nv12Canvas &canvas, const std::vector<MxBase::ObjectInfo> &faces)
+{
+    for (const auto &face : faces) {
+        canvas.DrawRect((int)face.x0, (int)face.y0, (int)face.x1, (int)face.y1, BOX_THICKNESS, FACE_COLOR);
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_NV12CANVAS_H
+#define STREAM_PULL_SAMPLE_NV12CANVAS_H
+
+#include <vector>
+#include <stdint.h>
+#include "../InferenceBackend/InferenceBackend.h"
+#include "../FramePipeline/FrameContext.h"
+
+// BT.601 limited range, what VDEC and libavcodec output
+struct Nv12Color {
+    uint8_t y;
+    uint8_t u;
+    uint8_t v;
+};
+
+// Draws on an NV12 frame in host memory, in place. Everything is painted in 2x2 blocks on even
+// coordinates, so every painted pixel owns its whole UV sample and the color stays exact.
+class Nv12Canvas {
+public:
+    Nv12Canvas(uint8_t *data, const FrameGeometry &geometry);
+
+    // the 2x2 block containing (x, y); outside the picture nothing happens
+    void PaintBlock(int x, int y, const Nv12Color &color);
+    void DrawRect(int x0, int y0, int x1, int y1, int thickness, const Nv12Color &color);
+    void DrawLine(int x0, int y0, int x1, int y1, const Nv12Color &color);
+private:
+    uint8_t *luma;
+    uint8_t *chroma;
+    FrameGeometry geometry;
+};
+
+// hand boxes in green and the 21-point skeletons in red, as the result client draws them
+void DrawHands(Nv12Canvas &canvas, const std::vector<HandResult> &hands);
+// face boxes in blue
+void DrawFaces(Nv12Canvas &canvas, const std::vector<MxBase::ObjectInfo> &faces);
+
+#endif // STREAM_PULL_SAMPLE_NV12CANVAS_H
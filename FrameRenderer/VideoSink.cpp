@@ -0,0 +1,365 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstring>
+#include "MxBase/Log/Log.h"
+#include "MxBase/DeviceManager/DeviceManager.h"
+#include "../AsyncLogger/AsyncLogger.h"
+#include "VideoSink.h"
+#include "Nv12Canvas.h"
+
+namespace {
+    const uint32_t SINK_POP_WAIT_TIME = 100;
+    // 90 kHz like RTP and MPEG-TS, the muxers rescale it to their own time base
+    const AVRational SINK_TIME_BASE = {1, 90000};
+    const int64_t US_PER_TICK_NUM = 100;
+    const int64_t US_PER_TICK_DEN = 9;
+    // a key frame at least every 2 s at 25 fps, MP4 segments can only start on one
+    const int SINK_GOP_SIZE = 50;
+    // an output that failed to open or broke (RTSP server gone, disk full) is retried after this long
+    const uint32_t SINK_RETRY_INTERVAL_MS = 5000;
+    const char *STREAM_PLACEHOLDER = "{stream}";
+
+    bool EndsWith(const std::string &name, const std::string &suffix)
+    {
+        return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // libavformat muxer for the configured output, "segment" for a directory
+    const char *MuxerName(const std::string &name)
+    {
+        if (name.compare(0, strlen("rtsp://"), "rtsp://") == 0) {
+            return "rtsp";
+        }
+        if (name.find("://") != std::string::npos || EndsWith(name, ".ts")) {
+            return "mpegts";
+        }
+        return "segment";
+    }
+
+    bool SupportsNv12(const AVCodec *codec)
+    {
+        if (codec->pix_fmts == nullptr) {
+            return false;
+        }
+        for (const enum AVPixelFormat *format = codec->pix_fmts; *format != AV_PIX_FMT_NONE; format++) {
+            if (*format == AV_PIX_FMT_NV12) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // libx264 when it is built in, otherwise whatever H.264 encoder libavcodec has, as long as it takes NV12
+    const AVCodec *FindH264Encoder()
+    {
+        const AVCodec *codec = avcodec_find_encoder_by_name("libx264");
+        if (codec == nullptr) {
+            codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+        }
+        return codec != nullptr && SupportsNv12(codec) ? codec : nullptr;
+    }
+}
+
+VideoSink::VideoSink(uint32_t streamId) : streamId(streamId)
+{
+}
+
+VideoSink::~VideoSink()
+{
+    Stop();
+}
+
+APP_ERROR VideoSink::Start(const VideoSinkParam &param)
+{
+    if (running) {
+        return APP_ERR_OK;
+    }
+    if (param.output.empty()) {
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    const AVCodec *codec = FindH264Encoder();
+    if (codec == nullptr) {
+        LogError << "video output needs an H.264 encoder with NV12 input (libx264) in libavcodec";
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    this->param = param;
+    queue.reset(new FrameQueue<RenderJob>(QUEUE_POLICY_DROP_OLDEST, param.queueDepth));
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    std::string labels = MetricLabels({{"stream", std::to_string(streamId)}});
+    encoded = registry->GetCounter("hand_video_out_frames_total", "Annotated frames encoded to the video output",
+                                   labels);
+    failed = registry->GetCounter("hand_video_out_errors_total", "Frames the video output could not encode",
+                                  labels);
+    bytes = registry->GetCounter("hand_video_out_bytes_total", "H.264 bytes written to the video output", labels);
+    latency = registry->GetHistogram("hand_video_out_latency_seconds", "Copy, draw and encode of one frame",
+                                     labels);
+    FrameQueue<RenderJob> *jobs = queue.get();
+    metricCallbacks.push_back(registry->RegisterCallback("hand_video_out_dropped_total",
+        "Frames skipped because the video encoder was behind", METRIC_COUNTER, labels,
+        [jobs]() { return (double)jobs->GetDroppedCount(); }));
+    running = true;
+    worker = std::thread(&VideoSink::Run, this);
+    LogInfo << "stream " << streamId << " video output to " << OutputName() << " at " << param.bitrateKbps
+            << " kbit/s with " << codec->name;
+    return APP_ERR_OK;
+}
+
+void VideoSink::Stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    queue->Stop();
+    worker.join();
+    for (uint64_t id : metricCallbacks) {
+        MetricsRegistry::GetInstance()->Unregister(id);
+    }
+    metricCallbacks.clear();
+    if (queue->GetDroppedCount() != 0) {
+        LogInfo << "stream " << streamId << " video output skipped " << queue->GetDroppedCount() << " of "
+                << queue->GetPushedCount() << " frames, the encoder was behind";
+    }
+}
+
+bool VideoSink::IsRunning() const
+{
+    return running.load(std::memory_order_relaxed);
+}
+
+void VideoSink::Submit(const RenderJob &job)
+{
+    if (!running.load(std::memory_order_relaxed) || job.frame == nullptr) {
+        return;
+    }
+    queue->Push(job);
+}
+
+std::string VideoSink::OutputName() const
+{
+    std::string name = param.output;
+    size_t pos = name.find(STREAM_PLACEHOLDER);
+    if (pos != std::string::npos) {
+        name.replace(pos, strlen(STREAM_PLACEHOLDER), std::to_string(streamId));
+    }
+    if (std::string(MuxerName(name)) != "segment") {
+        return name;
+    }
+    // 目录：按开始时间命名的MP4分段文件，重启不会覆盖之前的录像
+    return name + "/stream" + std::to_string(streamId) + "_%Y%m%d-%H%M%S.mp4";
+}
+
+void VideoSink::Run()
+{
+    MxBase::DeviceContext device;
+    device.devId = param.deviceId;
+    if (param.bindDevice && MxBase::DeviceManager::GetInstance()->SetDevice(device) != APP_ERR_OK) {
+        LogError << "SetDevice failed in the video output of stream " << streamId;
+        return;
+    }
+    RenderJob job;
+    while (queue->Pop(job, SINK_POP_WAIT_TIME) != APP_ERR_QUEUE_STOPED) {
+        if (job.frame == nullptr) {
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        APP_ERROR ret = Encode(job);
+        // 尽早释放解码帧
+        job = RenderJob();
+        if (ret != APP_ERR_OK) {
+            failed->Add();
+            HotLogRate(HOT_LOG_LEVEL_WARN, 1) << "stream " << streamId << " video output failed, ret=" << ret;
+            continue;
+        }
+        encoded->Add();
+        latency->ObserveSince(start);
+    }
+    Close();
+}
+
+APP_ERROR VideoSink::Open(const FrameGeometry &geometry)
+{
+    Close();
+    std::string name = OutputName();
+    std::string format = MuxerName(name);
+    if (avformat_alloc_output_context2(&output, nullptr, format.c_str(), name.c_str()) < 0 || output == nullptr) {
+        LogError << "cannot create the " << format << " output " << name;
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    const AVCodec *codec = FindH264Encoder();
+    encoder = avcodec_alloc_context3(codec);
+    stream = avformat_new_stream(output, nullptr);
+    picture = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (encoder == nullptr || stream == nullptr || picture == nullptr || packet == nullptr) {
+        Close();
+        return APP_ERR_COMM_ALLOC_MEM;
+    }
+    // 4:2:0 needs even sizes, an odd last row or column is left out
+    encoder->width = (int)(geometry.width & ~1u);
+    encoder->height = (int)(geometry.height & ~1u);
+    encoder->pix_fmt = AV_PIX_FMT_NV12;
+    encoder->time_base = SINK_TIME_BASE;
+    encoder->bit_rate = (int64_t)param.bitrateKbps * 1000;
+    encoder->gop_size = SINK_GOP_SIZE;
+    encoder->max_b_frames = 0;
+    // one encode thread per stream is enough for the bitrates of a review video
+    encoder->thread_count = 1;
+    if (output->oformat->flags & AVFMT_GLOBALHEADER) {
+        encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    AVDictionary *codecOptions = nullptr;
+    av_dict_set(&codecOptions, "preset", "veryfast", 0);
+    // no lookahead: a packet per frame, nothing held back in the encoder
+    av_dict_set(&codecOptions, "tune", "zerolatency", 0);
+    int err = avcodec_open2(encoder, codec, &codecOptions);
+    av_dict_free(&codecOptions);
+    if (err < 0) {
+        LogError << "cannot open the " << codec->name << " encoder for " << encoder->width << "x" << encoder->height;
+        Close();
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    avcodec_parameters_from_context(stream->codecpar, encoder);
+    stream->time_base = encoder->time_base;
+    if (!(output->oformat->flags & AVFMT_NOFILE) && avio_open(&output->pb, name.c_str(), AVIO_FLAG_WRITE) < 0) {
+        LogError << "cannot open " << name;
+        Close();
+        return APP_ERR_COMM_OPEN_FAIL;
+    }
+    AVDictionary *muxOptions = nullptr;
+    if (format == "segment") {
+        av_dict_set(&muxOptions, "segment_format", "mp4", 0);
+        av_dict_set(&muxOptions, "segment_time", std::to_string(param.segmentSeconds).c_str(), 0);
+        av_dict_set(&muxOptions, "reset_timestamps", "1", 0);
+        av_dict_set(&muxOptions, "strftime", "1", 0);
+    } else if (format == "rtsp") {
+        av_dict_set(&muxOptions, "rtsp_transport", "tcp", 0);
+    }
+    err = avformat_write_header(output, &muxOptions);
+    av_dict_free(&muxOptions);
+    if (err < 0) {
+        LogError << "cannot start the " << format << " output " << name;
+        Close();
+        return APP_ERR_COMM_OPEN_FAIL;
+    }
+    headerWritten = true;
+    openGeometry = geometry;
+    firstCaptureUs = 0;
+    lastPts = -1;
+    LogInfo << "stream " << streamId << " video output opened, " << encoder->width << "x" << encoder->height;
+    return APP_ERR_OK;
+}
+
+void VideoSink::Close()
+{
+    if (headerWritten) {
+        // 冲刷编码器并写完文件尾
+        WritePackets(nullptr);
+        av_write_trailer(output);
+        headerWritten = false;
+    }
+    if (output != nullptr) {
+        if (!(output->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&output->pb);
+        }
+        avformat_free_context(output);
+        output = nullptr;
+        stream = nullptr;
+    }
+    if (packet != nullptr) {
+        av_packet_free(&packet);
+    }
+    if (picture != nullptr) {
+        av_frame_free(&picture);
+    }
+    if (encoder != nullptr) {
+        avcodec_free_context(&encoder);
+    }
+}
+
+APP_ERROR VideoSink::Encode(const RenderJob &job)
+{
+    const FrameGeometry &geometry = job.geometry;
+    size_t frameSize = GetNv12Size(geometry);
+    if (frameSize == 0 || job.frame->size < frameSize) {
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    // a reconnect may bring another picture size, the output starts over with it
+    if (!headerWritten || geometry.width != openGeometry.width || geometry.height != openGeometry.height) {
+        if (std::chrono::steady_clock::now() < retryTime) {
+            return APP_ERR_COMM_OPEN_FAIL;
+        }
+        APP_ERROR ret = Open(geometry);
+        if (ret != APP_ERR_OK) {
+            retryTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(SINK_RETRY_INTERVAL_MS);
+            return ret;
+        }
+    }
+    if (nv12.size() < frameSize) {
+        nv12.resize(frameSize);
+    }
+    MxBase::MemoryData host(nv12.data(), frameSize, MxBase::MemoryData::MEMORY_HOST_NEW, param.deviceId);
+    APP_ERROR ret = MxBase::MemoryHelper::MxbsMemcpy(host, *job.frame, frameSize);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    Nv12Canvas canvas(nv12.data(), geometry);
+    DrawHands(canvas, job.hands);
+    DrawFaces(canvas, job.faces);
+
+    if (lastPts < 0) {
+        firstCaptureUs = job.captureUs;
+    }
+    int64_t pts = (job.captureUs - firstCaptureUs) * US_PER_TICK_DEN / US_PER_TICK_NUM;
+    if (pts <= lastPts) {
+        pts = lastPts + 1;
+    }
+    lastPts = pts;
+    picture->data[0] = nv12.data();
+    picture->data[1] = nv12.data() + (size_t)geometry.widthStride * geometry.heightStride;
+    picture->linesize[0] = (int)geometry.widthStride;
+    picture->linesize[1] = (int)geometry.widthStride;
+    picture->width = encoder->width;
+    picture->height = encoder->height;
+    picture->format = AV_PIX_FMT_NV12;
+    picture->pts = pts;
+    ret = WritePackets(picture);
+    if (ret == APP_ERR_COMM_WRITE_FAIL) {
+        LogWarn << "stream " << streamId << " video output broken, reopening in " << SINK_RETRY_INTERVAL_MS << " ms";
+        Close();
+        retryTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(SINK_RETRY_INTERVAL_MS);
+    }
+    return ret;
+}
+
+APP_ERROR VideoSink::WritePackets(const AVFrame *picture)
+{
+    if (avcodec_send_frame(encoder, picture) < 0) {
+        return APP_ERR_COMM_FAILURE;
+    }
+    while (avcodec_receive_packet(encoder, packet) == 0) {
+        av_packet_rescale_ts(packet, encoder->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        bytes->Add((uint64_t)packet->size);
+        int err = av_interleaved_write_frame(output, packet);
+        av_packet_unref(packet);
+        if (err < 0) {
+            return APP_ERR_COMM_WRITE_FAIL;
+        }
+    }
+    return APP_ERR_OK;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_VIDEOSINK_H
+#define STREAM_PULL_SAMPLE_VIDEOSINK_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "../BlockingQueue/FrameQueue.h"
+#include "../Metrics/Metrics.h"
+#include "FrameRenderer.h"
+
+extern "C"{
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/avutil.h"
+}
+
+static const uint32_t DEFAULT_VIDEO_OUT_BITRATE = 2000;     // kbit/s per stream
+static const uint32_t DEFAULT_VIDEO_OUT_SEGMENT = 300;      // seconds per MP4 file
+static const uint32_t DEFAULT_VIDEO_OUT_QUEUE = 8;
+
+struct VideoSinkParam {
+    // a directory gets segmented MP4 files, rtsp:// is published to an RTSP server,
+    // any other URL (udp://, tcp://, a .ts path) gets MPEG-TS; "{stream}" is replaced by the stream id
+    std::string output;
+    uint32_t bitrateKbps = DEFAULT_VIDEO_OUT_BITRATE;
+    uint32_t segmentSeconds = DEFAULT_VIDEO_OUT_SEGMENT;
+    // frames waiting for the encoder; when it falls behind the oldest is skipped, the pipeline never waits
+    uint32_t queueDepth = DEFAULT_VIDEO_OUT_QUEUE;
+    uint32_t deviceId = 0;
+    // false when the stream's frames are in host memory, the encode thread then binds no device
+    bool bindDevice = true;
+};
+
+// Annotated H.264 video of one stream. The encode thread copies each NV12 frame to the host, draws
+// the hands like FrameRenderer does and feeds it to libavcodec (libx264 takes NV12 as it is); the
+// packets are muxed to MP4 segments, RTSP or MPEG-TS. Timestamps follow the camera clock, so frames
+// skipped by the pipeline or the queue show up as a longer frame instead of a faster video.
+// The output is opened on the first frame, when the picture size is known.
+class VideoSink {
+public:
+    explicit VideoSink(uint32_t streamId);
+    ~VideoSink();
+    VideoSink(const VideoSink &) = delete;
+    VideoSink &operator=(const VideoSink &) = delete;
+
+    APP_ERROR Start(const VideoSinkParam &param);
+    // frames still queued are discarded, the encoder is flushed and the file finished
+    void Stop();
+    bool IsRunning() const;
+    // never blocks; a full queue drops its oldest frame
+    void Submit(const RenderJob &job);
+private:
+    void Run();
+    APP_ERROR Open(const FrameGeometry &geometry);
+    void Close();
+    APP_ERROR Encode(const RenderJob &job);
+    // picture == nullptr drains the encoder at the end
+    APP_ERROR WritePackets(const AVFrame *picture);
+    std::string OutputName() const;
+private:
+    const uint32_t streamId;
+    VideoSinkParam param;
+    std::unique_ptr<FrameQueue<RenderJob>> queue;
+    std::thread worker;
+    std::atomic<bool> running{false};
+    // encode thread only
+    std::vector<uint8_t> nv12;
+    AVFormatContext *output = nullptr;
+    AVStream *stream = nullptr;
+    AVCodecContext *encoder = nullptr;
+    AVFrame *picture = nullptr;
+    AVPacket *packet = nullptr;
+    bool headerWritten = false;
+    FrameGeometry openGeometry;
+    std::chrono::steady_clock::time_point retryTime;
+    int64_t firstCaptureUs = 0;
+    int64_t lastPts = -1;
+    MetricCounter *encoded = nullptr;
+    MetricCounter *failed = nullptr;
+    MetricCounter *bytes = nullptr;
+    LatencyHistogram *latency = nullptr;
+    std::vector<uint64_t> metricCallbacks;
+};
+
+#endif // STREAM_PULL_SAMPLE_VIDEOSINK_H
@@ -0,0 +1,306 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "GestureEngine.h"
+
+namespace {
+    const float PI = 3.14159265f;
+    const float RAD_TO_DEG = 180.0f / PI;
+    // time step when the capture clock gives none, and the range a real one is clamped to
+    const float DEFAULT_DT = 0.04f;
+    const float MIN_DT = 0.001f;
+    const float MAX_DT = 1.0f;
+    // One-Euro: cutoff of the speed estimate that drives the adaptive cutoff
+    const float SPEED_CUTOFF = 1.0f;
+    // a hand matches last frame's hand whose center is within this share of its size
+    const float MATCH_RATIO = 1.0f;
+    // a slot forgets its hand after this many frames without it
+    const uint32_t MAX_MISSES = 5;
+    // bend of a finger, the sum of its two upper joint angles in degrees; the gap between entering
+    // and leaving a state keeps a half-bent finger from flickering
+    const float EXTEND_ENTER = 50.0f;
+    const float EXTEND_LEAVE = 70.0f;
+    const float FOLD_ENTER = 110.0f;
+    const float FOLD_LEAVE = 90.0f;
+    // thumb tip this far from the index knuckle, relative to the palm length, counts as out
+    const float THUMB_OUT_RATIO = 0.6f;
+    // thumbs up: cosine between the thumb and straight up
+    const float THUMB_UP_COS = 0.7f;
+    // 21-point layout: 0 wrist, then 4 joints per finger from the base, thumb first
+    const uint32_t WRIST = 0;
+    const uint32_t FINGER_JOINTS = 4;
+    const uint32_t THUMB = 0;
+    const uint32_t INDEX = 1;
+    const uint32_t MIDDLE = 2;
+    const uint32_t RING = 3;
+    const uint32_t PINKY = 4;
+
+    struct Point {
+        float x;
+        float y;
+    };
+
+    Point At(const float *points, uint32_t index)
+    {
+        return Point{points[index * 2], points[index * 2 + 1]};
+    }
+
+    uint32_t Joint(uint32_t finger, uint32_t joint)
+    {
+        return finger * FINGER_JOINTS + joint + 1;
+    }
+
+    float Distance(const Point &a, const Point &b)
+    {
+        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+    }
+
+    // angle in degrees between a->b and b->c, 0 for a straight line
+    float Bend(const Point &a, const Point &b, const Point &c)
+    {
+        float ux = b.x - a.x;
+        float uy = b.y - a.y;
+        float vx = c.x - b.x;
+        float vy = c.y - b.y;
+        float norm = std::sqrt((ux * ux + uy * uy) * (vx * vx + vy * vy));
+        if (norm <= 0) {
+            return 0;
+        }
+        float cosine = std::min(std::max((ux * vx + uy * vy) / norm, -1.0f), 1.0f);
+        return std::acos(cosine) * RAD_TO_DEG;
+    }
+
+    float Alpha(float cutoff, float dt)
+    {
+        float tau = 1.0f / (2 * PI * cutoff);
+        return 1.0f / (1.0f + tau / dt);
+    }
+}
+
+GestureEngine::GestureEngine(const GestureParam &param, const std::string &metricLabels) : param(param)
+{
+    for (uint32_t i = 0; i < MAX_HANDS; i++) {
+        ResetSlot(slots[i]);
+    }
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    for (uint32_t g = GESTURE_NONE + 1; g < GESTURE_NUM; g++) {
+        std::string labels = JoinMetricLabels(metricLabels, MetricLabels({{"gesture", GestureName(g)}}));
+        events[g] = registry->GetCounter("hand_gesture_events_total", "Gestures recognized, counted when they start",
+                                         labels);
+    }
+}
+
+void GestureEngine::ResetSlot(Slot &slot)
+{
+    slot.active = false;
+    slot.misses = 0;
+    slot.cx = 0;
+    slot.cy = 0;
+    std::fill(slot.x, slot.x + KEYPOINT_NUM * 2, 0.0f);
+    std::fill(slot.dx, slot.dx + KEYPOINT_NUM * 2, 0.0f);
+    std::fill(slot.fingers, slot.fingers + FINGER_NUM, FINGER_UNKNOWN);
+    slot.gesture = GESTURE_NONE;
+    slot.candidate = GESTURE_NONE;
+    slot.candidateFrames = 0;
+}
+
+void GestureEngine::Process(int64_t captureUs, std::vector<HandResult> &hands)
+{
+    float dt = DEFAULT_DT;
+    if (lastCaptureUs != 0 && captureUs > lastCaptureUs) {
+        dt = std::min(std::max((captureUs - lastCaptureUs) / 1e6f, MIN_DT), MAX_DT);
+    }
+    lastCaptureUs = captureUs;
+    bool claimed[MAX_HANDS] = {};
+    float points[KEYPOINT_NUM * 2];
+    for (size_t i = 0; i < hands.size(); i++) {
+        HandResult &hand = hands[i];
+        hand.gesture = GESTURE_NONE;
+        hand.gestureStart = false;
+        if (i >= MAX_HANDS || hand.keypoints.size() < KEYPOINT_NUM * 2) {
+            continue;
+        }
+        const MxBase::ObjectInfo &box = hand.box;
+        float ow = box.x1 - box.x0;
+        float oh = box.y1 - box.y0;
+        for (uint32_t k = 0; k < KEYPOINT_NUM * 2; k += 2) {
+            points[k] = hand.keypoints[k] * ow + box.x0;
+            points[k + 1] = hand.keypoints[k + 1] * oh + box.y0;
+        }
+        bool fresh = false;
+        Slot &slot = MatchSlot((box.x0 + box.x1) / 2, (box.y0 + box.y1) / 2, std::max(ow, oh), claimed, fresh);
+        Filter(slot, points, dt, fresh);
+        if (Debounce(slot, Classify(slot)) && slot.gesture != GESTURE_NONE) {
+            hand.gestureStart = true;
+            events[slot.gesture]->Add();
+        }
+        hand.gesture = (uint8_t)slot.gesture;
+        if (param.smoothKeypoints && ow > 0 && oh > 0) {
+            for (uint32_t k = 0; k < KEYPOINT_NUM * 2; k += 2) {
+                hand.keypoints[k] = (slot.x[k] - box.x0) / ow;
+                hand.keypoints[k + 1] = (slot.x[k + 1] - box.y0) / oh;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < MAX_HANDS; i++) {
+        if (slots[i].active && !claimed[i] && ++slots[i].misses > MAX_MISSES) {
+            ResetSlot(slots[i]);
+        }
+    }
+}
+
+GestureEngine::Slot &GestureEngine::MatchSlot(float cx, float cy, float size, bool *claimed, bool &fresh)
+{
+    int best = -1;
+    float bestDistance = size * MATCH_RATIO;
+    for (uint32_t i = 0; i < MAX_HANDS; i++) {
+        if (claimed[i] || !slots[i].active) {
+            continue;
+        }
+        float distance = Distance(Point{cx, cy}, Point{slots[i].cx, slots[i].cy});
+        if (distance < bestDistance) {
+            best = (int)i;
+            bestDistance = distance;
+        }
+    }
+    fresh = best < 0;
+    if (fresh) {
+        // a free slot, or the one whose hand has been gone the longest
+        for (uint32_t i = 0; i < MAX_HANDS; i++) {
+            if (claimed[i]) {
+                continue;
+            }
+            if (best < 0 || !slots[i].active || slots[i].misses > slots[best].misses) {
+                best = (int)i;
+            }
+            if (!slots[i].active) {
+                break;
+            }
+        }
+        ResetSlot(slots[best]);
+        slots[best].active = true;
+    }
+    claimed[best] = true;
+    Slot &slot = slots[best];
+    slot.cx = cx;
+    slot.cy = cy;
+    slot.misses = 0;
+    return slot;
+}
+
+void GestureEngine::Filter(Slot &slot, const float *points, float dt, bool reset) const
+{
+    if (reset) {
+        std::copy(points, points + KEYPOINT_NUM * 2, slot.x);
+        std::fill(slot.dx, slot.dx + KEYPOINT_NUM * 2, 0.0f);
+        return;
+    }
+    float speedAlpha = Alpha(SPEED_CUTOFF, dt);
+    for (uint32_t k = 0; k < KEYPOINT_NUM * 2; k++) {
+        float speed = (points[k] - slot.x[k]) / dt;
+        slot.dx[k] += speedAlpha * (speed - slot.dx[k]);
+        // 运动越快截止频率越高：静止时抑制抖动，快速移动时减少滞后
+        float cutoff = param.minCutoff + param.beta * std::fabs(slot.dx[k]);
+        slot.x[k] += Alpha(cutoff, dt) * (points[k] - slot.x[k]);
+    }
+}
+
+GestureEngine::FingerState GestureEngine::NextFingerState(FingerState previous, float bend, bool tipOut)
+{
+    if (previous == FINGER_EXTENDED && bend < EXTEND_LEAVE && tipOut) {
+        return FINGER_EXTENDED;
+    }
+    if (previous == FINGER_FOLDED && (bend > FOLD_LEAVE || !tipOut)) {
+        return FINGER_FOLDED;
+    }
+    if (bend < EXTEND_ENTER && tipOut) {
+        return FINGER_EXTENDED;
+    }
+    if (bend > FOLD_ENTER || !tipOut) {
+        return FINGER_FOLDED;
+    }
+    return FINGER_UNKNOWN;
+}
+
+GestureType GestureEngine::Classify(Slot &slot) const
+{
+    const float *p = slot.x;
+    Point wrist = At(p, WRIST);
+    float palm = Distance(wrist, At(p, Joint(MIDDLE, 0)));
+    if (palm <= 0) {
+        return GESTURE_NONE;
+    }
+    for (uint32_t f = 0; f < FINGER_NUM; f++) {
+        Point base = At(p, Joint(f, 0));
+        Point middle = At(p, Joint(f, 1));
+        Point upper = At(p, Joint(f, 2));
+        Point tip = At(p, Joint(f, 3));
+        float bend = Bend(base, middle, upper) + Bend(middle, upper, tip);
+        // 拇指看指尖是否离开食指根部，其余手指看指尖是否比第二关节离手腕更远
+        bool tipOut = f == THUMB ? Distance(tip, At(p, Joint(INDEX, 0))) > THUMB_OUT_RATIO * palm :
+                                   Distance(tip, wrist) > Distance(middle, wrist);
+        slot.fingers[f] = NextFingerState(slot.fingers[f], bend, tipOut);
+    }
+    const FingerState *s = slot.fingers;
+    bool othersFolded = s[MIDDLE] == FINGER_FOLDED && s[RING] == FINGER_FOLDED && s[PINKY] == FINGER_FOLDED;
+    if (s[THUMB] == FINGER_EXTENDED && s[INDEX] == FINGER_EXTENDED && s[MIDDLE] == FINGER_EXTENDED &&
+        s[RING] == FINGER_EXTENDED && s[PINKY] == FINGER_EXTENDED) {
+        return GESTURE_OPEN_HAND;
+    }
+    if (s[INDEX] == FINGER_EXTENDED && s[MIDDLE] == FINGER_EXTENDED && s[RING] == FINGER_FOLDED &&
+        s[PINKY] == FINGER_FOLDED) {
+        return GESTURE_VICTORY;
+    }
+    if (s[INDEX] == FINGER_EXTENDED && othersFolded) {
+        return GESTURE_POINTING;
+    }
+    if (s[INDEX] != FINGER_FOLDED || !othersFolded) {
+        return GESTURE_NONE;
+    }
+    if (s[THUMB] == FINGER_FOLDED) {
+        return GESTURE_FIST;
+    }
+    // 图像坐标y向下，拇指朝上时指尖的y更小
+    Point thumbBase = At(p, Joint(THUMB, 1));
+    Point thumbTip = At(p, Joint(THUMB, 3));
+    float length = Distance(thumbBase, thumbTip);
+    if (s[THUMB] == FINGER_EXTENDED && length > 0 && thumbBase.y - thumbTip.y > THUMB_UP_COS * length) {
+        return GESTURE_THUMBS_UP;
+    }
+    return GESTURE_NONE;
+}
+
+bool GestureEngine::Debounce(Slot &slot, GestureType raw) const
+{
+    if (raw == slot.gesture) {
+        slot.candidateFrames = 0;
+        return false;
+    }
+    if (raw == slot.candidate && slot.candidateFrames > 0) {
+        slot.candidateFrames++;
+    } else {
+        slot.candidate = raw;
+        slot.candidateFrames = 1;
+    }
+    if (slot.candidateFrames < param.debounceFrames) {
+        return false;
+    }
+    slot.gesture = raw;
+    slot.candidateFrames = 0;
+    return true;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_GESTUREENGINE_H
+#define STREAM_PULL_SAMPLE_GESTUREENGINE_H
+
+#include <string>
+#include <vector>
+#include "../FramePipeline/FrameContext.h"
+#include "../Metrics/Metrics.h"
+#include "../ResultProtocol/ResultProtocol.h"
+
+static const uint32_t DEFAULT_GESTURE_DEBOUNCE = 3;
+static const float DEFAULT_GESTURE_MIN_CUTOFF = 1.0f;
+static const float DEFAULT_GESTURE_BETA = 0.01f;
+
+struct GestureParam {
+    // off by default: gestures only reach the client in result protocol v2, ParseAppConfig turns it on there
+    bool enabled = false;
+    // frames a new gesture has to be seen in a row before it replaces the current one
+    uint32_t debounceFrames = DEFAULT_GESTURE_DEBOUNCE;
+    // One-Euro filter: cutoff of a resting hand in Hz, and how much it opens up per pixel/s of speed
+    float minCutoff = DEFAULT_GESTURE_MIN_CUTOFF;
+    float beta = DEFAULT_GESTURE_BETA;
+    // send the filtered keypoints instead of the model output
+    bool smoothKeypoints = false;
+};
+
+// Gesture recognition on top of the 21 keypoints of every hand, for one stream. Hands are matched to
+// the previous frame's by position, their keypoints go through a One-Euro filter, and every finger is
+// classified as extended or folded from its joint angles with separate enter and leave thresholds.
+// The finger states give the gesture, which only changes after debounceFrames agreeing frames; the
+// frame where it changes carries the event. All state lives in fixed arrays, Process allocates nothing.
+// Not thread-safe: the send stage is its only caller and sees the frames in order.
+class GestureEngine {
+public:
+    // hands per frame that get gestures, the rest keep GESTURE_NONE
+    static const uint32_t MAX_HANDS = 8;
+    static const uint32_t KEYPOINT_NUM = 21;
+    static const uint32_t FINGER_NUM = 5;
+
+    GestureEngine(const GestureParam &param, const std::string &metricLabels);
+    // sets gesture and gestureStart of every hand; captureUs gives the filter its time step
+    void Process(int64_t captureUs, std::vector<HandResult> &hands);
+private:
+    enum FingerState {
+        FINGER_UNKNOWN = 0,
+        FINGER_EXTENDED,
+        FINGER_FOLDED,
+    };
+    struct Slot {
+        bool active;
+        uint32_t misses;        // frames since the hand was last seen
+        float cx;               // box center, frame pixels
+        float cy;
+        float x[KEYPOINT_NUM * 2];  // filtered keypoints, frame pixels
+        float dx[KEYPOINT_NUM * 2]; // filtered speed, pixels/s
+        FingerState fingers[FINGER_NUM];
+        GestureType gesture;
+        GestureType candidate;
+        uint32_t candidateFrames;
+    };
+    // slot of the hand centered at (cx, cy), claimed for this frame; fresh when it starts a new hand
+    Slot &MatchSlot(float cx, float cy, float size, bool *claimed, bool &fresh);
+    void Filter(Slot &slot, const float *points, float dt, bool reset) const;
+    // finger states from the filtered keypoints, then the gesture they make
+    GestureType Classify(Slot &slot) const;
+    // extended below EXTEND_ENTER and folded above FOLD_ENTER, but a finger keeps its state until LEAVE
+    static FingerState NextFingerState(FingerState previous, float bend, bool tipOut);
+    // debounce, true when the gesture changed on this frame
+    bool Debounce(Slot &slot, GestureType raw) const;
+    static void ResetSlot(Slot &slot);
+private:
+    const GestureParam param;
+    Slot slots[MAX_HANDS];
+    int64_t lastCaptureUs = 0;
+    MetricCounter *events[GESTURE_NUM] = {};
+};
+
+#endif // STREAM_PULL_SAMPLE_GESTUREENGINE_H
@@ -0,0 +1,166 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "MxBase/Log/Log.h"
+#include "HandTracker.h"
+#include "../AsyncLogger/AsyncLogger.h"
+
+namespace {
+    // keypoints span the hand, the detector box SelectHands expands is slightly larger: together
+    // about the 1.5x expansion the keypoint model was trained on
+    const float TRACK_BOX_SCALE = 1.7f;
+    // thin keypoint boxes (a hand seen edge-on) still get a crop of reasonable shape
+    const float MIN_ASPECT = 0.6f;
+    // keypoints this far outside the normalized crop still count as inside
+    const float INSIDE_MARGIN = 0.05f;
+    // keypoints squeezed into a small part of the crop mean the model lost the hand
+    const float MIN_SPAN_RATIO = 0.15f;
+    const float MIN_TRACK_SIZE = 16.0f;
+    // velocity smoothing, weight of the newest measurement
+    const float VELOCITY_ALPHA = 0.5f;
+}
+
+HandTracker::HandTracker(const TrackParam &param, const std::string &metricLabels) : param(param)
+{
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    detectedFrames = registry->GetCounter("hand_detector_frames_total", "Frames the hand detector ran on",
+                                          metricLabels);
+    trackedFrames = registry->GetCounter("hand_tracked_frames_total", "Frames whose hands came from tracking",
+                                         metricLabels);
+    lostTracks = registry->GetCounter("hand_track_lost_total", "Times tracking fell back to the detector",
+                                      metricLabels);
+}
+
+bool HandTracker::ShouldDetect(uint32_t frameId)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    bool detect = param.detectInterval <= 1 || tracks.empty() || lost ||
+                  frameId - lastDetectFrameId >= param.detectInterval;
+    if (detect) {
+        lastDetectFrameId = frameId;
+        detectedFrames->Add();
+    } else {
+        trackedFrames->Add();
+    }
+    return detect;
+}
+
+void HandTracker::Predict(uint32_t frameId, uint32_t height, uint32_t width, std::vector<HandResult> &hands)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    hands.clear();
+    float gap = (float)(int32_t)(frameId - trackFrameId);
+    for (const auto &track : tracks) {
+        float cx = track.cx + track.vx * gap;
+        float cy = track.cy + track.vy * gap;
+        float w = std::max(track.w, track.h * MIN_ASPECT) * TRACK_BOX_SCALE;
+        float h = std::max(track.h, track.w * MIN_ASPECT) * TRACK_BOX_SCALE;
+        HandResult hand;
+        hand.box.x0 = std::max(0.0f, cx - w / 2);
+        hand.box.y0 = std::max(0.0f, cy - h / 2);
+        hand.box.x1 = std::min((float)width - 1, cx + w / 2);
+        hand.box.y1 = std::min((float)height - 1, cy + h / 2);
+        hand.box.confidence = track.quality;
+        if (hand.box.x1 - hand.box.x0 < MIN_TRACK_SIZE || hand.box.y1 - hand.box.y0 < MIN_TRACK_SIZE) {
+            continue; // moved out of the frame
+        }
+        hands.push_back(hand);
+    }
+}
+
+void HandTracker::Update(uint32_t frameId, const std::vector<HandResult> &hands)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (hasUpdate && (int32_t)(frameId - trackFrameId) <= 0) {
+        return;
+    }
+    float gap = hasUpdate ? (float)(frameId - trackFrameId) : 1.0f;
+    std::vector<Track> next;
+    bool trackLost = false;
+    for (const auto &hand : hands) {
+        Track track;
+        if (!FitKeypoints(hand, track) || track.quality < param.minQuality) {
+            trackLost = true;
+            continue;
+        }
+        // carry the velocity of the nearest previous track within one hand size
+        const Track *previous = nullptr;
+        float best = std::max(track.w, track.h);
+        for (const auto &old : tracks) {
+            float dist = std::hypot(track.cx - old.cx, track.cy - old.cy);
+            if (dist < best) {
+                best = dist;
+                previous = &old;
+            }
+        }
+        track.vx = 0;
+        track.vy = 0;
+        if (previous != nullptr) {
+            track.vx = VELOCITY_ALPHA * (track.cx - previous->cx) / gap + (1 - VELOCITY_ALPHA) * previous->vx;
+            track.vy = VELOCITY_ALPHA * (track.cy - previous->cy) / gap + (1 - VELOCITY_ALPHA) * previous->vy;
+        }
+        next.push_back(track);
+    }
+    if (trackLost && !lost) {
+        lostTracks->Add();
+        HotLogDebug << "hand track lost at frame " << frameId << ", detecting again";
+    }
+    tracks.swap(next);
+    trackFrameId = frameId;
+    hasUpdate = true;
+    lost = trackLost;
+}
+
+bool HandTracker::FitKeypoints(const HandResult &hand, Track &track)
+{
+    size_t pointNum = hand.keypoints.size() / 2;
+    if (pointNum == 0) {
+        return false;
+    }
+    float boxW = hand.box.x1 - hand.box.x0;
+    float boxH = hand.box.y1 - hand.box.y0;
+    float minX = 1;
+    float minY = 1;
+    float maxX = 0;
+    float maxY = 0;
+    size_t inside = 0;
+    for (size_t i = 0; i < pointNum; i++) {
+        float x = hand.keypoints[i * 2];
+        float y = hand.keypoints[i * 2 + 1];
+        if (x >= -INSIDE_MARGIN && x <= 1 + INSIDE_MARGIN && y >= -INSIDE_MARGIN && y <= 1 + INSIDE_MARGIN) {
+            inside++;
+        }
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+    }
+    track.quality = (float)inside / pointNum;
+    if (maxX - minX < MIN_SPAN_RATIO && maxY - minY < MIN_SPAN_RATIO) {
+        track.quality = 0;
+    }
+    minX = std::max(minX, 0.0f);
+    minY = std::max(minY, 0.0f);
+    maxX = std::min(maxX, 1.0f);
+    maxY = std::min(maxY, 1.0f);
+    track.cx = hand.box.x0 + (minX + maxX) / 2 * boxW;
+    track.cy = hand.box.y0 + (minY + maxY) / 2 * boxH;
+    track.w = (maxX - minX) * boxW;
+    track.h = (maxY - minY) * boxH;
+    return track.w > 0 && track.h > 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_HANDTRACKER_H
+#define STREAM_PULL_SAMPLE_HANDTRACKER_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../FramePipeline/FrameContext.h"
+#include "../Metrics/Metrics.h"
+
+static const uint32_t DEFAULT_DETECT_INTERVAL = 1;
+static const float DEFAULT_TRACK_QUALITY = 0.8;
+
+struct TrackParam {
+    // YOLO runs on every N-th frame, 1 detects every frame and disables tracking
+    uint32_t detectInterval = DEFAULT_DETECT_INTERVAL;
+    // share of keypoints that must stay inside their crop for a track to be trusted
+    float minQuality = DEFAULT_TRACK_QUALITY;
+};
+
+// Detect-every-N mode for one stream. Between detector frames the hand ROI is the bounding box of
+// the latest keypoints, moved by the track's velocity and expanded like a detector box, and goes
+// straight to the keypoint crop. A track whose keypoints drift out of the crop or collapse marks the
+// tracker lost, and the next frame runs the detector again.
+// The pipeline overlaps frames, so the latest keypoints may be a few frames older than the frame
+// being predicted; the prediction extrapolates over that gap. Called from several stage workers.
+class HandTracker {
+public:
+    HandTracker(const TrackParam &param, const std::string &metricLabels);
+    // decided before resize: true when this frame gets the detector
+    bool ShouldDetect(uint32_t frameId);
+    // predicted hands for a tracked frame, most confident first; empty when nothing is tracked
+    void Predict(uint32_t frameId, uint32_t height, uint32_t width, std::vector<HandResult> &hands);
+    // keypoints of a finished frame, detected or tracked; older frames than the last update are ignored
+    void Update(uint32_t frameId, const std::vector<HandResult> &hands);
+private:
+    struct Track {
+        float cx;       // keypoint box center, frame pixels
+        float cy;
+        float w;        // keypoint box size
+        float h;
+        float vx;       // center motion per frame
+        float vy;
+        float quality;
+    };
+    static bool FitKeypoints(const HandResult &hand, Track &track);
+private:
+    const TrackParam param;
+    std::mutex mutex;
+    std::vector<Track> tracks;
+    uint32_t trackFrameId = 0;
+    bool hasUpdate = false;
+    uint32_t lastDetectFrameId = 0;
+    bool lost = false;
+    MetricCounter *detectedFrames = nullptr;
+    MetricCounter *trackedFrames = nullptr;
+    MetricCounter *lostTracks = nullptr;
+};
+
+#endif // STREAM_PULL_SAMPLE_HANDTRACKER_H
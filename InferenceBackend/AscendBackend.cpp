@@ -0,0 +1,313 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include "MxBase/Log/Log.h"
+#include "MxBase/Tensor/TensorContext/TensorContext.h"
+#include "AscendBackend.h"
+
+namespace {
+    const uint32_t YUV_BYTE_NU = 3;
+    const uint32_t YUV_BYTE_DE = 2;
+    // smallest picture VPC crops
+    const uint32_t VPC_MIN_CROP = 10;
+    // AIPP models describe their input as NHWC
+    const size_t INPUT_DIMS = 4;
+    const size_t INPUT_HEIGHT_DIM = 1;
+    const size_t INPUT_WIDTH_DIM = 2;
+    const uint32_t OUTPUT_POOL_WAIT_TIME = 1000;
+}
+
+APP_ERROR AscendBackend::Init(const BackendInitParam &initParam)
+{
+    deviceId = initParam.deviceId;
+    APP_ERROR ret = MxBase::TensorContext::GetInstance()->SetContext(initParam.deviceId);
+    if (ret != APP_ERR_OK) {
+        LogError << "Set context failed, ret=" << ret << ".";
+        return ret;
+    }
+    inputPool.reset(new BufferPool(std::make_shared<MxBaseAllocator>(MxBase::MemoryData::MEMORY_DVPP, deviceId,
+                                                                     "vpc output pool"),
+                                   MxBase::MemoryData::MEMORY_DVPP, deviceId));
+    dvppWrapper = std::make_shared<MxBase::DvppWrapper>();
+    ret = dvppWrapper->Init();
+    if (ret != APP_ERR_OK) {
+        LogError << "DvppWrapper init failed, ret=" << ret << ".";
+        return ret;
+    }
+    model = std::make_shared<MxBase::ModelInferenceProcessor>();
+    LogInfo << "model path: " << initParam.modelPath;
+    ret = model->Init(initParam.modelPath, modelDesc);
+    if (ret != APP_ERR_OK) {
+        LogError << "ModelInferenceProcessor init failed, ret=" << ret << ".";
+        return ret;
+    }
+
+    // 模型输入尺寸以.om模型记录的为准，模型未记录时使用配置值
+    inputHeight = initParam.inputHeight;
+    inputWidth = initParam.inputWidth;
+    if (!modelDesc.inputTensors.empty() && modelDesc.inputTensors[0].tensorDims.size() == INPUT_DIMS &&
+        modelDesc.inputTensors[0].tensorDims[INPUT_HEIGHT_DIM] > 0 &&
+        modelDesc.inputTensors[0].tensorDims[INPUT_WIDTH_DIM] > 0) {
+        inputHeight = (uint32_t)modelDesc.inputTensors[0].tensorDims[INPUT_HEIGHT_DIM];
+        inputWidth = (uint32_t)modelDesc.inputTensors[0].tensorDims[INPUT_WIDTH_DIM];
+    }
+    if (inputHeight == 0 || inputWidth == 0) {
+        LogError << "Input size of " << initParam.modelPath << " is unknown";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    if ((initParam.inputHeight != 0 && initParam.inputHeight != inputHeight) ||
+        (initParam.inputWidth != 0 && initParam.inputWidth != inputWidth)) {
+        LogWarn << "configured input " << initParam.inputWidth << "x" << initParam.inputHeight << " ignored, "
+                << initParam.modelPath << " takes " << inputWidth << "x" << inputHeight;
+    }
+    LogInfo << "model input " << inputWidth << "x" << inputHeight;
+
+    auto dtypes = model->GetOutputDataType();
+    outputDescs.clear();
+    for (size_t i = 0; i < modelDesc.outputTensors.size(); ++i) {
+        OutputTensorDesc desc;
+        for (size_t j = 0; j < modelDesc.outputTensors[i].tensorDims.size(); ++j) {
+            desc.shape.push_back((uint32_t)modelDesc.outputTensors[i].tensorDims[j]);
+        }
+        desc.dtype = dtypes[i];
+        // 动态batch模型按单张输入描述输出，批量推理时再替换batch维
+        if (modelDesc.dynamicBatch && !desc.shape.empty()) {
+            desc.shape[0] = 1;
+        }
+        outputDescs.push_back(desc);
+    }
+    batchSizes.clear();
+    if (modelDesc.dynamicBatch) {
+        for (size_t batchSize : modelDesc.batchSizes) {
+            batchSizes.push_back((uint32_t)batchSize);
+        }
+        std::sort(batchSizes.begin(), batchSizes.end());
+        if (batchSizes.empty() || batchSizes[0] != 1) {
+            LogError << "Dynamic batch model " << initParam.modelPath << " has no batch 1 gear";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        LogInfo << "dynamic batch model, largest batch " << batchSizes.back();
+    } else {
+        batchSizes.push_back(1);
+    }
+    batchOutputPool.Init(outputDescs, GetOutputMemoryType(), deviceId, initParam.batchPoolSize);
+    return APP_ERR_OK;
+}
+
+APP_ERROR AscendBackend::DeInit()
+{
+    BufferPoolStats stats = GetInputPoolStats();
+    LogInfo << "VPC output pool: " << stats.allocations << " allocations, " << stats.reuses << " reuses, "
+            << stats.bytes << " bytes held";
+    // VPC outputs and output sets still in flight are freed by their last handle
+    inputPool.reset();
+    batchOutputPool.DeInit();
+    dvppWrapper->DeInit();
+    APP_ERROR ret = model->DeInit();
+    if (ret != APP_ERR_OK) {
+        LogError << "deinit model failed";
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+MxBase::DvppDataInfo AscendBackend::ToDvppInput(const std::shared_ptr<MxBase::MemoryData> frameInfo,
+                                                const FrameGeometry &geometry)
+{
+    // 视频帧的原始数据，VDEC输出按对齐后的跨距存放
+    MxBase::DvppDataInfo input = {};
+    input.height = geometry.height;
+    input.width = geometry.width;
+    input.heightStride = geometry.heightStride;
+    input.widthStride = geometry.widthStride;
+    input.dataSize = frameInfo->size;
+    input.data = (uint8_t*)frameInfo->ptrData;
+    return input;
+}
+
+APP_ERROR AscendBackend::Resize(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                                const uint32_t &resizeHeight, const uint32_t &resizeWidth,
+                                InputTensorHandle &tensor)
+{
+    // 整帧作为裁剪区域，缩放与裁剪缩放走同一个VPC操作
+    MxBase::CropRoiConfig roi = {};
+    roi.x1 = geometry.width - 1;
+    roi.y1 = geometry.height - 1;
+    return CropAndResize(frameInfo, geometry, roi, resizeHeight, resizeWidth, tensor);
+}
+
+APP_ERROR AscendBackend::CropAndResize(const std::shared_ptr<MxBase::MemoryData> frameInfo,
+                                       const FrameGeometry &geometry, const MxBase::CropRoiConfig &roi,
+                                       const uint32_t &resizeHeight, const uint32_t &resizeWidth,
+                                       InputTensorHandle &tensor)
+{
+    MxBase::DvppDataInfo input = ToDvppInput(frameInfo, geometry);
+    // VPC crop corners: even left/top, odd right/bottom, inside the picture
+    MxBase::CropRoiConfig crop = {};
+    crop.x0 = std::min(roi.x0, geometry.width - VPC_MIN_CROP) & ~1u;
+    crop.y0 = std::min(roi.y0, geometry.height - VPC_MIN_CROP) & ~1u;
+    crop.x1 = std::min(std::max(roi.x1, crop.x0 + 1), geometry.width - 1) | 1u;
+    crop.y1 = std::min(std::max(roi.y1, crop.y0 + 1), geometry.height - 1) | 1u;
+
+    // 输出直接写入池化的DVPP缓冲区，不再经过中间图像
+    MxBase::DvppDataInfo output = {};
+    output.width = resizeWidth;
+    output.height = resizeHeight;
+    output.widthStride = (resizeWidth + DVPP_WIDTH_ALIGN - 1) / DVPP_WIDTH_ALIGN * DVPP_WIDTH_ALIGN;
+    output.heightStride = (resizeHeight + DVPP_HEIGHT_ALIGN - 1) / DVPP_HEIGHT_ALIGN * DVPP_HEIGHT_ALIGN;
+    output.dataSize = output.widthStride * output.heightStride * YUV_BYTE_NU / YUV_BYTE_DE;
+    std::vector<uint32_t> shape = {output.heightStride * YUV_BYTE_NU / YUV_BYTE_DE, output.widthStride};
+    InputTensorHandle pooled;
+    APP_ERROR ret = inputPool->AcquireTensor(shape, MxBase::TENSOR_DTYPE_UINT8, output.dataSize, pooled);
+    if (ret != APP_ERR_OK) {
+        LogError << "No VPC output buffer, ret=" << ret << ".";
+        return ret;
+    }
+    output.data = (uint8_t*)pooled->GetBuffer();
+    MxBase::CropRoiConfig paste = {};
+    paste.x1 = (resizeWidth - 1) | 1u;
+    paste.y1 = (resizeHeight - 1) | 1u;
+
+    std::lock_guard<std::mutex> lock(dvppMutex);
+    ret = dvppWrapper->VpcCropAndPaste(input, output, paste, crop);
+    if (ret != APP_ERR_OK) {
+        LogError << GetError(ret) << "VpcCropAndPaste failed.";
+        return ret;
+    }
+    tensor = pooled;
+    return APP_ERR_OK;
+}
+
+APP_ERROR AscendBackend::Inference(const std::vector<MxBase::TensorBase> &inputs,
+                                   std::vector<MxBase::TensorBase> &outputs)
+{
+    if (inputs.empty() || inputs[0].GetBuffer() == nullptr) {
+        LogError << "input is null";
+        return APP_ERR_FAILURE;
+    }
+    if (outputs.size() != outputDescs.size()) {
+        LogError << "Model has " << outputDescs.size() << " outputs, " << outputs.size() << " were provided";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+
+    MxBase::DynamicInfo dynamicInfo = {};
+    if (modelDesc.dynamicBatch) {
+        dynamicInfo.dynamicType = MxBase::DynamicType::DYNAMIC_BATCH;
+        dynamicInfo.batchSize = 1;
+    } else {
+        // 设置类型为静态batch
+        dynamicInfo.dynamicType = MxBase::DynamicType::STATIC_BATCH;
+    }
+    std::lock_guard<std::mutex> lock(modelMutex);
+    APP_ERROR ret = model->ModelInference(inputs, outputs, dynamicInfo);
+    if (ret != APP_ERR_OK) {
+        LogError << "ModelInference failed, ret=" << ret << ".";
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR AscendBackend::BatchInference(const std::vector<MxBase::TensorBase> &samples,
+                                        OutputTensorHandle &outputs)
+{
+    if (samples.empty() || samples[0].GetBuffer() == nullptr) {
+        LogError << "input is null";
+        return APP_ERR_FAILURE;
+    }
+    // 选取不小于样本数的最小档位
+    auto gear = std::lower_bound(batchSizes.begin(), batchSizes.end(), (uint32_t)samples.size());
+    if (gear == batchSizes.end()) {
+        LogError << samples.size() << " samples exceed the largest batch " << GetMaxBatchSize();
+        return APP_ERR_COMM_OUT_OF_RANGE;
+    }
+    uint32_t batchSize = *gear;
+    size_t sampleBytes = samples[0].GetByteSize();
+    std::vector<uint32_t> shape = samples[0].GetShape();
+    shape.insert(shape.begin(), batchSize);
+    // 批量输入同样取自缓冲池，每次推理不再单独分配
+    InputTensorHandle batch;
+    APP_ERROR ret = inputPool->AcquireTensor(shape, samples[0].GetDataType(), sampleBytes * batchSize, batch);
+    if (ret != APP_ERR_OK) {
+        LogError << "No batch input buffer, ret=" << ret << ".";
+        return ret;
+    }
+    // 样本依次拷入批量输入，补齐的档位重复最后一个样本
+    for (uint32_t i = 0; i < batchSize; i++) {
+        const MxBase::TensorBase &sample = samples[std::min((size_t)i, samples.size() - 1)];
+        if (sample.GetByteSize() != sampleBytes) {
+            LogError << "Batch samples differ in size: " << sample.GetByteSize() << " vs " << sampleBytes;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        MxBase::MemoryData dst((uint8_t*)batch->GetBuffer() + i * sampleBytes, sampleBytes,
+                               MxBase::MemoryData::MEMORY_DVPP, deviceId);
+        MxBase::MemoryData src(sample.GetBuffer(), sampleBytes, MxBase::MemoryData::MEMORY_DVPP, deviceId);
+        ret = MxBase::MemoryHelper::MxbsMemcpy(dst, src, sampleBytes);
+        if (ret != APP_ERR_OK) {
+            LogError << "MxbsMemcpy failed, ret=" << ret << ".";
+            return ret;
+        }
+    }
+    ret = batchOutputPool.Acquire(batchSize, outputs, OUTPUT_POOL_WAIT_TIME);
+    if (ret != APP_ERR_OK) {
+        LogError << "No batch output tensors, ret=" << ret << ".";
+        return ret;
+    }
+
+    MxBase::DynamicInfo dynamicInfo = {};
+    dynamicInfo.dynamicType = modelDesc.dynamicBatch ? MxBase::DynamicType::DYNAMIC_BATCH :
+        MxBase::DynamicType::STATIC_BATCH;
+    dynamicInfo.batchSize = batchSize;
+    std::vector<MxBase::TensorBase> inputs = {*batch};
+    std::lock_guard<std::mutex> lock(modelMutex);
+    ret = model->ModelInference(inputs, *outputs, dynamicInfo);
+    if (ret != APP_ERR_OK) {
+        LogError << "ModelInference failed, batch=" << batchSize << ", ret=" << ret << ".";
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+void AscendBackend::GetInputSize(uint32_t &height, uint32_t &width) const
+{
+    height = inputHeight;
+    width = inputWidth;
+}
+
+uint32_t AscendBackend::GetMaxBatchSize() const
+{
+    return batchSizes.empty() ? 1 : batchSizes.back();
+}
+
+const std::vector<OutputTensorDesc> &AscendBackend::GetOutputDescs() const
+{
+    return outputDescs;
+}
+
+MxBase::MemoryData::MemoryType AscendBackend::GetOutputMemoryType() const
+{
+    return MxBase::MemoryData::MEMORY_DVPP;
+}
+
+BackendType AscendBackend::GetType() const
+{
+    return BACKEND_ASCEND;
+}
+
+BufferPoolStats AscendBackend::GetInputPoolStats() const
+{
+    return inputPool == nullptr ? BufferPoolStats() : inputPool->GetStats();
+}
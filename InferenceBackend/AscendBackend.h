@@ -0,0 +1,71 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_ASCENDBACKEND_H
+#define STREAM_PULL_SAMPLE_ASCENDBACKEND_H
+
+#include <mutex>
+#include "MxBase/DvppWrapper/DvppWrapper.h"
+#include "MxBase/ModelInfer/ModelInferenceProcessor.h"
+#include "InferenceBackend.h"
+#include "TensorPool.h"
+
+// .om model through ModelInferenceProcessor; resize and crop+resize are one VPC crop-and-paste each,
+// written straight into a pooled DVPP buffer
+class AscendBackend : public InferenceBackend {
+public:
+    APP_ERROR Init(const BackendInitParam &initParam) override;
+    APP_ERROR DeInit() override;
+    APP_ERROR Resize(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                     const uint32_t &resizeHeight, const uint32_t &resizeWidth, InputTensorHandle &tensor) override;
+    APP_ERROR CropAndResize(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                            const MxBase::CropRoiConfig &roi, const uint32_t &resizeHeight,
+                            const uint32_t &resizeWidth, InputTensorHandle &tensor) override;
+    APP_ERROR Inference(const std::vector<MxBase::TensorBase> &inputs,
+                        std::vector<MxBase::TensorBase> &outputs) override;
+    APP_ERROR BatchInference(const std::vector<MxBase::TensorBase> &samples,
+                             OutputTensorHandle &outputs) override;
+    void GetInputSize(uint32_t &height, uint32_t &width) const override;
+    uint32_t GetMaxBatchSize() const override;
+    const std::vector<OutputTensorDesc> &GetOutputDescs() const override;
+    MxBase::MemoryData::MemoryType GetOutputMemoryType() const override;
+    BackendType GetType() const override;
+    BufferPoolStats GetInputPoolStats() const override;
+private:
+    // VPC input description of a frame
+    static MxBase::DvppDataInfo ToDvppInput(const std::shared_ptr<MxBase::MemoryData> frameInfo,
+                                            const FrameGeometry &geometry);
+private:
+    std::shared_ptr<MxBase::DvppWrapper> dvppWrapper;
+    std::shared_ptr<MxBase::ModelInferenceProcessor> model;
+    // one backend serves every stream: VPC calls and model executions are serialized separately,
+    // so a stream resizing on DVPP does not wait for another stream's model execution
+    std::mutex dvppMutex;
+    std::mutex modelMutex;
+    MxBase::ModelDesc modelDesc = {};
+    std::vector<OutputTensorDesc> outputDescs;
+    uint32_t inputHeight = 0;
+    uint32_t inputWidth = 0;
+    // batch gears of a dynamic-batch model in ascending order, {1} for a static model
+    std::vector<uint32_t> batchSizes;
+    uint32_t deviceId = 0;
+    // VPC outputs, recycled instead of a DVPP allocation per resize and crop
+    std::unique_ptr<BufferPool> inputPool;
+    // BatchInference outputs, one pool per batch gear
+    BatchTensorPool batchOutputPool;
+};
+
+#endif // STREAM_PULL_SAMPLE_ASCENDBACKEND_H
@@ -0,0 +1,170 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <new>
+#include "MxBase/Log/Log.h"
+#include "../Metrics/MemoryTracker.h"
+#include "BufferPool.h"
+
+namespace {
+    const size_t MIN_SIZE_CLASS = 4096;
+    // classes per power of two
+    const size_t CLASS_STEPS = 4;
+}
+
+APP_ERROR MxBaseAllocator::Malloc(size_t size, void *&data)
+{
+    MxBase::MemoryData memory(size, type, deviceId);
+    APP_ERROR ret = MemoryTracker::GetInstance()->Malloc(memory, site);
+    if (ret != APP_ERR_OK) {
+        LogError << "MxbsMalloc of " << size << " bytes failed, ret=" << ret << ".";
+        return ret;
+    }
+    data = memory.ptrData;
+    return APP_ERR_OK;
+}
+
+void MxBaseAllocator::Free(void *data, size_t size)
+{
+    MxBase::MemoryData memory(data, size, type, deviceId);
+    MemoryTracker::GetInstance()->Free(memory);
+}
+
+APP_ERROR HostAllocator::Malloc(size_t size, void *&data)
+{
+    data = new (std::nothrow) uint8_t[size];
+    if (data == nullptr) {
+        return APP_ERR_COMM_ALLOC_MEM;
+    }
+    MemoryTracker::GetInstance()->Track(data, size, MxBase::MemoryData::MEMORY_HOST_NEW, site);
+    return APP_ERR_OK;
+}
+
+void HostAllocator::Free(void *data, size_t)
+{
+    MemoryTracker::GetInstance()->Untrack(data);
+    delete[] (uint8_t*)data;
+}
+
+BufferPool::BufferPool(std::shared_ptr<BufferAllocator> allocator, MxBase::MemoryData::MemoryType memoryType,
+                       uint32_t deviceId, uint32_t maxFreePerClass)
+    : state(std::make_shared<PoolState>()), memoryType(memoryType), deviceId(deviceId)
+{
+    state->allocator = allocator;
+    state->maxFreePerClass = maxFreePerClass;
+}
+
+BufferPool::~BufferPool()
+{
+    // buffers still held by handles are freed when the last handle goes away
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->closed = true;
+    for (auto &freeList : state->freeLists) {
+        for (void *data : freeList.second) {
+            state->allocator->Free(data, freeList.first);
+            state->stats.bytes -= freeList.first;
+        }
+        state->stats.free -= (uint32_t)freeList.second.size();
+    }
+    state->freeLists.clear();
+}
+
+size_t BufferPool::SizeClass(size_t size)
+{
+    if (size <= MIN_SIZE_CLASS) {
+        return MIN_SIZE_CLASS;
+    }
+    size_t top = MIN_SIZE_CLASS;
+    while (top < size) {
+        top <<= 1;
+    }
+    // size is in (top/2, top]: round up to a multiple of (top/2) / CLASS_STEPS
+    size_t step = top / 2 / CLASS_STEPS;
+    return (size + step - 1) / step * step;
+}
+
+APP_ERROR BufferPool::Acquire(size_t size, PooledBuffer &buffer)
+{
+    size_t sizeClass = SizeClass(size);
+    void *data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        std::vector<void*> &freeList = state->freeLists[sizeClass];
+        if (!freeList.empty()) {
+            data = freeList.back();
+            freeList.pop_back();
+            state->stats.free--;
+            state->stats.reuses++;
+            state->stats.inUse++;
+        }
+    }
+    if (data == nullptr) {
+        // 分配在锁外进行，DVPP内存分配较慢
+        APP_ERROR ret = state->allocator->Malloc(sizeClass, data);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->stats.allocations++;
+        state->stats.inUse++;
+        state->stats.bytes += sizeClass;
+    }
+    std::shared_ptr<PoolState> owner = state;
+    buffer = PooledBuffer(new MxBase::MemoryData(data, size, memoryType, deviceId),
+                          [owner, sizeClass] (MxBase::MemoryData *memory) {
+        Release(owner, memory->ptrData, sizeClass);
+        delete memory;
+    });
+    return APP_ERR_OK;
+}
+
+APP_ERROR BufferPool::AcquireTensor(const std::vector<uint32_t> &shape, MxBase::TensorDataType dtype,
+                                    size_t byteSize, InputTensorHandle &tensor)
+{
+    PooledBuffer buffer;
+    APP_ERROR ret = Acquire(byteSize, buffer);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    // borrowed: the tensor never frees the memory, the captured buffer returns it to the pool
+    tensor = InputTensorHandle(new MxBase::TensorBase(*buffer, true, shape, dtype),
+                               [buffer] (MxBase::TensorBase *borrowed) {
+        delete borrowed;
+    });
+    return APP_ERR_OK;
+}
+
+void BufferPool::Release(const std::shared_ptr<PoolState> &state, void *data, size_t sizeClass)
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->stats.inUse--;
+    if (!state->closed) {
+        std::vector<void*> &freeList = state->freeLists[sizeClass];
+        if (freeList.size() < state->maxFreePerClass) {
+            freeList.push_back(data);
+            state->stats.free++;
+            return;
+        }
+    }
+    state->allocator->Free(data, sizeClass);
+    state->stats.bytes -= sizeClass;
+}
+
+BufferPoolStats BufferPool::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->stats;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_BUFFERPOOL_H
+#define STREAM_PULL_SAMPLE_BUFFERPOOL_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "MxBase/MemoryHelper/MemoryHelper.h"
+#include "MxBase/Tensor/TensorBase/TensorBase.h"
+
+// free buffers kept per size class, the rest go back to the allocator
+static const uint32_t DEFAULT_BUFFER_POOL_FREE = 16;
+
+// where a BufferPool gets its memory from
+class BufferAllocator {
+public:
+    virtual ~BufferAllocator() {}
+    virtual APP_ERROR Malloc(size_t size, void *&data) = 0;
+    virtual void Free(void *data, size_t size) = 0;
+};
+
+// MxbsMalloc/MxbsFree of the given memory type, DVPP memory for VPC outputs; MemoryTracker counts
+// the buffers under site, a string literal
+class MxBaseAllocator : public BufferAllocator {
+public:
+    MxBaseAllocator(MxBase::MemoryData::MemoryType type, uint32_t deviceId, const char *site)
+        : type(type), deviceId(deviceId), site(site) {}
+    APP_ERROR Malloc(size_t size, void *&data) override;
+    void Free(void *data, size_t size) override;
+private:
+    MxBase::MemoryData::MemoryType type;
+    uint32_t deviceId;
+    const char *site;
+};
+
+// new[]/delete[], what MEMORY_HOST_NEW means; needs no device, so the pool's accounting runs anywhere
+class HostAllocator : public BufferAllocator {
+public:
+    explicit HostAllocator(const char *site = "host buffer pool") : site(site) {}
+    APP_ERROR Malloc(size_t size, void *&data) override;
+    void Free(void *data, size_t size) override;
+private:
+    const char *site;
+};
+
+// A buffer from the pool. It goes back to its size class when the last copy of the handle is
+// released, so keep the handle for as long as the memory is read.
+typedef std::shared_ptr<MxBase::MemoryData> PooledBuffer;
+// a model input tensor borrowing a pooled buffer; the buffer is returned with the last handle
+typedef std::shared_ptr<MxBase::TensorBase> InputTensorHandle;
+
+struct BufferPoolStats {
+    uint64_t allocations = 0;   // buffers taken from the allocator
+    uint64_t reuses = 0;        // acquires served from a free list
+    uint32_t inUse = 0;         // buffers held by handles
+    uint32_t free = 0;          // buffers waiting in the free lists
+    size_t bytes = 0;           // size-class bytes of all buffers the pool owns, in use or free
+};
+
+// Size-classed recycling of preprocessing outputs. Sizes round up to quarter steps between powers
+// of two (4 KB at least), so the few fixed model input sizes each get a class of their own and a
+// request wastes at most a quarter of its buffer. Thread-safe; buffers released after the pool
+// is gone are freed instead of recycled.
+class BufferPool {
+public:
+    BufferPool(std::shared_ptr<BufferAllocator> allocator, MxBase::MemoryData::MemoryType memoryType,
+               uint32_t deviceId, uint32_t maxFreePerClass = DEFAULT_BUFFER_POOL_FREE);
+    ~BufferPool();
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    // a buffer of at least size bytes; its MemoryData reports size, not the class size
+    APP_ERROR Acquire(size_t size, PooledBuffer &buffer);
+    // a tensor of shape and type over a buffer from the pool
+    APP_ERROR AcquireTensor(const std::vector<uint32_t> &shape, MxBase::TensorDataType dtype, size_t byteSize,
+                            InputTensorHandle &tensor);
+    BufferPoolStats GetStats() const;
+    static size_t SizeClass(size_t size);
+private:
+    // shared with the handles, like TensorPool's sets
+    struct PoolState {
+        std::mutex mutex;
+        std::shared_ptr<BufferAllocator> allocator;
+        std::map<size_t, std::vector<void*>> freeLists;
+        BufferPoolStats stats;
+        uint32_t maxFreePerClass = DEFAULT_BUFFER_POOL_FREE;
+        bool closed = false;
+    };
+    static void Release(const std::shared_ptr<PoolState> &state, void *data, size_t sizeClass);
+private:
+    std::shared_ptr<PoolState> state;
+    MxBase::MemoryData::MemoryType memoryType;
+    uint32_t deviceId;
+};
+
+#endif // STREAM_PULL_SAMPLE_BUFFERPOOL_H
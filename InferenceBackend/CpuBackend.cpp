@@ -0,0 +1,324 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "MxBase/Log/Log.h"
+#include "../Metrics/MemoryTracker.h"
+#include "CpuBackend.h"
+
+namespace {
+    const uint32_t YUV_BYTE_NU = 3;
+    const uint32_t YUV_BYTE_DE = 2;
+    const int BLOB_DIMS = 4;
+    const int RGB_CHANNELS = 3;
+    const uint32_t OUTPUT_POOL_WAIT_TIME = 1000;
+
+    std::vector<uint32_t> MatShape(const cv::Mat &mat)
+    {
+        std::vector<uint32_t> shape;
+        for (int i = 0; i < mat.dims; i++) {
+            shape.push_back((uint32_t)mat.size[i]);
+        }
+        return shape;
+    }
+
+    // Scale the ROI of an NV12 frame plane by plane, so color conversion only runs at model resolution.
+    // ROI corners are rounded down to even coordinates to keep the chroma plane aligned.
+    void ScaleNv12(const uint8_t *frame, const FrameGeometry &geometry, const MxBase::CropRoiConfig &roi,
+                   uint32_t dstHeight, uint32_t dstWidth, cv::Mat &dst)
+    {
+        const uint32_t width = geometry.width;
+        const uint32_t height = geometry.height;
+        uint32_t x0 = roi.x0 & ~1u;
+        uint32_t y0 = roi.y0 & ~1u;
+        uint32_t x1 = std::max(std::min(roi.x1, width - 1), x0 + 1);
+        uint32_t y1 = std::max(std::min(roi.y1, height - 1), y0 + 1);
+        uint32_t roiWidth = ((x1 - x0 + 2) & ~1u);
+        uint32_t roiHeight = ((y1 - y0 + 2) & ~1u);
+        roiWidth = std::min(roiWidth, width - x0);
+        roiHeight = std::min(roiHeight, height - y0);
+
+        // padded rows: the planes are views with the decoder's stride as row step
+        cv::Mat yPlane((int)height, (int)width, CV_8UC1, (void*)frame, geometry.widthStride);
+        cv::Mat uvPlane((int)height / 2, (int)width / 2, CV_8UC2,
+                        (void*)(frame + (size_t)geometry.heightStride * geometry.widthStride), geometry.widthStride);
+        dst = cv::Mat((int)(dstHeight * YUV_BYTE_NU / YUV_BYTE_DE), (int)dstWidth, CV_8UC1);
+        cv::Mat yDst((int)dstHeight, (int)dstWidth, CV_8UC1, dst.data);
+        cv::Mat uvDst((int)dstHeight / 2, (int)dstWidth / 2, CV_8UC2, dst.data + dstHeight * dstWidth);
+        cv::resize(yPlane(cv::Rect(x0, y0, roiWidth, roiHeight)), yDst,
+                   cv::Size(dstWidth, dstHeight), 0, 0, cv::INTER_LINEAR);
+        cv::resize(uvPlane(cv::Rect(x0 / 2, y0 / 2, roiWidth / 2, roiHeight / 2)), uvDst,
+                   cv::Size(dstWidth / 2, dstHeight / 2), 0, 0, cv::INTER_LINEAR);
+    }
+}
+
+APP_ERROR CpuBackend::Init(const BackendInitParam &initParam)
+{
+    param = initParam;
+    inputPool.reset(new BufferPool(std::make_shared<HostAllocator>("cpu input pool"),
+                                   MxBase::MemoryData::MEMORY_HOST_NEW, initParam.deviceId));
+    LogInfo << "model path: " << initParam.modelPath;
+    net = cv::dnn::readNetFromONNX(initParam.modelPath);
+    if (net.empty()) {
+        LogError << "Failed to load onnx model " << initParam.modelPath;
+        return APP_ERR_COMM_OPEN_FAIL;
+    }
+    net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    uint32_t threadNum = initParam.threadNum;
+    if (threadNum == 0) {
+        threadNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+    cv::setNumThreads((int)threadNum);
+    outputNames = net.getUnconnectedOutLayersNames();
+
+    // one forward pass on a blank blob to learn the output shapes
+    if (initParam.inputHeight == 0 || initParam.inputWidth == 0) {
+        LogError << "CPU backend needs the model input size";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    int sizes[BLOB_DIMS] = {1, RGB_CHANNELS, (int)initParam.inputHeight, (int)initParam.inputWidth};
+    cv::Mat blob(BLOB_DIMS, sizes, CV_32F, cv::Scalar(0));
+    std::vector<cv::Mat> results;
+    APP_ERROR ret = Forward(blob, results);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    outputDescs.clear();
+    for (size_t i = 0; i < results.size(); i++) {
+        OutputTensorDesc desc;
+        desc.shape = MatShape(results[i]);
+        desc.dtype = MxBase::TENSOR_DTYPE_FLOAT32;
+        outputDescs.push_back(desc);
+    }
+    batchOutputPool.Init(outputDescs, GetOutputMemoryType(), initParam.deviceId, initParam.batchPoolSize);
+    LogInfo << "CPU backend ready with " << threadNum << " threads, " << outputDescs.size() << " outputs";
+    return APP_ERR_OK;
+}
+
+APP_ERROR CpuBackend::DeInit()
+{
+    batchOutputPool.DeInit();
+    std::lock_guard<std::mutex> lock(netMutex);
+    net = cv::dnn::Net();
+    return APP_ERR_OK;
+}
+
+APP_ERROR CpuBackend::ToInputTensor(const std::shared_ptr<MxBase::MemoryData> frameInfo,
+                                    const FrameGeometry &geometry, const MxBase::CropRoiConfig &roi,
+                                    const uint32_t &resizeHeight, const uint32_t &resizeWidth,
+                                    InputTensorHandle &tensor)
+{
+    // 解码帧若在Device侧，先拷贝到Host侧
+    MxBase::MemoryData hostFrame = *frameInfo;
+    bool copied = false;
+    if (frameInfo->type != MxBase::MemoryData::MEMORY_HOST && frameInfo->type != MxBase::MemoryData::MEMORY_HOST_NEW &&
+        frameInfo->type != MxBase::MemoryData::MEMORY_HOST_MALLOC) {
+        hostFrame = MxBase::MemoryData(frameInfo->size, MxBase::MemoryData::MEMORY_HOST_NEW);
+        APP_ERROR ret = MemoryTracker::GetInstance()->MallocAndCopy(hostFrame, *frameInfo, "host frame copy");
+        if (ret != APP_ERR_OK) {
+            LogError << "Fail to malloc and copy host memory.";
+            return ret;
+        }
+        copied = true;
+    }
+
+    cv::Mat nv12;
+    ScaleNv12((const uint8_t*)hostFrame.ptrData, geometry, roi, resizeHeight, resizeWidth, nv12);
+    if (copied) {
+        MemoryTracker::GetInstance()->Free(hostFrame);
+    }
+    cv::Mat image;
+    cv::cvtColor(nv12, image, param.inputRgb ? cv::COLOR_YUV2RGB_NV12 : cv::COLOR_YUV2BGR_NV12);
+
+    // NCHW float blob written straight into the tensor buffer
+    std::vector<uint32_t> shape = {1, RGB_CHANNELS, resizeHeight, resizeWidth};
+    size_t byteSize = (size_t)RGB_CHANNELS * resizeHeight * resizeWidth * sizeof(float);
+    InputTensorHandle pooled;
+    APP_ERROR ret = inputPool->AcquireTensor(shape, MxBase::TENSOR_DTYPE_FLOAT32, byteSize, pooled);
+    if (ret != APP_ERR_OK) {
+        LogError << "No input blob buffer, ret=" << ret << ".";
+        return ret;
+    }
+    int sizes[BLOB_DIMS] = {1, RGB_CHANNELS, (int)resizeHeight, (int)resizeWidth};
+    cv::Mat blob(BLOB_DIMS, sizes, CV_32F, pooled->GetBuffer());
+    cv::Scalar mean(param.inputMean[0], param.inputMean[1], param.inputMean[2]);
+    cv::dnn::blobFromImage(image, blob, param.inputScale, cv::Size(), mean, false, false);
+    tensor = pooled;
+    return APP_ERR_OK;
+}
+
+APP_ERROR CpuBackend::Resize(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                             const uint32_t &resizeHeight, const uint32_t &resizeWidth, InputTensorHandle &tensor)
+{
+    MxBase::CropRoiConfig roi = {};
+    roi.x1 = geometry.width - 1;
+    roi.y1 = geometry.height - 1;
+    return ToInputTensor(frameInfo, geometry, roi, resizeHeight, resizeWidth, tensor);
+}
+
+APP_ERROR CpuBackend::CropAndResize(const std::shared_ptr<MxBase::MemoryData> frameInfo,
+                                    const FrameGeometry &geometry, const MxBase::CropRoiConfig &roi,
+                                    const uint32_t &resizeHeight, const uint32_t &resizeWidth,
+                                    InputTensorHandle &tensor)
+{
+    return ToInputTensor(frameInfo, geometry, roi, resizeHeight, resizeWidth, tensor);
+}
+
+APP_ERROR CpuBackend::Forward(const cv::Mat &blob, std::vector<cv::Mat> &results)
+{
+    std::lock_guard<std::mutex> lock(netMutex);
+    if (net.empty()) {
+        LogError << "model is not loaded";
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    try {
+        net.setInput(blob);
+        net.forward(results, outputNames);
+    } catch (const cv::Exception &e) {
+        // e.g. a batch the exported graph does not accept
+        LogError << "Forward failed: " << e.what();
+        return APP_ERR_COMM_FAILURE;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR CpuBackend::Inference(const std::vector<MxBase::TensorBase> &inputs,
+                                std::vector<MxBase::TensorBase> &outputs)
+{
+    if (inputs.empty() || inputs[0].GetBuffer() == nullptr) {
+        LogError << "input is null";
+        return APP_ERR_FAILURE;
+    }
+    std::vector<uint32_t> shape = inputs[0].GetShape();
+    if (shape.size() != BLOB_DIMS) {
+        LogError << "CPU backend expects an NCHW input, got " << shape.size() << " dims";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    int sizes[BLOB_DIMS] = {(int)shape[0], (int)shape[1], (int)shape[2], (int)shape[3]};
+    cv::Mat blob(BLOB_DIMS, sizes, CV_32F, inputs[0].GetBuffer());
+    std::vector<cv::Mat> results;
+    APP_ERROR ret = Forward(blob, results);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    if (outputs.size() != results.size()) {
+        LogError << "Model has " << results.size() << " outputs, " << outputs.size() << " were provided";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        size_t byteSize = results[i].total() * sizeof(float);
+        if (outputs[i].GetByteSize() < byteSize) {
+            LogError << "Output " << i << " needs " << byteSize << " bytes, got " << outputs[i].GetByteSize();
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        memcpy(outputs[i].GetBuffer(), results[i].data, byteSize);
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR CpuBackend::BatchInference(const std::vector<MxBase::TensorBase> &samples,
+                                     OutputTensorHandle &outputs)
+{
+    if (samples.empty() || samples[0].GetBuffer() == nullptr) {
+        LogError << "input is null";
+        return APP_ERR_FAILURE;
+    }
+    if (samples.size() > GetMaxBatchSize()) {
+        LogError << samples.size() << " samples exceed the largest batch " << GetMaxBatchSize();
+        return APP_ERR_COMM_OUT_OF_RANGE;
+    }
+    std::vector<uint32_t> shape = samples[0].GetShape();
+    if (shape.size() != BLOB_DIMS || shape[0] != 1) {
+        LogError << "CPU backend expects single-sample NCHW inputs";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    // NCHW样本按batch维拼接，一次前向
+    size_t sampleBytes = samples[0].GetByteSize();
+    int sizes[BLOB_DIMS] = {(int)samples.size(), (int)shape[1], (int)shape[2], (int)shape[3]};
+    cv::Mat blob(BLOB_DIMS, sizes, CV_32F);
+    for (size_t i = 0; i < samples.size(); i++) {
+        if (samples[i].GetByteSize() != sampleBytes) {
+            LogError << "Batch samples differ in size: " << samples[i].GetByteSize() << " vs " << sampleBytes;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        memcpy(blob.data + i * sampleBytes, samples[i].GetBuffer(), sampleBytes);
+    }
+    std::vector<cv::Mat> results;
+    APP_ERROR ret = Forward(blob, results);
+    if (ret == APP_ERR_COMM_FAILURE) {
+        // the same graph ran a single sample at Init, so a throwing forward means a fixed batch dimension
+        LogError << "Model does not take a batch of " << samples.size();
+        return APP_ERR_COMM_OUT_OF_RANGE;
+    }
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    OutputTensorHandle pooled;
+    ret = batchOutputPool.Acquire((uint32_t)samples.size(), pooled, OUTPUT_POOL_WAIT_TIME);
+    if (ret != APP_ERR_OK) {
+        LogError << "No batch output tensors, ret=" << ret << ".";
+        return ret;
+    }
+    if (pooled->size() != results.size()) {
+        LogError << "Model has " << results.size() << " outputs, " << pooled->size() << " were expected";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        size_t byteSize = results[i].total() * sizeof(float);
+        if ((*pooled)[i].GetByteSize() != byteSize) {
+            LogError << "Output " << i << " has " << byteSize << " bytes, " << (*pooled)[i].GetByteSize()
+                     << " were expected";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        memcpy((*pooled)[i].GetBuffer(), results[i].data, byteSize);
+    }
+    outputs = pooled;
+    return APP_ERR_OK;
+}
+
+void CpuBackend::GetInputSize(uint32_t &height, uint32_t &width) const
+{
+    height = param.inputHeight;
+    width = param.inputWidth;
+}
+
+uint32_t CpuBackend::GetMaxBatchSize() const
+{
+    return std::max(1u, param.maxBatchSize);
+}
+
+const std::vector<OutputTensorDesc> &CpuBackend::GetOutputDescs() const
+{
+    return outputDescs;
+}
+
+MxBase::MemoryData::MemoryType CpuBackend::GetOutputMemoryType() const
+{
+    return MxBase::MemoryData::MEMORY_HOST_NEW;
+}
+
+BackendType CpuBackend::GetType() const
+{
+    return BACKEND_CPU;
+}
+
+BufferPoolStats CpuBackend::GetInputPoolStats() const
+{
+    return inputPool == nullptr ? BufferPoolStats() : inputPool->GetStats();
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_CPUBACKEND_H
+#define STREAM_PULL_SAMPLE_CPUBACKEND_H
+
+#include <mutex>
+#include "opencv2/opencv.hpp"
+#include "InferenceBackend.h"
+#include "TensorPool.h"
+
+// Reference backend for hosts without an NPU: the ONNX export of the model runs through
+// OpenCV DNN on all cores, NV12 scaling and color conversion are done on the host.
+// Tensors it produces live in host memory; input blobs come from a host BufferPool.
+class CpuBackend : public InferenceBackend {
+public:
+    APP_ERROR Init(const BackendInitParam &initParam) override;
+    APP_ERROR DeInit() override;
+    APP_ERROR Resize(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                     const uint32_t &resizeHeight, const uint32_t &resizeWidth, InputTensorHandle &tensor) override;
+    APP_ERROR CropAndResize(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                            const MxBase::CropRoiConfig &roi, const uint32_t &resizeHeight,
+                            const uint32_t &resizeWidth, InputTensorHandle &tensor) override;
+    APP_ERROR Inference(const std::vector<MxBase::TensorBase> &inputs,
+                        std::vector<MxBase::TensorBase> &outputs) override;
+    APP_ERROR BatchInference(const std::vector<MxBase::TensorBase> &samples,
+                             OutputTensorHandle &outputs) override;
+    void GetInputSize(uint32_t &height, uint32_t &width) const override;
+    uint32_t GetMaxBatchSize() const override;
+    const std::vector<OutputTensorDesc> &GetOutputDescs() const override;
+    MxBase::MemoryData::MemoryType GetOutputMemoryType() const override;
+    BackendType GetType() const override;
+    BufferPoolStats GetInputPoolStats() const override;
+private:
+    APP_ERROR ToInputTensor(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                            const MxBase::CropRoiConfig &roi,
+                            const uint32_t &resizeHeight, const uint32_t &resizeWidth,
+                            InputTensorHandle &tensor);
+    APP_ERROR Forward(const cv::Mat &blob, std::vector<cv::Mat> &results);
+private:
+    cv::dnn::Net net;
+    std::vector<std::string> outputNames;
+    // cv::dnn::Net is not re-entrant
+    std::mutex netMutex;
+    BackendInitParam param;
+    std::vector<OutputTensorDesc> outputDescs;
+    // input blobs, recycled instead of allocated per frame
+    std::unique_ptr<BufferPool> inputPool;
+    // BatchInference outputs, one pool per batch size
+    BatchTensorPool batchOutputPool;
+};
+
+#endif // STREAM_PULL_SAMPLE_CPUBACKEND_H
@@ -0,0 +1,68 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <vector>
+#include "../Metrics/MemoryTracker.h"
+#include "InferenceBackend.h"
+#include "AscendBackend.h"
+#include "CpuBackend.h"
+
+std::shared_ptr<InferenceBackend> CreateInferenceBackend(BackendType type)
+{
+    if (type == BACKEND_CPU) {
+        return std::make_shared<CpuBackend>();
+    }
+    return std::make_shared<AscendBackend>();
+}
+
+FrameGeometry MakeFrameGeometry(uint32_t width, uint32_t height, uint32_t widthAlign, uint32_t heightAlign)
+{
+    FrameGeometry geometry;
+    geometry.width = width;
+    geometry.height = height;
+    geometry.widthStride = widthAlign <= 1 ? width : (width + widthAlign - 1) / widthAlign * widthAlign;
+    geometry.heightStride = heightAlign <= 1 ? height : (height + heightAlign - 1) / heightAlign * heightAlign;
+    return geometry;
+}
+
+size_t GetNv12Size(const FrameGeometry &geometry)
+{
+    // Y plane plus a half-height interleaved UV plane
+    return (size_t)geometry.widthStride * geometry.heightStride * 3 / 2;
+}
+
+APP_ERROR CreateWarmupFrame(BackendType type, uint32_t deviceId, const FrameGeometry &geometry,
+                            std::shared_ptr<MxBase::MemoryData> &frame, FramePattern pattern)
+{
+    const uint8_t gray = 128;
+    size_t size = GetNv12Size(geometry);
+    std::vector<uint8_t> pixels(size, gray);
+    if (pattern == FRAME_PATTERN_NOISE) {
+        for (size_t i = 0; i < size; i++) {
+            pixels[i] = (uint8_t)(rand() & 0xff);
+        }
+    }
+    MxBase::MemoryData host(pixels.data(), size, MxBase::MemoryData::MEMORY_HOST_NEW, deviceId);
+    MxBase::MemoryData::MemoryType memoryType = type == BACKEND_ASCEND ?
+        MxBase::MemoryData::MEMORY_DVPP : MxBase::MemoryData::MEMORY_HOST_NEW;
+    auto deleter = [] (MxBase::MemoryData *memoryData) {
+        MemoryTracker::GetInstance()->Free(*memoryData);
+        delete memoryData;
+    };
+    frame = std::shared_ptr<MxBase::MemoryData>(new MxBase::MemoryData(size, memoryType, deviceId), deleter);
+    return MemoryTracker::GetInstance()->MallocAndCopy(*frame, host, "warm-up frame");
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_INFERENCEBACKEND_H
+#define STREAM_PULL_SAMPLE_INFERENCEBACKEND_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "MxBase/DvppWrapper/DvppWrapper.h"
+#include "MxBase/MemoryHelper/MemoryHelper.h"
+#include "MxBase/Tensor/TensorBase/TensorBase.h"
+#include "BufferPool.h"
+
+enum BackendType {
+    BACKEND_ASCEND = 0, // .om model on the NPU, preprocessing on DVPP
+    BACKEND_CPU,        // ONNX export of the same model through OpenCV DNN, preprocessing on the host
+};
+
+// One complete set of model outputs. The set goes back to its pool when the last copy of the
+// handle is released, so keep the handle (not copies of the tensors) for as long as they are read.
+typedef std::shared_ptr<std::vector<MxBase::TensorBase>> OutputTensorHandle;
+
+static const uint32_t DEFAULT_TENSOR_POOL_SIZE = 4;
+
+struct BackendInitParam {
+    BackendType type = BACKEND_ASCEND;
+    uint32_t deviceId = 0;
+    std::string modelPath;
+    // model input size; the Ascend backend takes it from the .om model when the model records one,
+    // the CPU backend sizes its blob with it
+    uint32_t inputHeight = 0;
+    uint32_t inputWidth = 0;
+    // CPU preprocessing, mirrors what AIPP does inside the .om model
+    double inputScale = 1.0 / 255;
+    float inputMean[3] = {0, 0, 0};
+    bool inputRgb = true;
+    // CPU worker threads, 0 means all cores
+    uint32_t threadNum = 0;
+    // largest batch the CPU backend packs into one forward pass; the Ascend backend reads its
+    // batch gears from the .om model instead
+    uint32_t maxBatchSize = 1;
+    // BatchInference output sets recycled per batch size
+    uint32_t batchPoolSize = DEFAULT_TENSOR_POOL_SIZE;
+};
+
+// DVPP VDEC output and VPC input rows are padded to these
+static const uint32_t DVPP_WIDTH_ALIGN = 16;
+static const uint32_t DVPP_HEIGHT_ALIGN = 2;
+
+// Picture size of an NV12 frame and the layout it is stored in: Y rows are widthStride bytes apart
+// and the interleaved UV plane starts heightStride rows into the buffer.
+struct FrameGeometry {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t widthStride = 0;
+    uint32_t heightStride = 0;
+};
+
+// strides rounded up to the given alignment, 1 for a tightly packed frame
+FrameGeometry MakeFrameGeometry(uint32_t width, uint32_t height, uint32_t widthAlign = 1, uint32_t heightAlign = 1);
+// bytes of an NV12 buffer laid out as geometry
+size_t GetNv12Size(const FrameGeometry &geometry);
+
+// shape and data type of one model output, fixed after Init
+struct OutputTensorDesc {
+    std::vector<uint32_t> shape;
+    MxBase::TensorDataType dtype = MxBase::TENSOR_DTYPE_FLOAT32;
+};
+
+// Model load, input preprocessing and inference for one model. Frames are NV12 buffers of the
+// given size; the tensors produced by Resize/CropAndResize are only meaningful to the same backend
+// and live in its preprocessing buffer pool until their last handle is released.
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() {}
+
+    virtual APP_ERROR Init(const BackendInitParam &initParam) = 0;
+    virtual APP_ERROR DeInit() = 0;
+    // scale the whole frame to the model input
+    virtual APP_ERROR Resize(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                             const uint32_t &resizeHeight, const uint32_t &resizeWidth,
+                             InputTensorHandle &tensor) = 0;
+    // cut a region out of the frame and scale it to the model input, in one pass without an intermediate
+    virtual APP_ERROR CropAndResize(const std::shared_ptr<MxBase::MemoryData> frameInfo,
+                                    const FrameGeometry &geometry, const MxBase::CropRoiConfig &roi,
+                                    const uint32_t &resizeHeight, const uint32_t &resizeWidth,
+                                    InputTensorHandle &tensor) = 0;
+    // outputs are preallocated to match GetOutputDescs(), normally a set from a TensorPool
+    virtual APP_ERROR Inference(const std::vector<MxBase::TensorBase> &inputs,
+                                std::vector<MxBase::TensorBase> &outputs) = 0;
+    // Packs single-sample tensors from Resize/CropAndResize into one launch. Outputs come from a pool
+    // kept per batch size, with the batch as first dimension, padded up to a batch size the model supports.
+    // APP_ERR_COMM_OUT_OF_RANGE when the model does not take a batch of that many samples.
+    virtual APP_ERROR BatchInference(const std::vector<MxBase::TensorBase> &samples,
+                                     OutputTensorHandle &outputs) = 0;
+    // input picture size of the model, fixed after Init
+    virtual void GetInputSize(uint32_t &height, uint32_t &width) const = 0;
+    // most samples one BatchInference call takes
+    virtual uint32_t GetMaxBatchSize() const = 0;
+    virtual const std::vector<OutputTensorDesc> &GetOutputDescs() const = 0;
+    // where preallocated outputs have to live
+    virtual MxBase::MemoryData::MemoryType GetOutputMemoryType() const = 0;
+    virtual BackendType GetType() const = 0;
+    // accounting of the preprocessing buffer pool
+    virtual BufferPoolStats GetInputPoolStats() const = 0;
+};
+
+std::shared_ptr<InferenceBackend> CreateInferenceBackend(BackendType type);
+// content of a synthetic frame
+enum FramePattern {
+    FRAME_PATTERN_GRAY = 0, // mid-gray, for a warm-up pass before the first real frame
+    FRAME_PATTERN_NOISE,    // random pixels, for benchmarks that should not hit a constant-input fast path
+};
+
+// NV12 frame in the memory the backend reads frames from
+APP_ERROR CreateWarmupFrame(BackendType type, uint32_t deviceId, const FrameGeometry &geometry,
+                            std::shared_ptr<MxBase::MemoryData> &frame, FramePattern pattern = FRAME_PATTERN_GRAY);
+
+#endif // STREAM_PULL_SAMPLE_INFERENCEBACKEND_H
@@ -0,0 +1,141 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MxBase/Log/Log.h"
+#include "../Metrics/MemoryTracker.h"
+#include "TensorPool.h"
+
+TensorPool::PoolState::~PoolState()
+{
+    // the tensors free their memory with the last copy, which is this one
+    for (const auto &set : sets) {
+        for (const auto &tensor : set) {
+            MemoryTracker::GetInstance()->Untrack(tensor.GetBuffer());
+        }
+    }
+}
+
+APP_ERROR TensorPool::Init(const std::vector<OutputTensorDesc> &descs, MxBase::MemoryData::MemoryType memoryType,
+                           uint32_t deviceId, uint32_t poolSize)
+{
+    if (poolSize == 0 || descs.empty()) {
+        LogError << "Invalid tensor pool, size=" << poolSize << ", outputs=" << descs.size() << ".";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    auto newState = std::make_shared<PoolState>(poolSize);
+    for (uint32_t i = 0; i < poolSize; i++) {
+        std::vector<MxBase::TensorBase> tensors;
+        for (size_t j = 0; j < descs.size(); j++) {
+            MxBase::TensorBase tensor(descs[j].shape, descs[j].dtype, memoryType, deviceId);
+            APP_ERROR ret = MxBase::TensorBase::TensorBaseMalloc(tensor);
+            if (ret != APP_ERR_OK) {
+                LogError << "TensorBaseMalloc failed, ret=" << ret << ".";
+                return ret;
+            }
+            tensors.push_back(tensor);
+        }
+        // 整组分配成功才计入，析构PoolState时整组注销
+        for (const auto &tensor : tensors) {
+            MemoryTracker::GetInstance()->Track(tensor.GetBuffer(), tensor.GetByteSize(), memoryType,
+                                                "model output pool");
+        }
+        newState->sets.push_back(tensors);
+        uint32_t index = i;
+        newState->freeList.TryPush(index);
+    }
+    state = newState;
+    return APP_ERR_OK;
+}
+
+void TensorPool::DeInit()
+{
+    // sets still held by handles are freed when the last handle goes away
+    state.reset();
+}
+
+APP_ERROR TensorPool::Acquire(OutputTensorHandle &handle, unsigned int timeOutMs)
+{
+    if (state == nullptr) {
+        LogError << "Tensor pool is not initialized.";
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    uint32_t index = 0;
+    APP_ERROR ret = state->freeList.Pop(index, timeOutMs);
+    if (ret != APP_ERR_OK) {
+        LogError << "No free output tensors after " << timeOutMs << "ms, ret=" << ret << ".";
+        return ret;
+    }
+    std::shared_ptr<PoolState> owner = state;
+    handle = OutputTensorHandle(&owner->sets[index], [owner, index] (std::vector<MxBase::TensorBase> *) {
+        uint32_t released = index;
+        owner->freeList.TryPush(released);
+    });
+    return APP_ERR_OK;
+}
+
+uint32_t TensorPool::GetPoolSize() const
+{
+    return state == nullptr ? 0 : (uint32_t)state->sets.size();
+}
+
+uint32_t TensorPool::GetFreeCount() const
+{
+    return state == nullptr ? 0 : (uint32_t)state->freeList.GetSize();
+}
+
+void BatchTensorPool::Init(const std::vector<OutputTensorDesc> &descs, MxBase::MemoryData::MemoryType memoryType,
+                           uint32_t deviceId, uint32_t poolSize)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->descs = descs;
+    this->memoryType = memoryType;
+    this->deviceId = deviceId;
+    this->poolSize = poolSize;
+    pools.clear();
+}
+
+void BatchTensorPool::DeInit()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pools.clear();
+}
+
+APP_ERROR BatchTensorPool::Acquire(uint32_t batchSize, OutputTensorHandle &handle, unsigned int timeOutMs)
+{
+    TensorPool *pool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = pools.find(batchSize);
+        if (found == pools.end()) {
+            std::vector<OutputTensorDesc> batchDescs = descs;
+            for (auto &desc : batchDescs) {
+                if (!desc.shape.empty()) {
+                    desc.shape[0] = batchSize;
+                }
+            }
+            std::unique_ptr<TensorPool> created(new TensorPool());
+            APP_ERROR ret = created->Init(batchDescs, memoryType, deviceId, poolSize);
+            if (ret != APP_ERR_OK) {
+                LogError << "Output pool for batch " << batchSize << " init failed, ret=" << ret << ".";
+                return ret;
+            }
+            found = pools.emplace(batchSize, std::move(created)).first;
+        }
+        pool = found->second.get();
+    }
+    // 等待空闲输出时不持锁，其他批大小不受影响
+    return pool->Acquire(handle, timeOutMs);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_TENSORPOOL_H
+#define STREAM_PULL_SAMPLE_TENSORPOOL_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "MxBase/Tensor/TensorBase/TensorBase.h"
+#include "../BlockingQueue/RingQueue.h"
+#include "InferenceBackend.h"
+
+// Fixed number of output tensor sets allocated once per model and recycled frame after frame.
+class TensorPool {
+public:
+    APP_ERROR Init(const std::vector<OutputTensorDesc> &descs, MxBase::MemoryData::MemoryType memoryType,
+                   uint32_t deviceId, uint32_t poolSize = DEFAULT_TENSOR_POOL_SIZE);
+    void DeInit();
+    // waits up to timeOutMs for a set to come back when all of them are in flight
+    APP_ERROR Acquire(OutputTensorHandle &handle, unsigned int timeOutMs);
+    uint32_t GetPoolSize() const;
+    uint32_t GetFreeCount() const;
+private:
+    // shared with the handles, so sets released after DeInit are still valid to return
+    struct PoolState {
+        std::vector<std::vector<MxBase::TensorBase>> sets;
+        MpmcRingQueue<uint32_t> freeList;
+
+        explicit PoolState(uint32_t poolSize) : freeList(poolSize) {}
+        ~PoolState();
+    };
+    std::shared_ptr<PoolState> state;
+};
+
+// One TensorPool per batch size for outputs whose first dimension is the batch. A size gets its
+// sets on its first launch, so a backend that never batches holds none.
+class BatchTensorPool {
+public:
+    void Init(const std::vector<OutputTensorDesc> &descs, MxBase::MemoryData::MemoryType memoryType,
+              uint32_t deviceId, uint32_t poolSize = DEFAULT_TENSOR_POOL_SIZE);
+    void DeInit();
+    APP_ERROR Acquire(uint32_t batchSize, OutputTensorHandle &handle, unsigned int timeOutMs);
+private:
+    std::mutex mutex;
+    std::vector<OutputTensorDesc> descs;
+    MxBase::MemoryData::MemoryType memoryType = MxBase::MemoryData::MEMORY_HOST_NEW;
+    uint32_t deviceId = 0;
+    uint32_t poolSize = DEFAULT_TENSOR_POOL_SIZE;
+    std::map<uint32_t, std::unique_ptr<TensorPool>> pools;
+};
+
+#endif // STREAM_PULL_SAMPLE_TENSORPOOL_H
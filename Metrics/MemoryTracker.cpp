@@ -0,0 +1,300 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include "MemoryTracker.h"
+
+namespace {
+    // oldest buffers listed per site, the rest only count
+    const size_t MAX_DUMP_BUFFERS = 8;
+    const double BYTES_PER_MB = 1024.0 * 1024.0;
+    // allocations a soak cannot see, listed with every report so a flat trend is not over-read
+    const char *UNTRACKED_MEMORY = "not tracked: VDEC input packets (freed by the SDK once decoded), "
+                                   "buffers allocated inside the SDK\n";
+}
+
+const char *MemoryTypeName(MxBase::MemoryData::MemoryType type)
+{
+    switch (type) {
+        case MxBase::MemoryData::MEMORY_HOST:
+            return "host";
+        case MxBase::MemoryData::MEMORY_DEVICE:
+            return "device";
+        case MxBase::MemoryData::MEMORY_DVPP:
+            return "dvpp";
+        case MxBase::MemoryData::MEMORY_HOST_MALLOC:
+            return "host_malloc";
+        case MxBase::MemoryData::MEMORY_HOST_NEW:
+            return "host_new";
+        default:
+            return "unknown";
+    }
+}
+
+MemoryTracker *MemoryTracker::GetInstance()
+{
+    static MemoryTracker tracker;
+    return &tracker;
+}
+
+APP_ERROR MemoryTracker::Malloc(MxBase::MemoryData &memory, const char *site)
+{
+    APP_ERROR ret = MxBase::MemoryHelper::MxbsMalloc(memory);
+    if (ret == APP_ERR_OK) {
+        Track(memory.ptrData, memory.size, memory.type, site);
+    }
+    return ret;
+}
+
+APP_ERROR MemoryTracker::MallocAndCopy(MxBase::MemoryData &dst, const MxBase::MemoryData &src, const char *site)
+{
+    APP_ERROR ret = MxBase::MemoryHelper::MxbsMallocAndCopy(dst, src);
+    if (ret == APP_ERR_OK) {
+        Track(dst.ptrData, dst.size, dst.type, site);
+    }
+    return ret;
+}
+
+APP_ERROR MemoryTracker::Free(MxBase::MemoryData &memory)
+{
+    // 先注销再释放，同一地址被其他线程重新分配时不会混淆
+    Untrack(memory.ptrData);
+    return MxBase::MemoryHelper::MxbsFree(memory);
+}
+
+MemoryTracker::Site &MemoryTracker::GetSite(MxBase::MemoryData::MemoryType type, const char *name)
+{
+    auto key = std::make_pair(type, std::string(name));
+    auto found = sites.find(key);
+    if (found != sites.end()) {
+        return found->second;
+    }
+    Site &site = sites[key];
+    site.type = type;
+    site.name = name;
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    std::string labels = MetricLabels({{"type", MemoryTypeName(type)}, {"site", name}});
+    site.liveBytes = registry->GetGauge("hand_memory_live_bytes", "Bytes of live buffers per allocation site", labels);
+    site.liveBuffers = registry->GetGauge("hand_memory_live_buffers", "Live buffers per allocation site", labels);
+    site.peakBytes = registry->GetGauge("hand_memory_peak_bytes", "High-water mark of live bytes per allocation site",
+                                        labels);
+    if (typePeaks.find(type) == typePeaks.end()) {
+        typePeaks[type] = registry->GetGauge("hand_memory_type_peak_bytes",
+            "High-water mark of live bytes per memory type", MetricLabels({{"type", MemoryTypeName(type)}}));
+    }
+    return site;
+}
+
+void MemoryTracker::Track(const void *data, size_t size, MxBase::MemoryData::MemoryType type, const char *site)
+{
+    if (data == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    Site &owner = GetSite(type, site);
+    auto found = allocations.find(data);
+    if (found != allocations.end()) {
+        // the address was freed behind the tracker's back and handed out again
+        Site *stale = found->second.site;
+        stale->usage.liveBytes -= found->second.size;
+        stale->usage.liveBuffers--;
+        stale->liveBytes->Set((int64_t)stale->usage.liveBytes);
+        stale->liveBuffers->Set((int64_t)stale->usage.liveBuffers);
+        types[stale->type].liveBytes -= found->second.size;
+        types[stale->type].liveBuffers--;
+        allocations.erase(found);
+    }
+    allocations[data] = Allocation{size, &owner, Clock::now()};
+
+    MemoryUsage &usage = owner.usage;
+    usage.liveBytes += size;
+    usage.liveBuffers++;
+    usage.allocations++;
+    usage.peakBytes = std::max(usage.peakBytes, usage.liveBytes);
+    owner.liveBytes->Set((int64_t)usage.liveBytes);
+    owner.liveBuffers->Set((int64_t)usage.liveBuffers);
+    owner.peakBytes->Set((int64_t)usage.peakBytes);
+    MemoryUsage &typeUsage = types[type];
+    typeUsage.liveBytes += size;
+    typeUsage.liveBuffers++;
+    typeUsage.allocations++;
+    typeUsage.peakBytes = std::max(typeUsage.peakBytes, typeUsage.liveBytes);
+    typePeaks[type]->Set((int64_t)typeUsage.peakBytes);
+}
+
+void MemoryTracker::Untrack(const void *data)
+{
+    if (data == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = allocations.find(data);
+    if (found == allocations.end()) {
+        // freed twice, or allocated on a path that bypasses the tracker
+        if (unknownFrees == nullptr) {
+            unknownFrees = MetricsRegistry::GetInstance()->GetCounter("hand_memory_unknown_frees_total",
+                "Frees of buffers the memory tracker never saw allocated", "");
+        }
+        unknownFrees->Add();
+        return;
+    }
+    Site *site = found->second.site;
+    site->usage.liveBytes -= found->second.size;
+    site->usage.liveBuffers--;
+    site->liveBytes->Set((int64_t)site->usage.liveBytes);
+    site->liveBuffers->Set((int64_t)site->usage.liveBuffers);
+    MemoryUsage &typeUsage = types[site->type];
+    typeUsage.liveBytes -= found->second.size;
+    typeUsage.liveBuffers--;
+    allocations.erase(found);
+}
+
+MemoryUsage MemoryTracker::GetUsage(MxBase::MemoryData::MemoryType type) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = types.find(type);
+    return found == types.end() ? MemoryUsage() : found->second;
+}
+
+std::map<MxBase::MemoryData::MemoryType, MemoryUsage> MemoryTracker::GetUsageByType() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return types;
+}
+
+uint64_t MemoryTracker::GetLiveBuffers() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocations.size();
+}
+
+std::string MemoryTracker::Dump() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::time_point now = Clock::now();
+    std::map<const Site*, std::vector<std::pair<Clock::time_point, const void*>>> outstanding;
+    for (const auto &allocation : allocations) {
+        outstanding[allocation.second.site].emplace_back(allocation.second.time, allocation.first);
+    }
+    char line[256];
+    std::string out;
+    for (const auto &type : types) {
+        snprintf(line, sizeof(line), "%-12s %-20s %8lu live %10.1f MB %10.1f MB peak %10lu allocated\n",
+                 MemoryTypeName(type.first), "(all sites)", (unsigned long)type.second.liveBuffers,
+                 type.second.liveBytes / BYTES_PER_MB, type.second.peakBytes / BYTES_PER_MB,
+                 (unsigned long)type.second.allocations);
+        out += line;
+    }
+    // 按站点列出，每个站点附最旧的几块，长期不释放的缓冲区即为泄漏嫌疑
+    for (const auto &entry : sites) {
+        const Site &site = entry.second;
+        snprintf(line, sizeof(line), "%-12s %-20s %8lu live %10.1f MB %10.1f MB peak %10lu allocated\n",
+                 MemoryTypeName(site.type), site.name.c_str(), (unsigned long)site.usage.liveBuffers,
+                 site.usage.liveBytes / BYTES_PER_MB, site.usage.peakBytes / BYTES_PER_MB,
+                 (unsigned long)site.usage.allocations);
+        out += line;
+        auto found = outstanding.find(&site);
+        if (found == outstanding.end()) {
+            continue;
+        }
+        std::vector<std::pair<Clock::time_point, const void*>> &buffers = found->second;
+        size_t listed = std::min(buffers.size(), MAX_DUMP_BUFFERS);
+        std::partial_sort(buffers.begin(), buffers.begin() + listed, buffers.end());
+        for (size_t i = 0; i < listed; i++) {
+            const Allocation &allocation = allocations.at(buffers[i].second);
+            snprintf(line, sizeof(line), "    %p %10lu bytes, %.1f s old\n", buffers[i].second,
+                     (unsigned long)allocation.size,
+                     std::chrono::duration<double>(now - allocation.time).count());
+            out += line;
+        }
+        if (buffers.size() > listed) {
+            out += "    ... " + std::to_string(buffers.size() - listed) + " more\n";
+        }
+    }
+    return out;
+}
+
+MemorySoak::MemorySoak(uint32_t seconds, uint64_t maxGrowthBytes)
+    : seconds(seconds), maxGrowthBytes(maxGrowthBytes), start(MemoryTracker::Clock::now())
+{
+}
+
+void MemorySoak::Sample()
+{
+    Point point;
+    point.seconds = std::chrono::duration<double>(MemoryTracker::Clock::now() - start).count();
+    for (const auto &type : MemoryTracker::GetInstance()->GetUsageByType()) {
+        point.liveBytes[type.first] = type.second.liveBytes;
+    }
+    points.push_back(point);
+}
+
+bool MemorySoak::Check(std::string &report) const
+{
+    std::vector<const Point*> steady;
+    for (const auto &point : points) {
+        if (point.seconds >= seconds * SOAK_WARMUP_SHARE) {
+            steady.push_back(&point);
+        }
+    }
+    if (steady.size() < MIN_SOAK_SAMPLES) {
+        report = "soak too short: " + std::to_string(steady.size()) + " samples after warm-up, " +
+                 std::to_string(MIN_SOAK_SAMPLES) + " needed";
+        return false;
+    }
+    std::map<MxBase::MemoryData::MemoryType, bool> seen;
+    for (const Point *point : steady) {
+        for (const auto &type : point->liveBytes) {
+            seen[type.first] = true;
+        }
+    }
+    double t0 = steady.front()->seconds;
+    double span = steady.back()->seconds - t0;
+    bool ok = true;
+    char line[200];
+    report.clear();
+    for (const auto &type : seen) {
+        // 最小二乘拟合，单次突发不会被当作增长
+        double meanT = 0;
+        double meanBytes = 0;
+        for (const Point *point : steady) {
+            auto found = point->liveBytes.find(type.first);
+            meanT += point->seconds - t0;
+            meanBytes += found == point->liveBytes.end() ? 0 : (double)found->second;
+        }
+        meanT /= steady.size();
+        meanBytes /= steady.size();
+        double covariance = 0;
+        double variance = 0;
+        for (const Point *point : steady) {
+            auto found = point->liveBytes.find(type.first);
+            double bytes = found == point->liveBytes.end() ? 0 : (double)found->second;
+            double dt = point->seconds - t0 - meanT;
+            covariance += dt * (bytes - meanBytes);
+            variance += dt * dt;
+        }
+        double growth = variance > 0 ? covariance / variance * span : 0;
+        bool grows = growth > (double)maxGrowthBytes;
+        ok = ok && !grows;
+        snprintf(line, sizeof(line), "%-12s %10.1f MB mean, %+10.2f MB over %.0f s steady state%s\n",
+                 MemoryTypeName(type.first), meanBytes / BYTES_PER_MB, growth / BYTES_PER_MB, span,
+                 grows ? "  GROWING" : "");
+        report += line;
+    }
+    report += UNTRACKED_MEMORY;
+    return ok;
+}
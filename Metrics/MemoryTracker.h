@@ -0,0 +1,119 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_MEMORYTRACKER_H
+#define STREAM_PULL_SAMPLE_MEMORYTRACKER_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "MxBase/MemoryHelper/MemoryHelper.h"
+#include "Metrics.h"
+
+// soak runs: the first quarter is warm-up (pools, queues and codecs fill up) and not judged
+static const double SOAK_WARMUP_SHARE = 0.25;
+// steady-state samples a soak needs before its trend means anything
+static const uint32_t MIN_SOAK_SAMPLES = 10;
+static const uint64_t DEFAULT_SOAK_GROWTH_BYTES = 8 * 1024 * 1024;
+
+const char *MemoryTypeName(MxBase::MemoryData::MemoryType type);
+
+// live buffers and bytes of one memory type, or of one allocation site within it
+struct MemoryUsage {
+    uint64_t liveBytes = 0;
+    uint64_t liveBuffers = 0;
+    uint64_t peakBytes = 0;     // high-water mark of liveBytes
+    uint64_t allocations = 0;   // buffers ever recorded
+};
+
+// Live buffer accounting for DVPP, device and host memory. Every pipeline buffer is recorded under
+// the site that allocated or adopted it, e.g. "vdec frame" or "vpc output pool", and forgotten when
+// it is freed, so what is still outstanding can be listed at any time. One mutex and a hash map
+// entry per buffer: a few lookups per frame, far below a DVPP allocation.
+// Model outputs are always TensorPool sets. Not covered: VDEC input packets, which the SDK frees
+// itself once decoded, and memory allocated inside the SDK; MemorySoak::Check says so in its report.
+class MemoryTracker {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static MemoryTracker *GetInstance();
+
+    // MxbsMalloc/MxbsMallocAndCopy/MxbsFree that record the buffer under site, a string literal
+    APP_ERROR Malloc(MxBase::MemoryData &memory, const char *site);
+    APP_ERROR MallocAndCopy(MxBase::MemoryData &dst, const MxBase::MemoryData &src, const char *site);
+    APP_ERROR Free(MxBase::MemoryData &memory);
+    // memory that comes from somewhere else (VDEC output, new[], a TensorPool) or is freed elsewhere
+    void Track(const void *data, size_t size, MxBase::MemoryData::MemoryType type, const char *site);
+    void Untrack(const void *data);
+
+    MemoryUsage GetUsage(MxBase::MemoryData::MemoryType type) const;
+    std::map<MxBase::MemoryData::MemoryType, MemoryUsage> GetUsageByType() const;
+    uint64_t GetLiveBuffers() const;
+    // every site with live buffers and the oldest of them, for /memory, shutdown and soak reports
+    std::string Dump() const;
+private:
+    struct Site {
+        MxBase::MemoryData::MemoryType type;
+        std::string name;
+        MemoryUsage usage;
+        MetricGauge *liveBytes = nullptr;
+        MetricGauge *liveBuffers = nullptr;
+        MetricGauge *peakBytes = nullptr;
+    };
+    struct Allocation {
+        size_t size;
+        Site *site;
+        Clock::time_point time;
+    };
+    MemoryTracker() = default;
+    Site &GetSite(MxBase::MemoryData::MemoryType type, const char *name);
+private:
+    mutable std::mutex mutex;
+    // map nodes stay put, allocations point at their site
+    std::map<std::pair<MxBase::MemoryData::MemoryType, std::string>, Site> sites;
+    std::map<MxBase::MemoryData::MemoryType, MemoryUsage> types;
+    std::map<MxBase::MemoryData::MemoryType, MetricGauge*> typePeaks;
+    std::unordered_map<const void*, Allocation> allocations;
+    MetricCounter *unknownFrees = nullptr;
+};
+
+// Steady-state growth check for a soak run: Sample about once a second while the pipeline runs,
+// then Check fits a line through the live bytes of every memory type after the warm-up share of
+// the run. Growth along that line over the judged part must stay within maxGrowthBytes.
+class MemorySoak {
+public:
+    MemorySoak(uint32_t seconds, uint64_t maxGrowthBytes);
+    void Sample();
+    // false when some memory type grows or the run was too short to tell; report says which
+    bool Check(std::string &report) const;
+private:
+    struct Point {
+        double seconds;
+        std::map<MxBase::MemoryData::MemoryType, uint64_t> liveBytes;
+    };
+    uint32_t seconds;
+    uint64_t maxGrowthBytes;
+    MemoryTracker::Clock::time_point start;
+    std::vector<Point> points;
+};
+
+#endif // STREAM_PULL_SAMPLE_MEMORYTRACKER_H
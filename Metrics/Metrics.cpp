@@ -0,0 +1,244 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include "MxBase/Log/Log.h"
+#include "Metrics.h"
+
+namespace {
+    const double US_PER_SECOND = 1e6;
+    const char *TYPE_NAMES[] = {"counter", "gauge", "histogram"};
+
+    std::string FormatValue(double value)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.9g", value);
+        return buf;
+    }
+
+    std::string Braced(const std::string &labels)
+    {
+        return labels.empty() ? "" : "{" + labels + "}";
+    }
+}
+
+const uint64_t LatencyHistogram::BUCKET_BOUNDS_US[LatencyHistogram::BUCKET_NUM] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 20000, 33000, 50000, 75000, 100000, 250000, 500000, 1000000,
+    2500000, UINT64_MAX
+};
+
+LatencyHistogram::LatencyHistogram() : sumUs(0)
+{
+    for (uint32_t i = 0; i < BUCKET_NUM; i++) {
+        buckets[i] = 0;
+    }
+}
+
+void LatencyHistogram::Observe(uint64_t us)
+{
+    uint32_t i = 0;
+    while (us > BUCKET_BOUNDS_US[i]) {
+        i++;
+    }
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::ObserveSince(const std::chrono::steady_clock::time_point &start)
+{
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    Observe((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+uint64_t LatencyHistogram::GetCount() const
+{
+    return GetCumulativeCount(BUCKET_NUM - 1);
+}
+
+uint64_t LatencyHistogram::GetSumUs() const
+{
+    return sumUs.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetCumulativeCount(uint32_t bucket) const
+{
+    uint64_t count = 0;
+    for (uint32_t i = 0; i <= bucket && i < BUCKET_NUM; i++) {
+        count += buckets[i].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t LatencyHistogram::Quantile(double q) const
+{
+    uint64_t total = GetCount();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * total);
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < BUCKET_NUM; i++) {
+        count += buckets[i].load(std::memory_order_relaxed);
+        if (count > rank) {
+            return BUCKET_BOUNDS_US[i];
+        }
+    }
+    return BUCKET_BOUNDS_US[BUCKET_NUM - 1];
+}
+
+std::string MetricLabels(const std::vector<std::pair<std::string, std::string>> &labels)
+{
+    std::string out;
+    for (const auto &label : labels) {
+        if (!out.empty()) {
+            out += ",";
+        }
+        out += label.first + "=\"";
+        for (char c : label.second) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else {
+                out += c;
+            }
+        }
+        out += "\"";
+    }
+    return out;
+}
+
+std::string JoinMetricLabels(const std::string &first, const std::string &second)
+{
+    if (first.empty() || second.empty()) {
+        return first + second;
+    }
+    return first + "," + second;
+}
+
+MetricsRegistry *MetricsRegistry::GetInstance()
+{
+    static MetricsRegistry registry;
+    return &registry;
+}
+
+MetricsRegistry::Family &MetricsRegistry::GetFamily(const std::string &name, const std::string &help,
+                                                    MetricType type)
+{
+    auto it = families.find(name);
+    if (it == families.end()) {
+        Family &family = families[name];
+        family.type = type;
+        family.help = help;
+        return family;
+    }
+    if (it->second.type != type) {
+        LogError << "Metric " << name << " registered as " << TYPE_NAMES[it->second.type] << " and "
+                 << TYPE_NAMES[type];
+    }
+    return it->second;
+}
+
+LatencyHistogram *MetricsRegistry::GetHistogram(const std::string &name, const std::string &help,
+                                                const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &series = GetFamily(name, help, METRIC_HISTOGRAM).histograms[labels];
+    if (!series) {
+        series.reset(new LatencyHistogram);
+    }
+    return series.get();
+}
+
+MetricCounter *MetricsRegistry::GetCounter(const std::string &name, const std::string &help,
+                                           const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &series = GetFamily(name, help, METRIC_COUNTER).counters[labels];
+    if (!series) {
+        series.reset(new MetricCounter);
+    }
+    return series.get();
+}
+
+MetricGauge *MetricsRegistry::GetGauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &series = GetFamily(name, help, METRIC_GAUGE).gauges[labels];
+    if (!series) {
+        series.reset(new MetricGauge);
+    }
+    return series.get();
+}
+
+uint64_t MetricsRegistry::RegisterCallback(const std::string &name, const std::string &help, MetricType type,
+                                           const std::string &labels, std::function<double()> callback)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t id = nextCallbackId++;
+    GetFamily(name, help, type).callbacks[id] = std::make_pair(labels, callback);
+    return id;
+}
+
+void MetricsRegistry::Unregister(uint64_t callbackId)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &family : families) {
+        if (family.second.callbacks.erase(callbackId) > 0) {
+            return;
+        }
+    }
+}
+
+void MetricsRegistry::RenderHistogram(const std::string &name, const std::string &labels,
+                                      const LatencyHistogram &histogram, std::string &out)
+{
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < LatencyHistogram::BUCKET_NUM; i++) {
+        count = histogram.GetCumulativeCount(i);
+        std::string le = i + 1 == LatencyHistogram::BUCKET_NUM ? "+Inf" :
+            FormatValue(LatencyHistogram::BUCKET_BOUNDS_US[i] / US_PER_SECOND);
+        out += name + "_bucket{" + JoinMetricLabels(labels, "le=\"" + le + "\"") + "} " + std::to_string(count) + "\n";
+    }
+    out += name + "_sum" + Braced(labels) + " " + FormatValue(histogram.GetSumUs() / US_PER_SECOND) + "\n";
+    out += name + "_count" + Braced(labels) + " " + std::to_string(count) + "\n";
+}
+
+std::string MetricsRegistry::Render()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string out;
+    for (auto &entry : families) {
+        const std::string &name = entry.first;
+        Family &family = entry.second;
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + TYPE_NAMES[family.type] + "\n";
+        for (auto &series : family.histograms) {
+            RenderHistogram(name, series.first, *series.second, out);
+        }
+        for (auto &series : family.counters) {
+            out += name + Braced(series.first) + " " + std::to_string(series.second->Get()) + "\n";
+        }
+        for (auto &series : family.gauges) {
+            out += name + Braced(series.first) + " " + std::to_string(series.second->Get()) + "\n";
+        }
+        for (auto &callback : family.callbacks) {
+            out += name + Braced(callback.second.first) + " " + FormatValue(callback.second.second()) + "\n";
+        }
+    }
+    return out;
+}
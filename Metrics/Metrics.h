@@ -0,0 +1,131 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_METRICS_H
+#define STREAM_PULL_SAMPLE_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+enum MetricType {
+    METRIC_COUNTER = 0,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+};
+
+// Latency histogram with fixed buckets from 50us to 2.5s. Observe is a couple of relaxed atomic adds,
+// safe from any thread without a lock; readers see a consistent-enough view for scraping.
+class LatencyHistogram {
+public:
+    static const uint32_t BUCKET_NUM = 18;
+    // upper bound of every bucket in microseconds, the last one is +Inf
+    static const uint64_t BUCKET_BOUNDS_US[BUCKET_NUM];
+
+    LatencyHistogram();
+    void Observe(uint64_t us);
+    void ObserveSince(const std::chrono::steady_clock::time_point &start);
+    uint64_t GetCount() const;
+    uint64_t GetSumUs() const;
+    // cumulative count of bucket i, as exported
+    uint64_t GetCumulativeCount(uint32_t bucket) const;
+    // upper bucket bound holding the q-th quantile, in microseconds
+    uint64_t Quantile(double q) const;
+private:
+    std::atomic<uint64_t> buckets[BUCKET_NUM];
+    std::atomic<uint64_t> sumUs;
+};
+
+class MetricCounter {
+public:
+    MetricCounter() : value(0) {}
+    void Add(uint64_t n = 1)
+    {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t Get() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+private:
+    std::atomic<uint64_t> value;
+};
+
+class MetricGauge {
+public:
+    MetricGauge() : value(0) {}
+    void Set(int64_t v)
+    {
+        value.store(v, std::memory_order_relaxed);
+    }
+    void Add(int64_t n)
+    {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+    int64_t Get() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+private:
+    std::atomic<int64_t> value;
+};
+
+// label set in exposition syntax: stream="0",stage="resize"
+std::string MetricLabels(const std::vector<std::pair<std::string, std::string>> &labels);
+std::string JoinMetricLabels(const std::string &first, const std::string &second);
+
+// Process-wide metric families. Lookups take a mutex and are meant for setup: hot paths keep the
+// returned pointer, which stays valid for the life of the process. Callback metrics are sampled at
+// scrape time and must be unregistered before what they read goes away.
+class MetricsRegistry {
+public:
+    static MetricsRegistry *GetInstance();
+
+    LatencyHistogram *GetHistogram(const std::string &name, const std::string &help, const std::string &labels);
+    MetricCounter *GetCounter(const std::string &name, const std::string &help, const std::string &labels);
+    MetricGauge *GetGauge(const std::string &name, const std::string &help, const std::string &labels);
+    uint64_t RegisterCallback(const std::string &name, const std::string &help, MetricType type,
+                              const std::string &labels, std::function<double()> callback);
+    void Unregister(uint64_t callbackId);
+    // Prometheus text exposition format 0.0.4
+    std::string Render();
+private:
+    MetricsRegistry() = default;
+    struct Family {
+        MetricType type;
+        std::string help;
+        std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+        std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+        std::map<std::string, std::unique_ptr<MetricGauge>> gauges;
+        std::map<uint64_t, std::pair<std::string, std::function<double()>>> callbacks;
+    };
+    Family &GetFamily(const std::string &name, const std::string &help, MetricType type);
+    void RenderHistogram(const std::string &name, const std::string &labels, const LatencyHistogram &histogram,
+                         std::string &out);
+private:
+    std::mutex mutex;
+    std::map<std::string, Family> families;
+    uint64_t nextCallbackId = 1;
+};
+
+#endif // STREAM_PULL_SAMPLE_METRICS_H
@@ -0,0 +1,157 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "MxBase/Log/Log.h"
+#include "Metrics.h"
+#include "MemoryTracker.h"
+#include "MetricsServer.h"
+
+namespace {
+    const int ACCEPT_POLL_TIMEOUT_MS = 200;
+    const int CLIENT_TIMEOUT_S = 1;
+    const int LISTEN_BACKLOG = 4;
+    const size_t MAX_REQUEST_SIZE = 4096;
+
+    void SendAll(int sock, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            sent += (size_t)n;
+        }
+    }
+
+    std::string Response(const char *status, const char *contentType, const std::string &body)
+    {
+        return std::string("HTTP/1.0 ") + status + "\r\nContent-Type: " + contentType +
+               "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    }
+}
+
+MetricsServer::~MetricsServer()
+{
+    Stop();
+}
+
+APP_ERROR MetricsServer::Start(const std::string &bindAddr, uint16_t port)
+{
+    if (running) {
+        return APP_ERR_OK;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, bindAddr.c_str(), &addr.sin_addr) != 1) {
+        LogError << "Invalid metrics bind address: " << bindAddr;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    listenSock = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSock < 0) {
+        LogError << "Failed to create metrics socket";
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    int reuse = 1;
+    setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(listenSock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenSock, LISTEN_BACKLOG) != 0) {
+        LogError << "Failed to listen on " << bindAddr << ":" << port << " for metrics: " << strerror(errno);
+        close(listenSock);
+        listenSock = -1;
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    running = true;
+    worker = std::thread(&MetricsServer::Serve, this);
+    LogInfo << "metrics on http://" << bindAddr << ":" << port << "/metrics";
+    return APP_ERR_OK;
+}
+
+void MetricsServer::Stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    close(listenSock);
+    listenSock = -1;
+}
+
+void MetricsServer::Serve()
+{
+    struct pollfd fd;
+    fd.fd = listenSock;
+    fd.events = POLLIN;
+    while (running) {
+        // poll with a timeout so Stop() is noticed without closing the socket under accept()
+        if (poll(&fd, 1, ACCEPT_POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+        int sock = accept(listenSock, nullptr, nullptr);
+        if (sock < 0) {
+            continue;
+        }
+        HandleConnection(sock);
+        close(sock);
+    }
+}
+
+void MetricsServer::HandleConnection(int sock)
+{
+    struct timeval timeout;
+    timeout.tv_sec = CLIENT_TIMEOUT_S;
+    timeout.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buf[512];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        request.append(buf, (size_t)n);
+    }
+    size_t lineEnd = request.find("\r\n");
+    std::string line = request.substr(0, lineEnd);
+    if (line.compare(0, 4, "GET ") != 0) {
+        SendAll(sock, Response("405 Method Not Allowed", "text/plain", "GET only\n"));
+        return;
+    }
+    std::string path = line.substr(4, line.find(' ', 4) - 4);
+    if (path == "/memory") {
+        SendAll(sock, Response("200 OK", "text/plain", MemoryTracker::GetInstance()->Dump()));
+        return;
+    }
+    if (path != "/metrics" && path.compare(0, 9, "/metrics?") != 0) {
+        SendAll(sock, Response("404 Not Found", "text/plain", "try /metrics or /memory\n"));
+        return;
+    }
+    SendAll(sock, Response("200 OK", "text/plain; version=0.0.4",
+                           MetricsRegistry::GetInstance()->Render()));
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_METRICSSERVER_H
+#define STREAM_PULL_SAMPLE_METRICSSERVER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+
+static const char *const DEFAULT_METRICS_BIND = "127.0.0.1";
+
+// Minimal HTTP/1.0 server answering GET /metrics with MetricsRegistry::Render() and GET /memory with
+// MemoryTracker::Dump(). One thread, one request per connection: it is scraped every few seconds,
+// not a general purpose web server.
+class MetricsServer {
+public:
+    MetricsServer() = default;
+    ~MetricsServer();
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    APP_ERROR Start(const std::string &bindAddr, uint16_t port);
+    void Stop();
+private:
+    void Serve();
+    void HandleConnection(int sock);
+private:
+    int listenSock = -1;
+    std::thread worker;
+    std::atomic<bool> running{false};
+};
+
+#endif // STREAM_PULL_SAMPLE_METRICSSERVER_H
@@ -0,0 +1,86 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include "MxBase/Log/Log.h"
+#include "StartupTimeline.h"
+
+StartupTimeline *StartupTimeline::GetInstance()
+{
+    static StartupTimeline timeline;
+    return &timeline;
+}
+
+StartupTimeline::StartupTimeline() : origin(Clock::now()), readyTime(origin) {}
+
+void StartupTimeline::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    origin = Clock::now();
+    readyTime = origin;
+    steps.clear();
+    firstResultStreams.clear();
+}
+
+void StartupTimeline::AddStep(const std::string &name, const Clock::time_point &start, const Clock::time_point &end)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    steps.push_back({name, start, end});
+}
+
+double StartupTimeline::SinceOriginMs(const Clock::time_point &time) const
+{
+    return std::chrono::duration<double, std::milli>(time - origin).count();
+}
+
+void StartupTimeline::Report()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    readyTime = Clock::now();
+    std::vector<Step> sorted(steps);
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Step &a, const Step &b) {
+        return a.start < b.start;
+    });
+    // 各步骤并行执行时，起始偏移相同的步骤即为同时进行
+    LogInfo << "startup timeline (offset from process start, duration):";
+    for (const auto &step : sorted) {
+        char line[160];
+        snprintf(line, sizeof(line), "  +%8.1f ms %8.1f ms  %s", SinceOriginMs(step.start),
+                 std::chrono::duration<double, std::milli>(step.end - step.start).count(), step.name.c_str());
+        LogInfo << line;
+    }
+    LogInfo << "startup finished after " << SinceOriginMs(readyTime) << " ms";
+}
+
+void StartupTimeline::MarkFirstResult(uint32_t streamId)
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(firstResultStreams.begin(), firstResultStreams.end(), streamId) != firstResultStreams.end()) {
+        return;
+    }
+    firstResultStreams.push_back(streamId);
+    LogInfo << "stream " << streamId << " first result after " << SinceOriginMs(now) << " ms ("
+            << std::chrono::duration<double, std::milli>(now - readyTime).count() << " ms after startup)";
+}
+
+StartupStep::StartupStep(const std::string &name) : name(name), start(StartupTimeline::Clock::now()) {}
+
+StartupStep::~StartupStep()
+{
+    StartupTimeline::GetInstance()->AddStep(name, start, StartupTimeline::Clock::now());
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_STARTUPTIMELINE_H
+#define STREAM_PULL_SAMPLE_STARTUPTIMELINE_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Startup steps (device init, model load, warm-up, stream open) with their offset from process start
+// and duration, plus the time until each stream emits its first result. Steps may be recorded from
+// any thread; the whole timeline is logged once by Report.
+class StartupTimeline {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static StartupTimeline *GetInstance();
+
+    // time zero of the timeline, first thing in main
+    void Reset();
+    void AddStep(const std::string &name, const Clock::time_point &start, const Clock::time_point &end);
+    // every recorded step in start order, and the total so far
+    void Report();
+    // logged at the first result of every stream, later calls for the same stream do nothing
+    void MarkFirstResult(uint32_t streamId);
+private:
+    struct Step {
+        std::string name;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+    StartupTimeline();
+    double SinceOriginMs(const Clock::time_point &time) const;
+private:
+    std::mutex mutex;
+    Clock::time_point origin;
+    Clock::time_point readyTime;
+    std::vector<Step> steps;
+    std::vector<uint32_t> firstResultStreams;
+};
+
+// records its own lifetime as one startup step
+class StartupStep {
+public:
+    explicit StartupStep(const std::string &name);
+    ~StartupStep();
+    StartupStep(const StartupStep &) = delete;
+    StartupStep &operator=(const StartupStep &) = delete;
+private:
+    std::string name;
+    StartupTimeline::Clock::time_point start;
+};
+
+#endif // STREAM_PULL_SAMPLE_STARTUPTIMELINE_H
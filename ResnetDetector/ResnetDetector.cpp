@@ -14,14 +14,18 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include "ResnetDetector.h"
-#include "MxBase/Tensor/TensorContext/TensorContext.h"
-
+#include "MxBase/Log/Log.h"
+#include "../AsyncLogger/AsyncLogger.h"
+#include "../Metrics/MemoryTracker.h"
 
 namespace {
-    const uint32_t YUV_BYTE_NU = 3;
-    const uint32_t YUV_BYTE_DE = 2;
-    const uint32_t VPC_H_ALIGN = 2;
+    const uint32_t TENSOR_POOL_WAIT_TIME = 1000;
+    // per-launch timing is in the keypoints stage histogram, the log only samples it
+    const uint32_t INFERENCE_LOG_INTERVAL = 100;
+    // keypoint input when neither the model nor the configuration gives one
+    const uint32_t DEFAULT_NET_SIZE = 256;
 }
 
 APP_ERROR ResnetDetector::Init(const ResnetInitParam &initParam)
@@ -29,20 +33,8 @@ APP_ERROR ResnetDetector::Init(const ResnetInitParam &initParam)
     LogDebug << "ResnetDetector init start.";
     this->deviceId = initParam.deviceId;
 
-    // set tensor context
-    APP_ERROR ret = MxBase::TensorContext::GetInstance()->SetContext(initParam.deviceId);
-    if (ret != APP_ERR_OK) {
-        LogError << "Set tensor context failed, ret = " << ret << ".";
-        return ret;
-    }
-    rDvppWrapper = std::make_shared<MxBase::DvppWrapper>();
-    ret = rDvppWrapper->Init();
-    if (ret != APP_ERR_OK) {
-        LogError << "DvppWrapper init failed, ret=" << ret << ".";
-        return ret;
-    }
     // Init Resnet model
-    ret = InitModel(initParam);
+    APP_ERROR ret = InitModel(initParam);
     if (ret != APP_ERR_OK) {
         LogError << "init model failed.";
         return ret;
@@ -55,12 +47,19 @@ APP_ERROR ResnetDetector::DeInit()
 {
     LogDebug << "ResnetDetector deinit start.";
 
-    APP_ERROR ret = model->DeInit();
+    outputPool.DeInit();
+    {
+        std::lock_guard<std::mutex> lock(keypointMutex);
+        if (keypointHost.ptrData != nullptr) {
+            MemoryTracker::GetInstance()->Free(keypointHost);
+            keypointHost = MxBase::MemoryData();
+        }
+    }
+    APP_ERROR ret = backend->DeInit();
     if (ret != APP_ERR_OK) {
         LogError << "deinit model failed";
         return ret;
     }
-    rDvppWrapper->DeInit();
     LogDebug << "ResnetDetector deinit successful.";
     return APP_ERR_OK;
 }
@@ -70,17 +69,63 @@ APP_ERROR ResnetDetector::Process()
     return APP_ERR_OK;
 }
 
+APP_ERROR ResnetDetector::Warmup(const FrameGeometry &geometry)
+{
+    std::shared_ptr<MxBase::MemoryData> frame;
+    APP_ERROR ret = CreateWarmupFrame(backend->GetType(), deviceId, geometry, frame);
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to create the warm-up frame, ret=" << ret << ".";
+        return ret;
+    }
+    // 中心区域裁剪一次，单手和满批次各推理一次，两种launch都提前完成初始化
+    const uint32_t quarter = 4;
+    InputTensorHandle crop;
+    const uint32_t width = geometry.width;
+    const uint32_t height = geometry.height;
+    ret = CropAndResizeFrame(frame, geometry, width / quarter, height / quarter, width - width / quarter,
+                             height - height / quarter, crop);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    std::vector<std::vector<float>> keypoints;
+    ret = BatchInference({*crop}, keypoints);
+    if (ret != APP_ERR_OK || backend->GetMaxBatchSize() <= 1) {
+        return ret;
+    }
+    std::vector<MxBase::TensorBase> crops(backend->GetMaxBatchSize(), *crop);
+    return BatchInference(crops, keypoints);
+}
+
 /// ========== private Method ========== ///
 
 APP_ERROR ResnetDetector::InitModel(const ResnetInitParam &initParam)
 {
     LogDebug << "ResnetDetector init model start.";
-    model = std::make_shared<MxBase::ModelInferenceProcessor>();
-    LogInfo << "model path: " << initParam.modelPath;
+    BackendInitParam backendParam;
+    backendParam.type = initParam.backendType;
+    backendParam.deviceId = initParam.deviceId;
+    backendParam.modelPath = initParam.modelPath;
+    backendParam.inputHeight = initParam.inputHeight;
+    backendParam.inputWidth = initParam.inputWidth;
+    if (initParam.backendType == BACKEND_CPU && (initParam.inputHeight == 0 || initParam.inputWidth == 0)) {
+        backendParam.inputHeight = DEFAULT_NET_SIZE;
+        backendParam.inputWidth = DEFAULT_NET_SIZE;
+    }
+    backendParam.inputScale = initParam.inputScale;
+    backendParam.maxBatchSize = initParam.maxBatchSize;
+    backendParam.batchPoolSize = initParam.outputPoolSize;
+    backend = CreateInferenceBackend(initParam.backendType);
 
-    APP_ERROR ret = model->Init(initParam.modelPath, modelDesc);
+    APP_ERROR ret = backend->Init(backendParam);
     if (ret != APP_ERR_OK) {
-        LogError << "ModelInferenceProcessor init failed, ret=" << ret << ".";
+        LogError << "Inference backend init failed, ret=" << ret << ".";
+        return ret;
+    }
+    backend->GetInputSize(netHeight, netWidth);
+    ret = outputPool.Init(backend->GetOutputDescs(), backend->GetOutputMemoryType(), deviceId,
+                          initParam.outputPoolSize);
+    if (ret != APP_ERR_OK) {
+        LogError << "Output tensor pool init failed, ret=" << ret << ".";
         return ret;
     }
 
@@ -90,7 +135,7 @@ APP_ERROR ResnetDetector::InitModel(const ResnetInitParam &initParam)
 
 
 APP_ERROR ResnetDetector::Inference(const std::vector<MxBase::TensorBase> &inputs,
-                                    std::vector<MxBase::TensorBase> &outputs)
+                                    OutputTensorHandle &outputs)
 {
     APP_ERROR ret;
 
@@ -100,39 +145,23 @@ APP_ERROR ResnetDetector::Inference(const std::vector<MxBase::TensorBase> &input
         return APP_ERR_FAILURE;
     }
 
-    auto dtypes = model->GetOutputDataType();
-    for (size_t i = 0; i < modelDesc.outputTensors.size(); ++i) {
-        std::vector<uint32_t> shape = {};
-        for (size_t j = 0; j < modelDesc.outputTensors[i].tensorDims.size(); ++j) {
-            shape.push_back((uint32_t)modelDesc.outputTensors[i].tensorDims[j]);
-        }
-
-        MxBase::TensorBase tensor(shape, dtypes[i], MxBase::MemoryData::MemoryType::MEMORY_DVPP, deviceId);
-        ret = MxBase::TensorBase::TensorBaseMalloc(tensor);
-        if (ret != APP_ERR_OK) {
-            LogError << "TensorBaseMalloc failed, ret = " << ret << ".";
-            return ret;
-        }
-
-        outputs.push_back(tensor);
+    ret = outputPool.Acquire(outputs, TENSOR_POOL_WAIT_TIME);
+    if (ret != APP_ERR_OK) {
+        return ret;
     }
 
-    LogInfo << outputs[0].GetDesc();
-
-    MxBase::DynamicInfo dynamicInfo = {};
-    dynamicInfo.dynamicType = MxBase::DynamicType::STATIC_BATCH;
-
     // model infer
     auto startTime = std::chrono::high_resolution_clock::now();
-    ret = model->ModelInference(inputs, outputs, dynamicInfo);
+    ret = backend->Inference(inputs, *outputs);
     auto endTime = std::chrono::high_resolution_clock::now();
     double costMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
-    LogInfo << "model inference time: " << costMs;
+    HotLogEvery(HOT_LOG_LEVEL_INFO, INFERENCE_LOG_INTERVAL) << "model inference time: " << costMs;
 
     if (ret != APP_ERR_OK) {
-        LogError << "ModelInference failed, ret=" << ret << ".";
+        LogError << "Inference failed, ret=" << ret << ".";
         return ret;
     }
+    HotLogDebug << (*outputs)[0].GetDesc();
 
     return APP_ERR_OK;
 }
@@ -140,56 +169,112 @@ APP_ERROR ResnetDetector::Inference(const std::vector<MxBase::TensorBase> &input
 
 
 
-APP_ERROR ResnetDetector::CropAndResizeFrame(const std::shared_ptr<MxBase::MemoryData> frameInfo,
-                                    const uint32_t &height,const uint32_t &width, 
-                                    const uint32_t &x0,const uint32_t &y0,const uint32_t &x1,const uint32_t &y1,
-                                    MxBase::TensorBase &tensor)
+APP_ERROR ResnetDetector::BatchInference(const std::vector<MxBase::TensorBase> &crops,
+                                         std::vector<std::vector<float>> &keypoints)
 {
-    // 视频帧的原始数据
-    MxBase::DvppDataInfo input = {};
-    input.height = height;
-    input.width = width;
-    input.heightStride = height;
-    input.widthStride = width;
-    input.dataSize = frameInfo->size;
-    input.data = (uint8_t*)frameInfo->ptrData;
-
-    const uint32_t resizeHeight = 256;
-    const uint32_t resizeWidth = 256;
-    MxBase::CropRoiConfig crop = {};
-    crop.x0=x0;
-    crop.x1=x1;
-    crop.y0=y0;
-    crop.y1=y1;
-    MxBase::ResizeConfig resize = {};
-    resize.height = resizeHeight;
-    resize.width = resizeWidth;
-    MxBase::DvppDataInfo tmp;
-    MxBase::DvppDataInfo output;
-
-
-    // 图像缩放
-    APP_ERROR ret = rDvppWrapper->VpcCrop(input, tmp,crop);
-    if(ret != APP_ERR_OK){
-        LogError << GetError(ret) << "VpcCrop failed.";
-        return ret;
+    keypoints.clear();
+    size_t maxBatch = batchDisabled ? 1 : backend->GetMaxBatchSize();
+    size_t offset = 0;
+    while (offset < crops.size()) {
+        size_t count = std::min(maxBatch, crops.size() - offset);
+        if (count > 1) {
+            std::vector<MxBase::TensorBase> samples(crops.begin() + offset, crops.begin() + offset + count);
+            OutputTensorHandle outputs;
+            auto startTime = std::chrono::high_resolution_clock::now();
+            APP_ERROR ret = backend->BatchInference(samples, outputs);
+            auto endTime = std::chrono::high_resolution_clock::now();
+            if (ret == APP_ERR_OK) {
+                HotLogEvery(HOT_LOG_LEVEL_INFO, INFERENCE_LOG_INTERVAL) << "model inference time: "
+                    << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " for " << count
+                    << " hands";
+                ret = CopyKeypoints((*outputs)[0], count, keypoints);
+                if (ret != APP_ERR_OK) {
+                    return ret;
+                }
+                offset += count;
+                continue;
+            }
+            if (ret == APP_ERR_COMM_OUT_OF_RANGE) {
+                // 模型不接受该批次形状，之后的帧都逐手推理
+                LogWarn << "Model rejects a batch of " << count << " hands, using one launch per hand from now on";
+                batchDisabled = true;
+            } else {
+                HotLogRate(HOT_LOG_LEVEL_WARN, 1) << "Batched keypoint inference failed, ret=" << ret
+                                                  << ", launching these hands one by one";
+            }
+            maxBatch = 1;
+        }
+        // 单手推理
+        std::vector<MxBase::TensorBase> inputs = {crops[offset]};
+        OutputTensorHandle outputs;
+        APP_ERROR ret = Inference(inputs, outputs);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        ret = CopyKeypoints((*outputs)[0], 1, keypoints);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        offset++;
     }
-    ret = rDvppWrapper->VpcResize(tmp, output,resize);
-    if(ret != APP_ERR_OK){
-        LogError << GetError(ret) << "VpcCrop failed.";
-        return ret;
-    }    
-
-    // 缩放后的图像信息
-    MxBase::MemoryData outMemoryData((void*)output.data, output.dataSize, MxBase::MemoryData::MEMORY_DVPP, deviceId);
-    // 对缩放后图像对齐尺寸进行判定
-    if (output.heightStride % VPC_H_ALIGN != 0) {
-        LogError << "Output data height(" << output.heightStride << ") can't be divided by " << VPC_H_ALIGN << ".";
-        MxBase::MemoryHelper::MxbsFree(outMemoryData);
+    return APP_ERR_OK;
+}
+
+APP_ERROR ResnetDetector::CopyKeypoints(const MxBase::TensorBase &output, size_t rows,
+                                        std::vector<std::vector<float>> &keypoints)
+{
+    std::vector<uint32_t> shape = output.GetShape();
+    size_t batch = shape.empty() ? 1 : shape[0];
+    if (output.GetDataType() != MxBase::TENSOR_DTYPE_FLOAT32 || batch < rows || batch == 0) {
+        LogError << "Unexpected keypoint output, dtype " << output.GetDataType() << ", batch " << batch;
         return APP_ERR_COMM_INVALID_PARAM;
     }
-    std::vector<uint32_t> shape = {output.heightStride * YUV_BYTE_NU / YUV_BYTE_DE, output.widthStride};
-    tensor = MxBase::TensorBase(outMemoryData, false, shape, MxBase::TENSOR_DTYPE_UINT8);
-
+    size_t rowSize = output.GetSize() / batch;
+    if (backend->GetOutputMemoryType() == MxBase::MemoryData::MEMORY_HOST_NEW) {
+        // CPU后端的输出已在Host侧，直接读取
+        const float *data = (const float*)output.GetBuffer();
+        for (size_t r = 0; r < rows; r++) {
+            keypoints.emplace_back(data + r * rowSize, data + (r + 1) * rowSize);
+        }
+        return APP_ERR_OK;
+    }
+    // 推理结果从Device侧拷贝到Host侧，Host缓冲区按最大批次保留复用
+    std::lock_guard<std::mutex> lock(keypointMutex);
+    if (keypointHost.size < output.GetByteSize()) {
+        if (keypointHost.ptrData != nullptr) {
+            MemoryTracker::GetInstance()->Free(keypointHost);
+        }
+        keypointHost = MxBase::MemoryData(output.GetByteSize(), MxBase::MemoryData::MEMORY_HOST_NEW);
+        APP_ERROR ret = MemoryTracker::GetInstance()->Malloc(keypointHost, "keypoint host copy");
+        if (ret != APP_ERR_OK) {
+            LogError << "Fail to malloc host memory.";
+            keypointHost = MxBase::MemoryData();
+            return ret;
+        }
+    }
+    MxBase::MemoryData src(output.GetBuffer(), output.GetByteSize(), backend->GetOutputMemoryType(), deviceId);
+    APP_ERROR ret = MxBase::MemoryHelper::MxbsMemcpy(keypointHost, src, output.GetByteSize());
+    if (ret != APP_ERR_OK) {
+        LogError << "Fail to copy keypoints to host memory, ret=" << ret << ".";
+        return ret;
+    }
+    const float *data = (const float*)keypointHost.ptrData;
+    for (size_t r = 0; r < rows; r++) {
+        keypoints.emplace_back(data + r * rowSize, data + (r + 1) * rowSize);
+    }
     return APP_ERR_OK;
-}
\ No newline at end of file
+}
+
+APP_ERROR ResnetDetector::CropAndResizeFrame(const std::shared_ptr<MxBase::MemoryData> frameInfo,
+                                    const FrameGeometry &geometry,
+                                    const uint32_t &x0,const uint32_t &y0,const uint32_t &x1,const uint32_t &y1,
+                                    InputTensorHandle &tensor)
+{
+    MxBase::CropRoiConfig crop = {};
+    crop.x0 = x0;
+    crop.x1 = x1;
+    crop.y0 = y0;
+    crop.y1 = y1;
+    // 图像裁剪并缩放
+    return backend->CropAndResize(frameInfo, geometry, crop, netHeight, netWidth, tensor);
+}
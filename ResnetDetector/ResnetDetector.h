@@ -17,17 +17,31 @@
 #ifndef VIDEOGESTURERECOGNITION_RESNET_DETECTOR_H
 #define VIDEOGESTURERECOGNITION_RESNET_DETECTOR_H
 
+#include <atomic>
+#include <mutex>
 #include "MxBase/ErrorCode/ErrorCode.h"
 #include "MxBase/DvppWrapper/DvppWrapper.h"
 #include "MxBase/ModelInfer/ModelInferenceProcessor.h"
 #include "ClassPostProcessors/Resnet50PostProcess.h"
 #include "../BlockingQueue/BlockingQueue.h"
+#include "../InferenceBackend/InferenceBackend.h"
+#include "../InferenceBackend/TensorPool.h"
 
 
 struct ResnetInitParam {
     uint32_t deviceId = 0;
     std::string modelPath;
     uint32_t classNum = 0;
+    BackendType backendType = BACKEND_ASCEND;
+    // keypoint input size, 0 takes the .om model's own size (256 on the CPU backend)
+    uint32_t inputHeight = 0;
+    uint32_t inputWidth = 0;
+    // CPU backend input normalization
+    double inputScale = 1.0 / 255;
+    // output tensor sets recycled between frames
+    uint32_t outputPoolSize = DEFAULT_TENSOR_POOL_SIZE;
+    // hands packed into one launch on the CPU backend, the .om model brings its own batch gears
+    uint32_t maxBatchSize = 1;
 };
 
 class ResnetDetector {
@@ -38,26 +52,36 @@ public:
     APP_ERROR Init(const ResnetInitParam & initParam);
     APP_ERROR DeInit();
     APP_ERROR Process();
+    // a single-crop and a full-batch launch on a gray frame of the stream size, before the first real frame
+    APP_ERROR Warmup(const FrameGeometry &geometry);
     APP_ERROR CropAndResizeFrame(const std::shared_ptr<MxBase::MemoryData> frameInfo,
-                                    const uint32_t &height,const uint32_t &width, 
+                                    const FrameGeometry &geometry,
                                     const uint32_t &x0,const uint32_t &y0,const uint32_t &x1,const uint32_t &y1,
-                                    MxBase::TensorBase &tensor);
-    APP_ERROR Inference(const std::vector<MxBase::TensorBase> &inputs, std::vector<MxBase::TensorBase> &outputs);
+                                    InputTensorHandle &tensor);
+    APP_ERROR Inference(const std::vector<MxBase::TensorBase> &inputs, OutputTensorHandle &outputs);
+    // keypoints of every crop as normalized (x, y) pairs, in crop order. Crops are packed into as few
+    // launches as the model's batch allows. A failed batched launch is retried one crop at a time; a model
+    // that rejects the batch shape (APP_ERR_COMM_OUT_OF_RANGE) gets one launch per crop from then on.
+    APP_ERROR BatchInference(const std::vector<MxBase::TensorBase> &crops, std::vector<std::vector<float>> &keypoints);
 private:
     APP_ERROR InitModel(const ResnetInitParam &initParam);
+    APP_ERROR CopyKeypoints(const MxBase::TensorBase &output, size_t rows, std::vector<std::vector<float>> &keypoints);
 private:
-    // model
-    std::shared_ptr<MxBase::ModelInferenceProcessor> model;
-    // infer result post process
-    MxBase::ModelDesc modelDesc = {};
+    // model load, preprocessing and inference
+    std::shared_ptr<InferenceBackend> backend;
+    // keypoint output tensors, allocated once at init
+    TensorPool outputPool;
+    // set once the model rejected a batch shape, later frames go straight to per-crop launches
+    std::atomic<bool> batchDisabled{false};
+    // host copy of the keypoint outputs, grown to the largest batch seen and reused by every launch
+    MxBase::MemoryData keypointHost;
+    std::mutex keypointMutex;
     // device id
     uint32_t deviceId = 1;
-    // network width
-    uint32_t const netWidth = 256;
-    // network height
-    uint32_t const netHeight = 256;
-
-    std::shared_ptr<MxBase::DvppWrapper> rDvppWrapper;
+    // network width, from the model after Init
+    uint32_t netWidth = 0;
+    // network height, from the model after Init
+    uint32_t netHeight = 0;
 };
 
 #endif // VIDEOGESTURERECOGNITION_RESNET_DETECTOR_H
@@ -0,0 +1,195 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include "ResultProtocol.h"
+
+namespace {
+    const float CONFIDENCE_SCALE = 65535.0f;
+
+    void Put16(uint8_t *p, uint16_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+
+    void Put32(uint8_t *p, uint32_t v)
+    {
+        Put16(p, (uint16_t)v);
+        Put16(p + 2, (uint16_t)(v >> 16));
+    }
+
+    void Put64(uint8_t *p, uint64_t v)
+    {
+        Put32(p, (uint32_t)v);
+        Put32(p + 4, (uint32_t)(v >> 32));
+    }
+
+    uint16_t Get16(const uint8_t *p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    uint32_t Get32(const uint8_t *p)
+    {
+        return Get16(p) | ((uint32_t)Get16(p + 2) << 16);
+    }
+
+    uint64_t Get64(const uint8_t *p)
+    {
+        return Get32(p) | ((uint64_t)Get32(p + 4) << 32);
+    }
+
+    size_t HandCount(const ResultPacket &packet)
+    {
+        return std::min(packet.hands.size(), (size_t)RESULT_MAX_HANDS);
+    }
+
+    size_t HandRecordSize(uint32_t keypointNum)
+    {
+        return RESULT_HAND_FIXED_SIZE + 4 * (size_t)keypointNum;
+    }
+
+    size_t FaceCount(const ResultPacket &packet)
+    {
+        size_t room = (RESULT_MAX_DATAGRAM_SIZE - RESULT_HEADER_SIZE - HandCount(packet) *
+                       HandRecordSize(RESULT_KEYPOINT_NUM)) / RESULT_FACE_SIZE;
+        return std::min(std::min(packet.faces.size(), (size_t)RESULT_MAX_FACES), room);
+    }
+
+    uint16_t EncodeConfidence(float confidence)
+    {
+        return (uint16_t)(std::min(std::max(confidence, 0.0f), 1.0f) * CONFIDENCE_SCALE + 0.5f);
+    }
+}
+
+size_t ResultPacketSize(const ResultPacket &packet)
+{
+    return RESULT_HEADER_SIZE + HandCount(packet) * HandRecordSize(RESULT_KEYPOINT_NUM) +
+           FaceCount(packet) * RESULT_FACE_SIZE;
+}
+
+size_t EncodeResultPacket(const ResultPacket &packet, uint8_t *buf, size_t size)
+{
+    size_t total = ResultPacketSize(packet);
+    if (buf == nullptr || size < total) {
+        return 0;
+    }
+    size_t handCount = HandCount(packet);
+    Put16(buf, RESULT_MAGIC);
+    buf[2] = RESULT_VERSION;
+    buf[3] = (uint8_t)RESULT_HEADER_SIZE;
+    Put16(buf + 4, packet.streamId);
+    buf[6] = (uint8_t)handCount;
+    buf[7] = (uint8_t)RESULT_KEYPOINT_NUM;
+    Put32(buf + 8, packet.sequence);
+    Put32(buf + 12, packet.frameId);
+    Put64(buf + 16, (uint64_t)packet.captureUs);
+    Put64(buf + 24, (uint64_t)packet.sendUs);
+    size_t faceCount = FaceCount(packet);
+    buf[32] = (uint8_t)faceCount;
+    buf[33] = 0;
+    buf[34] = 0;
+    buf[35] = 0;
+    uint8_t *p = buf + RESULT_HEADER_SIZE;
+    for (size_t i = 0; i < handCount; i++) {
+        const ResultHand &hand = packet.hands[i];
+        Put16(p, hand.x0);
+        Put16(p + 2, hand.y0);
+        Put16(p + 4, hand.x1);
+        Put16(p + 6, hand.y1);
+        Put16(p + 8, EncodeConfidence(hand.confidence));
+        p[10] = hand.flags;
+        p[11] = hand.gesture;
+        p += RESULT_HAND_FIXED_SIZE;
+        // missing keypoints are sent as (0, 0)
+        for (uint32_t k = 0; k < RESULT_KEYPOINT_NUM * 2; k++, p += 2) {
+            Put16(p, k < hand.keypoints.size() ? hand.keypoints[k] : 0);
+        }
+    }
+    for (size_t i = 0; i < faceCount; i++, p += RESULT_FACE_SIZE) {
+        const ResultFace &face = packet.faces[i];
+        Put16(p, face.x0);
+        Put16(p + 2, face.y0);
+        Put16(p + 4, face.x1);
+        Put16(p + 6, face.y1);
+        Put16(p + 8, EncodeConfidence(face.confidence));
+    }
+    return total;
+}
+
+bool DecodeResultPacket(const uint8_t *buf, size_t size, ResultPacket &packet)
+{
+    if (buf == nullptr || size < RESULT_BASE_HEADER_SIZE || Get16(buf) != RESULT_MAGIC ||
+        buf[2] != RESULT_VERSION) {
+        return false;
+    }
+    // a longer header or longer records come from a newer sender that appended fields: skip them
+    size_t headerSize = buf[3];
+    uint32_t handCount = buf[6];
+    uint32_t keypointNum = buf[7];
+    size_t recordSize = HandRecordSize(keypointNum);
+    // senders from before faces have the base header and no face count
+    uint32_t faceCount = headerSize > RESULT_BASE_HEADER_SIZE ? buf[RESULT_BASE_HEADER_SIZE] : 0;
+    if (headerSize < RESULT_BASE_HEADER_SIZE ||
+        size < headerSize + handCount * recordSize + faceCount * RESULT_FACE_SIZE) {
+        return false;
+    }
+    packet.streamId = Get16(buf + 4);
+    packet.sequence = Get32(buf + 8);
+    packet.frameId = Get32(buf + 12);
+    packet.captureUs = (int64_t)Get64(buf + 16);
+    packet.sendUs = (int64_t)Get64(buf + 24);
+    packet.hands.resize(handCount);
+    const uint8_t *p = buf + headerSize;
+    for (uint32_t i = 0; i < handCount; i++, p += recordSize) {
+        ResultHand &hand = packet.hands[i];
+        hand.x0 = Get16(p);
+        hand.y0 = Get16(p + 2);
+        hand.x1 = Get16(p + 4);
+        hand.y1 = Get16(p + 6);
+        hand.confidence = Get16(p + 8) / CONFIDENCE_SCALE;
+        hand.flags = p[10];
+        hand.gesture = p[11];
+        hand.keypoints.resize(keypointNum * 2);
+        for (uint32_t k = 0; k < keypointNum * 2; k++) {
+            hand.keypoints[k] = Get16(p + RESULT_HAND_FIXED_SIZE + k * 2);
+        }
+    }
+    packet.faces.resize(faceCount);
+    for (uint32_t i = 0; i < faceCount; i++, p += RESULT_FACE_SIZE) {
+        ResultFace &face = packet.faces[i];
+        face.x0 = Get16(p);
+        face.y0 = Get16(p + 2);
+        face.x1 = Get16(p + 4);
+        face.y1 = Get16(p + 6);
+        face.confidence = Get16(p + 8) / CONFIDENCE_SCALE;
+    }
+    return true;
+}
+
+int64_t ResultWallClockUs()
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char *GestureName(uint8_t gesture)
+{
+    static const char *names[GESTURE_NUM] = {"none", "open_hand", "fist", "thumbs_up", "pointing", "victory"};
+    return gesture < GESTURE_NUM ? names[gesture] : "unknown";
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_RESULTPROTOCOL_H
+#define STREAM_PULL_SAMPLE_RESULTPROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Keypoint result datagram, version 2. Only needs the C++ standard library, so clients can build
+// it (and ResultReceiver) without the Ascend SDK. All fields are little-endian.
+//
+// header, RESULT_HEADER_SIZE bytes:
+//   0  u16 magic 0x4b48 ("HK")       2  u8  version (2)          3  u8  header size
+//   4  u16 stream id                 6  u8  hand count           7  u8  keypoints per hand
+//   8  u32 sequence, per stream, +1 for every datagram sent
+//  12  u32 frame id, per stream, counts decoded frames
+//  16  i64 capture time, us since the Unix epoch (RTCP wall clock when the camera sends it,
+//          the demux time otherwise)
+//  24  i64 send time, us since the Unix epoch
+//  32  u8  face count                33  3 bytes reserved    (not sent before faces were added, the
+//          header was RESULT_BASE_HEADER_SIZE bytes then and carried no faces)
+// hand record, RESULT_HAND_FIXED_SIZE + 4 * keypoints per hand bytes, most confident hand first:
+//   0  u16 x0, y0, x1, y1            crop box in frame pixels
+//   8  u16 confidence * 65535
+//  10  u8  flags (RESULT_HAND_*)     11  u8  gesture (GestureType), 0 from senders without a gesture engine
+//  12  u16 x, y per keypoint         frame pixels
+// face record, RESULT_FACE_SIZE bytes, after the last hand record, most confident face first:
+//   0  u16 x0, y0, x1, y1            face box in frame pixels
+//   8  u16 confidence * 65535
+// A frame without hands is still sent, as a header with hand count 0, so every frame id arrives.
+
+static const uint16_t RESULT_MAGIC = 0x4b48;
+static const uint8_t RESULT_VERSION = 2;
+static const size_t RESULT_BASE_HEADER_SIZE = 32;
+static const size_t RESULT_HEADER_SIZE = 36;
+static const size_t RESULT_HAND_FIXED_SIZE = 12;
+static const size_t RESULT_FACE_SIZE = 10;
+static const uint32_t RESULT_MAX_FACES = 16;
+static const uint32_t RESULT_KEYPOINT_NUM = 21;
+// keeps a datagram under a 1500-byte MTU
+static const size_t RESULT_MAX_DATAGRAM_SIZE = 1400;
+static const uint32_t RESULT_MAX_HANDS =
+    (RESULT_MAX_DATAGRAM_SIZE - RESULT_HEADER_SIZE) / (RESULT_HAND_FIXED_SIZE + 4 * RESULT_KEYPOINT_NUM);
+static const uint8_t RESULT_HAND_TRACKED = 0x01;    // box predicted from keypoints, not detected
+static const uint8_t RESULT_HAND_GESTURE_START = 0x02;  // gesture event: the first frame the gesture is held
+
+// debounced gesture of one hand, see GestureEngine
+enum GestureType {
+    GESTURE_NONE = 0,
+    GESTURE_OPEN_HAND,      // all five fingers extended
+    GESTURE_FIST,           // all fingers folded, thumb included
+    GESTURE_THUMBS_UP,      // fist with the thumb extended and pointing up
+    GESTURE_POINTING,       // only the index finger extended, the thumb may be either
+    GESTURE_VICTORY,        // index and middle finger extended
+    GESTURE_NUM,
+};
+
+enum ResultProtocolVersion {
+    RESULT_PROTOCOL_V1 = 1,     // legacy: one 40-byte-padded datagram per hand, zeros after 10 empty frames
+    RESULT_PROTOCOL_V2 = 2,
+};
+
+struct ResultHand {
+    uint16_t x0 = 0;
+    uint16_t y0 = 0;
+    uint16_t x1 = 0;
+    uint16_t y1 = 0;
+    float confidence = 0;
+    uint8_t flags = 0;
+    uint8_t gesture = GESTURE_NONE;
+    std::vector<uint16_t> keypoints;    // (x, y) pairs
+};
+
+struct ResultFace {
+    uint16_t x0 = 0;
+    uint16_t y0 = 0;
+    uint16_t x1 = 0;
+    uint16_t y1 = 0;
+    float confidence = 0;
+};
+
+struct ResultPacket {
+    uint16_t streamId = 0;
+    uint32_t sequence = 0;
+    uint32_t frameId = 0;
+    int64_t captureUs = 0;
+    int64_t sendUs = 0;
+    std::vector<ResultHand> hands;
+    std::vector<ResultFace> faces;
+};
+
+// encoded size of a packet; hands beyond RESULT_MAX_HANDS are not sent, nor faces beyond RESULT_MAX_FACES
+// or the room the hands leave in the datagram
+size_t ResultPacketSize(const ResultPacket &packet);
+// bytes written, 0 when buf is too small
+size_t EncodeResultPacket(const ResultPacket &packet, uint8_t *buf, size_t size);
+// false for anything that is not a well-formed version 2 datagram
+bool DecodeResultPacket(const uint8_t *buf, size_t size, ResultPacket &packet);
+// wall clock in us since the Unix epoch, the time base of captureUs and sendUs
+int64_t ResultWallClockUs();
+// "thumbs_up" etc., "unknown" for ids from a newer sender
+const char *GestureName(uint8_t gesture);
+
+#endif // STREAM_PULL_SAMPLE_RESULTPROTOCOL_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ResultReceiver.h"
+
+namespace {
+    // a sequence this far behind the expected one is a restarted sender, not a late datagram
+    const int32_t RESTART_WINDOW = 1024;
+    const size_t RECEIVE_BUFFER_SIZE = 65536;
+}
+
+ResultReceiver::~ResultReceiver()
+{
+    Close();
+}
+
+bool ResultReceiver::Open(uint16_t port, const std::string &bindIp)
+{
+    Close();
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, bindIp.c_str(), &addr.sin_addr) != 1) {
+        errno = EINVAL;
+        return false;
+    }
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return false;
+    }
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        Close();
+        return false;
+    }
+    buffer.resize(RECEIVE_BUFFER_SIZE);
+    return true;
+}
+
+void ResultReceiver::Close()
+{
+    if (sock >= 0) {
+        close(sock);
+        sock = -1;
+    }
+}
+
+ReceiveResult ResultReceiver::Receive(ResultPacket &packet, int timeoutMs)
+{
+    if (sock < 0) {
+        errno = EBADF;
+        return RECEIVE_ERROR;
+    }
+    struct pollfd fd;
+    fd.fd = sock;
+    fd.events = POLLIN;
+    int ready = poll(&fd, 1, timeoutMs);
+    if (ready < 0) {
+        return errno == EINTR ? RECEIVE_TIMEOUT : RECEIVE_ERROR;
+    }
+    if (ready == 0) {
+        return RECEIVE_TIMEOUT;
+    }
+    ssize_t len = recv(sock, buffer.data(), buffer.size(), 0);
+    if (len < 0) {
+        return RECEIVE_ERROR;
+    }
+    if (!DecodeResultPacket(buffer.data(), (size_t)len, packet)) {
+        invalid++;
+        return RECEIVE_INVALID;
+    }
+    Track(packet);
+    return RECEIVE_OK;
+}
+
+void ResultReceiver::Track(const ResultPacket &packet)
+{
+    SequenceState &state = sequences[packet.streamId];
+    ResultStreamStats &stream = stats[packet.streamId];
+    stream.received++;
+    stream.lastFrameId = packet.frameId;
+    if (!state.started) {
+        state.started = true;
+        state.next = packet.sequence + 1;
+        return;
+    }
+    int32_t diff = (int32_t)(packet.sequence - state.next);
+    if (diff >= 0) {
+        stream.lost += (uint32_t)diff;
+        state.next = packet.sequence + 1;
+    } else if (diff < -RESTART_WINDOW) {
+        stream.restarts++;
+        state.next = packet.sequence + 1;
+    } else {
+        // counted as lost when the gap opened, it only came late
+        stream.reordered++;
+        if (stream.lost > 0) {
+            stream.lost--;
+        }
+    }
+}
+
+const std::map<uint16_t, ResultStreamStats> &ResultReceiver::GetStats() const
+{
+    return stats;
+}
+
+uint64_t ResultReceiver::GetInvalidCount() const
+{
+    return invalid;
+}
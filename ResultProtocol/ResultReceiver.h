@@ -0,0 +1,72 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_RESULTRECEIVER_H
+#define STREAM_PULL_SAMPLE_RESULTRECEIVER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ResultProtocol.h"
+
+enum ReceiveResult {
+    RECEIVE_OK = 0,
+    RECEIVE_TIMEOUT,
+    RECEIVE_INVALID,    // a datagram arrived that is not a version 2 result
+    RECEIVE_ERROR,      // socket error, see errno
+};
+
+struct ResultStreamStats {
+    uint64_t received = 0;
+    uint64_t lost = 0;          // sequence numbers never seen, late arrivals are taken back out
+    uint64_t reordered = 0;     // arrived after a later sequence number (duplicates count here too)
+    uint64_t restarts = 0;      // sequence jumped back far: the sender restarted
+    uint32_t lastFrameId = 0;
+};
+
+// Client side of the result protocol: receives version 2 datagrams on a UDP port and keeps per-stream
+// loss/reordering statistics from the sequence numbers. Latency is left to the caller, who knows
+// whether its clock is synchronized with the sender: ResultWallClockUs() - packet.captureUs is the
+// glass-to-result delay, ResultWallClockUs() - packet.sendUs the network part of it.
+// Single-threaded; depends on the C++ standard library and POSIX sockets only.
+class ResultReceiver {
+public:
+    ResultReceiver() = default;
+    ~ResultReceiver();
+    ResultReceiver(const ResultReceiver &) = delete;
+    ResultReceiver &operator=(const ResultReceiver &) = delete;
+
+    bool Open(uint16_t port, const std::string &bindIp = "0.0.0.0");
+    void Close();
+    // waits up to timeoutMs, a negative timeout waits forever
+    ReceiveResult Receive(ResultPacket &packet, int timeoutMs);
+    const std::map<uint16_t, ResultStreamStats> &GetStats() const;
+    uint64_t GetInvalidCount() const;
+private:
+    void Track(const ResultPacket &packet);
+private:
+    struct SequenceState {
+        bool started = false;
+        uint32_t next = 0;
+    };
+    int sock = -1;
+    std::vector<uint8_t> buffer;
+    std::map<uint16_t, SequenceState> sequences;
+    std::map<uint16_t, ResultStreamStats> stats;
+    uint64_t invalid = 0;
+};
+
+#endif // STREAM_PULL_SAMPLE_RESULTRECEIVER_H
@@ -0,0 +1,328 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "MxBase/Log/Log.h"
+#include "../Metrics/Metrics.h"
+#include "../Metrics/StartupTimeline.h"
+#include "StreamManager.h"
+
+namespace {
+    const uint32_t MAX_PORT = 65535;
+    const double US_PER_MS = 1000.0;
+    // hand_stage_latency_seconds stages in the order a frame passes them
+    const char *REPORT_STAGES[] = {
+        "demux", "decode", "queue_wait", "resize", "detect", "face", "postprocess", "crop", "keypoints", "send",
+        "relay"
+    };
+
+    void PrintLatencyRow(const char *name, const LatencyHistogram &histogram)
+    {
+        uint64_t count = histogram.GetCount();
+        if (count == 0) {
+            return;
+        }
+        printf("  %-12s %8llu %9.2f %8.2f %8.2f %8.2f\n", name, (unsigned long long)count,
+               histogram.GetSumUs() / US_PER_MS / count, histogram.Quantile(0.5) / US_PER_MS,
+               histogram.Quantile(0.9) / US_PER_MS, histogram.Quantile(0.99) / US_PER_MS);
+    }
+
+    bool ParsePort(const std::string &text, uint16_t &port)
+    {
+        char *end = nullptr;
+        unsigned long value = strtoul(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0' || value == 0 || value > MAX_PORT) {
+            return false;
+        }
+        port = (uint16_t)value;
+        return true;
+    }
+}
+
+APP_ERROR LoadStreamList(const std::string &path, std::vector<StreamConfig> &streams)
+{
+    std::ifstream infile(path);
+    if (!infile.is_open()) {
+        LogError << "Failed to open stream list file: " << path;
+        return APP_ERR_COMM_OPEN_FAIL;
+    }
+    std::string line;
+    uint32_t lineNo = 0;
+    while (std::getline(infile, line)) {
+        lineNo++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::istringstream fields(line);
+        StreamConfig config;
+        if (!(fields >> config.url)) {
+            continue; // 空行或注释行
+        }
+        std::string videoPort;
+        std::string resultPort;
+        std::string extra;
+        bool valid = (bool)(fields >> config.clientIp);
+        if (valid && (fields >> videoPort)) {
+            valid = (fields >> resultPort) && ParsePort(videoPort, config.videoPort) &&
+                    ParsePort(resultPort, config.resultPort) && !(fields >> extra);
+        }
+        if (!valid) {
+            LogError << path << ":" << lineNo << ": expected \"url clientIp [videoPort resultPort]\"";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+        streams.push_back(config);
+    }
+    if (streams.empty()) {
+        LogError << "No stream in " << path;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    if (streams.size() > MAX_STREAM_NUM) {
+        LogError << path << " lists " << streams.size() << " streams, at most " << MAX_STREAM_NUM << " are supported";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR StreamManager::Init(const std::vector<StreamConfig> &configs, QueuePolicy policy, uint32_t queueDepth,
+                              const HandSelectParam &handParam, const TrackParam &trackParam,
+                              const GestureParam &gestureParam,
+                              std::shared_ptr<WorkerGroup> workers,
+                              std::shared_ptr<FrameRenderer> renderer)
+{
+    this->workers = workers;
+    size_t streamNum = std::min(configs.size(), (size_t)MAX_STREAM_NUM * workers->GetReplicaNum());
+    std::vector<std::unique_ptr<StreamContext>> contexts(streamNum);
+    std::vector<APP_ERROR> results(streamNum, APP_ERR_OK);
+    // VDEC channels are numbered per chip
+    std::map<uint32_t, uint32_t> deviceChannels;
+    // 各路流的拉流连接和解码器创建互不依赖，并行打开，启动时间取决于最慢的一路
+    std::vector<std::thread> openThreads;
+    for (size_t i = 0; i < streamNum; i++) {
+        // 解码器与推理放在同一芯片上，解码帧不跨设备拷贝
+        std::shared_ptr<WorkerReplica> worker = workers->Acquire((uint32_t)i);
+        uint32_t channelId = deviceChannels[worker->deviceId]++;
+        contexts[i].reset(new StreamContext);
+        contexts[i]->config = configs[i];
+        contexts[i]->videoProcess = std::make_shared<VideoProcess>((uint32_t)i, channelId);
+        contexts[i]->videoProcess->SetWorker(worker);
+        if (channelId >= MAX_STREAM_NUM) {
+            LogError << "device " << worker->deviceId << " has no decoder channel left for stream " << i
+                     << ", skipped";
+            results[i] = APP_ERR_COMM_FULL;
+            continue;
+        }
+        // OpenStream reads the replay mode and the decoder choice, set them before it runs
+        contexts[i]->videoProcess->SetReplayMode(configs[i].replayMode);
+        contexts[i]->videoProcess->SetDecoder(configs[i].decoderType, configs[i].decodeThreads,
+                                              configs[i].frameMemoryType);
+        LogInfo << "stream " << i << " runs on device " << worker->deviceId << " (replica " << worker->index << ")";
+        openThreads.emplace_back([&contexts, &results, i]() {
+            results[i] = OpenStream(*contexts[i]);
+        });
+    }
+    for (auto &openThread : openThreads) {
+        openThread.join();
+    }
+    for (size_t i = 0; i < streamNum; i++) {
+        if (results[i] != APP_ERR_OK) {
+            workers->Release((uint32_t)i);
+            continue;
+        }
+        std::unique_ptr<StreamContext> &context = contexts[i];
+        context->videoProcess->SetHandSelectParam(handParam);
+        context->videoProcess->SetTrackParam(trackParam);
+        context->videoProcess->SetGestureParam(gestureParam);
+        context->videoProcess->SetResultProtocol(context->config.resultProtocol);
+        context->videoProcess->SetRenderer(renderer);
+        context->videoProcess->SetVideoSink(context->config.videoSink);
+        context->frameQueue = std::make_shared<DecodedFrameQueue>(policy, queueDepth);
+        RegisterMetrics(*context);
+        streams.push_back(std::move(context));
+    }
+    if (streams.empty()) {
+        LogError << "None of the " << configs.size() << " streams could be opened";
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    LogInfo << streams.size() << " of " << configs.size() << " streams opened";
+    return APP_ERR_OK;
+}
+
+APP_ERROR StreamManager::OpenStream(StreamContext &context)
+{
+    const StreamConfig &config = context.config;
+    uint32_t streamId = context.videoProcess->GetStreamId();
+    StartupStep step("stream " + std::to_string(streamId) + " open");
+    // 解码器(VDEC通道)创建在当前线程的设备上下文中进行
+    APP_ERROR ret = APP_ERR_OK;
+    if (context.videoProcess->UsesDevice()) {
+        MxBase::DeviceContext device;
+        device.devId = context.videoProcess->GetDeviceId();
+        ret = MxBase::DeviceManager::GetInstance()->SetDevice(device);
+        if (ret != APP_ERR_OK) {
+            LogError << "SetDevice failed for stream " << streamId;
+            return ret;
+        }
+    }
+    // 视频流处理
+    ret = context.videoProcess->StreamInit(config.url, config.clientIp, config.videoPort, config.resultPort,
+                                          config.relayRateMbps);
+    if (ret != APP_ERR_OK) {
+        LogError << "StreamInit failed for stream " << streamId << " (" << config.url << "), skipped";
+        return ret;
+    }
+    // 解码模块功能初始化
+    ret = context.videoProcess->VideoDecodeInit();
+    if (ret != APP_ERR_OK) {
+        LogError << "VideoDecodeInit failed for stream " << streamId << " (" << config.url << "), skipped";
+        context.videoProcess->StreamDeInit();
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+void StreamManager::RegisterMetrics(StreamContext &context)
+{
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    std::string labels = MetricLabels({{"stream", std::to_string(context.videoProcess->GetStreamId())}});
+    std::shared_ptr<DecodedFrameQueue> queue = context.frameQueue;
+    context.metricCallbacks.push_back(registry->RegisterCallback("hand_decoded_frames_total",
+        "Frames produced by the decoder", METRIC_COUNTER, labels,
+        [queue]() { return (double)queue->GetPushedCount(); }));
+    context.metricCallbacks.push_back(registry->RegisterCallback("hand_dropped_frames_total",
+        "Decoded frames dropped by the queue policy", METRIC_COUNTER, labels,
+        [queue]() { return (double)queue->GetDroppedCount(); }));
+    context.metricCallbacks.push_back(registry->RegisterCallback("hand_decoded_queue_depth",
+        "Decoded frames waiting for the pipeline", METRIC_GAUGE, labels,
+        [queue]() { return (double)queue->GetSize(); }));
+}
+
+APP_ERROR StreamManager::Start()
+{
+    if (streams.empty()) {
+        LogError << "StreamManager is not initialized";
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    for (auto &context : streams) {
+        StreamContext *stream = context.get();
+        stream->startTime = std::chrono::steady_clock::now();
+        stream->getFrame = std::thread(VideoProcess::GetFrames, stream->frameQueue, stream->videoProcess);
+        stream->getResult = std::thread([this, stream]() {
+            VideoProcess::GetResults(stream->frameQueue, stream->videoProcess);
+            stream->finishTime = std::chrono::steady_clock::now();
+            stream->finished = true;
+        });
+    }
+    return APP_ERR_OK;
+}
+
+void StreamManager::Stop()
+{
+    for (auto &context : streams) {
+        context->videoProcess->Stop();
+    }
+}
+
+void StreamManager::Join()
+{
+    for (auto &context : streams) {
+        if (context->getFrame.joinable()) {
+            context->getFrame.join();
+        }
+        if (context->getResult.joinable()) {
+            context->getResult.join();
+        }
+        context->frameQueue->Stop();
+        context->frameQueue->Clear();
+        LogInfo << "stream " << context->videoProcess->GetStreamId() << " decoded frames: "
+                << context->frameQueue->GetPushedCount() << ", dropped by queue policy: "
+                << context->frameQueue->GetDroppedCount();
+    }
+}
+
+APP_ERROR StreamManager::DeInit()
+{
+    APP_ERROR result = APP_ERR_OK;
+    for (auto &context : streams) {
+        for (uint64_t id : context->metricCallbacks) {
+            MetricsRegistry::GetInstance()->Unregister(id);
+        }
+        APP_ERROR ret = context->videoProcess->StreamDeInit();
+        if (ret != APP_ERR_OK) {
+            LogError << "StreamDeInit failed for stream " << context->videoProcess->GetStreamId();
+            result = ret;
+        }
+        ret = context->videoProcess->VideoDecodeDeInit();
+        if (ret != APP_ERR_OK) {
+            LogError << "VideoDecodeDeInit failed for stream " << context->videoProcess->GetStreamId();
+            result = ret;
+        }
+        workers->Release(context->videoProcess->GetStreamId());
+    }
+    streams.clear();
+    return result;
+}
+
+size_t StreamManager::GetStreamNum() const
+{
+    return streams.size();
+}
+
+bool StreamManager::IsFinished() const
+{
+    for (const auto &context : streams) {
+        if (!context->finished) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StreamManager::PrintReport() const
+{
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    for (const auto &context : streams) {
+        std::string labels = MetricLabels({{"stream", std::to_string(context->videoProcess->GetStreamId())}});
+        auto end = context->finished ? context->finishTime : std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - context->startTime).count();
+        uint64_t decoded = context->frameQueue->GetPushedCount();
+        uint64_t dropped = context->frameQueue->GetDroppedCount();
+        const LatencyHistogram *frameLatency = registry->GetHistogram("hand_frame_latency_seconds", "", labels);
+        uint64_t processed = frameLatency->GetCount();
+        uint64_t failed = registry->GetCounter("hand_failed_frames_total", "", labels)->Get();
+        printf("stream %u (%s): %.2f s\n", context->videoProcess->GetStreamId(), context->config.url.c_str(),
+               seconds);
+        printf("  packets %u, decoded %llu, dropped by queue %llu, failed %llu, sent %llu\n",
+               context->videoProcess->GetSubmittedFrameNum(), (unsigned long long)decoded,
+               (unsigned long long)dropped, (unsigned long long)failed, (unsigned long long)processed);
+        if (seconds > 0) {
+            printf("  decoded %.1f fps, sent %.1f fps\n", decoded / seconds, processed / seconds);
+        }
+        // quantiles are histogram bucket bounds, the mean is exact
+        printf("  %-12s %8s %9s %8s %8s %8s\n", "stage", "frames", "mean ms", "p50 ms", "p90 ms", "p99 ms");
+        for (const char *stage : REPORT_STAGES) {
+            PrintLatencyRow(stage, *registry->GetHistogram("hand_stage_latency_seconds", "",
+                JoinMetricLabels(labels, MetricLabels({{"stage", stage}}))));
+        }
+        PrintLatencyRow("frame", *frameLatency);
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_STREAMMANAGER_H
+#define STREAM_PULL_SAMPLE_STREAMMANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "../BlockingQueue/FrameQueue.h"
+#include "../VideoProcess/VideoProcess.h"
+#include "../WorkerGroup/WorkerGroup.h"
+
+// VDEC channels available on one Ascend 310 and per model replica, also the limit with the software decoder
+static const uint32_t MAX_STREAM_NUM = 32;
+
+struct StreamConfig {
+    std::string url;
+    std::string clientIp;
+    uint16_t videoPort = DEFAULT_VIDEO_PORT;
+    uint16_t resultPort = DEFAULT_RESULT_PORT;
+    uint32_t relayRateMbps = DEFAULT_RELAY_RATE_MBPS;
+    ResultProtocolVersion resultProtocol = RESULT_PROTOCOL_V1;
+    ReplayMode replayMode = REPLAY_OFF;
+    DecoderType decoderType = DECODER_DVPP;
+    uint32_t decodeThreads = 0;
+    // where software-decoded frames are stored, host memory when the CPU backend reads them
+    MxBase::MemoryData::MemoryType frameMemoryType = MxBase::MemoryData::MEMORY_DVPP;
+    // annotated H.264 output, off while its output is empty
+    VideoSinkParam videoSink;
+};
+
+// stream list file: one "url clientIp [videoPort resultPort]" per line, '#' starts a comment
+APP_ERROR LoadStreamList(const std::string &path, std::vector<StreamConfig> &streams);
+
+// Runs N cameras in one process. Every stream owns its VideoProcess (input, decoder, sockets),
+// its decoded-frame queue and its decode/result threads; the detectors are loaded once per replica
+// of the WorkerGroup and shared by the streams pinned to it.
+class StreamManager {
+public:
+    APP_ERROR Init(const std::vector<StreamConfig> &configs, QueuePolicy policy, uint32_t queueDepth,
+                   const HandSelectParam &handParam, const TrackParam &trackParam,
+                   const GestureParam &gestureParam,
+                   std::shared_ptr<WorkerGroup> workers,
+                   std::shared_ptr<FrameRenderer> renderer = nullptr);
+    APP_ERROR Start();
+    void Stop();
+    void Join();
+    APP_ERROR DeInit();
+    size_t GetStreamNum() const;
+    // every stream's result thread has returned, which a replayed file does on its own at the end
+    bool IsFinished() const;
+    // throughput, drops and per-stage latency of every stream since Start, on stdout
+    void PrintReport() const;
+private:
+    struct StreamContext {
+        StreamConfig config;
+        std::shared_ptr<VideoProcess> videoProcess;
+        std::shared_ptr<DecodedFrameQueue> frameQueue;
+        std::thread getFrame;
+        std::thread getResult;
+        std::vector<uint64_t> metricCallbacks;
+        std::atomic<bool> finished{false};
+        std::chrono::steady_clock::time_point startTime;
+        std::chrono::steady_clock::time_point finishTime;   // valid once finished
+    };
+    // input, sockets and decoder of one stream; runs on its own thread during Init
+    static APP_ERROR OpenStream(StreamContext &context);
+    void RegisterMetrics(StreamContext &context);
+    std::vector<std::unique_ptr<StreamContext>> streams;
+    std::shared_ptr<WorkerGroup> workers;
+};
+
+#endif // STREAM_PULL_SAMPLE_STREAMMANAGER_H
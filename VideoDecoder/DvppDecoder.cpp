@@ -0,0 +1,137 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MxBase/Log/Log.h"
+#include "DvppDecoder.h"
+
+DvppDecoder::DvppDecoder()
+{
+    for (uint32_t i = 0; i < FRAME_SIZE_TRACK; i++) {
+        frameSizes[i] = 0;
+    }
+}
+
+APP_ERROR DvppDecoder::Init(const DecoderInitParam &initParam, DecodedFrameCallback callback)
+{
+    if (initParam.codecpar == nullptr || !IsSupportedCodec(initParam.codecpar->codec_id)) {
+        LogError << "VDEC decodes H.264 and H.265 only";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    param = initParam;
+    param.codecpar = nullptr;
+    this->callback = callback;
+    MxBase::VdecConfig vdecConfig;
+    // 解码输入格式取自码流，H264各档次均按MAIN_LEVEL配置
+    vdecConfig.inputVideoFormat = initParam.codecpar->codec_id == AV_CODEC_ID_HEVC ?
+        MxBase::MXBASE_STREAM_FORMAT_H265_MAIN_LEVEL : MxBase::MXBASE_STREAM_FORMAT_H264_MAIN_LEVEL;
+    // 将解码函数的输出格式设为YUV420
+    vdecConfig.outputImageFormat = MxBase::MXBASE_PIXEL_FORMAT_YUV_SEMIPLANAR_420;
+    vdecConfig.deviceId = param.deviceId;
+    vdecConfig.channelId = param.channelId;
+    vdecConfig.callbackFunc = VdecCallback;
+    vdecConfig.outMode = 1;
+
+    vDvppWrapper = std::make_shared<MxBase::DvppWrapper>();
+    APP_ERROR ret = vDvppWrapper->InitVdec(vdecConfig);
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to initialize VDEC channel " << param.channelId;
+        vDvppWrapper.reset();
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR DvppDecoder::DeInit()
+{
+    if (vDvppWrapper == nullptr) {
+        return APP_ERR_OK;
+    }
+    APP_ERROR ret = vDvppWrapper->DeInitVdec();
+    vDvppWrapper.reset();
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to deinitialize VDEC channel " << param.channelId;
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR DvppDecoder::Decode(const uint8_t *data, size_t size, uint32_t width, uint32_t height,
+                              uint32_t frameId)
+{
+    // 将帧数据从Host侧移到Device侧
+    MxBase::MemoryData streamData((void *)data, size, MxBase::MemoryData::MEMORY_HOST_NEW, param.deviceId);
+    MxBase::MemoryData dvppMemory(size, MxBase::MemoryData::MEMORY_DVPP, param.deviceId);
+    APP_ERROR ret = MxBase::MemoryHelper::MxbsMallocAndCopy(dvppMemory, streamData);
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to MxbsMallocAndCopy";
+        return ret;
+    }
+    // 构建DvppDataInfo结构体以便解码
+    MxBase::DvppDataInfo inputDataInfo;
+    inputDataInfo.dataSize = dvppMemory.size;
+    inputDataInfo.data = (uint8_t *)dvppMemory.ptrData;
+    inputDataInfo.height = height;
+    inputDataInfo.width = width;
+    inputDataInfo.channelId = param.channelId;
+    inputDataInfo.frameId = frameId;
+    frameSizes[frameId % FRAME_SIZE_TRACK].store(((uint64_t)width << 32) | height, std::memory_order_relaxed);
+    ret = vDvppWrapper->DvppVdec(inputDataInfo, (void *)this);
+    if (ret != APP_ERR_OK) {
+        LogError << "DvppVdec Failed";
+        MxBase::MemoryHelper::MxbsFree(dvppMemory);
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR DvppDecoder::Flush()
+{
+    // without the flush VDEC keeps its last reference frames until more input arrives
+    return vDvppWrapper->DvppVdecFlush();
+}
+
+DecoderType DvppDecoder::GetType() const
+{
+    return DECODER_DVPP;
+}
+
+// 每进行一次视频帧解码会调用一次该函数，解码结果交给回调
+APP_ERROR DvppDecoder::VdecCallback(std::shared_ptr<void> buffer, MxBase::DvppDataInfo &inputDataInfo,
+                                    void *userData)
+{
+    auto *decoder = (DvppDecoder *)userData;
+    // 解码后的视频信息，先接管DVPP内存，提前返回时也能释放
+    auto output = WrapFrameMemory(MxBase::MemoryData(buffer.get(), (size_t)inputDataInfo.dataSize,
+        MxBase::MemoryData::MEMORY_DVPP, decoder == nullptr ? 0 : decoder->param.deviceId), "vdec frame");
+    if (decoder == nullptr) {
+        LogError << "userData is nullptr";
+        return APP_ERR_COMM_INVALID_POINTER;
+    }
+    FrameGeometry geometry;
+    // VDEC输出的行和平面按DVPP要求对齐，带跨距传给后续的缩放和裁剪
+    if (inputDataInfo.width != 0 && inputDataInfo.widthStride >= inputDataInfo.width &&
+        inputDataInfo.heightStride >= inputDataInfo.height) {
+        geometry.width = inputDataInfo.width;
+        geometry.height = inputDataInfo.height;
+        geometry.widthStride = inputDataInfo.widthStride;
+        geometry.heightStride = inputDataInfo.heightStride;
+    } else {
+        uint64_t size = decoder->frameSizes[inputDataInfo.frameId % FRAME_SIZE_TRACK].load(std::memory_order_relaxed);
+        geometry = MakeFrameGeometry((uint32_t)(size >> 32), (uint32_t)size, DVPP_WIDTH_ALIGN, DVPP_HEIGHT_ALIGN);
+    }
+    decoder->callback(output, geometry, inputDataInfo.frameId);
+    return APP_ERR_OK;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_DVPPDECODER_H
+#define STREAM_PULL_SAMPLE_DVPPDECODER_H
+
+#include <atomic>
+#include "MxBase/DvppWrapper/DvppWrapper.h"
+#include "VideoDecoder.h"
+
+// One VDEC channel. Packets are copied to DVPP memory and decoded asynchronously, frames come back
+// on the VDEC callback thread.
+class DvppDecoder : public VideoDecoder {
+public:
+    DvppDecoder();
+    ~DvppDecoder() override = default;
+
+    APP_ERROR Init(const DecoderInitParam &initParam, DecodedFrameCallback callback) override;
+    APP_ERROR DeInit() override;
+    APP_ERROR Decode(const uint8_t *data, size_t size, uint32_t width, uint32_t height,
+                     uint32_t frameId) override;
+    APP_ERROR Flush() override;
+    DecoderType GetType() const override;
+private:
+    static APP_ERROR VdecCallback(std::shared_ptr<void> buffer, MxBase::DvppDataInfo &inputDataInfo,
+                                  void *userData);
+private:
+    std::shared_ptr<MxBase::DvppWrapper> vDvppWrapper;
+    DecoderInitParam param;
+    DecodedFrameCallback callback;
+    // width << 32 | height the packet was submitted with, indexed by frameId, for a callback that
+    // does not report its geometry
+    static const uint32_t FRAME_SIZE_TRACK = 64;
+    std::atomic<uint64_t> frameSizes[FRAME_SIZE_TRACK];
+};
+
+#endif // STREAM_PULL_SAMPLE_DVPPDECODER_H
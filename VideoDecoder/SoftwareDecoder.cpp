@@ -0,0 +1,188 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MxBase/Log/Log.h"
+#include "../AsyncLogger/AsyncLogger.h"
+#include "SoftwareDecoder.h"
+
+SoftwareDecoder::~SoftwareDecoder()
+{
+    DeInit();
+}
+
+APP_ERROR SoftwareDecoder::Init(const DecoderInitParam &initParam, DecodedFrameCallback callback)
+{
+    if (initParam.codecpar == nullptr || !IsSupportedCodec(initParam.codecpar->codec_id)) {
+        LogError << "the software decoder is set up for H.264 and H.265 only";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    const AVCodec *codec = avcodec_find_decoder(initParam.codecpar->codec_id);
+    if (codec == nullptr) {
+        LogError << "libavcodec has no " << avcodec_get_name(initParam.codecpar->codec_id) << " decoder";
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    codecContext = avcodec_alloc_context3(codec);
+    if (codecContext == nullptr) {
+        LogError << "avcodec_alloc_context3 failed";
+        return APP_ERR_COMM_ALLOC_MEM;
+    }
+    // Annex-B extradata carries parameter sets an RTSP stream may only announce in its SDP
+    if (avcodec_parameters_to_context(codecContext, initParam.codecpar) < 0) {
+        LogError << "avcodec_parameters_to_context failed";
+        DeInit();
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    // 帧级并行提高吞吐，每个线程多占一帧延迟；条带并行不增加延迟
+    codecContext->thread_count = (int)initParam.threadNum;
+    codecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
+        LogError << "avcodec_open2 failed for " << codec->name;
+        DeInit();
+        return APP_ERR_COMM_INIT_FAIL;
+    }
+    frame = av_frame_alloc();
+    if (frame == nullptr) {
+        LogError << "av_frame_alloc failed";
+        DeInit();
+        return APP_ERR_COMM_ALLOC_MEM;
+    }
+    param = initParam;
+    param.codecpar = nullptr;
+    this->callback = callback;
+    LogInfo << "software decoder " << codec->name << " with " << codecContext->thread_count << " thread(s)";
+    return APP_ERR_OK;
+}
+
+APP_ERROR SoftwareDecoder::DeInit()
+{
+    if (swsContext != nullptr) {
+        sws_freeContext(swsContext);
+        swsContext = nullptr;
+    }
+    if (frame != nullptr) {
+        av_frame_free(&frame);
+    }
+    if (codecContext != nullptr) {
+        avcodec_free_context(&codecContext);
+    }
+    std::vector<uint8_t>().swap(hostFrame);
+    return APP_ERR_OK;
+}
+
+APP_ERROR SoftwareDecoder::Decode(const uint8_t *data, size_t size, uint32_t, uint32_t, uint32_t frameId)
+{
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.data = (uint8_t *)data;
+    pkt.size = (int)size;
+    // the frameId rides along as pts and comes back on the frame it decodes to, after any reordering
+    pkt.pts = frameId;
+    pkt.dts = AV_NOPTS_VALUE;
+    int ret = avcodec_send_packet(codecContext, &pkt);
+    if (ret < 0 && ret != AVERROR(EAGAIN)) {
+        HotLogRate(HOT_LOG_LEVEL_ERROR, 1) << "avcodec_send_packet failed, ret=" << ret;
+        return APP_ERR_COMM_FAILURE;
+    }
+    return ReceiveFrames();
+}
+
+APP_ERROR SoftwareDecoder::Flush()
+{
+    // a null packet drains the frames the decoder threads still hold
+    if (avcodec_send_packet(codecContext, nullptr) < 0) {
+        return APP_ERR_COMM_FAILURE;
+    }
+    APP_ERROR ret = ReceiveFrames();
+    // ready for the next packet after a drain
+    avcodec_flush_buffers(codecContext);
+    return ret;
+}
+
+DecoderType SoftwareDecoder::GetType() const
+{
+    return DECODER_SOFTWARE;
+}
+
+APP_ERROR SoftwareDecoder::ReceiveFrames()
+{
+    while (true) {
+        int ret = avcodec_receive_frame(codecContext, frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return APP_ERR_OK;
+        }
+        if (ret < 0) {
+            HotLogRate(HOT_LOG_LEVEL_ERROR, 1) << "avcodec_receive_frame failed, ret=" << ret;
+            return APP_ERR_COMM_FAILURE;
+        }
+        APP_ERROR emitRet = EmitFrame(*frame);
+        av_frame_unref(frame);
+        if (emitRet != APP_ERR_OK) {
+            return emitRet;
+        }
+    }
+}
+
+APP_ERROR SoftwareDecoder::EmitFrame(const AVFrame &picture)
+{
+    if (picture.width <= 0 || picture.height <= 0) {
+        return APP_ERR_COMM_FAILURE;
+    }
+    bool dvppOutput = param.outputMemoryType == MxBase::MemoryData::MEMORY_DVPP;
+    // DVPP的VPC要求输入按DVPP对齐，Host侧输出紧凑排列
+    FrameGeometry geometry = dvppOutput ?
+        MakeFrameGeometry((uint32_t)picture.width, (uint32_t)picture.height, DVPP_WIDTH_ALIGN, DVPP_HEIGHT_ALIGN) :
+        MakeFrameGeometry((uint32_t)picture.width, (uint32_t)picture.height);
+    size_t frameSize = GetNv12Size(geometry);
+    MxBase::MemoryData output(frameSize, param.outputMemoryType, param.deviceId);
+    uint8_t *nv12 = nullptr;
+    if (dvppOutput) {
+        hostFrame.resize(frameSize);
+        nv12 = hostFrame.data();
+    } else {
+        APP_ERROR ret = MxBase::MemoryHelper::MxbsMalloc(output);
+        if (ret != APP_ERR_OK) {
+            LogError << "Failed to MxbsMalloc a decoded frame";
+            return ret;
+        }
+        nv12 = (uint8_t *)output.ptrData;
+    }
+    std::shared_ptr<MxBase::MemoryData> frameData = dvppOutput ? nullptr :
+        WrapFrameMemory(output, "soft decoder frame");
+
+    // no scaling, only YUV420P (or whatever the stream decodes to) into NV12
+    swsContext = sws_getCachedContext(swsContext, picture.width, picture.height, (AVPixelFormat)picture.format,
+                                      picture.width, picture.height, AV_PIX_FMT_NV12, SWS_POINT,
+                                      nullptr, nullptr, nullptr);
+    if (swsContext == nullptr) {
+        LogError << "No conversion from pixel format " << picture.format << " to NV12";
+        return APP_ERR_COMM_FAILURE;
+    }
+    uint8_t *const dst[] = {nv12, nv12 + (size_t)geometry.widthStride * geometry.heightStride};
+    const int dstStride[] = {(int)geometry.widthStride, (int)geometry.widthStride};
+    sws_scale(swsContext, picture.data, picture.linesize, 0, picture.height, dst, dstStride);
+
+    if (dvppOutput) {
+        MxBase::MemoryData host(hostFrame.data(), frameSize, MxBase::MemoryData::MEMORY_HOST_NEW, param.deviceId);
+        APP_ERROR ret = MxBase::MemoryHelper::MxbsMallocAndCopy(output, host);
+        if (ret != APP_ERR_OK) {
+            LogError << "Failed to copy a decoded frame to DVPP memory";
+            return ret;
+        }
+        frameData = WrapFrameMemory(output, "soft decoder frame");
+    }
+    callback(frameData, geometry, (uint32_t)picture.pts);
+    return APP_ERR_OK;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_SOFTWAREDECODER_H
+#define STREAM_PULL_SAMPLE_SOFTWAREDECODER_H
+
+#include <vector>
+#include "VideoDecoder.h"
+
+extern "C"{
+#include "libavutil/avutil.h"
+#include "libswscale/swscale.h"
+}
+
+// libavcodec H.264/H.265 decoder. Decoding runs synchronously in Decode on libavcodec's own frame and
+// slice threads; frame threading holds back about one frame per thread, which Flush releases.
+// Pictures are converted to NV12 so they look like VDEC output to the rest of the pipeline.
+class SoftwareDecoder : public VideoDecoder {
+public:
+    SoftwareDecoder() = default;
+    ~SoftwareDecoder() override;
+
+    APP_ERROR Init(const DecoderInitParam &initParam, DecodedFrameCallback callback) override;
+    APP_ERROR DeInit() override;
+    APP_ERROR Decode(const uint8_t *data, size_t size, uint32_t width, uint32_t height,
+                     uint32_t frameId) override;
+    APP_ERROR Flush() override;
+    DecoderType GetType() const override;
+private:
+    // hands every frame libavcodec has ready to the callback
+    APP_ERROR ReceiveFrames();
+    APP_ERROR EmitFrame(const AVFrame &picture);
+private:
+    DecoderInitParam param;
+    DecodedFrameCallback callback;
+    AVCodecContext *codecContext = nullptr;
+    AVFrame *frame = nullptr;
+    SwsContext *swsContext = nullptr;
+    // NV12 staging for DVPP output, reused between frames
+    std::vector<uint8_t> hostFrame;
+};
+
+#endif // STREAM_PULL_SAMPLE_SOFTWAREDECODER_H
@@ -0,0 +1,49 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MxBase/Log/Log.h"
+#include "../AsyncLogger/AsyncLogger.h"
+#include "../Metrics/MemoryTracker.h"
+#include "VideoDecoder.h"
+#include "DvppDecoder.h"
+#include "SoftwareDecoder.h"
+
+std::shared_ptr<VideoDecoder> CreateVideoDecoder(DecoderType type)
+{
+    if (type == DECODER_SOFTWARE) {
+        return std::make_shared<SoftwareDecoder>();
+    }
+    return std::make_shared<DvppDecoder>();
+}
+
+bool IsSupportedCodec(AVCodecID codecId)
+{
+    return codecId == AV_CODEC_ID_H264 || codecId == AV_CODEC_ID_HEVC;
+}
+
+std::shared_ptr<MxBase::MemoryData> VideoDecoder::WrapFrameMemory(const MxBase::MemoryData &memory,
+                                                                  const char *site)
+{
+    MemoryTracker::GetInstance()->Track(memory.ptrData, memory.size, memory.type, site);
+    auto deleter = [] (MxBase::MemoryData *memoryData) {
+        APP_ERROR ret = MemoryTracker::GetInstance()->Free(*memoryData);
+        delete memoryData;
+        if (ret != APP_ERR_OK) {
+            HotLogRate(HOT_LOG_LEVEL_ERROR, 1) << GetError(ret) << " MxbsFree failed";
+        }
+    };
+    return std::shared_ptr<MxBase::MemoryData>(new MxBase::MemoryData(memory), deleter);
+}
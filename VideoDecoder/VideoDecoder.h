@@ -0,0 +1,76 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_VIDEODECODER_H
+#define STREAM_PULL_SAMPLE_VIDEODECODER_H
+
+#include <functional>
+#include <memory>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "MxBase/MemoryHelper/MemoryHelper.h"
+#include "../InferenceBackend/InferenceBackend.h"
+
+extern "C"{
+#include "libavcodec/avcodec.h"
+}
+
+enum DecoderType {
+    DECODER_DVPP = 0,   // Ascend VDEC, NV12 output in DVPP memory
+    DECODER_SOFTWARE,   // libavcodec on the host with frame and slice threads, for hosts without VDEC
+};
+
+struct DecoderInitParam {
+    // codec parameters of the Annex-B packets Decode receives, after the mp4toannexb filter if there is one
+    const AVCodecParameters *codecpar = nullptr;
+    uint32_t deviceId = 0;
+    uint32_t channelId = 0;     // VDEC channel
+    uint32_t threadNum = 0;     // software decoder threads, 0 picks one per core
+    // where the software decoder puts its frames; DVPP for the Ascend backend, host memory saves the
+    // copy when the CPU backend reads them
+    MxBase::MemoryData::MemoryType outputMemoryType = MxBase::MemoryData::MEMORY_DVPP;
+};
+
+// one NV12 picture; frameId is the one its packet was submitted with. Called on the VDEC callback thread
+// for DVPP and on the caller of Decode/Flush for the software decoder.
+typedef std::function<void(const std::shared_ptr<MxBase::MemoryData> &frame, const FrameGeometry &geometry,
+                           uint32_t frameId)> DecodedFrameCallback;
+
+// Turns Annex-B H.264/H.265 packets into NV12 frames. Every backend hands its frames to the callback in
+// the same form, with the deleter that releases their memory attached.
+class VideoDecoder {
+public:
+    virtual ~VideoDecoder() {}
+
+    virtual APP_ERROR Init(const DecoderInitParam &initParam, DecodedFrameCallback callback) = 0;
+    virtual APP_ERROR DeInit() = 0;
+    // width/height are the stream's picture size, the software decoder reads it from the bitstream
+    virtual APP_ERROR Decode(const uint8_t *data, size_t size, uint32_t width, uint32_t height,
+                             uint32_t frameId) = 0;
+    // end of input: the frames still held as references come out before this returns (software)
+    // or through the callback shortly after (DVPP)
+    virtual APP_ERROR Flush() = 0;
+    virtual DecoderType GetType() const = 0;
+protected:
+    // takes over memory allocated by MxbsMalloc/MxbsMallocAndCopy or VDEC, MxbsFree runs with the last
+    // reference; MemoryTracker counts the frame under site until then
+    static std::shared_ptr<MxBase::MemoryData> WrapFrameMemory(const MxBase::MemoryData &memory, const char *site);
+};
+
+std::shared_ptr<VideoDecoder> CreateVideoDecoder(DecoderType type);
+// codecs both backends decode
+bool IsSupportedCodec(AVCodecID codecId);
+
+#endif // STREAM_PULL_SAMPLE_VIDEODECODER_H
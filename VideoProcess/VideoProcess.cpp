@@ -14,68 +14,203 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <thread>
 #include "MxBase/ErrorCode/ErrorCodes.h"
 #include "MxBase/Log/Log.h"
-#include "opencv2/opencv.hpp"
 #include "VideoProcess.h"
+#include "../AsyncLogger/AsyncLogger.h"
+#include "../Metrics/StartupTimeline.h"
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <unistd.h>
 namespace {
-    static AVFormatContext *formatContext = nullptr; // 视频流信息
-    static int _videoIndex = -1;
-    const uint32_t VIDEO_WIDTH = {1920};
-    const uint32_t VIDEO_HEIGHT = {1080};
-    const uint32_t MAX_QUEUE_LENGHT = 1000;
     const uint32_t QUEUE_POP_WAIT_TIME = 10;
-    const uint32_t YUV_BYTE_NU = 3;
-    const uint32_t YUV_BYTE_DE = 2;
-}
-    static int vSock = -1; // socket to send video data to client
-    static int iSock = -1;
-static int keypointConnectMatrix[5][5] = {
-        {0, 1, 2, 3, 4}, 
-        {0, 5, 6, 7, 8}, 
-        {0, 9, 10, 11, 12}, 
-        {0, 13, 14, 15, 16}, 
-        {0, 17, 18, 19, 20}
-    };
-static std::string _clientIp="192.168.30.36";
-APP_ERROR VideoProcess::StreamInit(const std::string &rtspUrl,const std::string &clientIp)
+    const uint32_t DROP_REPORT_INTERVAL = 100;
+    // reconnect: the first retry is immediate, then the wait doubles up to the maximum
+    const uint32_t RECONNECT_MIN_BACKOFF_MS = 100;
+    const uint32_t RECONNECT_MAX_BACKOFF_MS = 5000;
+    const uint32_t RECONNECT_POLL_MS = 10;
+    // replay: give up on frames the decoder still holds after the flush when none arrived for this long
+    const uint32_t DECODE_DRAIN_TIMEOUT_MS = 1000;
+    const uint32_t DECODE_DRAIN_POLL_MS = 5;
+
+    int64_t SteadyNowNs()
+    {
+        return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+VideoProcess::VideoProcess(uint32_t streamId, uint32_t channelId)
+    : inputDone(false), streamId(streamId), channelId(channelId), stopFlag(false)
+{
+    for (uint32_t i = 0; i < DECODE_TRACK_SIZE; i++) {
+        decodeSubmitNs[i] = 0;
+        decodeCaptureUs[i] = 0;
+    }
+    InitMetrics();
+    relay.reset(new VideoRelay(MetricLabels({{"stream", std::to_string(streamId)}})));
+}
+
+void VideoProcess::InitMetrics()
+{
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    std::string labels = MetricLabels({{"stream", std::to_string(streamId)}});
+    const char *stageHelp = "Time spent in one processing stage per frame";
+    metrics.demux = registry->GetHistogram("hand_stage_latency_seconds", stageHelp,
+                                           JoinMetricLabels(labels, MetricLabels({{"stage", "demux"}})));
+    metrics.decode = registry->GetHistogram("hand_stage_latency_seconds", stageHelp,
+                                            JoinMetricLabels(labels, MetricLabels({{"stage", "decode"}})));
+    metrics.queueWait = registry->GetHistogram("hand_stage_latency_seconds", stageHelp,
+                                               JoinMetricLabels(labels, MetricLabels({{"stage", "queue_wait"}})));
+    metrics.frameLatency = registry->GetHistogram("hand_frame_latency_seconds",
+                                                  "Decoded frame to keypoint result sent", labels);
+    metrics.readErrors = registry->GetCounter("hand_read_errors_total", "Failed av_read_frame calls", labels);
+    metrics.hands = registry->GetCounter("hand_detected_hands_total", "Hands that got keypoints", labels);
+    metrics.faces = registry->GetCounter("hand_detected_faces_total", "Faces sent with the results", labels);
+    metrics.reconnects = registry->GetCounter("hand_stream_reconnects_total",
+                                              "Input reopened after a read error or end of stream", labels);
+}
+
+void VideoProcess::SetHandSelectParam(const HandSelectParam &param)
+{
+    handParam = param;
+}
+
+void VideoProcess::SetTrackParam(const TrackParam &param)
+{
+    trackParam = param;
+}
+
+void VideoProcess::SetGestureParam(const GestureParam &param)
+{
+    gestureParam = param;
+}
+
+void VideoProcess::SetWorker(std::shared_ptr<WorkerReplica> worker)
+{
+    this->worker = worker;
+    deviceId = worker->deviceId;
+}
+
+void VideoProcess::SetResultProtocol(ResultProtocolVersion version)
+{
+    resultProtocol = version;
+}
+
+void VideoProcess::SetRenderer(std::shared_ptr<FrameRenderer> renderer)
+{
+    this->renderer = renderer;
+}
+
+void VideoProcess::SetVideoSink(const VideoSinkParam &param)
+{
+    sinkParam = param;
+}
+
+void VideoProcess::SetReplayMode(ReplayMode mode)
+{
+    replayMode = mode;
+}
+
+void VideoProcess::SetDecoder(DecoderType type, uint32_t threadNum, MxBase::MemoryData::MemoryType memoryType)
+{
+    decoderType = type;
+    decodeThreads = threadNum;
+    frameMemoryType = memoryType;
+}
+
+uint32_t VideoProcess::GetSubmittedFrameNum() const
+{
+    return decodeFrameId;
+}
+
+void VideoProcess::Stop()
+{
+    stopFlag = true;
+}
+
+bool VideoProcess::IsStopped() const
+{
+    return stopFlag;
+}
+
+uint32_t VideoProcess::GetStreamId() const
+{
+    return streamId;
+}
+
+uint32_t VideoProcess::GetDeviceId() const
+{
+    return deviceId;
+}
+
+bool VideoProcess::UsesDevice() const
+{
+    return decoderType == DECODER_DVPP || frameMemoryType == MxBase::MemoryData::MEMORY_DVPP;
+}
+
+APP_ERROR VideoProcess::StreamInit(const std::string &rtspUrl, const std::string &clientIp,
+                                   uint16_t videoPort, uint16_t resultPort, uint32_t relayRateMbps)
 {
     avformat_network_init();
 
+    streamUrl = rtspUrl;
+    APP_ERROR ret = OpenInput();
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    // 打印视频信息
+    av_dump_format(formatContext, 0, rtspUrl.c_str(), 0);
+    vSock = socket(AF_INET, SOCK_DGRAM, 0);
+    iSock = socket(AF_INET, SOCK_DGRAM, 0);
+    this->clientIp = clientIp;
+    this->videoPort = videoPort;
+    this->resultPort = resultPort;
+    this->relayRateMbps = relayRateMbps;
+    LogInfo << "stream " << streamId << " (" << avcodec_get_name(codecId) << ") on "
+            << (decoderType == DECODER_DVPP ? "VDEC channel " + std::to_string(channelId) : "the software decoder")
+            << " sends to " << clientIp << ":" << videoPort << "/" << resultPort;
+    return APP_ERR_OK;
+}
+
+APP_ERROR VideoProcess::OpenInput()
+{
     AVDictionary *options = nullptr;
-    av_dict_set(&options, "rtsp_transport", "tcp", 0);
-    av_dict_set(&options, "stimeout", "3000000", 0);
+    if (replayMode == REPLAY_OFF) {
+        av_dict_set(&options, "rtsp_transport", "tcp", 0);
+        av_dict_set(&options, "stimeout", "3000000", 0);
+    }
     // ffmpeg打开流媒体-视频流
-    APP_ERROR ret = avformat_open_input(&formatContext, rtspUrl.c_str(), nullptr, &options);
+    APP_ERROR ret = avformat_open_input(&formatContext, streamUrl.c_str(), nullptr, &options);
     if (options != nullptr) {
         av_dict_free(&options);
     }
     if(ret != APP_ERR_OK){
-        LogError << "Couldn't open input stream " << rtspUrl.c_str() <<  " ret = " << ret;
+        LogError << "Couldn't open input stream " << streamUrl.c_str() <<  " ret = " << ret;
         return APP_ERR_STREAM_NOT_EXIST;
     }
     // 获取视频的相关信息
     ret = avformat_find_stream_info(formatContext, nullptr);
     if(ret != APP_ERR_OK){
         LogError << "Couldn't find stream information";
+        CloseInput();
         return APP_ERR_STREAM_NOT_EXIST;
     }
 
     // formatContext 是一个表示视频文件格式的结构体，它存储了视频文件中所有的流（轨道）信息，包括视频流、音频流等
-    // _videoIndex 初始值为 -1，表示尚未找到视频流
+    // videoIndex 初始值为 -1，表示尚未找到视频流
     // nb_streams 表示视频文件中包含的流的个数
-    for (int i = 0; (i < formatContext->nb_streams) && (_videoIndex == -1); i++)
+    videoIndex = -1;
+    for (int i = 0; (i < (int)formatContext->nb_streams) && (videoIndex == -1); i++)
     // 遍历所有的multimedia container中的streams
     {
         switch (formatContext->streams[i]->codec->codec_type)
         // 第i个流的type（audio, video, subtitle，等）
         {
         case AVMEDIA_TYPE_VIDEO:
-            _videoIndex = i; //找到流
+            videoIndex = i; //找到流
             formatContext->streams[i]->discard = AVDISCARD_NONE; // 不丢弃
             break;
         default:
@@ -84,364 +219,618 @@ APP_ERROR VideoProcess::StreamInit(const std::string &rtspUrl,const std::string
         }
     }    
 
-    // 打印视频信息
-    av_dump_format(formatContext, 0, rtspUrl.c_str(), 0);
-    vSock = socket(AF_INET, SOCK_DGRAM, 0);
-    iSock = socket(AF_INET, SOCK_DGRAM, 0);
-    _clientIp=clientIp;
+    if (videoIndex == -1) {
+        LogError << "No video stream in " << streamUrl;
+        CloseInput();
+        return APP_ERR_STREAM_NOT_EXIST;
+    }
+    // 分辨率取自码流参数，子码流(720p等)无需改代码
+    const AVCodecParameters *codecpar = formatContext->streams[videoIndex]->codecpar;
+    if (codecpar->width <= 0 || codecpar->height <= 0) {
+        LogError << "No picture size in " << streamUrl;
+        CloseInput();
+        return APP_ERR_STREAM_NOT_EXIST;
+    }
+    if (frameWidth != 0 && ((uint32_t)codecpar->width != frameWidth || (uint32_t)codecpar->height != frameHeight)) {
+        LogWarn << "stream " << streamId << " changed from " << frameWidth << "x" << frameHeight << " to "
+                << codecpar->width << "x" << codecpar->height;
+    }
+    // 解码器按首次打开的编码格式创建，重连后编码格式不能改变
+    if (!IsSupportedCodec(codecpar->codec_id)) {
+        LogError << streamUrl << " is " << avcodec_get_name(codecpar->codec_id) << ", only H.264 and H.265 are decoded";
+        CloseInput();
+        return APP_ERR_STREAM_NOT_EXIST;
+    }
+    if (codecId != AV_CODEC_ID_NONE && codecpar->codec_id != codecId) {
+        LogError << "stream " << streamId << " changed from " << avcodec_get_name(codecId) << " to "
+                 << avcodec_get_name(codecpar->codec_id) << ", restart it to switch decoders";
+        CloseInput();
+        return APP_ERR_STREAM_NOT_EXIST;
+    }
+    codecId = codecpar->codec_id;
+    frameWidth = (uint32_t)codecpar->width;
+    frameHeight = (uint32_t)codecpar->height;
+    ret = InitBitstreamFilter();
+    if (ret != APP_ERR_OK) {
+        CloseInput();
+        return ret;
+    }
     return APP_ERR_OK;
 }
 
-APP_ERROR VideoProcess::StreamDeInit()
+void VideoProcess::CloseInput()
 {
+    if (bsfContext != nullptr) {
+        av_bsf_free(&bsfContext);
+    }
     avformat_close_input(&formatContext);
-    return APP_ERR_OK;
+    videoIndex = -1;
 }
 
-// 每进行一次视频帧解码会调用一次该函数，将解码后的帧信息存入对列中
-APP_ERROR VideoProcess::VideoDecodeCallback(std::shared_ptr<void> buffer, MxBase::DvppDataInfo &inputDataInfo, 
-                                            void *userData)
+APP_ERROR VideoProcess::Reconnect()
 {
-    auto deleter = [] (MxBase::MemoryData *mempryData) {
-        if (mempryData == nullptr) {
-            LogError << "MxbsFree failed";
-            return;
+    CloseInput();
+    auto lostTime = std::chrono::steady_clock::now();
+    uint32_t backoffMs = 0;
+    uint32_t attempts = 0;
+    while (!IsStopped()) {
+        // 按退避时间分段等待，以便及时响应停止
+        auto retryTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(backoffMs);
+        while (!IsStopped() && std::chrono::steady_clock::now() < retryTime) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(RECONNECT_POLL_MS));
         }
-        APP_ERROR ret = MxBase::MemoryHelper::MxbsFree(*mempryData);
-        delete mempryData;
-        if (ret != APP_ERR_OK) {
-            LogError << GetError(ret) << " MxbsFree failed";
-            return;
+        if (IsStopped()) {
+            break;
         }
-        LogInfo << "MxbsFree successfully";
-    };
-    // 解码后的视频信息
-    auto output = std::shared_ptr<MxBase::MemoryData>(new MxBase::MemoryData(buffer.get(),
-                     (size_t)inputDataInfo.dataSize, MxBase::MemoryData::MEMORY_DVPP, inputDataInfo.frameId), deleter);
-
-    if (userData == nullptr) {
-        LogError << "userData is nullptr";
-        return APP_ERR_COMM_INVALID_POINTER;
+        attempts++;
+        if (OpenInput() == APP_ERR_OK) {
+            metrics.reconnects->Add();
+            waitKeyFrame = true;
+            skippedPackets = 0;
+            LogWarn << "stream " << streamId << " reconnected after " << attempts << " attempt(s), "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - lostTime).count() << " ms";
+            return APP_ERR_OK;
+        }
+        backoffMs = backoffMs == 0 ? RECONNECT_MIN_BACKOFF_MS : std::min(backoffMs * 2, RECONNECT_MAX_BACKOFF_MS);
     }
-    auto *queue = (BlockingQueue<std::shared_ptr<void>>*)userData;
-    queue->Push(output);
-    return APP_ERR_OK;
+    return APP_ERR_COMM_CONNECTION_CLOSE;
 }
 
-APP_ERROR VideoProcess::VideoDecodeInit()
+APP_ERROR VideoProcess::InitBitstreamFilter()
 {
-    MxBase::VdecConfig vdecConfig;
-    // 将解码函数的输入格式设为H264
-    vdecConfig.inputVideoFormat = MxBase::MXBASE_STREAM_FORMAT_H264_MAIN_LEVEL;
-    // 将解码函数的输出格式设为YUV420
-    vdecConfig.outputImageFormat = MxBase::MXBASE_PIXEL_FORMAT_YUV_SEMIPLANAR_420;
-    vdecConfig.deviceId = DEVICE_ID;
-    vdecConfig.channelId = CHANNEL_ID;
-    vdecConfig.callbackFunc = VideoDecodeCallback;
-    vdecConfig.outMode = 1;
-
-    vDvppWrapper = std::make_shared<MxBase::DvppWrapper>();
-    if (vDvppWrapper == nullptr) {
-        LogError << "Failed to create dvppWrapper";
+    const AVCodecParameters *codecpar = formatContext->streams[videoIndex]->codecpar;
+    // avcC/hvcC extradata starts with version 1, an Annex-B stream (RTSP, .h264, .h265) needs no filter
+    if (codecpar->extradata == nullptr || codecpar->extradata_size == 0 || codecpar->extradata[0] != 1) {
+        return APP_ERR_OK;
+    }
+    const char *filterName = codecpar->codec_id == AV_CODEC_ID_HEVC ? "hevc_mp4toannexb" : "h264_mp4toannexb";
+    const AVBitStreamFilter *filter = av_bsf_get_by_name(filterName);
+    if (filter == nullptr || av_bsf_alloc(filter, &bsfContext) < 0) {
+        LogError << filterName << " is not available";
         return APP_ERR_COMM_INIT_FAIL;
     }
-    APP_ERROR ret = vDvppWrapper->InitVdec(vdecConfig);
-    if (ret != APP_ERR_OK) {
-        LogError << "Failed to initialize dvppWrapper";
-        return ret;
+    avcodec_parameters_copy(bsfContext->par_in, codecpar);
+    bsfContext->time_base_in = formatContext->streams[videoIndex]->time_base;
+    if (av_bsf_init(bsfContext) < 0) {
+        LogError << "Failed to init " << filterName;
+        av_bsf_free(&bsfContext);
+        return APP_ERR_COMM_INIT_FAIL;
     }
+    LogInfo << "stream " << streamId << " converted to Annex-B by " << filterName;
     return APP_ERR_OK;
 }
 
-APP_ERROR VideoProcess::VideoDecodeDeInit()
+APP_ERROR VideoProcess::StreamDeInit()
 {
-    APP_ERROR ret = vDvppWrapper->DeInitVdec();
-    if (ret != APP_ERR_OK) {
-        LogError << "Failed to deinitialize dvppWrapper";
-        return ret;
+    CloseInput();
+    if (vSock >= 0) {
+        close(vSock);
+        vSock = -1;
+    }
+    if (iSock >= 0) {
+        close(iSock);
+        iSock = -1;
     }
     return APP_ERR_OK;
 }
 
-APP_ERROR VideoProcess::VideoDecode(MxBase::MemoryData &streamData, const uint32_t &height, 
-                                    const uint32_t &width, void *userData)
+// 解码器每输出一帧调用一次该函数，将解码后的帧信息存入对列中
+void VideoProcess::OnDecodedFrame(const std::shared_ptr<MxBase::MemoryData> &frame, const FrameGeometry &geometry,
+                                  uint32_t frameId)
 {
-    static uint32_t frameId = 0;
-    // 将帧数据从Host侧移到Device侧
-    MxBase::MemoryData dvppMemory((size_t)streamData.size,
-                                  MxBase::MemoryData::MEMORY_DVPP, DEVICE_ID);
-    APP_ERROR ret = MxBase::MemoryHelper::MxbsMallocAndCopy(dvppMemory, streamData);
+    DecodedFrame decoded;
+    decoded.data = frame;
+    decoded.geometry = geometry;
+    decoded.frameId = frameId;
+    decoded.decodeTime = std::chrono::steady_clock::now();
+    decoded.captureUs = decodeCaptureUs[frameId % DECODE_TRACK_SIZE].load(std::memory_order_relaxed);
+    int64_t submitNs = decodeSubmitNs[frameId % DECODE_TRACK_SIZE].load(std::memory_order_relaxed);
+    if (submitNs != 0) {
+        int64_t decodeNs = SteadyNowNs() - submitNs;
+        metrics.decode->Observe(decodeNs > 0 ? (uint64_t)decodeNs / 1000 : 0);
+    }
+    // a rejected frame is counted by the queue and its buffer is released by the decoder's deleter
+    APP_ERROR ret = frameQueue->Push(decoded);
+    if (ret != APP_ERR_OK && ret != APP_ERR_QUEUE_FULL) {
+        HotLogRate(HOT_LOG_LEVEL_ERROR, 1) << "Push decoded frame failed, ret=" << ret << ".";
+    }
+}
+
+APP_ERROR VideoProcess::VideoDecodeInit()
+{
+    decoder = CreateVideoDecoder(decoderType);
+    DecoderInitParam param;
+    // 码流经过mp4toannexb时，解码器使用转换后的参数集
+    param.codecpar = bsfContext != nullptr ? bsfContext->par_out : formatContext->streams[videoIndex]->codecpar;
+    param.deviceId = deviceId;
+    param.channelId = channelId;
+    param.threadNum = decodeThreads;
+    param.outputMemoryType = frameMemoryType;
+    APP_ERROR ret = decoder->Init(param, [this](const std::shared_ptr<MxBase::MemoryData> &frame,
+                                                const FrameGeometry &geometry, uint32_t frameId) {
+        OnDecodedFrame(frame, geometry, frameId);
+    });
     if (ret != APP_ERR_OK) {
-        LogError << "Failed to MxbsMallocAndCopy";
+        LogError << "Failed to initialize the decoder of stream " << streamId;
+        decoder.reset();
         return ret;
     }
-    // 构建DvppDataInfo结构体以便解码
-    MxBase::DvppDataInfo inputDataInfo;
-    inputDataInfo.dataSize = dvppMemory.size;
-    inputDataInfo.data = (uint8_t *)dvppMemory.ptrData;
-    inputDataInfo.height = VIDEO_HEIGHT;
-    inputDataInfo.width = VIDEO_WIDTH;
-    inputDataInfo.channelId = CHANNEL_ID;
-    inputDataInfo.frameId = frameId;
-    ret = vDvppWrapper->DvppVdec(inputDataInfo, userData);
+    return APP_ERR_OK;
+}
 
+APP_ERROR VideoProcess::VideoDecodeDeInit()
+{
+    if (decoder == nullptr) {
+        return APP_ERR_OK;
+    }
+    APP_ERROR ret = decoder->DeInit();
     if (ret != APP_ERR_OK) {
-        LogError << "DvppVdec Failed";
-        MxBase::MemoryHelper::MxbsFree(dvppMemory);
+        LogError << "Failed to deinitialize the decoder of stream " << streamId;
         return ret;
     }
-    frameId++;
     return APP_ERR_OK;
 }
 
 // 获取视频帧
-void VideoProcess::GetFrames(std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>  blockingQueue, 
+void VideoProcess::GetFrames(std::shared_ptr<DecodedFrameQueue> blockingQueue, 
                             std::shared_ptr<VideoProcess> videoProcess)
 {
-    MxBase::DeviceContext device;
-    device.devId = DEVICE_ID;
-    APP_ERROR ret = MxBase::DeviceManager::GetInstance()->SetDevice(device);
-    if (ret != APP_ERR_OK) {
-        LogError << "SetDevice failed";
-        return;
+    if (videoProcess->UsesDevice()) {
+        MxBase::DeviceContext device;
+        device.devId = videoProcess->deviceId;
+        if (MxBase::DeviceManager::GetInstance()->SetDevice(device) != APP_ERR_OK) {
+            LogError << "SetDevice failed";
+            videoProcess->inputDone = true;
+            return;
+        }
     }
 
+    videoProcess->frameQueue = blockingQueue;
+    APP_ERROR ret = videoProcess->relay->Start(videoProcess->vSock, videoProcess->clientIp,
+                                               videoProcess->videoPort, videoProcess->relayRateMbps);
+    if (ret != APP_ERR_OK) {
+        LogError << "Video relay start failed, stream " << videoProcess->streamId << " is not relayed";
+    }
     AVPacket pkt;
-    while(!stopFlag){
+    while (!videoProcess->IsStopped()) {
         av_init_packet(&pkt);
         // 读取视频帧
-        APP_ERROR ret = av_read_frame(formatContext, &pkt);
+        auto demuxStart = std::chrono::steady_clock::now();
+        APP_ERROR ret = av_read_frame(videoProcess->formatContext, &pkt);
+        videoProcess->metrics.demux->ObserveSince(demuxStart);
         if(ret != APP_ERR_OK){
-            LogError << "Read frame failed, continue";
-            if(ret == AVERROR_EOF){
-                LogError << "StreamPuller is EOF, over!";
+            if (ret == AVERROR(EAGAIN)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            if(ret == AVERROR_EOF && videoProcess->replayMode != REPLAY_OFF){
+                LogInfo << "StreamPuller is EOF, over!";
+                break;
+            }
+            videoProcess->metrics.readErrors->Add();
+            if (videoProcess->replayMode != REPLAY_OFF) {
+                LogError << "Read frame failed, ret=" << ret << ", replay stopped";
+                break;
+            }
+            // 直播流断开：只重新打开输入，模型与解码器保持不变
+            LogWarn << "Read frame failed, ret=" << ret << ", reconnecting stream " << videoProcess->streamId;
+            if (videoProcess->Reconnect() != APP_ERR_OK) {
                 break;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
-        if(pkt.stream_index!=_videoIndex){
+        if (pkt.stream_index != videoProcess->videoIndex) {
             av_packet_unref(&pkt);
             continue;
         }
-
-        // 原始帧数据被存储在Host侧
-        MxBase::MemoryData streamData((void *)pkt.data, (size_t)pkt.size,
-                                      MxBase::MemoryData::MEMORY_HOST_NEW, DEVICE_ID);
-        ret = videoProcess->VideoDecode(streamData, VIDEO_HEIGHT, VIDEO_WIDTH, (void*)blockingQueue.get());
-        if (ret != APP_ERR_OK) {
-            LogError << "VideoDecode failed";
-            return;
-        }
-        {
-         struct sockaddr_in addr;
-            addr.sin_family = AF_INET;
-            addr.sin_port = htons(6071);
-            addr.sin_addr.s_addr = inet_addr(_clientIp.c_str());
-       char buf[1440];
-            buf[0]=0x55;
-            buf[1]=0xaa;
-            buf[2]=0x55;
-            buf[3]=0xaa;
-            int offset = 0;
-            int cnt =(pkt.size+1399)/1400;
-            int i = 0;
-            for(i=0;i<pkt.size/1400;i++){
-                memcpy(buf+4,&cnt,4);
-                memcpy(buf+8,&i,4);
-                memcpy(buf+40,pkt.data+offset,1400);
-                sendto(vSock, buf, 1440 , 0, (struct sockaddr *)&addr, sizeof(addr));            
-                if(i%4==0)
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                offset+=1400;
+        // 从IDR帧开始解码，之前的帧缺少参考帧
+        if (videoProcess->waitKeyFrame) {
+            if ((pkt.flags & AV_PKT_FLAG_KEY) == 0) {
+                videoProcess->skippedPackets++;
+                av_packet_unref(&pkt);
+                continue;
+            }
+            videoProcess->waitKeyFrame = false;
+            if (videoProcess->skippedPackets != 0) {
+                LogInfo << "stream " << videoProcess->streamId << " resumed at an IDR frame, skipped "
+                        << videoProcess->skippedPackets << " packets";
             }
-            if(offset<pkt.size){
-                memcpy(buf+4,&cnt,4);
-                memcpy(buf+8,&i,4);
-                memcpy(buf+40,pkt.data+offset,pkt.size-offset);
-                sendto(vSock, buf,pkt.size-offset+40, 0, (struct sockaddr *)&addr, sizeof(addr));            
-            }            
+        }
+
+        if (videoProcess->bsfContext == nullptr) {
+            ret = videoProcess->SubmitPacket(pkt);
+        } else {
+            ret = videoProcess->FilterPacket(&pkt);
         }
         av_packet_unref(&pkt);
+        if (ret != APP_ERR_OK) {
+            // 解码器保留，丢弃到下一个IDR帧
+            HotLogRate(HOT_LOG_LEVEL_ERROR, 1) << "VideoDecode failed, ret=" << ret
+                                               << ", waiting for the next IDR frame";
+            videoProcess->waitKeyFrame = true;
+            videoProcess->skippedPackets = 0;
+        }
     }
     av_packet_unref(&pkt);
+    if (videoProcess->replayMode != REPLAY_OFF) {
+        videoProcess->FinishReplayInput();
+    }
+    videoProcess->relay->Stop();
 }
 
-APP_ERROR VideoProcess::SaveResult(std::shared_ptr<MxBase::MemoryData> resultInfo, const uint32_t frameId,
-                     const std::vector<MxBase::ObjectInfo>& objInfos,
-                     const std::vector<MxBase::TensorBase>& keyPointInfos)
+APP_ERROR VideoProcess::FilterPacket(AVPacket *pkt)
 {
-    // 将推理结果从Device侧移到Host侧
-    MxBase::MemoryData memoryDst(resultInfo->size,MxBase::MemoryData::MEMORY_HOST_NEW);
-    APP_ERROR ret = MxBase::MemoryHelper::MxbsMallocAndCopy(memoryDst, *resultInfo);
-    if(ret != APP_ERR_OK){
-        LogError << "Fail to malloc and copy host memory.";
-        return ret;
+    // the filter takes over the packet's reference
+    if (av_bsf_send_packet(bsfContext, pkt) < 0) {
+        LogError << "mp4toannexb rejected a packet";
+        return APP_ERR_COMM_FAILURE;
     }
-    // 初始化OpenCV图像信息矩阵
-    cv::Mat imgYuv = cv::Mat(VIDEO_HEIGHT* YUV_BYTE_NU / YUV_BYTE_DE, VIDEO_WIDTH, CV_8UC1, memoryDst.ptrData);
-    cv::Mat imgBgr = cv::Mat(VIDEO_HEIGHT, VIDEO_WIDTH, CV_8UC3);
-    // 颜色空间转换
-    cv::cvtColor(imgYuv, imgBgr, cv::COLOR_YUV2BGR_NV12);
-    for (uint32_t i = 0; i < objInfos.size(); i++) {
-        MxBase::ObjectInfo oi = objInfos[i];
-        MxBase::TensorBase kpi = keyPointInfos[i];
-        int ow = oi.x1 - oi.x0;
-        int oh = oi.y1 - oi.y0;        
-
-        const cv::Scalar green = cv::Scalar(0, 255, 0);
-        const cv::Scalar red = cv::Scalar(0, 0, 255);
-        const uint32_t thickness = 4;
-        const uint32_t xOffset = 10;
-        const uint32_t yOffset = 10;
-        const uint32_t lineType = 8;
-        const float fontScale = 1.0;
-
-        // 绘制矩形
-        cv::rectangle(imgBgr,cv::Rect(oi.x0, oi.y0, ow, oh),green, thickness);
-        
-        float* ptr = (float*)kpi.GetBuffer();            
-        int arrSize = kpi.GetSize()/2;
-        int x[21],y[21];
-        for(int j=0;j<arrSize;j++){
-            float fx = *(ptr++);
-            float fy = *(ptr++);
-            x[j] = (fx*ow)+oi.x0;
-            y[j] = (fy*oh)+oi.y0;
-            LogInfo << "keypoints[ " << j << "]:" << x << "," << y ;
-        }
-        for(int m=0;m<5;m++){
-            int from = 0;
-            int to = m*4+1;
-            cv::line(imgBgr,cv::Point(x[from],y[from]),cv::Point(x[to],y[to]),red);
-            for(int n=0;n<4;n++){
-                from=to;
-                to++;
-                cv::line(imgBgr,cv::Point(x[from],y[from]),cv::Point(x[to],y[to]),red);
-            }
+    AVPacket filtered;
+    av_init_packet(&filtered);
+    filtered.data = nullptr;
+    filtered.size = 0;
+    while (av_bsf_receive_packet(bsfContext, &filtered) == 0) {
+        APP_ERROR ret = SubmitPacket(filtered);
+        av_packet_unref(&filtered);
+        if (ret != APP_ERR_OK) {
+            return ret;
         }
+    }
+    return APP_ERR_OK;
+}
 
+APP_ERROR VideoProcess::SubmitPacket(AVPacket &pkt)
+{
+    if (replayMode == REPLAY_REALTIME) {
+        PaceReplay(pkt);
     }
-    std::string fileName = "./result/result" + std::to_string(frameId+1) + ".jpg";
-    cv::imwrite(fileName, imgBgr);
-    ret = MxBase::MemoryHelper::MxbsFree(memoryDst);
-    if(ret != APP_ERR_OK){
-        LogError << "Fail to MxbsFree memory.";
+    uint32_t slot = decodeFrameId % DECODE_TRACK_SIZE;
+    decodeCaptureUs[slot].store(CaptureTimeUs(pkt), std::memory_order_relaxed);
+    decodeSubmitNs[slot].store(SteadyNowNs(), std::memory_order_relaxed);
+    // 原始帧数据在Host侧，由解码器决定是否搬到Device侧
+    APP_ERROR ret = decoder->Decode(pkt.data, (size_t)pkt.size, frameWidth, frameHeight, decodeFrameId);
+    if (ret != APP_ERR_OK) {
         return ret;
     }
+    decodeFrameId++;
+    // 转发给客户端，发送线程持有数据包引用，不阻塞解封装
+    relay->Send(pkt);
     return APP_ERR_OK;
 }
 
-void VideoProcess::GetResults(std::shared_ptr<BlockingQueue<std::shared_ptr<void>>> blockingQueue, 
-                              std::shared_ptr<Yolov3Detection> yolov3Detection,
-                              std::shared_ptr<ResnetDetector> resnetDetection, 
-                              std::shared_ptr<VideoProcess> videoProcess)
+void VideoProcess::PaceReplay(const AVPacket &pkt)
 {
-    uint32_t frameId = 0;
-    MxBase::DeviceContext device;
-    device.devId = DEVICE_ID;
-    APP_ERROR ret = MxBase::DeviceManager::GetInstance()->SetDevice(device);
-    if (ret != APP_ERR_OK) {
-        LogError << "SetDevice failed";
+    // decode order timestamps increase monotonically, pts does not with B-frames
+    int64_t ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+    if (ts == AV_NOPTS_VALUE) {
         return;
     }
-    int noObjCnt = 0;
-    struct sockaddr_in addr;
-            addr.sin_family = AF_INET;
-            addr.sin_port = htons(6072);
-            addr.sin_addr.s_addr = inet_addr(_clientIp.c_str());
- 
-    while (!stopFlag) {
-        std::shared_ptr<void> data = nullptr;
-        // 从队列中去出解码后的帧数据
-        APP_ERROR ret = blockingQueue->Pop(data, QUEUE_POP_WAIT_TIME);
-        if (ret != APP_ERR_OK) {
-            LogError << "Pop failed";
-            return;
-        }
-        struct timeval tv0,tv1;
-         gettimeofday(&tv0,NULL);
-        LogInfo << "get result:";
+    int64_t tsUs = av_rescale_q(ts, formatContext->streams[videoIndex]->time_base, AV_TIME_BASE_Q);
+    if (!replayClockStarted) {
+        replayClockStarted = true;
+        replayStartTime = std::chrono::steady_clock::now();
+        replayFirstUs = tsUs;
+        return;
+    }
+    std::this_thread::sleep_until(replayStartTime + std::chrono::microseconds(tsUs - replayFirstUs));
+}
 
-        MxBase::TensorBase resizeFrame;
-        auto result = std::make_shared<MxBase::MemoryData>();
-        result = std::static_pointer_cast<MxBase::MemoryData>(data);
+void VideoProcess::FinishReplayInput()
+{
+    if (bsfContext != nullptr && !IsStopped()) {
+        FilterPacket(nullptr);
+    }
+    // without the flush the decoder keeps its last reference frames until more input arrives
+    APP_ERROR ret = decoder->Flush();
+    if (ret != APP_ERR_OK) {
+        LogWarn << "Decoder flush failed, ret=" << ret;
+    }
+    uint64_t decoded = frameQueue->GetPushedCount();
+    auto lastProgress = std::chrono::steady_clock::now();
+    while (!IsStopped() && decoded < decodeFrameId) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(DECODE_DRAIN_POLL_MS));
+        uint64_t now = frameQueue->GetPushedCount();
+        if (now != decoded) {
+            decoded = now;
+            lastProgress = std::chrono::steady_clock::now();
+        } else if (std::chrono::steady_clock::now() - lastProgress >
+                   std::chrono::milliseconds(DECODE_DRAIN_TIMEOUT_MS)) {
+            LogWarn << "stream " << streamId << ": " << (decodeFrameId - decoded) << " of " << decodeFrameId
+                    << " packets never came out of the decoder";
+            break;
+        }
+    }
+    inputDone = true;
+}
 
-        // 图像缩放
-        ret = yolov3Detection->ResizeFrame(result, VIDEO_HEIGHT, VIDEO_WIDTH,resizeFrame);
-        if (ret != APP_ERR_OK) {
-            LogError << "Resize failed";
+void VideoProcess::GetResults(std::shared_ptr<DecodedFrameQueue> blockingQueue, 
+                              std::shared_ptr<VideoProcess> videoProcess)
+{
+    uint32_t frameId = 0;
+    std::shared_ptr<WorkerReplica> worker = videoProcess->worker;
+    std::shared_ptr<Yolov3Detection> yolov3Detection = worker->yolov3;
+    std::shared_ptr<ResnetDetector> resnetDetection = worker->resnet;
+    if (videoProcess->UsesDevice()) {
+        MxBase::DeviceContext device;
+        device.devId = videoProcess->deviceId;
+        if (MxBase::DeviceManager::GetInstance()->SetDevice(device) != APP_ERR_OK) {
+            LogError << "SetDevice failed";
             return;
         }
-
-        std::vector<MxBase::TensorBase> inputs = {};
-        std::vector<MxBase::TensorBase> outputs = {};
-        inputs.push_back(resizeFrame);
+    }
+    uint64_t reportedDrops = 0;
+    uint64_t poppedFrames = 0;
+
+    // resize → detect → [face] → postprocess → crop → keypoints → send, each stage on its own worker
+    std::string metricLabels = MetricLabels({{"stream", std::to_string(videoProcess->streamId)}});
+    FramePipeline pipeline(metricLabels);
+    // 检测帧之间由上一帧关键点预测手部区域
+    auto tracker = std::make_shared<HandTracker>(videoProcess->trackParam, metricLabels);
+    pipeline.AddStage("resize", [yolov3Detection, tracker](FrameContext &context) -> APP_ERROR {
+        context.tracked = !tracker->ShouldDetect(context.frameId);
+        if (context.tracked) {
+            return APP_ERR_OK;
+        }
+        // 图像缩放
+        return yolov3Detection->ResizeFrame(context.frame, context.geometry, context.resizeFrame);
+    });
+    std::shared_ptr<Yolov3Detection> faceDetection = worker->face;
+    pipeline.AddStage("detect", [yolov3Detection, faceDetection](FrameContext &context) -> APP_ERROR {
+        if (context.tracked) {
+            return APP_ERR_OK;
+        }
+        std::vector<MxBase::TensorBase> inputs = {*context.resizeFrame};
         // 推理
-        ret = yolov3Detection->Inference(inputs, outputs);
-        if (ret != APP_ERR_OK) {
-            LogError << "Inference failed, ret=" << ret << ".";
-            return;
+        APP_ERROR ret = yolov3Detection->Inference(inputs, context.detectOutputs);
+        // 人脸检测复用同一张缩放图，由下一级释放；推理失败时帧不再往下走，立即释放
+        if (faceDetection == nullptr || ret != APP_ERR_OK) {
+            context.resizeFrame.reset();
+        }
+        return ret;
+    });
+    if (faceDetection != nullptr) {
+        // own worker: faces of frame N are detected while the hand detector runs on frame N+1, so
+        // throughput overlaps but a detected frame's latency is both inferences plus one queue hop; the
+        // stage shows up as "face" in the latency report. Frames between detections keep the last faces,
+        // like the hands are tracked in between
+        auto lastFaces = std::make_shared<std::vector<MxBase::ObjectInfo>>();
+        pipeline.AddStage("face", [faceDetection, lastFaces](FrameContext &context) -> APP_ERROR {
+            if (context.tracked) {
+                context.faces = *lastFaces;
+                return APP_ERR_OK;
+            }
+            std::vector<MxBase::TensorBase> inputs = {*context.resizeFrame};
+            OutputTensorHandle outputs;
+            APP_ERROR ret = faceDetection->Inference(inputs, outputs);
+            context.resizeFrame.reset();
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+            std::vector<std::vector<MxBase::ObjectInfo>> objInfos;
+            ret = faceDetection->PostProcess(*outputs, context.geometry.height, context.geometry.width, objInfos);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
+            SelectFaces(objInfos, context.faces);
+            *lastFaces = context.faces;
+            return APP_ERR_OK;
+        });
+    }
+    HandSelectParam handParam = videoProcess->handParam;
+    pipeline.AddStage("postprocess", [yolov3Detection, handParam, tracker](FrameContext &context) -> APP_ERROR {
+        if (context.tracked) {
+            tracker->Predict(context.frameId, context.geometry.height, context.geometry.width, context.hands);
+            return APP_ERR_OK;
         }
-
-        std::vector<std::vector<MxBase::ObjectInfo>> objInfos;
         // 后处理
-        ret = yolov3Detection->PostProcess(outputs, VIDEO_HEIGHT, VIDEO_WIDTH, objInfos);
+        APP_ERROR ret = yolov3Detection->PostProcess(*context.detectOutputs, context.geometry.height,
+                                                     context.geometry.width, context.objInfos);
+        // 检测输出尽早归还给TensorPool
+        context.detectOutputs.reset();
         if (ret != APP_ERR_OK) {
-            LogError << "PostProcess failed, ret=" << ret << ".";
-            return;
+            return ret;
         }
-
-        if(objInfos.size()==0){
-            frameId++;
-            return;
+        SelectHands(context.objInfos, context.geometry.height, context.geometry.width, handParam, context.hands);
+        return APP_ERR_OK;
+    });
+    pipeline.AddStage("crop", [resnetDetection](FrameContext &context) -> APP_ERROR {
+        for (auto &hand : context.hands) {
+            const MxBase::ObjectInfo &obj = hand.box;
+            APP_ERROR ret = resnetDetection->CropAndResizeFrame(context.frame, context.geometry, obj.x0, obj.y0,
+                                                                obj.x1, obj.y1, hand.cropFrame);
+            if (ret != APP_ERR_OK) {
+                return ret;
+            }
         }
-
-
-
-        // model infer
-        std::vector<MxBase::ObjectInfo> info;
-        std::vector<MxBase::TensorBase> keyPointInfos;    
-        int maxConfIdx = -1;  
-        float maxConfidenceGlobal = 0;      
-        for (uint32_t i = 0; i < objInfos.size(); i++) {
-            if(objInfos[i].size()==0) continue;
-            float maxConfidence = 0;
-            uint32_t index;
-            for (uint32_t j = 0; j < objInfos[i].size(); j++) {
-                if (objInfos[i][j].confidence > maxConfidence) {
-                    maxConfidence = objInfos[i][j].confidence;
-                    index = j;
-                    
+        return APP_ERR_OK;
+    });
+    pipeline.AddStage("keypoints", [resnetDetection, tracker](FrameContext &context) -> APP_ERROR {
+        if (context.hands.empty()) {
+            tracker->Update(context.frameId, context.hands);
+            return APP_ERR_OK;
+        }
+        // 所有手的裁剪图打包为一次批量推理
+        // 句柄保留到推理结束，之后裁剪图缓冲区一起归还
+        std::vector<MxBase::TensorBase> crops;
+        std::vector<InputTensorHandle> cropHandles;
+        for (auto &hand : context.hands) {
+            crops.push_back(*hand.cropFrame);
+            cropHandles.push_back(std::move(hand.cropFrame));
+        }
+        std::vector<std::vector<float>> keypoints;
+        APP_ERROR ret = resnetDetection->BatchInference(crops, keypoints);
+        crops.clear();
+        cropHandles.clear();
+        // 关键点推理完成后不再需要原始帧，需要渲染的帧保留到发送阶段
+        if (!context.render) {
+            context.frame.reset();
+        }
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+        for (size_t i = 0; i < context.hands.size(); i++) {
+            context.hands[i].keypoints.swap(keypoints[i]);
+        }
+        tracker->Update(context.frameId, context.hands);
+        return APP_ERR_OK;
+    });
+    std::shared_ptr<int> noObjCnt = std::make_shared<int>(0);
+    std::shared_ptr<bool> firstResultSent = std::make_shared<bool>(false);
+    // 手势识别在发送阶段按帧顺序进行，结果随关键点数据报一起发出
+    std::shared_ptr<GestureEngine> gestures;
+    if (videoProcess->gestureParam.enabled) {
+        gestures = std::make_shared<GestureEngine>(videoProcess->gestureParam, metricLabels);
+    }
+    pipeline.AddStage("send", [videoProcess, noObjCnt, firstResultSent, gestures](FrameContext &context) -> APP_ERROR {
+        if (gestures != nullptr) {
+            gestures->Process(context.captureUs, context.hands);
+            for (const auto &hand : context.hands) {
+                if (hand.gestureStart) {
+                    HotLogInfo << "stream " << videoProcess->streamId << " frame " << context.frameId << ": "
+                               << GestureName(hand.gesture);
                 }
             }
-
-            info.push_back(objInfos[i][index]);
-            // 打印置信度最大推理结果
-            LogInfo << "id: " << info[i].classId << "; lable: " << info[i].className
-                << "; confidence: " << info[i].confidence
-                << "; box: [ (" << info[i].x0 << "," << info[i].y0 << ") "
-                << "(" << info[i].x1 << "," << info[i].y1 << ") ]";
-        }
-        for (uint32_t i = 0; i < info.size(); i++){
-            if(info[i].confidence>maxConfidenceGlobal){
-                maxConfidenceGlobal = info[i].confidence;
-                maxConfIdx = i;
-            } 
-        }
-        if(maxConfIdx==-1) {
-            noObjCnt++;
-            if(noObjCnt>10){
-               char buf[1040];
-                memset(buf,0,40);
-                sendto(iSock, buf, 40 , 0, (struct sockaddr *)&addr, sizeof(addr));
-                noObjCnt = 0;
+        }
+        videoProcess->SendResult(context, *noObjCnt);
+        if (context.render) {
+            // 结果可视化交给渲染和视频编码线程，不占用流水线
+            RenderJob job;
+            job.streamId = videoProcess->streamId;
+            job.frameId = context.frameId;
+            job.captureUs = context.captureUs;
+            job.frame = context.frame;
+            job.geometry = context.geometry;
+            job.hands = context.hands;
+            job.faces = context.faces;
+            if (videoProcess->renderer != nullptr && videoProcess->renderer->ShouldRender(context.frameId)) {
+                videoProcess->renderer->Submit(job);
             }
+            if (videoProcess->videoSink != nullptr) {
+                videoProcess->videoSink->Submit(job);
+            }
+            context.frame.reset();
+        }
+        if (!*firstResultSent) {
+            *firstResultSent = true;
+            StartupTimeline::GetInstance()->MarkFirstResult(videoProcess->streamId);
+        }
+        videoProcess->metrics.hands->Add(context.hands.size());
+        videoProcess->metrics.faces->Add(context.faces.size());
+        videoProcess->worker->frames->Add();
+        videoProcess->metrics.frameLatency->ObserveSince(context.startTime);
+        return APP_ERR_OK;
+    });
+    if (!videoProcess->sinkParam.output.empty()) {
+        // 编码线程从本路流所在的设备拷贝帧
+        videoProcess->sinkParam.deviceId = videoProcess->deviceId;
+        videoProcess->sinkParam.bindDevice = videoProcess->UsesDevice();
+        videoProcess->videoSink.reset(new VideoSink(videoProcess->streamId));
+        // 视频输出失败只影响录像，不影响推理
+        if (videoProcess->videoSink->Start(videoProcess->sinkParam) != APP_ERR_OK) {
+            LogWarn << "video output disabled for stream " << videoProcess->streamId;
+            videoProcess->videoSink.reset();
+        }
+    }
+    APP_ERROR ret = pipeline.Start(videoProcess->deviceId, videoProcess->UsesDevice());
+    if (ret != APP_ERR_OK) {
+        LogError << "Pipeline start failed";
+        videoProcess->videoSink.reset();
+        return;
+    }
 
+    while (!videoProcess->IsStopped()) {
+        DecodedFrame data;
+        // read before the pop: once set, an empty queue stays empty
+        bool inputDone = videoProcess->inputDone;
+        // 从队列中去出解码后的帧数据
+        ret = blockingQueue->Pop(data, QUEUE_POP_WAIT_TIME);
+        if (ret == APP_ERR_QUEUE_EMPTY) {
+            if (inputDone) {
+                break;
+            }
             continue;
         }
-        noObjCnt = 0;
-        MxBase::ObjectInfo obj = info[maxConfIdx];
+        if (ret != APP_ERR_OK) {
+            LogError << "Pop failed";
+            break;
+        }
+        videoProcess->metrics.queueWait->ObserveSince(data.decodeTime);
+        if (++poppedFrames % DROP_REPORT_INTERVAL == 0) {
+            if (blockingQueue->GetDroppedCount() != reportedDrops) {
+                reportedDrops = blockingQueue->GetDroppedCount();
+                LogWarn << "inference is behind the stream, dropped " << reportedDrops << " of "
+                        << blockingQueue->GetPushedCount() << " decoded frames";
+            }
+            pipeline.ReportOccupancy();
+        }
+
+        auto context = std::make_shared<FrameContext>();
+        context->frameId = frameId++;
+        context->geometry = data.geometry;
+        context->frame = data.data;
+        context->startTime = data.decodeTime;
+        context->captureUs = data.captureUs;
+        context->render = (videoProcess->renderer != nullptr &&
+                           videoProcess->renderer->ShouldRender(context->frameId)) ||
+                          (videoProcess->videoSink != nullptr && videoProcess->videoSink->IsRunning());
+        // 流水线首级满时在此等待，解码队列按其策略丢帧
+        if (pipeline.Push(context) != APP_ERR_OK) {
+            break;
+        }
+    }
+    // replay: let the frames in flight finish so every decoded frame is accounted for
+    bool drained = !videoProcess->inputDone;
+    while (!drained && !videoProcess->IsStopped()) {
+        drained = pipeline.Drain(QUEUE_POP_WAIT_TIME);
+    }
+    pipeline.Stop();
+    // 流水线停止后不再有新帧，收尾写完视频文件
+    videoProcess->videoSink.reset();
+}
+
+void VideoProcess::SelectHands(const std::vector<std::vector<MxBase::ObjectInfo>> &objInfos, uint32_t height,
+                               uint32_t width, const HandSelectParam &param, std::vector<HandResult> &hands)
+{
+    hands.clear();
+    std::vector<MxBase::ObjectInfo> info;
+    for (uint32_t i = 0; i < objInfos.size(); i++) {
+        info.insert(info.end(), objInfos[i].begin(), objInfos[i].end());
+    }
+    std::stable_sort(info.begin(), info.end(), [](const MxBase::ObjectInfo &a, const MxBase::ObjectInfo &b) {
+        return a.confidence > b.confidence;
+    });
+    for (uint32_t i = 0; i < info.size() && hands.size() < param.maxHands; i++) {
+        // 置信度最高的手总是保留，其余需达到阈值
+        if (i > 0 && info[i].confidence < param.minConfidence) {
+            break;
+        }
+        MxBase::ObjectInfo obj = info[i];
+        // 打印推理结果
+        HotLogDebug << "id: " << obj.classId << "; lable: " << obj.className
+            << "; confidence: " << obj.confidence
+            << "; box: [ (" << obj.x0 << "," << obj.y0 << ") "
+            << "(" << obj.x1 << "," << obj.y1 << ") ]";
         int w = obj.x1 - obj.x0;
         int h = obj.y1 - obj.y0;
         obj.x0 = (obj.x1+obj.x0)/2 - w*3/4;
@@ -450,70 +839,139 @@ void VideoProcess::GetResults(std::shared_ptr<BlockingQueue<std::shared_ptr<void
         obj.y1 = (obj.y1+obj.y0)/2 + h*3/4;
         if(obj.x0<0) obj.x0 = 0;
         if(obj.y0<0) obj.y0 = 0;
-        if(obj.x1>=VIDEO_WIDTH-1) obj.x1 = VIDEO_WIDTH-1;
-        if(obj.y1>=VIDEO_HEIGHT-1) obj.y1 = VIDEO_HEIGHT-1;
-        MxBase::TensorBase keypoint;
-
-        MxBase::TensorBase cropFrame;
-        ret = resnetDetection->CropAndResizeFrame(result, VIDEO_HEIGHT, VIDEO_WIDTH, obj.x0, obj.y0, obj.x1, obj.y1, cropFrame);
-        if (ret != APP_ERR_OK)
-        {
-            LogError << "Resize failed";
-            return;
-        }
-        std::vector<MxBase::TensorBase> rinputs = {};
-        std::vector<MxBase::TensorBase> routputs = {};
-        rinputs.push_back(cropFrame);
+        if(obj.x1>=width-1) obj.x1 = width-1;
+        if(obj.y1>=height-1) obj.y1 = height-1;
+        HandResult hand;
+        hand.box = obj;
+        hands.push_back(hand);
+    }
+}
 
-        LogInfo << "resnet input tensor" << cropFrame.GetDesc();
-        ret = resnetDetection->Inference(rinputs, routputs);
-        LogInfo << "resnet output tensor" << routputs[0].GetDesc();
+void VideoProcess::SelectFaces(const std::vector<std::vector<MxBase::ObjectInfo>> &objInfos,
+                               std::vector<MxBase::ObjectInfo> &faces)
+{
+    faces.clear();
+    for (const auto &info : objInfos) {
+        faces.insert(faces.end(), info.begin(), info.end());
+    }
+    // 后处理已按配置阈值过滤，这里只按置信度排序并截断
+    std::stable_sort(faces.begin(), faces.end(), [](const MxBase::ObjectInfo &a, const MxBase::ObjectInfo &b) {
+        return a.confidence > b.confidence;
+    });
+    if (faces.size() > RESULT_MAX_FACES) {
+        faces.resize(RESULT_MAX_FACES);
+    }
+}
 
+int64_t VideoProcess::CaptureTimeUs(const AVPacket &pkt) const
+{
+    const AVStream *stream = formatContext->streams[videoIndex];
+    if (formatContext->start_time_realtime == AV_NOPTS_VALUE || formatContext->start_time_realtime <= 0 ||
+        pkt.pts == AV_NOPTS_VALUE) {
+        return ResultWallClockUs();
+    }
+    int64_t start = stream->start_time == AV_NOPTS_VALUE ? 0 : stream->start_time;
+    return formatContext->start_time_realtime + av_rescale_q(pkt.pts - start, stream->time_base, AV_TIME_BASE_Q);
+}
 
-        // 结果可视化
-        /*
-        ret = videoProcess->SaveResult(result, frameId, info,keyPointInfos);
-        if (ret != APP_ERR_OK) {
-            LogError << "Save result failed, ret=" << ret << ".";
-            return;
+void VideoProcess::SendResultV2(const FrameContext &context)
+{
+    const uint32_t maxCoord = 65535;
+    auto coord = [maxCoord](float v) -> uint16_t {
+        return (uint16_t)std::min(std::max(v, 0.0f), (float)maxCoord);
+    };
+    ResultPacket packet;
+    packet.streamId = (uint16_t)streamId;
+    packet.sequence = resultSequence++;
+    packet.frameId = context.frameId;
+    packet.captureUs = context.captureUs;
+    for (const auto &hand : context.hands) {
+        ResultHand record;
+        record.x0 = coord(hand.box.x0);
+        record.y0 = coord(hand.box.y0);
+        record.x1 = coord(hand.box.x1);
+        record.y1 = coord(hand.box.y1);
+        record.confidence = hand.box.confidence;
+        record.flags = context.tracked ? RESULT_HAND_TRACKED : 0;
+        if (hand.gestureStart) {
+            record.flags |= RESULT_HAND_GESTURE_START;
+        }
+        record.gesture = hand.gesture;
+        float ow = hand.box.x1 - hand.box.x0;
+        float oh = hand.box.y1 - hand.box.y0;
+        for (size_t j = 0; j + 1 < hand.keypoints.size(); j += 2) {
+            record.keypoints.push_back(coord(hand.keypoints[j] * ow + hand.box.x0));
+            record.keypoints.push_back(coord(hand.keypoints[j + 1] * oh + hand.box.y0));
         }
-        */
+        packet.hands.push_back(record);
+    }
+    for (const auto &face : context.faces) {
+        ResultFace record;
+        record.x0 = coord(face.x0);
+        record.y0 = coord(face.y0);
+        record.x1 = coord(face.x1);
+        record.y1 = coord(face.y1);
+        record.confidence = face.confidence;
+        packet.faces.push_back(record);
+    }
+    uint8_t buf[RESULT_MAX_DATAGRAM_SIZE];
+    packet.sendUs = ResultWallClockUs();
+    size_t len = EncodeResultPacket(packet, buf, sizeof(buf));
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(resultPort);
+    addr.sin_addr.s_addr = inet_addr(clientIp.c_str());
+    sendto(iSock, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+}
 
-        {
-           char buf[1040];
-            int offset = 40;
-            {
-                MxBase::TensorBase tensor = routputs[0];
-                int x0 = obj.x0;
-                int x1 = obj.x1;
-                int y0 = obj.y0;
-                int y1 = obj.y1;
-                memcpy(buf+offset,&x0,4);
-                offset+=4;
-                memcpy(buf+offset,&y0,4);
-                offset+=4;
-                memcpy(buf+offset,&x1,4);
-                offset+=4;
-                memcpy(buf+offset,&y1,4);
-                offset+=4;
-                float* ptr = (float*)tensor.GetBuffer();
-                short ow = x1 - x0;
-                short oh = y1 - y0;
-                for(int j=0;j<tensor.GetSize()/2;j++){
-                    float fx = *(ptr++);
-                    float fy = *(ptr++);
-                    short x = (fx*ow)+x0;
-                    short y = (fy*oh)+y0;
-                    memcpy(buf+offset,&x,2);
-                    offset+=2;
-                    memcpy(buf+offset,&y,2);
-                    offset+=2;
-                }
-            }
-            sendto(iSock, buf, offset , 0, (struct sockaddr *)&addr, sizeof(addr));            
+void VideoProcess::SendResult(const FrameContext &context, int &noObjCnt)
+{
+    if (resultProtocol == RESULT_PROTOCOL_V2) {
+        SendResultV2(context);
+        return;
+    }
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(resultPort);
+    addr.sin_addr.s_addr = inet_addr(clientIp.c_str());
+    if (context.hands.empty()) {
+        noObjCnt++;
+        if (noObjCnt > 10) {
+            char buf[1040];
+            memset(buf, 0, 40);
+            sendto(iSock, buf, 40, 0, (struct sockaddr *)&addr, sizeof(addr));
+            noObjCnt = 0;
+        }
+        return;
+    }
+    noObjCnt = 0;
+
+    // 每只手一个数据报，格式与单手时相同
+    for (const auto &hand : context.hands) {
+        char buf[1040];
+        int offset = 40;
+        int x0 = hand.box.x0;
+        int x1 = hand.box.x1;
+        int y0 = hand.box.y0;
+        int y1 = hand.box.y1;
+        memcpy(buf+offset,&x0,4);
+        offset+=4;
+        memcpy(buf+offset,&y0,4);
+        offset+=4;
+        memcpy(buf+offset,&x1,4);
+        offset+=4;
+        memcpy(buf+offset,&y1,4);
+        offset+=4;
+        short ow = x1 - x0;
+        short oh = y1 - y0;
+        for(size_t j=0;j+1<hand.keypoints.size() && offset+4<=(int)sizeof(buf);j+=2){
+            short x = (hand.keypoints[j]*ow)+x0;
+            short y = (hand.keypoints[j+1]*oh)+y0;
+            memcpy(buf+offset,&x,2);
+            offset+=2;
+            memcpy(buf+offset,&y,2);
+            offset+=2;
         }
-        frameId++;
-        gettimeofday(&tv1,NULL);
-        LogInfo << "got hand cost:" << (tv1.tv_sec-tv0.tv_sec)*1000000+(tv1.tv_usec-tv0.tv_usec);
+        sendto(iSock, buf, offset, 0, (struct sockaddr *)&addr, sizeof(addr));
     }
 }
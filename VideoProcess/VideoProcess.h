@@ -17,6 +17,8 @@
 #ifndef STREAM_PULL_SAMPLE_VIDEOPROCESS_H
 #define STREAM_PULL_SAMPLE_VIDEOPROCESS_H
 
+#include <atomic>
+#include <chrono>
 #include "MxBase/ErrorCode/ErrorCodes.h"
 #include "MxBase/DvppWrapper/DvppWrapper.h"
 #include "MxBase/MemoryHelper/MemoryHelper.h"
@@ -24,8 +26,19 @@
 #include "MxBase/Tensor/TensorBase/TensorBase.h"
 #include "ObjectPostProcessors/Yolov3PostProcess.h"
 #include "../BlockingQueue/BlockingQueue.h"
+#include "../BlockingQueue/FrameQueue.h"
 #include "../Yolov3Detection/Yolov3Detection.h"
 #include "../ResnetDetector/ResnetDetector.h"
+#include "../FramePipeline/FramePipeline.h"
+#include "../Metrics/Metrics.h"
+#include "../HandTracker/HandTracker.h"
+#include "../GestureEngine/GestureEngine.h"
+#include "../VideoRelay/VideoRelay.h"
+#include "../ResultProtocol/ResultProtocol.h"
+#include "../VideoDecoder/VideoDecoder.h"
+#include "../FrameRenderer/FrameRenderer.h"
+#include "../FrameRenderer/VideoSink.h"
+#include "../WorkerGroup/WorkerGroup.h"
 
 extern "C"{
 #include "libavformat/avformat.h"
@@ -34,36 +47,171 @@ extern "C"{
 #include "libswscale/swscale.h"
 }
 
+// one decoded NV12 frame on its way from the decoder to the pipeline, whichever backend produced it
+struct DecodedFrame {
+    std::shared_ptr<MxBase::MemoryData> data;
+    FrameGeometry geometry;                             // picture size and the decoder's row/plane padding
+    uint32_t frameId = 0;
+    std::chrono::steady_clock::time_point decodeTime;   // when the decoder handed the frame over
+    int64_t captureUs = 0;                              // wall clock, see CaptureTimeUs
+};
+
+// decoded frames are handed from the decoder (VDEC callback or demux thread) to the inference thread,
+// overflow is resolved by the configured QueuePolicy instead of piling up frame buffers
+typedef FrameQueue<DecodedFrame> DecodedFrameQueue;
+
+// where the packets come from: a live camera, or a local file replayed for benchmarking
+enum ReplayMode {
+    REPLAY_OFF = 0,     // live stream, read as it arrives
+    REPLAY_FAST,        // file, read as fast as decode and the decoded-frame queue accept it
+    REPLAY_REALTIME,    // file, paced to its own timestamps like a camera
+};
+
+static const uint16_t DEFAULT_VIDEO_PORT = 6071;
+static const uint16_t DEFAULT_RESULT_PORT = 6072;
 
 class VideoProcess {
 private:
-    static APP_ERROR VideoDecodeCallback(std::shared_ptr<void> buffer, 
-	                                    MxBase::DvppDataInfo &inputDataInfo, void *userData);
-    APP_ERROR VideoDecode(MxBase::MemoryData &streamData, const uint32_t &height, 
-	                    const uint32_t &width, void *userData);
-    APP_ERROR SaveResult(const std::shared_ptr<MxBase::MemoryData> resulInfo, const uint32_t frameId,
-                    const std::vector<MxBase::ObjectInfo>& objInfos,
-                    const std::vector<MxBase::TensorBase>& keyPointInfos);
+    // decoder output, on the VDEC callback thread or in SubmitPacket for the software decoder
+    void OnDecodedFrame(const std::shared_ptr<MxBase::MemoryData> &frame, const FrameGeometry &geometry,
+                        uint32_t frameId);
+    void InitMetrics();
+    // hands for keypoint inference by confidence, boxes expanded 1.5x for the crop
+    static void SelectHands(const std::vector<std::vector<MxBase::ObjectInfo>> &objInfos, uint32_t height,
+                            uint32_t width, const HandSelectParam &param, std::vector<HandResult> &hands);
+    // faces by confidence, at most RESULT_MAX_FACES, in frame pixels like the detector reports them
+    static void SelectFaces(const std::vector<std::vector<MxBase::ObjectInfo>> &objInfos,
+                            std::vector<MxBase::ObjectInfo> &faces);
+    // one keypoint datagram per hand, or an empty one after a run of frames without a hand
+    void SendResult(const FrameContext &context, int &noObjCnt);
+    // one ResultProtocol v2 datagram per frame, with or without hands
+    void SendResultV2(const FrameContext &context);
+    // camera wall clock of the packet from the RTCP sender reports, the demux time without them
+    int64_t CaptureTimeUs(const AVPacket &pkt) const;
+    // opens streamUrl and picks its video stream; CloseInput undoes it
+    APP_ERROR OpenInput();
+    void CloseInput();
+    // live input lost: reopen only the AVFormatContext, with exponential backoff, until it works or Stop
+    APP_ERROR Reconnect();
+    // MP4/MKV store H.264/H.265 as length-prefixed NALUs, the decoders and the relay need Annex-B start codes
+    APP_ERROR InitBitstreamFilter();
+    // pkt == nullptr flushes the filter at end of file
+    APP_ERROR FilterPacket(AVPacket *pkt);
+    // one Annex-B packet to the decoder and the relay
+    APP_ERROR SubmitPacket(AVPacket &pkt);
+    void PaceReplay(const AVPacket &pkt);
+    // end of file: flush the decoder and wait for its last frames before the pipeline is told the input is done
+    void FinishReplayInput();
 public:
-    APP_ERROR StreamInit(const std::string &rtspUrl,const std::string &clientIp);
+    // every instance owns its stream, its decoder (VDEC channel) and its sockets
+    explicit VideoProcess(uint32_t streamId = 0, uint32_t channelId = 0);
+    ~VideoProcess() = default;
+
+    APP_ERROR StreamInit(const std::string &rtspUrl, const std::string &clientIp,
+                         uint16_t videoPort = DEFAULT_VIDEO_PORT, uint16_t resultPort = DEFAULT_RESULT_PORT,
+                         uint32_t relayRateMbps = DEFAULT_RELAY_RATE_MBPS);
     APP_ERROR StreamDeInit();
     APP_ERROR VideoDecodeInit();
     APP_ERROR VideoDecodeDeInit();
-    static void GetFrames(std::shared_ptr<BlockingQueue<std::shared_ptr<void>>>  blockingQueue, 
+    static void GetFrames(std::shared_ptr<DecodedFrameQueue> blockingQueue, 
 	                      std::shared_ptr<VideoProcess> videoProcess);
-    static void GetResults(std::shared_ptr<BlockingQueue<std::shared_ptr<void>>> blockingQueue, 
-	                       std::shared_ptr<Yolov3Detection> yolov3Detection,
-                           std::shared_ptr<ResnetDetector> resnetDetection,  
+    // runs the detectors of the replica given to SetWorker
+    static void GetResults(std::shared_ptr<DecodedFrameQueue> blockingQueue, 
 						   std::shared_ptr<VideoProcess> videoProcess);
+    void SetHandSelectParam(const HandSelectParam &param);
+    void SetTrackParam(const TrackParam &param);
+    void SetGestureParam(const GestureParam &param);
+    // before VideoDecodeInit: the model replica this stream runs on, its decoder goes to the same device;
+    // a replica with a face detector runs it on the hand detector's resized frame
+    void SetWorker(std::shared_ptr<WorkerReplica> worker);
+    void SetResultProtocol(ResultProtocolVersion version);
+    // annotated JPEGs of every N-th frame, see RenderParam; nullptr renders nothing
+    void SetRenderer(std::shared_ptr<FrameRenderer> renderer);
+    // annotated H.264 of every frame, see VideoSinkParam; an empty output writes no video
+    void SetVideoSink(const VideoSinkParam &param);
+    // before StreamInit
+    void SetReplayMode(ReplayMode mode);
+    // before VideoDecodeInit; memoryType is where software-decoded frames go, VDEC always outputs DVPP memory
+    void SetDecoder(DecoderType type, uint32_t threadNum, MxBase::MemoryData::MemoryType memoryType);
+    // packets handed to the decoder so far
+    uint32_t GetSubmittedFrameNum() const;
+    void Stop();
+    bool IsStopped() const;
+    uint32_t GetStreamId() const;
+    uint32_t GetDeviceId() const;
+    // false when the software decoder writes host frames for the CPU backend: nothing on this stream
+    // touches the Ascend device, so its threads bind no device context
+    bool UsesDevice() const;
 private:
-    std::shared_ptr<MxBase::DvppWrapper> vDvppWrapper;
-    const uint32_t CHANNEL_ID = 0;
+    std::shared_ptr<VideoDecoder> decoder;
+    DecoderType decoderType = DECODER_DVPP;
+    uint32_t decodeThreads = 0;
+    MxBase::MemoryData::MemoryType frameMemoryType = MxBase::MemoryData::MEMORY_DVPP;
+    // codec of the first open, a reconnect has to find the same one since the decoder is kept
+    AVCodecID codecId = AV_CODEC_ID_NONE;
+    AVFormatContext *formatContext = nullptr; // 视频流信息
+    std::string streamUrl;
+    int videoIndex = -1;
+    // picture size from the stream's codec parameters, refreshed on every (re)open
+    uint32_t frameWidth = 0;
+    uint32_t frameHeight = 0;
+    // decoding starts at an IDR frame, after startup, a reconnect or a failed decode
+    bool waitKeyFrame = true;
+    uint64_t skippedPackets = 0;
+    ReplayMode replayMode = REPLAY_OFF;
+    AVBSFContext *bsfContext = nullptr;
+    // REPLAY_REALTIME: steady time of the first packet and its timestamp
+    bool replayClockStarted = false;
+    std::chrono::steady_clock::time_point replayStartTime;
+    int64_t replayFirstUs = 0;
+    // replay: no frame will enter the decoded-frame queue any more, GetResults drains and returns
+    std::atomic<bool> inputDone;
+    int vSock = -1; // socket to send video data to client
+    int iSock = -1; // socket to send keypoint results to client
+    std::string clientIp;
+    uint16_t videoPort = DEFAULT_VIDEO_PORT;
+    uint16_t resultPort = DEFAULT_RESULT_PORT;
+    uint32_t relayRateMbps = DEFAULT_RELAY_RATE_MBPS;
+    // H.264/H.265 packets to the client, on its own sender thread while GetFrames runs
+    std::unique_ptr<VideoRelay> relay;
+    uint32_t decodeFrameId = 0;
+    HandSelectParam handParam;
+    TrackParam trackParam;
+    GestureParam gestureParam;
+    std::shared_ptr<WorkerReplica> worker;
+    // device of the decoder and the pipeline, the worker's
+    uint32_t deviceId = DEVICE_ID;
+    ResultProtocolVersion resultProtocol = RESULT_PROTOCOL_V1;
+    uint32_t resultSequence = 0;    // send stage only
+    std::shared_ptr<FrameRenderer> renderer;
+    VideoSinkParam sinkParam;
+    // created by GetResults, lives as long as its pipeline
+    std::unique_ptr<VideoSink> videoSink;
+    const uint32_t streamId;
+    const uint32_t channelId;
+    std::atomic<bool> stopFlag;
+    // set by GetFrames before the first packet, the decoder output pushes into it
+    std::shared_ptr<DecodedFrameQueue> frameQueue;
+
+    // per-stream series, labelled stream="<streamId>"
+    struct StreamMetrics {
+        LatencyHistogram *demux = nullptr;
+        LatencyHistogram *decode = nullptr;
+        LatencyHistogram *queueWait = nullptr;
+        LatencyHistogram *frameLatency = nullptr;   // decode output to result sent
+        MetricCounter *readErrors = nullptr;
+        MetricCounter *hands = nullptr;
+        MetricCounter *faces = nullptr;
+        MetricCounter *reconnects = nullptr;
+    } metrics;
+    // submit time of the packets in flight in the decoder, indexed by frameId, for the decode latency
+    static const uint32_t DECODE_TRACK_SIZE = 64;
+    std::atomic<int64_t> decodeSubmitNs[DECODE_TRACK_SIZE];
+    std::atomic<int64_t> decodeCaptureUs[DECODE_TRACK_SIZE];
 
 public:
-    static bool stopFlag;
+    // device of everything that is not bound to a stream's worker: startup, shared renderer threads
     static const uint32_t DEVICE_ID = 0;
-
-
 };
 
 #endif //STREAM_PULL_SAMPLE_VIDEOPROCESS_H
@@ -0,0 +1,244 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include "MxBase/Log/Log.h"
+#include "VideoRelay.h"
+#include "../AsyncLogger/AsyncLogger.h"
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    const uint32_t RELAY_BATCH_SIZE = 32;
+    const uint32_t RELAY_DATAGRAM_SIZE = RELAY_HEADER_SIZE + RELAY_PAYLOAD_SIZE;
+    // two batches of full datagrams: sendmmsg always gets a useful batch, bursts stay short
+    const uint64_t RELAY_BURST_BYTES = 2 * RELAY_BATCH_SIZE * RELAY_DATAGRAM_SIZE;
+    const uint64_t BITS_PER_BYTE = 8;
+    const uint64_t BITS_PER_MBIT = 1000000;
+    const unsigned int RELAY_POP_WAIT_TIME = 10;
+    const unsigned char RELAY_MAGIC[] = {0x55, 0xaa, 0x55, 0xaa};
+    const uint32_t CHUNK_COUNT_OFFSET = 4;
+    const uint32_t CHUNK_INDEX_OFFSET = 8;
+    const double US_PER_SECOND = 1e6;
+}
+
+RelayPacer::RelayPacer(uint64_t bytesPerSecond, uint64_t burstBytes)
+    : bytesPerSecond(bytesPerSecond), burstBytes((double)burstBytes), tokens((double)burstBytes),
+      lastRefill(Clock::now())
+{
+}
+
+void RelayPacer::Refill()
+{
+    auto now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+    lastRefill = now;
+    tokens = std::min(burstBytes, tokens + elapsed * bytesPerSecond);
+}
+
+uint32_t RelayPacer::Acquire(uint32_t datagramSize, uint32_t limit)
+{
+    if (bytesPerSecond == 0) {
+        return limit;
+    }
+    Refill();
+    return std::min(limit, (uint32_t)(tokens / datagramSize));
+}
+
+void RelayPacer::Consume(uint64_t bytes)
+{
+    if (bytesPerSecond != 0) {
+        tokens -= (double)bytes;
+    }
+}
+
+std::chrono::microseconds RelayPacer::WaitTime(uint32_t datagramSize) const
+{
+    if (bytesPerSecond == 0 || tokens >= datagramSize) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds((int64_t)((datagramSize - tokens) * US_PER_SECOND / bytesPerSecond) + 1);
+}
+
+VideoRelay::VideoRelay(const std::string &metricLabels) : metricLabels(metricLabels)
+{
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    sentBytes = registry->GetCounter("hand_relay_bytes_total", "Video relay bytes sent, headers included",
+                                     metricLabels);
+    sentDatagrams = registry->GetCounter("hand_relay_datagrams_total", "Video relay datagrams sent", metricLabels);
+    droppedPackets = registry->GetCounter("hand_relay_dropped_packets_total",
+                                          "H.264 packets the relay dropped because the link fell behind", metricLabels);
+    sendErrors = registry->GetCounter("hand_relay_send_errors_total", "Failed sendmmsg calls", metricLabels);
+    packetLatency = registry->GetHistogram("hand_stage_latency_seconds", "Time spent in one processing stage per frame",
+                                           JoinMetricLabels(metricLabels, MetricLabels({{"stage", "relay"}})));
+}
+
+VideoRelay::~VideoRelay()
+{
+    Stop();
+}
+
+APP_ERROR VideoRelay::Start(int sock, const std::string &clientIp, uint16_t port, uint32_t rateMbps,
+                            uint32_t queueDepth)
+{
+    if (running) {
+        return APP_ERR_OK;
+    }
+    if (sock < 0 || queueDepth == 0) {
+        LogError << "Invalid video relay socket or queue depth";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, clientIp.c_str(), &addr.sin_addr) != 1) {
+        LogError << "Invalid video relay address: " << clientIp;
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    this->sock = sock;
+    pacer.reset(new RelayPacer((uint64_t)rateMbps * BITS_PER_MBIT / BITS_PER_BYTE, RELAY_BURST_BYTES));
+    queue.reset(new SpscRingQueue<QueuedPacket>(queueDepth));
+    headers.assign(RELAY_BATCH_SIZE * RELAY_HEADER_SIZE, 0);
+    iovecs.resize(RELAY_BATCH_SIZE * 2);
+    msgs.resize(RELAY_BATCH_SIZE);
+    for (uint32_t i = 0; i < RELAY_BATCH_SIZE; i++) {
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+        msgs[i].msg_hdr.msg_iov = &iovecs[i * 2];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+        memcpy(&headers[i * RELAY_HEADER_SIZE], RELAY_MAGIC, sizeof(RELAY_MAGIC));
+        iovecs[i * 2].iov_base = &headers[i * RELAY_HEADER_SIZE];
+        iovecs[i * 2].iov_len = RELAY_HEADER_SIZE;
+    }
+    SpscRingQueue<QueuedPacket> *queuePtr = queue.get();
+    queueCallback = MetricsRegistry::GetInstance()->RegisterCallback("hand_relay_queue_depth",
+        "Demuxed packets waiting for the video relay", METRIC_GAUGE, metricLabels,
+        [queuePtr]() { return (double)queuePtr->GetSize(); });
+    waitKeyFrame = false;
+    running = true;
+    worker = std::thread(&VideoRelay::SendLoop, this);
+    LogInfo << "video relay to " << clientIp << ":" << port << " paced at "
+            << (rateMbps == 0 ? std::string("unlimited") : std::to_string(rateMbps) + " Mbit/s");
+    return APP_ERR_OK;
+}
+
+APP_ERROR VideoRelay::Send(const AVPacket &pkt)
+{
+    if (!running) {
+        return APP_ERR_QUEUE_STOPED;
+    }
+    bool keyFrame = (pkt.flags & AV_PKT_FLAG_KEY) != 0;
+    if (waitKeyFrame && !keyFrame) {
+        droppedPackets->Add();
+        return APP_ERR_QUEUE_FULL;
+    }
+    QueuedPacket item;
+    item.packet = std::shared_ptr<AVPacket>(av_packet_alloc(), [](AVPacket *packet) { av_packet_free(&packet); });
+    if (!item.packet || av_packet_ref(item.packet.get(), &pkt) != 0) {
+        LogError << "Failed to reference packet for the video relay";
+        return APP_ERR_COMM_ALLOC_MEM;
+    }
+    item.queueTime = Clock::now();
+    if (!queue->TryPush(item)) {
+        // the link is behind: skip to the next key frame so the client can resync cleanly
+        waitKeyFrame = true;
+        droppedPackets->Add();
+        return APP_ERR_QUEUE_FULL;
+    }
+    waitKeyFrame = false;
+    return APP_ERR_OK;
+}
+
+void VideoRelay::Stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    queue->Stop();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    queue->Clear();
+    MetricsRegistry::GetInstance()->Unregister(queueCallback);
+}
+
+void VideoRelay::SendLoop()
+{
+    while (running) {
+        QueuedPacket item;
+        APP_ERROR ret = queue->Pop(item, RELAY_POP_WAIT_TIME);
+        if (ret == APP_ERR_QUEUE_EMPTY) {
+            continue;
+        }
+        if (ret != APP_ERR_OK) {
+            break;
+        }
+        SendPacket(*item.packet);
+        packetLatency->ObserveSince(item.queueTime);
+    }
+}
+
+void VideoRelay::SendPacket(const AVPacket &pkt)
+{
+    int chunkCount = (pkt.size + RELAY_PAYLOAD_SIZE - 1) / RELAY_PAYLOAD_SIZE;
+    int chunk = 0;
+    while (chunk < chunkCount && running) {
+        uint32_t count = pacer->Acquire(RELAY_DATAGRAM_SIZE, std::min(RELAY_BATCH_SIZE,
+                                                                       (uint32_t)(chunkCount - chunk)));
+        if (count == 0) {
+            std::this_thread::sleep_for(pacer->WaitTime(RELAY_DATAGRAM_SIZE));
+            continue;
+        }
+        uint64_t bytes = 0;
+        for (uint32_t i = 0; i < count; i++, chunk++) {
+            char *header = &headers[i * RELAY_HEADER_SIZE];
+            memcpy(header + CHUNK_COUNT_OFFSET, &chunkCount, sizeof(chunkCount));
+            memcpy(header + CHUNK_INDEX_OFFSET, &chunk, sizeof(chunk));
+            size_t offset = (size_t)chunk * RELAY_PAYLOAD_SIZE;
+            iovecs[i * 2 + 1].iov_base = pkt.data + offset;
+            iovecs[i * 2 + 1].iov_len = std::min((size_t)RELAY_PAYLOAD_SIZE, (size_t)pkt.size - offset);
+            bytes += RELAY_HEADER_SIZE + iovecs[i * 2 + 1].iov_len;
+        }
+        pacer->Consume(bytes);
+        if (!SendBatch(count)) {
+            return; // the rest of the packet is useless to the client
+        }
+    }
+}
+
+bool VideoRelay::SendBatch(uint32_t count)
+{
+    uint32_t sent = 0;
+    while (sent < count) {
+        int ret = sendmmsg(sock, &msgs[sent], count - sent, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            sendErrors->Add();
+            HotLogDebug << "video relay sendmmsg failed: " << strerror(errno);
+            return false;
+        }
+        for (int i = 0; i < ret; i++) {
+            sentBytes->Add(msgs[sent + i].msg_len);
+        }
+        sent += (uint32_t)ret;
+    }
+    sentDatagrams->Add(count);
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_VIDEORELAY_H
+#define STREAM_PULL_SAMPLE_VIDEORELAY_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "../BlockingQueue/RingQueue.h"
+#include "../Metrics/Metrics.h"
+
+extern "C"{
+#include "libavcodec/avcodec.h"
+}
+
+// datagram layout of the video relay: 40-byte header (magic 55 aa 55 aa, chunk count, chunk index,
+// rest zero) followed by up to 1400 bytes of the H.264 packet
+static const uint32_t RELAY_HEADER_SIZE = 40;
+static const uint32_t RELAY_PAYLOAD_SIZE = 1400;
+// outbound rate, 0 sends as fast as the socket takes it
+static const uint32_t DEFAULT_RELAY_RATE_MBPS = 40;
+// demuxed packets waiting for the sender
+static const uint32_t DEFAULT_RELAY_QUEUE_DEPTH = 64;
+
+// Token bucket in bytes. The bucket holds at most burst bytes, so an I-frame goes out at the
+// configured rate instead of as one burst that overflows the receiver or the link.
+class RelayPacer {
+public:
+    RelayPacer(uint64_t bytesPerSecond, uint64_t burstBytes);
+    // datagrams of datagramSize that may go out now, at most limit; 0 means wait WaitTime()
+    uint32_t Acquire(uint32_t datagramSize, uint32_t limit);
+    void Consume(uint64_t bytes);
+    std::chrono::microseconds WaitTime(uint32_t datagramSize) const;
+private:
+    void Refill();
+private:
+    const uint64_t bytesPerSecond;
+    const double burstBytes;
+    double tokens;
+    std::chrono::steady_clock::time_point lastRefill;
+};
+
+// Relays the demuxed H.264 packets to the client on its own thread, so a large I-frame no longer
+// holds up av_read_frame and decode submission. The demux thread only takes a reference to the
+// packet; the sender builds the datagrams as iovecs into the packet data (no copy) and hands them
+// to sendmmsg in batches, paced by RelayPacer.
+// When the link cannot keep up the queue fills and packets are dropped up to the next key frame,
+// so the client never gets a P-frame whose reference is missing.
+class VideoRelay {
+public:
+    explicit VideoRelay(const std::string &metricLabels = "");
+    ~VideoRelay();
+    VideoRelay(const VideoRelay &) = delete;
+    VideoRelay &operator=(const VideoRelay &) = delete;
+
+    // sock stays owned by the caller and must outlive Stop()
+    APP_ERROR Start(int sock, const std::string &clientIp, uint16_t port,
+                    uint32_t rateMbps = DEFAULT_RELAY_RATE_MBPS, uint32_t queueDepth = DEFAULT_RELAY_QUEUE_DEPTH);
+    // called from the demux thread, never blocks
+    APP_ERROR Send(const AVPacket &pkt);
+    void Stop();
+private:
+    struct QueuedPacket {
+        std::shared_ptr<AVPacket> packet;   // reference to the demuxed packet's buffer
+        std::chrono::steady_clock::time_point queueTime;
+    };
+    void SendLoop();
+    void SendPacket(const AVPacket &pkt);
+    bool SendBatch(uint32_t count);
+private:
+    const std::string metricLabels;
+    int sock = -1;
+    struct sockaddr_in addr = {};
+    std::unique_ptr<RelayPacer> pacer;
+    std::unique_ptr<SpscRingQueue<QueuedPacket>> queue;
+    std::thread worker;
+    std::atomic<bool> running{false};
+    bool waitKeyFrame = false;  // demux thread only
+    // per-datagram headers and iovecs, reused by the sender thread
+    std::vector<char> headers;
+    std::vector<struct iovec> iovecs;
+    std::vector<struct mmsghdr> msgs;
+    MetricCounter *sentBytes = nullptr;
+    MetricCounter *sentDatagrams = nullptr;
+    MetricCounter *droppedPackets = nullptr;
+    MetricCounter *sendErrors = nullptr;
+    LatencyHistogram *packetLatency = nullptr;  // queued by demux to last datagram sent
+    uint64_t queueCallback = 0;
+};
+
+#endif // STREAM_PULL_SAMPLE_VIDEORELAY_H
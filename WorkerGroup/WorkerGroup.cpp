@@ -0,0 +1,311 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <functional>
+#include <thread>
+#include "MxBase/Log/Log.h"
+#include "MxBase/DeviceManager/DeviceManager.h"
+#include "../Metrics/StartupTimeline.h"
+#include "WorkerGroup.h"
+
+namespace {
+    // binds the calling thread to the replica's device first, models load and free on their own chip;
+    // CPU replicas have no device to bind
+    APP_ERROR RunOnDevice(BackendType backendType, uint32_t deviceId, const std::function<APP_ERROR()> &task)
+    {
+        if (backendType != BACKEND_ASCEND) {
+            return task();
+        }
+        MxBase::DeviceContext device;
+        device.devId = (int32_t)deviceId;
+        APP_ERROR ret = MxBase::DeviceManager::GetInstance()->SetDevice(device);
+        if (ret != APP_ERR_OK) {
+            LogError << "SetDevice failed for device " << deviceId;
+            return ret;
+        }
+        return task();
+    }
+}
+
+WorkerGroup::~WorkerGroup()
+{
+    DeInit();
+}
+
+APP_ERROR WorkerGroup::Init(const WorkerGroupParam &param)
+{
+    if (param.deviceIds.empty() || param.deviceIds.size() > MAX_WORKER_REPLICAS) {
+        LogError << "a worker group needs 1 to " << MAX_WORKER_REPLICAS << " replicas, not "
+                 << param.deviceIds.size();
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    if (param.yoloParam.backendType == BACKEND_ASCEND) {
+        uint32_t deviceCount = 0;
+        APP_ERROR ret = MxBase::DeviceManager::GetInstance()->GetDevicesCount(deviceCount);
+        if (ret != APP_ERR_OK) {
+            LogError << "GetDevicesCount failed";
+            return ret;
+        }
+        for (uint32_t deviceId : param.deviceIds) {
+            if (deviceId >= deviceCount) {
+                LogError << "device " << deviceId << " does not exist, " << deviceCount << " device(s) found";
+                return APP_ERR_COMM_INVALID_PARAM;
+            }
+        }
+    }
+    this->param = param;
+    for (size_t i = 0; i < param.deviceIds.size(); i++) {
+        auto replica = std::make_shared<WorkerReplica>();
+        replica->index = (uint32_t)i;
+        replica->deviceId = param.deviceIds[i];
+        replica->yolov3 = std::make_shared<Yolov3Detection>();
+        replica->resnet = std::make_shared<ResnetDetector>();
+        if (param.faceEnabled) {
+            replica->face = std::make_shared<Yolov3Detection>();
+        }
+        RegisterMetrics(*replica);
+        replicas.push_back(replica);
+    }
+    return APP_ERR_OK;
+}
+
+void WorkerGroup::RegisterMetrics(WorkerReplica &replica)
+{
+    MetricsRegistry *registry = MetricsRegistry::GetInstance();
+    std::string labels = MetricLabels({{"replica", std::to_string(replica.index)},
+                                       {"device", std::to_string(replica.deviceId)}});
+    replica.frames = registry->GetCounter("hand_worker_frames_total", "Frames finished on a model replica", labels);
+    WorkerReplica *target = &replica;
+    metricCallbacks.push_back(registry->RegisterCallback("hand_worker_streams", "Streams pinned to a model replica",
+        METRIC_GAUGE, labels, [target]() { return (double)target->streams.load(); }));
+}
+
+APP_ERROR WorkerGroup::LoadReplica(WorkerReplica &replica, const WorkerGroupParam &param)
+{
+    std::string prefix = "replica " + std::to_string(replica.index) + " ";
+    InitParam yoloParam = param.yoloParam;
+    yoloParam.deviceId = replica.deviceId;
+    ResnetInitParam resnetParam = param.resnetParam;
+    resnetParam.deviceId = replica.deviceId;
+    InitParam faceParam = param.faceParam;
+    faceParam.deviceId = replica.deviceId;
+    // 同一副本内的各模型互不依赖，也并行加载
+    bool yoloLoaded = false;
+    bool resnetLoaded = false;
+    bool faceLoaded = false;
+    std::vector<std::function<APP_ERROR()>> tasks;
+    tasks.push_back([&]() -> APP_ERROR {
+        APP_ERROR ret;
+        {
+            StartupStep step(prefix + "yolo load");
+            ret = replica.yolov3->FrameInit(yoloParam);
+        }
+        if (ret != APP_ERR_OK) {
+            LogError << "Init yolo failed on device " << replica.deviceId;
+            return ret;
+        }
+        yoloLoaded = true;
+        StartupStep step(prefix + "yolo warm-up");
+        return replica.yolov3->Warmup(param.warmupGeometry);
+    });
+    tasks.push_back([&]() -> APP_ERROR {
+        APP_ERROR ret;
+        {
+            StartupStep step(prefix + "resnet load");
+            ret = replica.resnet->Init(resnetParam);
+        }
+        if (ret != APP_ERR_OK) {
+            LogError << "Init resnet failed on device " << replica.deviceId;
+            return ret;
+        }
+        resnetLoaded = true;
+        StartupStep step(prefix + "resnet warm-up");
+        return replica.resnet->Warmup(param.warmupGeometry);
+    });
+    if (replica.face != nullptr) {
+        tasks.push_back([&]() -> APP_ERROR {
+            APP_ERROR ret;
+            {
+                StartupStep step(prefix + "face load");
+                ret = replica.face->FrameInit(faceParam);
+            }
+            if (ret != APP_ERR_OK) {
+                LogError << "Init face detector failed on device " << replica.deviceId;
+                return ret;
+            }
+            faceLoaded = true;
+            StartupStep step(prefix + "face warm-up");
+            return replica.face->Warmup(param.warmupGeometry);
+        });
+    }
+    std::vector<APP_ERROR> results(tasks.size(), APP_ERR_OK);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < tasks.size(); i++) {
+        threads.emplace_back([&, i]() {
+            results[i] = RunOnDevice(param.yoloParam.backendType, replica.deviceId, tasks[i]);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    // DeInit skips a replica that never finished loading, so a failure releases the models that did load
+    auto unload = [&]() {
+        RunOnDevice(param.yoloParam.backendType, replica.deviceId, [&]() -> APP_ERROR {
+            if (yoloLoaded) {
+                replica.yolov3->FrameDeInit();
+            }
+            if (resnetLoaded) {
+                replica.resnet->DeInit();
+            }
+            if (faceLoaded) {
+                replica.face->FrameDeInit();
+            }
+            return APP_ERR_OK;
+        });
+    };
+    for (APP_ERROR ret : results) {
+        if (ret != APP_ERR_OK) {
+            unload();
+            return ret;
+        }
+    }
+    if (replica.face != nullptr) {
+        // 人脸检测直接使用手部检测的缩放图，两个模型的输入尺寸必须一致
+        uint32_t handHeight = 0;
+        uint32_t handWidth = 0;
+        uint32_t faceHeight = 0;
+        uint32_t faceWidth = 0;
+        replica.yolov3->GetInputSize(handHeight, handWidth);
+        replica.face->GetInputSize(faceHeight, faceWidth);
+        if (handHeight != faceHeight || handWidth != faceWidth) {
+            LogError << "face model input " << faceWidth << "x" << faceHeight << " differs from the hand model's "
+                     << handWidth << "x" << handHeight;
+            unload();
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+    }
+    replica.loaded = true;
+    return APP_ERR_OK;
+}
+
+APP_ERROR WorkerGroup::Load()
+{
+    std::vector<APP_ERROR> results(replicas.size(), APP_ERR_OK);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < replicas.size(); i++) {
+        threads.emplace_back([this, &results, i]() {
+            results[i] = LoadReplica(*replicas[i], param);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i] != APP_ERR_OK) {
+            LogError << "Loading replica " << i << " on device " << replicas[i]->deviceId << " failed";
+            return results[i];
+        }
+    }
+    LogInfo << replicas.size() << " model replica(s) loaded";
+    return APP_ERR_OK;
+}
+
+void WorkerGroup::DeInit()
+{
+    for (uint64_t id : metricCallbacks) {
+        MetricsRegistry::GetInstance()->Unregister(id);
+    }
+    metricCallbacks.clear();
+    // 各副本的模型在其所在设备上释放
+    for (auto &replica : replicas) {
+        if (!replica->loaded) {
+            continue;
+        }
+        RunOnDevice(param.yoloParam.backendType, replica->deviceId, [&replica]() -> APP_ERROR {
+            replica->yolov3->FrameDeInit();
+            replica->resnet->DeInit();
+            if (replica->face != nullptr) {
+                replica->face->FrameDeInit();
+            }
+            return APP_ERR_OK;
+        });
+    }
+    replicas.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    affinity.clear();
+}
+
+std::shared_ptr<WorkerReplica> WorkerGroup::Acquire(uint32_t streamId)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = affinity.find(streamId);
+    if (found != affinity.end()) {
+        return found->second;
+    }
+    if (replicas.empty()) {
+        return nullptr;
+    }
+    std::map<uint32_t, uint32_t> deviceStreams;
+    for (const auto &replica : replicas) {
+        deviceStreams[replica->deviceId] += replica->streams;
+    }
+    std::shared_ptr<WorkerReplica> best;
+    for (const auto &replica : replicas) {
+        if (best == nullptr) {
+            best = replica;
+            continue;
+        }
+        uint32_t streams = replica->streams;
+        uint32_t bestStreams = best->streams;
+        if (streams != bestStreams) {
+            if (streams < bestStreams) {
+                best = replica;
+            }
+            continue;
+        }
+        // 同负载时优先分散到不同芯片，再看已处理的帧数
+        uint32_t chipStreams = deviceStreams[replica->deviceId];
+        uint32_t bestChipStreams = deviceStreams[best->deviceId];
+        if (chipStreams != bestChipStreams) {
+            if (chipStreams < bestChipStreams) {
+                best = replica;
+            }
+            continue;
+        }
+        if (replica->frames->Get() < best->frames->Get()) {
+            best = replica;
+        }
+    }
+    best->streams++;
+    affinity[streamId] = best;
+    return best;
+}
+
+void WorkerGroup::Release(uint32_t streamId)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = affinity.find(streamId);
+    if (found == affinity.end()) {
+        return;
+    }
+    found->second->streams--;
+    affinity.erase(found);
+}
+
+size_t WorkerGroup::GetReplicaNum() const
+{
+    return replicas.size();
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_WORKERGROUP_H
+#define STREAM_PULL_SAMPLE_WORKERGROUP_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "MxBase/ErrorCode/ErrorCodes.h"
+#include "../Yolov3Detection/Yolov3Detection.h"
+#include "../ResnetDetector/ResnetDetector.h"
+#include "../Metrics/Metrics.h"
+
+static const uint32_t MAX_WORKER_REPLICAS = 32;
+
+struct WorkerGroupParam {
+    // one model replica per entry; a device may be listed more than once for several replicas on one chip
+    std::vector<uint32_t> deviceIds = {0};
+    // detector parameters of every replica, deviceId is set per replica
+    InitParam yoloParam;
+    ResnetInitParam resnetParam;
+    bool faceEnabled = false;
+    InitParam faceParam;
+    // every replica runs its first frame on this geometry before any stream does
+    FrameGeometry warmupGeometry;
+};
+
+// the detectors of one replica, loaded on deviceId; the frames of its streams never leave that chip
+struct WorkerReplica {
+    uint32_t index = 0;
+    uint32_t deviceId = 0;
+    std::shared_ptr<Yolov3Detection> yolov3;
+    std::shared_ptr<ResnetDetector> resnet;
+    std::shared_ptr<Yolov3Detection> face;      // nullptr without a face model
+    bool loaded = false;                        // every model loaded, DeInit releases them
+    std::atomic<uint32_t> streams{0};
+    MetricCounter *frames = nullptr;            // frames its streams finished
+};
+
+// Model replicas on a list of devices, and which stream runs on which. A stream is pinned to one
+// replica for its lifetime: its decoder, its decoded frames and its pipeline stay on that replica's
+// chip, so nothing is copied between chips and the tracker sees every frame of the stream. New
+// streams go to the least-loaded replica: fewest streams, then the chip with the fewest streams,
+// then the fewest frames done. The backend comes from the detector parameters, so CPU replicas
+// exercise the same dispatch on a host without Ascend cards.
+class WorkerGroup {
+public:
+    WorkerGroup() = default;
+    ~WorkerGroup();
+    WorkerGroup(const WorkerGroup &) = delete;
+    WorkerGroup &operator=(const WorkerGroup &) = delete;
+
+    // creates the replicas, cheap; streams can be assigned before Load
+    APP_ERROR Init(const WorkerGroupParam &param);
+    // loads and warms up every model of every replica, all in parallel
+    APP_ERROR Load();
+    void DeInit();
+    // the replica of a stream: chosen on the first call, the same one until Release
+    std::shared_ptr<WorkerReplica> Acquire(uint32_t streamId);
+    void Release(uint32_t streamId);
+    size_t GetReplicaNum() const;
+private:
+    static APP_ERROR LoadReplica(WorkerReplica &replica, const WorkerGroupParam &param);
+    void RegisterMetrics(WorkerReplica &replica);
+private:
+    WorkerGroupParam param;
+    std::vector<std::shared_ptr<WorkerReplica>> replicas;
+    std::mutex mutex;
+    std::map<uint32_t, std::shared_ptr<WorkerReplica>> affinity;
+    std::vector<uint64_t> metricCallbacks;
+};
+
+#endif // STREAM_PULL_SAMPLE_WORKERGROUP_H
@@ -0,0 +1,235 @@
+/*
+ * Copyright(C) 2021. Huawei Technologies Co.,Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STREAM_PULL_SAMPLE_YOLOV3DECODER_H
+#define STREAM_PULL_SAMPLE_YOLOV3DECODER_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YOLO_DECODER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define YOLO_DECODER_SSE2 1
+#endif
+
+// YOLOv3 detection layers the decoder expects: 13x13, 26x26 and 52x52 for a 416 input
+static const uint32_t YOLO_LAYER_NUM = 3;
+
+namespace Yolov3DecoderDetail {
+    inline float Sigmoid(float x)
+    {
+        return 1.0f / (1.0f + std::exp(-x));
+    }
+
+    // inverse sigmoid, so a probability threshold can be applied to raw logits
+    inline float Logit(float p)
+    {
+        p = std::min(std::max(p, 1e-6f), 1.0f - 1e-6f);
+        return std::log(p / (1.0f - p));
+    }
+
+    // Index of the first logit >= threshold in [begin, end), end when there is none.
+    // Almost every cell of the objectness plane is background, so this compare is the hot loop.
+    inline uint32_t NextAbove(const float *data, uint32_t begin, uint32_t end, float threshold)
+    {
+        uint32_t i = begin;
+#if defined(YOLO_DECODER_NEON)
+        float32x4_t th = vdupq_n_f32(threshold);
+        for (; i + 4 <= end; i += 4) {
+            uint32x4_t ge = vcgeq_f32(vld1q_f32(data + i), th);
+            uint32x2_t any = vorr_u32(vget_low_u32(ge), vget_high_u32(ge));
+            if ((vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) != 0) {
+                break;
+            }
+        }
+#elif defined(YOLO_DECODER_SSE2)
+        __m128 th = _mm_set1_ps(threshold);
+        for (; i + 4 <= end; i += 4) {
+            int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(data + i), th));
+            if (mask != 0) {
+                return i + (uint32_t)__builtin_ctz((unsigned int)mask);
+            }
+        }
+#endif
+        for (; i < end; i++) {
+            if (data[i] >= threshold) {
+                return i;
+            }
+        }
+        return end;
+    }
+}
+
+// Decode and NMS for YOLOv3 outputs in the NCHW layout of the converted Caffe model:
+// every layer is [AnchorNum * (5 + ClassNum), gridH, gridW], channel a * (5 + ClassNum) + k.
+// Class count and anchors per layer are template parameters so the inner loops unroll, and every
+// buffer is a fixed-capacity array: no allocation per frame.
+// Thresholds are compared in logit space, so sigmoid/exp only run for cells that pass the
+// objectness gate instead of for the whole plane.
+template<uint32_t ClassNum, uint32_t AnchorNum = 3, uint32_t MaxCandidates = 256, uint32_t MaxBoxes = 64>
+class Yolov3Decoder {
+public:
+    static const uint32_t CHANNELS_PER_ANCHOR = 5 + ClassNum;
+    static const uint32_t LAYER_CHANNELS = AnchorNum * CHANNELS_PER_ANCHOR;
+    static const uint32_t MAX_BOXES = MaxBoxes;
+
+    // normalized to the model input, (0, 0) top left
+    struct Box {
+        float x0;
+        float y0;
+        float x1;
+        float y1;
+        float score;
+        uint32_t classId;
+    };
+
+    struct Layer {
+        const float *data;
+        uint32_t gridH;
+        uint32_t gridW;
+        const float *anchors;   // AnchorNum (w, h) pairs in input pixels
+    };
+
+    Yolov3Decoder(float objectnessThresh, float scoreThresh, float iouThresh, uint32_t inputWidth,
+                  uint32_t inputHeight)
+        : objectnessThresh_(objectnessThresh), scoreThresh_(scoreThresh), iouThresh_(iouThresh),
+          // score = objectness * class probability <= objectness, so both thresholds gate objectness
+          objectnessLogit_(Yolov3DecoderDetail::Logit(std::max(objectnessThresh, scoreThresh))),
+          inputWidth_((float)inputWidth), inputHeight_((float)inputHeight) {}
+
+    // boxes sorted by score, at most MaxBoxes; returns the number written
+    uint32_t Decode(const Layer *layers, uint32_t layerNum, Box *boxes) const
+    {
+        Candidates candidates;
+        candidates.size = 0;
+        for (uint32_t i = 0; i < layerNum; i++) {
+            DecodeLayer(layers[i], candidates);
+        }
+        std::sort(candidates.boxes, candidates.boxes + candidates.size, [](const Box &a, const Box &b) {
+            return a.score > b.score;
+        });
+        return Nms(candidates, boxes);
+    }
+
+private:
+    struct Candidates {
+        Box boxes[MaxCandidates];
+        uint32_t size;
+    };
+
+    void DecodeLayer(const Layer &layer, Candidates &candidates) const
+    {
+        const uint32_t plane = layer.gridH * layer.gridW;
+        for (uint32_t a = 0; a < AnchorNum; a++) {
+            const float *base = layer.data + a * CHANNELS_PER_ANCHOR * plane;
+            const float *objectness = base + 4 * plane;
+            uint32_t cell = Yolov3DecoderDetail::NextAbove(objectness, 0, plane, objectnessLogit_);
+            while (cell < plane) {
+                DecodeCell(layer, a, base, cell, candidates);
+                cell = Yolov3DecoderDetail::NextAbove(objectness, cell + 1, plane, objectnessLogit_);
+            }
+        }
+    }
+
+    void DecodeCell(const Layer &layer, uint32_t anchor, const float *base, uint32_t cell,
+                    Candidates &candidates) const
+    {
+        using Yolov3DecoderDetail::Sigmoid;
+        const uint32_t plane = layer.gridH * layer.gridW;
+        float objectness = Sigmoid(base[4 * plane + cell]);
+        if (objectness < objectnessThresh_) {
+            return;
+        }
+        // best class
+        uint32_t classId = 0;
+        float classLogit = base[5 * plane + cell];
+        for (uint32_t c = 1; c < ClassNum; c++) {
+            float logit = base[(5 + c) * plane + cell];
+            if (logit > classLogit) {
+                classLogit = logit;
+                classId = c;
+            }
+        }
+        float score = objectness * Sigmoid(classLogit);
+        if (score < scoreThresh_) {
+            return;
+        }
+        uint32_t row = cell / layer.gridW;
+        uint32_t col = cell % layer.gridW;
+        float cx = (col + Sigmoid(base[cell])) / layer.gridW;
+        float cy = (row + Sigmoid(base[plane + cell])) / layer.gridH;
+        float w = std::exp(base[2 * plane + cell]) * layer.anchors[anchor * 2] / inputWidth_;
+        float h = std::exp(base[3 * plane + cell]) * layer.anchors[anchor * 2 + 1] / inputHeight_;
+        Box box = {cx - w / 2, cy - h / 2, cx + w / 2, cy + h / 2, score, classId};
+        if (candidates.size < MaxCandidates) {
+            candidates.boxes[candidates.size++] = box;
+            return;
+        }
+        // full: replace the weakest candidate, only reached on pathological frames
+        Box *weakest = std::min_element(candidates.boxes, candidates.boxes + MaxCandidates,
+                                        [](const Box &x, const Box &y) { return x.score < y.score; });
+        if (weakest->score < score) {
+            *weakest = box;
+        }
+    }
+
+    static float Iou(const Box &a, const Box &b)
+    {
+        float w = std::min(a.x1, b.x1) - std::max(a.x0, b.x0);
+        float h = std::min(a.y1, b.y1) - std::max(a.y0, b.y0);
+        if (w <= 0 || h <= 0) {
+            return 0;
+        }
+        float inter = w * h;
+        float areaA = (a.x1 - a.x0) * (a.y1 - a.y0);
+        float areaB = (b.x1 - b.x0) * (b.y1 - b.y0);
+        return inter / (areaA + areaB - inter);
+    }
+
+    // greedy per-class NMS over score-sorted candidates
+    uint32_t Nms(const Candidates &candidates, Box *boxes) const
+    {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < candidates.size && count < MaxBoxes; i++) {
+            const Box &box = candidates.boxes[i];
+            bool keep = true;
+            for (uint32_t k = 0; k < count; k++) {
+                if (boxes[k].classId == box.classId && Iou(boxes[k], box) > iouThresh_) {
+                    keep = false;
+                    break;
+                }
+            }
+            if (keep) {
+                boxes[count++] = box;
+            }
+        }
+        return count;
+    }
+
+private:
+    const float objectnessThresh_;
+    const float scoreThresh_;
+    const float iouThresh_;
+    const float objectnessLogit_;
+    const float inputWidth_;
+    const float inputHeight_;
+};
+
+#endif // STREAM_PULL_SAMPLE_YOLOV3DECODER_H
@@ -13,14 +13,33 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <sstream>
 #include "MxBase/ErrorCode/ErrorCodes.h"
 #include "MxBase/Log/Log.h"
 #include "Yolov3Detection.h"
 
 namespace {
-    const uint32_t YUV_BYTE_NU = 3;
-    const uint32_t YUV_BYTE_DE = 2;
-    const uint32_t VPC_H_ALIGN = 2;
+    // detector input when neither the model nor the configuration gives one
+    const uint32_t DEFAULT_MODEL_INPUT_SIZE = 416;
+    const uint32_t TENSOR_POOL_WAIT_TIME = 1000;
+    const size_t NCHW_DIMS = 4;
+    const size_t GRID_W_DIM = 3;
+    const size_t GRID_H_DIM = 2;
+    // MODEL_TYPE of the SDK post-processor: 1 for NCHW outputs, otherwise NHWC
+    const uint32_t MODEL_TYPE_NCHW = 1;
+    const size_t NCHW_CHANNEL_DIM = 1;
+    const size_t NHWC_CHANNEL_DIM = 3;
+    // x, y, w, h and objectness ahead of the class scores of every anchor
+    const uint32_t YOLO_BOX_VALUES = 5;
+
+    bool IsHostMemory(MxBase::MemoryData::MemoryType type)
+    {
+        return type == MxBase::MemoryData::MEMORY_HOST || type == MxBase::MemoryData::MEMORY_HOST_NEW ||
+            type == MxBase::MemoryData::MEMORY_HOST_MALLOC;
+    }
 }
 
 // 加载标签文件
@@ -80,30 +99,44 @@ void Yolov3Detection::SetYolov3PostProcessConfig(const InitParam &initParam, std
 APP_ERROR Yolov3Detection::FrameInit(const InitParam &initParam)
 {
     deviceId = initParam.deviceId;
-    APP_ERROR ret = MxBase::DeviceManager::GetInstance()->InitDevices();
-    if (ret != APP_ERR_OK) {
-        LogError << "Init devices failed, ret=" << ret << ".";
-        return ret;
+    // 设备由调用方初始化和销毁，检测器只加载模型
+    BackendInitParam backendParam;
+    backendParam.type = initParam.backendType;
+    backendParam.deviceId = initParam.deviceId;
+    backendParam.modelPath = initParam.modelPath;
+    backendParam.inputHeight = initParam.inputHeight;
+    backendParam.inputWidth = initParam.inputWidth;
+    if (initParam.backendType == BACKEND_CPU && (initParam.inputHeight == 0 || initParam.inputWidth == 0)) {
+        backendParam.inputHeight = DEFAULT_MODEL_INPUT_SIZE;
+        backendParam.inputWidth = DEFAULT_MODEL_INPUT_SIZE;
     }
-    ret = MxBase::TensorContext::GetInstance()->SetContext(initParam.deviceId);
+    backendParam.inputScale = initParam.inputScale;
+    backend = CreateInferenceBackend(initParam.backendType);
+    APP_ERROR ret = backend->Init(backendParam);
     if (ret != APP_ERR_OK) {
-        LogError << "Set context failed, ret=" << ret << ".";
+        LogError << "Inference backend init failed, ret=" << ret << ".";
         return ret;
     }
-    yDvppWrapper = std::make_shared<MxBase::DvppWrapper>();
-    ret = yDvppWrapper->Init();
+    backend->GetInputSize(inputHeight, inputWidth);
+    // yolov3模型3个检测特征图（13 * 13 26 * 26 52 *52）的输出tensor只在初始化时申请一次
+    ret = outputPool.Init(backend->GetOutputDescs(), backend->GetOutputMemoryType(), deviceId,
+                          initParam.outputPoolSize);
     if (ret != APP_ERR_OK) {
-        LogError << "DvppWrapper init failed, ret=" << ret << ".";
+        LogError << "Output tensor pool init failed, ret=" << ret << ".";
         return ret;
     }
-    model = std::make_shared<MxBase::ModelInferenceProcessor>();
-    LogInfo << "model path: " << initParam.modelPath;
-    ret = model->Init(initParam.modelPath, modelDesc);
+    ret = CheckOutputChannels(initParam);
     if (ret != APP_ERR_OK) {
-        LogError << "ModelInferenceProcessor init failed, ret=" << ret << ".";
         return ret;
     }
 
+    if (initParam.nativeDecode) {
+        ret = InitDecoder(initParam);
+        if (ret != APP_ERR_OK) {
+            LogWarn << "Model outputs do not fit the native decoder, using Yolov3PostProcess";
+        }
+    }
+
     std::map<std::string, std::shared_ptr<void>> config;
     SetYolov3PostProcessConfig(initParam, config);
     post = std::make_shared<MxBase::Yolov3PostProcess>();
@@ -121,108 +154,223 @@ APP_ERROR Yolov3Detection::FrameInit(const InitParam &initParam)
     return APP_ERR_OK;
 }
 
-APP_ERROR Yolov3Detection::FrameDeInit()
+APP_ERROR Yolov3Detection::GetLayerAnchors(const InitParam &initParam, const std::vector<OutputTensorDesc> &descs,
+                                           std::vector<std::vector<float>> &layerAnchors)
 {
-    yDvppWrapper->DeInit();
-    model->DeInit();
-    post->DeInit();
-    MxBase::DeviceManager::GetInstance()->DestroyDevices();
+    std::vector<float> biases;
+    std::stringstream biasStream(initParam.biases);
+    std::string item;
+    while (std::getline(biasStream, item, ',')) {
+        char *end = nullptr;
+        biases.push_back(strtof(item.c_str(), &end));
+        if (item.empty() || *end != '\0') {
+            LogError << "Invalid biases: " << initParam.biases;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+    }
+    const size_t anchorValues = initParam.anchorDim * 2;
+    if (biases.size() != initParam.biasesNum || biases.size() != descs.size() * anchorValues) {
+        LogError << biases.size() << " biases do not match " << descs.size() << " outputs with "
+                 << initParam.anchorDim << " anchors";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    for (const auto &desc : descs) {
+        if (desc.shape.size() != NCHW_DIMS) {
+            LogError << "Expected NCHW outputs";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+    }
+    // 特征图越大，对应的anchor越小：52x52取前三组，13x13取最后三组
+    std::vector<size_t> order(descs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&descs](size_t a, size_t b) {
+        return descs[a].shape[GRID_W_DIM] > descs[b].shape[GRID_W_DIM];
+    });
+    layerAnchors.assign(descs.size(), std::vector<float>());
+    for (size_t k = 0; k < order.size(); k++) {
+        layerAnchors[order[k]].assign(biases.begin() + k * anchorValues, biases.begin() + (k + 1) * anchorValues);
+    }
     return APP_ERR_OK;
 }
 
-APP_ERROR Yolov3Detection::ResizeFrame(const std::shared_ptr<MxBase::MemoryData> frameInfo, const uint32_t &height,
-                                       const uint32_t &width, MxBase::TensorBase &tensor)
+APP_ERROR Yolov3Detection::CheckOutputChannels(const InitParam &initParam) const
 {
-    // 视频帧的原始数据
-    MxBase::DvppDataInfo input = {};
-    input.height = height;
-    input.width = width;
-    input.heightStride = height;
-    input.widthStride = width;
-    input.dataSize = frameInfo->size;
-    input.data = (uint8_t*)frameInfo->ptrData;
-
-    const uint32_t resizeHeight = 416;
-    const uint32_t resizeWidth = 416;
-    MxBase::ResizeConfig resize = {};
-    resize.height = resizeHeight;
-    resize.width = resizeWidth;
-
-    MxBase::DvppDataInfo output = {};
-    // 图像缩放
-    APP_ERROR ret = yDvppWrapper->VpcResize(input, output, resize);
-    if(ret != APP_ERR_OK){
-        LogError << GetError(ret) << "VpcResize failed.";
-        return ret;
+    // 类别数或anchor数配错时，SDK后处理会按错误的步长读取输出
+    uint32_t channels = initParam.anchorDim * (YOLO_BOX_VALUES + initParam.classNum);
+    size_t channelDim = initParam.modelType == MODEL_TYPE_NCHW ? NCHW_CHANNEL_DIM : NHWC_CHANNEL_DIM;
+    for (const auto &desc : backend->GetOutputDescs()) {
+        if (desc.shape.size() != NCHW_DIMS) {
+            continue;
+        }
+        if (desc.shape[channelDim] != channels) {
+            LogError << initParam.modelPath << " has " << desc.shape[channelDim] << " output channels, "
+                     << initParam.classNum << " classes with " << initParam.anchorDim << " anchors need "
+                     << channels;
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
     }
+    return APP_ERR_OK;
+}
 
-    // 缩放后的图像信息
-    MxBase::MemoryData outMemoryData((void*)output.data, output.dataSize, MxBase::MemoryData::MEMORY_DVPP, deviceId);
-    // 对缩放后图像对齐尺寸进行判定
-    if (output.heightStride % VPC_H_ALIGN != 0) {
-        LogError << "Output data height(" << output.heightStride << ") can't be divided by " << VPC_H_ALIGN << ".";
-        MxBase::MemoryHelper::MxbsFree(outMemoryData);
+APP_ERROR Yolov3Detection::InitDecoder(const InitParam &initParam)
+{
+    const std::vector<OutputTensorDesc> &descs = backend->GetOutputDescs();
+    if (initParam.classNum != 1 || initParam.anchorDim != 3 || descs.size() != YOLO_LAYER_NUM) {
+        LogWarn << "Native decoder is built for " << YOLO_LAYER_NUM << " layers, 1 class, 3 anchors";
         return APP_ERR_COMM_INVALID_PARAM;
     }
-    std::vector<uint32_t> shape = {output.heightStride * YUV_BYTE_NU / YUV_BYTE_DE, output.widthStride};
-    tensor = MxBase::TensorBase(outMemoryData, false, shape, MxBase::TENSOR_DTYPE_UINT8);
+    for (const auto &desc : descs) {
+        if (desc.shape.size() != NCHW_DIMS || desc.shape[1] != HandDecoder::LAYER_CHANNELS ||
+            desc.dtype != MxBase::TENSOR_DTYPE_FLOAT32) {
+            LogWarn << "Native decoder needs float32 [N, " << HandDecoder::LAYER_CHANNELS << ", H, W] outputs";
+            return APP_ERR_COMM_INVALID_PARAM;
+        }
+    }
+    APP_ERROR ret = GetLayerAnchors(initParam, descs, layerAnchors);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    decoder.reset(new HandDecoder(strtof(initParam.objectnessThresh.c_str(), nullptr),
+                                  strtof(initParam.scoreThresh.c_str(), nullptr),
+                                  strtof(initParam.iouThresh.c_str(), nullptr), inputWidth, inputHeight));
+    LogInfo << "Using the native YOLOv3 decoder";
+    return APP_ERR_OK;
+}
 
+APP_ERROR Yolov3Detection::FrameDeInit()
+{
+    outputPool.DeInit();
+    backend->DeInit();
+    post->DeInit();
     return APP_ERR_OK;
 }
 
+APP_ERROR Yolov3Detection::Warmup(const FrameGeometry &geometry)
+{
+    std::shared_ptr<MxBase::MemoryData> frame;
+    APP_ERROR ret = CreateWarmupFrame(backend->GetType(), deviceId, geometry, frame);
+    if (ret != APP_ERR_OK) {
+        LogError << "Failed to create the warm-up frame, ret=" << ret << ".";
+        return ret;
+    }
+    InputTensorHandle resizeFrame;
+    ret = ResizeFrame(frame, geometry, resizeFrame);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    std::vector<MxBase::TensorBase> inputs = {*resizeFrame};
+    OutputTensorHandle outputs;
+    ret = Inference(inputs, outputs);
+    if (ret != APP_ERR_OK) {
+        return ret;
+    }
+    std::vector<std::vector<MxBase::ObjectInfo>> objInfos;
+    return PostProcess(*outputs, geometry.height, geometry.width, objInfos);
+}
+
+APP_ERROR Yolov3Detection::ResizeFrame(const std::shared_ptr<MxBase::MemoryData> frameInfo,
+                                       const FrameGeometry &geometry, InputTensorHandle &tensor)
+{
+    // 图像缩放
+    return backend->Resize(frameInfo, geometry, inputHeight, inputWidth, tensor);
+}
+
+void Yolov3Detection::GetInputSize(uint32_t &height, uint32_t &width) const
+{
+    height = inputHeight;
+    width = inputWidth;
+}
+
 APP_ERROR Yolov3Detection::Inference(const std::vector<MxBase::TensorBase> &inputs,
-                                  std::vector<MxBase::TensorBase> &outputs)
+                                     OutputTensorHandle &outputs)
 {
-    auto dtypes = model->GetOutputDataType();
-    for (size_t i = 0; i < modelDesc.outputTensors.size(); ++i) {
-        std::vector<uint32_t> shape = {};
-        // yolov3模型3个检测特征图尺寸（13 * 13 26 * 26 52 *52）
-        for (size_t j = 0; j < modelDesc.outputTensors[i].tensorDims.size(); ++j) {
-            shape.push_back((uint32_t)modelDesc.outputTensors[i].tensorDims[j]);
-        }
-        // 用3个检测特征图尺寸分别构建3个数据为空的tensor
-        MxBase::TensorBase tensor(shape, dtypes[i], MxBase::MemoryData::MemoryType::MEMORY_DVPP, deviceId);
-        APP_ERROR ret = MxBase::TensorBase::TensorBaseMalloc(tensor);
-        if (ret != APP_ERR_OK) {
-            LogError << "TensorBaseMalloc failed, ret=" << ret << ".";
-            return ret;
-        }
-        outputs.push_back(tensor);
-    }
-
-    MxBase::DynamicInfo dynamicInfo = {};
-    // 设置类型为静态batch
-    dynamicInfo.dynamicType = MxBase::DynamicType::STATIC_BATCH;
-    // 记录推理操作的开始时间
-    auto startTime = std::chrono::high_resolution_clock::now();
-    if(inputs[0].GetBuffer() == nullptr){
-        LogError << "input is null";
-        return APP_ERR_FAILURE;
-    }
-    APP_ERROR ret = model->ModelInference(inputs, outputs, dynamicInfo);
-    // 记录推理操作的结束时间
-    auto endTime = std::chrono::high_resolution_clock::now();
-    double costMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
-    g_inferCost.push_back(costMs);
+    APP_ERROR ret = outputPool.Acquire(outputs, TENSOR_POOL_WAIT_TIME);
     if (ret != APP_ERR_OK) {
-        LogError << "ModelInference failed, ret=" << ret << ".";
         return ret;
     }
+    // 推理耗时由流水线的detect阶段直方图统计
+    ret = backend->Inference(inputs, *outputs);
+    if (ret != APP_ERR_OK) {
+        LogError << "Inference failed, ret=" << ret << ".";
+        return ret;
+    }
+    return APP_ERR_OK;
+}
+
+APP_ERROR Yolov3Detection::NativePostProcess(const std::vector<MxBase::TensorBase> &outputs, const uint32_t &height,
+                                             const uint32_t &width,
+                                             std::vector<std::vector<MxBase::ObjectInfo>> &objInfos)
+{
+    if (outputs.size() != YOLO_LAYER_NUM) {
+        LogError << "Expected " << YOLO_LAYER_NUM << " outputs, got " << outputs.size();
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    // Device侧输出拷贝到线程私有的Host缓冲区，帧间复用
+    static thread_local std::vector<float> hostBuffers[YOLO_LAYER_NUM];
+    MxBase::MemoryData::MemoryType memoryType = backend->GetOutputMemoryType();
+    HandDecoder::Layer layers[YOLO_LAYER_NUM];
+    for (uint32_t i = 0; i < YOLO_LAYER_NUM; i++) {
+        const MxBase::TensorBase &tensor = outputs[i];
+        std::vector<uint32_t> shape = tensor.GetShape();
+        const float *data = (const float*)tensor.GetBuffer();
+        if (!IsHostMemory(memoryType)) {
+            hostBuffers[i].resize(tensor.GetSize());
+            MxBase::MemoryData dst(hostBuffers[i].data(), tensor.GetByteSize(), MxBase::MemoryData::MEMORY_HOST,
+                                   deviceId);
+            MxBase::MemoryData src(tensor.GetBuffer(), tensor.GetByteSize(), memoryType, deviceId);
+            APP_ERROR ret = MxBase::MemoryHelper::MxbsMemcpy(dst, src, tensor.GetByteSize());
+            if (ret != APP_ERR_OK) {
+                LogError << "MxbsMemcpy failed, ret=" << ret << ".";
+                return ret;
+            }
+            data = hostBuffers[i].data();
+        }
+        layers[i].data = data;
+        layers[i].gridH = shape[GRID_H_DIM];
+        layers[i].gridW = shape[GRID_W_DIM];
+        layers[i].anchors = layerAnchors[i].data();
+    }
+    HandDecoder::Box boxes[HandDecoder::MAX_BOXES];
+    uint32_t count = decoder->Decode(layers, YOLO_LAYER_NUM, boxes);
+
+    // 归一化坐标映射回原图，结果按置信度降序
+    objInfos.assign(1, std::vector<MxBase::ObjectInfo>());
+    objInfos[0].reserve(count);
+    const float maxX = (float)width - 1;
+    const float maxY = (float)height - 1;
+    for (uint32_t i = 0; i < count; i++) {
+        MxBase::ObjectInfo info;
+        info.x0 = std::min(std::max(boxes[i].x0 * width, 0.0f), maxX);
+        info.y0 = std::min(std::max(boxes[i].y0 * height, 0.0f), maxY);
+        info.x1 = std::min(std::max(boxes[i].x1 * width, 0.0f), maxX);
+        info.y1 = std::min(std::max(boxes[i].y1 * height, 0.0f), maxY);
+        info.confidence = boxes[i].score;
+        info.classId = boxes[i].classId;
+        auto label = labelMap.find((int)boxes[i].classId);
+        if (label != labelMap.end()) {
+            info.className = label->second;
+        }
+        objInfos[0].push_back(info);
+    }
     return APP_ERR_OK;
 }
 
 APP_ERROR Yolov3Detection::PostProcess(const std::vector<MxBase::TensorBase> &outputs,const uint32_t &height,
                                        const uint32_t &width, std::vector<std::vector<MxBase::ObjectInfo>> &objInfos)
 {
+    if (decoder) {
+        return NativePostProcess(outputs, height, width, objInfos);
+    }
     // 构建ResizedImageInfo
     MxBase::ResizedImageInfo imgInfo;
     imgInfo.widthOriginal = width;
     imgInfo.heightOriginal = height;
-    imgInfo.widthResize = 416;
-    imgInfo.heightResize = 416;
+    imgInfo.widthResize = inputWidth;
+    imgInfo.heightResize = inputHeight;
     imgInfo.resizeType = MxBase::RESIZER_STRETCHING;
     std::vector<MxBase::ResizedImageInfo> imageInfoVec = {};
     imageInfoVec.push_back(imgInfo);
+    std::lock_guard<std::mutex> lock(postMutex);
     APP_ERROR ret = post->Process(outputs, objInfos, imageInfoVec);
     if (ret != APP_ERR_OK) {
         LogError << "Process failed, ret=" << ret << ".";
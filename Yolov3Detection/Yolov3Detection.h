@@ -23,9 +23,11 @@
 #include "MxBase/Tensor/TensorContext/TensorContext.h"
 #include "MxBase/ModelInfer/ModelInferenceProcessor.h"
 #include "ObjectPostProcessors/Yolov3PostProcess.h"
+#include <mutex>
 #include "opencv2/opencv.hpp"
-
-extern std::vector<double> g_inferCost;
+#include "../InferenceBackend/InferenceBackend.h"
+#include "../InferenceBackend/TensorPool.h"
+#include "Yolov3Decoder.h"
 
 struct InitParam {
     uint32_t deviceId;
@@ -42,26 +44,59 @@ struct InitParam {
     uint32_t modelType;
     uint32_t inputType;
     uint32_t anchorDim;
+    BackendType backendType = BACKEND_ASCEND;
+    // detector input size, 0 takes the .om model's own size (416 on the CPU backend)
+    uint32_t inputHeight = 0;
+    uint32_t inputWidth = 0;
+    // CPU backend input normalization
+    double inputScale = 1.0 / 255;
+    // output tensor sets recycled between frames
+    uint32_t outputPoolSize = DEFAULT_TENSOR_POOL_SIZE;
+    // in-tree single-class decoder instead of the SDK post-processor when the model layout matches
+    bool nativeDecode = true;
 };
 
+// single-class hand model, three anchors per layer
+typedef Yolov3Decoder<1, 3> HandDecoder;
+
 class Yolov3Detection {
 protected:
     APP_ERROR LoadLabels(const std::string &labelPath, std::map<int, std::string> &labelMap);
-    void SetYolov3PostProcessConfig(const InitParam &initParam, std::map<std::string, std::shared_ptr<void>> &config);
+    // every 4-D output has anchorDim * (5 + classNum) channels
+    APP_ERROR CheckOutputChannels(const InitParam &initParam) const;
+    APP_ERROR InitDecoder(const InitParam &initParam);
+    APP_ERROR NativePostProcess(const std::vector<MxBase::TensorBase> &outputs, const uint32_t &height,
+                                const uint32_t &width, std::vector<std::vector<MxBase::ObjectInfo>> &objInfos);
 public:
+    static void SetYolov3PostProcessConfig(const InitParam &initParam,
+                                           std::map<std::string, std::shared_ptr<void>> &config);
+    // biases string of InitParam → anchors of each output, matched to the outputs by grid size
+    static APP_ERROR GetLayerAnchors(const InitParam &initParam, const std::vector<OutputTensorDesc> &descs,
+                                     std::vector<std::vector<float>> &layerAnchors);
     APP_ERROR FrameInit(const InitParam &initParam);
     APP_ERROR FrameDeInit();
-    APP_ERROR ResizeFrame(const std::shared_ptr<MxBase::MemoryData> frameInfo, const uint32_t &height,
-                          const uint32_t &width, MxBase::TensorBase &tensor);
-    APP_ERROR Inference(const std::vector<MxBase::TensorBase> &inputs, std::vector<MxBase::TensorBase> &outputs);
+    // one resize, inference and post-process on a gray frame of the stream size, so the first real
+    // frame does not pay for lazy runtime allocations
+    APP_ERROR Warmup(const FrameGeometry &geometry);
+    APP_ERROR ResizeFrame(const std::shared_ptr<MxBase::MemoryData> frameInfo, const FrameGeometry &geometry,
+                          InputTensorHandle &tensor);
+    // model input, after FrameInit; a second detector with the same size can take ResizeFrame's tensor
+    void GetInputSize(uint32_t &height, uint32_t &width) const;
+    APP_ERROR Inference(const std::vector<MxBase::TensorBase> &inputs, OutputTensorHandle &outputs);
     APP_ERROR PostProcess(const std::vector<MxBase::TensorBase> &outputs,const uint32_t &height,
                           const uint32_t &width, std::vector<std::vector<MxBase::ObjectInfo>> &objInfos);
 private:
-    std::shared_ptr<MxBase::DvppWrapper> yDvppWrapper;
-    std::shared_ptr<MxBase::ModelInferenceProcessor> model;
+    std::shared_ptr<InferenceBackend> backend;
+    TensorPool outputPool;
     std::shared_ptr<MxBase::Yolov3PostProcess> post;
-    MxBase::ModelDesc modelDesc = {};
+    std::unique_ptr<HandDecoder> decoder;
+    std::vector<std::vector<float>> layerAnchors;
+    // the SDK post-processor keeps per-call state, streams share one detector
+    std::mutex postMutex;
     std::map<int, std::string> labelMap = {};
     uint32_t deviceId = 0;
+    // model input, known after FrameInit
+    uint32_t inputHeight = 0;
+    uint32_t inputWidth = 0;
 };
 #endif //STREAM_PULL_SAMPLE_YOLOV3DETECTION_H
\ No newline at end of file
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include <iostream>
+#include <chrono>
 #include <memory>
 #include <queue>
 #include <mutex>
@@ -29,145 +30,242 @@
 #include "VideoProcess/VideoProcess.h"
 #include "Yolov3Detection/Yolov3Detection.h"
 #include "ResnetDetector/ResnetDetector.h"
+#include "WorkerGroup/WorkerGroup.h"
+#include "StreamManager/StreamManager.h"
+#include "Config/AppConfig.h"
+#include "Metrics/MetricsServer.h"
+#include "Metrics/StartupTimeline.h"
+#include "Metrics/MemoryTracker.h"
+#include "AsyncLogger/AsyncLogger.h"
 
-bool VideoProcess::stopFlag = false;
-std::vector<double> g_inferCost;
 namespace {
-    const uint32_t MAX_QUEUE_LENGHT = 1000;
+    const uint32_t STOP_CHECK_INTERVAL = 1;
+    // warm-up runs on a frame of the usual camera size while the streams are still opening,
+    // the models only see the scaled input
+    const uint32_t WARMUP_FRAME_WIDTH = 1920;
+    const uint32_t WARMUP_FRAME_HEIGHT = 1080;
+    const uint64_t BYTES_PER_MB = 1024 * 1024;
+    volatile sig_atomic_t g_stopRequested = 0;
 }
 
-static void SigHandler(int signal)
+// every thread that touches the device needs the context bound first
+static APP_ERROR SetStartupDevice()
 {
-    if (signal == SIGINT) {
-        VideoProcess::stopFlag = true;
+    MxBase::DeviceContext device;
+    device.devId = VideoProcess::DEVICE_ID;
+    APP_ERROR ret = MxBase::DeviceManager::GetInstance()->SetDevice(device);
+    if (ret != APP_ERR_OK) {
+        LogError << "SetDevice failed";
     }
+    return ret;
 }
 
-    /*
-CLASS_NUM=1
-BIASES_NUM=18
-BIASES=10,13,16,30,33,23,30,61,62,45,59,119,116,90,156,198,373,326
-SCORE_THRESH=0.31
-OBJECTNESS_THRESH=0.3
-IOU_THRESH=0.45
-YOLO_TYPE=3
-ANCHOR_DIM=3
-MODEL_TYPE=1
-RESIZE_FLAG=0    
-    */
-void InitYolov3Param(InitParam &initParam, const uint32_t deviceID)
+// nothing to release when the devices were never initialized
+static APP_ERROR DestroyDevices(bool useDevice)
 {
-    initParam.deviceId = deviceID;
-    initParam.labelPath = "./model/coco.names";
-    initParam.checkTensor = true;
-    initParam.modelPath = "./model/hand.om";
-    initParam.classNum = 1;
-    initParam.biasesNum = 18;
-    initParam.biases = "10,13,16,30,33,23,30,61,62,45,59,119,116,90,156,198,373,326";
-    initParam.objectnessThresh = "0.3";
-    initParam.iouThresh = "0.45";
-    initParam.scoreThresh = "0.31";
-    initParam.yoloType = 3;
-    initParam.modelType = 1;
-    initParam.inputType = 0;
-    initParam.anchorDim = 3;
+    return useDevice ? MxBase::DeviceManager::GetInstance()->DestroyDevices() : APP_ERR_OK;
 }
-void InitResnetParam(ResnetInitParam &initParam, const uint32_t deviceID)
+
+static void SigHandler(int signal)
 {
-    initParam.deviceId = deviceID;
-    initParam.modelPath = "./model/hand_keypoint.om";
-    initParam.classNum = 21;
+    if (signal == SIGINT) {
+        g_stopRequested = 1;
+    }
 }
 
 int main(int argc, char* argv[]) {
-    std::string streamName = "rtsp://192.168.30.20/";
-    std::string clientIp = "rtsp://192.168.30.36/";
-    if(argc>1){
-        streamName = argv[1];
-    }
-    if(argc>2){
-    	clientIp = argv[2];
-    }
-    LogInfo << "begin hand detect process on :" << streamName;
-    APP_ERROR ret = MxBase::DeviceManager::GetInstance()->InitDevices();
+    StartupTimeline::GetInstance()->Reset();
+    AppConfig config;
+    APP_ERROR ret = ParseAppConfig(argc, argv, config);
     if (ret != APP_ERR_OK) {
-        LogError << "InitDevices failed";
+        PrintUsage(argv[0]);
         return ret;
     }
-    LogInfo << "InitDevices done";
-
-    auto videoProcess = std::make_shared<VideoProcess>();
-    auto yolov3 = std::make_shared<Yolov3Detection>();
-    auto resnet = std::make_shared<ResnetDetector>();
+    std::vector<StreamConfig> streamConfigs;
+    if (!config.replayPath.empty()) {
+        StreamConfig streamConfig;
+        streamConfig.url = config.replayPath;
+        streamConfig.clientIp = config.clientIp;
+        streamConfig.replayMode = config.replayMode;
+        streamConfigs.push_back(streamConfig);
+    } else if (config.streamListPath.empty()) {
+        StreamConfig streamConfig;
+        streamConfig.url = config.streamName;
+        streamConfig.clientIp = config.clientIp;
+        streamConfigs.push_back(streamConfig);
+    } else {
+        ret = LoadStreamList(config.streamListPath, streamConfigs);
+        if (ret != APP_ERR_OK) {
+            return ret;
+        }
+    }
+    // CPU推理直接读取Host侧的软解输出，省去一次拷贝
+    MxBase::MemoryData::MemoryType frameMemoryType = config.backendType == BACKEND_CPU ?
+        MxBase::MemoryData::MEMORY_HOST_NEW : MxBase::MemoryData::MEMORY_DVPP;
+    // 多路流推到同一个URL会互相覆盖，需用{stream}区分；目录输出按流号命名文件
+    if (streamConfigs.size() > 1 && config.videoSink.output.find("://") != std::string::npos &&
+        config.videoSink.output.find("{stream}") == std::string::npos) {
+        LogError << "--video-out=" << config.videoSink.output << " is shared by " << streamConfigs.size()
+                 << " streams, put {stream} in the URL";
+        return APP_ERR_COMM_INVALID_PARAM;
+    }
+    if (!config.faceModelPath.empty() && config.resultProtocol == RESULT_PROTOCOL_V1) {
+        LogWarn << "faces are only sent with --result-protocol=v2, v1 clients get hands only";
+    }
+    config.videoSink.deviceId = VideoProcess::DEVICE_ID;
+    for (auto &streamConfig : streamConfigs) {
+        streamConfig.relayRateMbps = config.relayRateMbps;
+        streamConfig.resultProtocol = config.resultProtocol;
+        streamConfig.decoderType = config.decoderType;
+        streamConfig.decodeThreads = config.decodeThreads;
+        streamConfig.frameMemoryType = frameMemoryType;
+        streamConfig.videoSink = config.videoSink;
+    }
+    LogInfo << "begin hand detect process on " << streamConfigs.size() << " stream(s) with "
+            << BackendTypeName(config.backendType) << " backend and " << DecoderTypeName(config.decoderType)
+            << " decoder";
+    // 软解输出Host内存且CPU推理时，全程不使用昇腾设备
+    bool useDevice = config.backendType == BACKEND_ASCEND || config.decoderType == DECODER_DVPP;
+    if (useDevice) {
+        {
+            StartupStep step("devices");
+            ret = MxBase::DeviceManager::GetInstance()->InitDevices();
+        }
+        if (ret != APP_ERR_OK) {
+            LogError << "InitDevices failed";
+            return ret;
+        }
+        LogInfo << "InitDevices done";
+    } else {
+        LogInfo << "decoding and inference run on the host, no Ascend device is used";
+    }
 
-    InitParam initParam;
-    InitYolov3Param(initParam, videoProcess->DEVICE_ID);
-    ResnetInitParam resInitParam;
-    InitResnetParam(resInitParam, videoProcess->DEVICE_ID);
-    // 初始化模型推理所需的配置信息
-    yolov3->FrameInit(initParam);
-    LogInfo << "Init yolo done";
-    resnet->Init(resInitParam);
-    LogInfo << "Init resnet done";
-    MxBase::DeviceContext device;
-    device.devId = videoProcess->DEVICE_ID;
-    ret = MxBase::DeviceManager::GetInstance()->SetDevice(device);
-    if (ret != APP_ERR_OK) {
-        LogError << "SetDevice failed";
-        return ret;
+    LogInfo << "decoded frame queue policy: " << QueuePolicyName(config.queuePolicy)
+            << ", depth: " << config.queueDepth;
+    StreamManager streamManager;
+    std::shared_ptr<FrameRenderer> renderer;
+    if (config.renderParam.renderEvery != 0) {
+        renderer = std::make_shared<FrameRenderer>();
+        config.renderParam.deviceId = VideoProcess::DEVICE_ID;
+        config.renderParam.bindDevice = useDevice;
     }
-    // 视频流处理
-    ret = videoProcess->StreamInit(streamName,clientIp);
+    const FrameGeometry warmupGeometry = MakeFrameGeometry(WARMUP_FRAME_WIDTH, WARMUP_FRAME_HEIGHT,
+                                                           DVPP_WIDTH_ALIGN, DVPP_HEIGHT_ALIGN);
+    // 每个设备上一份模型副本，各路流按负载固定到其中一份
+    auto workers = std::make_shared<WorkerGroup>();
+    WorkerGroupParam workerParam;
+    InitWorkerGroupParam(config, warmupGeometry, workerParam);
+    ret = workers->Init(workerParam);
     if (ret != APP_ERR_OK) {
-        LogError << "StreamInit failed";
+        DestroyDevices(useDevice);
         return ret;
     }
-
-    // 解码模块功能初始化
-    ret = videoProcess->VideoDecodeInit();
+    // 模型的加载预热与各路流的打开互不依赖，并行进行
+    APP_ERROR modelRet = APP_ERR_OK;
+    APP_ERROR streamRet = APP_ERR_OK;
+    std::thread modelInit([&]() {
+        modelRet = workers->Load();
+    });
+    std::thread streamInit([&]() {
+        StartupStep step("streams");
+        streamRet = streamManager.Init(streamConfigs, config.queuePolicy, config.queueDepth, config.handParam,
+                                       config.trackParam, config.gestureParam, workers, renderer);
+    });
+    modelInit.join();
+    streamInit.join();
+    if (modelRet != APP_ERR_OK || streamRet != APP_ERR_OK) {
+        LogError << "Startup failed";
+        if (streamRet == APP_ERR_OK) {
+            streamManager.DeInit();
+        }
+        workers->DeInit();
+        DestroyDevices(useDevice);
+        return modelRet != APP_ERR_OK ? modelRet : streamRet;
+    }
+    LogInfo << "Init " << workers->GetReplicaNum() << " model replica(s) and " << streamManager.GetStreamNum()
+            << " stream(s) done";
+    ret = useDevice ? SetStartupDevice() : APP_ERR_OK;
     if (ret != APP_ERR_OK) {
-        LogError << "VideoDecodeInit failed";
-        MxBase::DeviceManager::GetInstance()->DestroyDevices();
         return ret;
     }
 
-    auto blockingQueue = std::make_shared<BlockingQueue<std::shared_ptr<void>>>(MAX_QUEUE_LENGHT);
-    std::thread getFrame(videoProcess->GetFrames, blockingQueue, videoProcess);
-    std::thread getResult(videoProcess->GetResults, blockingQueue, yolov3,resnet, videoProcess);
-
     if (signal(SIGINT, SigHandler) == SIG_ERR) {
         LogError << "can not catch SIGINT";
         return APP_ERR_COMM_FAILURE;
     }
-
-    while (!videoProcess->stopFlag) {
-        sleep(10);
+    MetricsServer metricsServer;
+    if (config.metricsPort != 0) {
+        // 指标服务不可用时不影响推理
+        if (metricsServer.Start(config.metricsBind, (uint16_t)config.metricsPort) != APP_ERR_OK) {
+            LogWarn << "metrics endpoint disabled";
+        }
     }
-    getFrame.join();
-    getResult.join();
-
-    blockingQueue->Stop();
-    blockingQueue->Clear();
-
-    ret = yolov3->FrameDeInit();
-    if (ret != APP_ERR_OK) {
-        LogError << "FrameInit failed";
-        return ret;
+    // 逐帧日志由后台线程写出，不占用解码和推理线程
+    AsyncLogger::GetInstance()->Start();
+    // 渲染失败只影响调试图片，不影响推理
+    if (renderer != nullptr && renderer->Start(config.renderParam) != APP_ERR_OK) {
+        LogWarn << "rendering disabled";
     }
-    ret = videoProcess->StreamDeInit();
+    ret = streamManager.Start();
     if (ret != APP_ERR_OK) {
-        LogError << "StreamDeInit failed";
+        LogError << "StreamManager start failed";
+        AsyncLogger::GetInstance()->Stop();
         return ret;
     }
-    ret = videoProcess->VideoDecodeDeInit();
+    StartupTimeline::GetInstance()->Report();
+
+    bool replay = !config.replayPath.empty();
+    // 浸泡测试按时结束，期间每秒采样一次各类内存的在用字节数
+    MemorySoak soak(config.soakSeconds, (uint64_t)config.soakGrowthMb * BYTES_PER_MB);
+    auto runStart = std::chrono::steady_clock::now();
+    // 回放文件结束后自动退出
+    while (!g_stopRequested && !(replay && streamManager.IsFinished())) {
+        sleep(STOP_CHECK_INTERVAL);
+        if (config.soakSeconds == 0) {
+            continue;
+        }
+        soak.Sample();
+        if (std::chrono::steady_clock::now() - runStart >= std::chrono::seconds(config.soakSeconds)) {
+            break;
+        }
+    }
+    streamManager.Stop();
+    streamManager.Join();
+    if (renderer != nullptr) {
+        renderer->Stop();
+    }
+    AsyncLogger::GetInstance()->Stop();
+    metricsServer.Stop();
+    if (replay) {
+        streamManager.PrintReport();
+    }
+
+    ret = streamManager.DeInit();
     if (ret != APP_ERR_OK) {
-        LogError << "VideoDecodeDeInit failed";
+        LogError << "StreamManager deinit failed";
         return ret;
     }
-    ret = MxBase::DeviceManager::GetInstance()->DestroyDevices();
+    workers->DeInit();
+    // 全部释放后仍登记的缓冲区即为泄漏
+    MemoryTracker *tracker = MemoryTracker::GetInstance();
+    uint64_t leaked = tracker->GetLiveBuffers();
+    if (leaked != 0) {
+        LogWarn << leaked << " buffer(s) still live at shutdown:\n" << tracker->Dump();
+    }
+    ret = DestroyDevices(useDevice);
     if (ret != APP_ERR_OK) {
         LogError << "DestroyDevices failed";
         return ret;
     }
+    if (config.soakSeconds != 0) {
+        std::string report;
+        bool steady = soak.Check(report);
+        LogInfo << "soak memory trend:\n" << report;
+        if (!steady || leaked != 0) {
+            LogError << "soak failed: " << (steady ? "buffers leaked at shutdown" : "live buffer memory grows");
+            return APP_ERR_COMM_FAILURE;
+        }
+        LogInfo << "soak passed";
+    }
     return 0;
 }